@@ -0,0 +1,234 @@
+/*
+ * JArcDiff.cpp
+ *
+ * Copyright (C) 2002-2020 Joris Heirbaut
+ *
+ * This file is part of JojoDiff.
+ *
+ * JojoDiff is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <new>
+#include <atomic>
+#include <thread>
+using namespace std;
+
+#include "JArcDiff.h"
+#include "JDebug.h"
+#include "JFileMap.h"
+#include "JOutBin.h"
+#include "JDiff.h"
+
+namespace JojoDiff {
+
+#define IDXORG  (256 * 1024)    /**< Index 1MB per 256KB of original region */
+
+JArcDiff::JArcDiff(JDiffJob::rSet const &arSet, int aiThr, int aiVerbse)
+: mrSet(arSet), miThr(aiThr < 1 ? 1 : aiThr), miVerbse(aiVerbse)
+{}
+
+JArcDiff::~JArcDiff() {
+    free(mpSeg) ;
+    delete mpArcOrg ;
+    delete mpArcNew ;
+    delete mpFilOrg ;
+    delete mpFilNew ;
+    JFileMap::unmap(mpMapOrg, mzMapOrg) ;
+    JFileMap::unmap(mpMapNew, mzMapNew) ;
+}
+
+/*******************************************************************************
+* Open
+*******************************************************************************/
+int JArcDiff::open(const char *asFilOrg, const char *asFilNew){
+    FILE *lfFil = jfopen(asFilOrg, "rb") ;
+    if (lfFil == null)
+        return EXI_FRT ;
+    mpMapOrg = JFileMap::map(lfFil, mzMapOrg) ;
+    jfclose(lfFil) ;
+
+    lfFil = jfopen(asFilNew, "rb") ;
+    if (lfFil == null)
+        return EXI_SCD ;
+    mpMapNew = JFileMap::map(lfFil, mzMapNew) ;
+    jfclose(lfFil) ;
+
+    if (mpMapOrg == null || mpMapNew == null) {
+        if (miVerbse > 0)
+            fprintf(JDebug::stddbg, "Archive: files cannot be mapped.\n") ;
+        return EXI_ARG ;
+    }
+
+    mpFilOrg = new JFileMap(mpMapOrg, mzMapOrg, "Org") ;
+    mpFilNew = new JFileMap(mpMapNew, mzMapNew, "New") ;
+    mpArcOrg = new JArchive(*mpFilOrg, mzMapOrg) ;
+    mpArcNew = new JArchive(*mpFilNew, mzMapNew) ;
+    if (miVerbse > 0)
+        fprintf(JDebug::stddbg, "Archive: %s with %d members against %s with %d members.\n",
+                mpArcNew->getTypNam(), mpArcNew->getCnt(), mpArcOrg->getTypNam(), mpArcOrg->getCnt()) ;
+    if (mpArcOrg->getTyp() == JArchive::None || mpArcOrg->getTyp() != mpArcNew->getTyp())
+        return EXI_ARG ;
+
+    return segment() ;
+}
+
+/*******************************************************************************
+* Segments
+*******************************************************************************/
+int JArcDiff::segment(){
+    mpSeg = (rSeg *) calloc(mpArcNew->getCnt(), sizeof(rSeg)) ;
+    if (mpSeg == null) {
+#ifdef JDIFF_THROW_BAD_ALLOC
+        throw bad_alloc() ;
+#else
+        return EXI_MEM ;
+#endif
+    }
+
+    bool lbWhl = false ;        // previous segment is diffed against the whole original ?
+    for (int liMbr = 0; liMbr < mpArcNew->getCnt(); liMbr++) {
+        JArchive::rMbr const &lrNew = mpArcNew->getMbr(liMbr) ;
+        int liOrg = mpArcOrg->find(lrNew.isNam) ;
+        if (liOrg < 0 && lbWhl) {
+            mpSeg[miSegCnt - 1].izNewLen += lrNew.izLen ;
+            continue ;
+        }
+
+        rSeg &lrSeg = mpSeg[miSegCnt++] ;
+        if (liOrg >= 0) {
+            lrSeg.izOrgBeg = mpArcOrg->getMbr(liOrg).izBeg ;
+            lrSeg.izOrgLen = mpArcOrg->getMbr(liOrg).izLen ;
+            miPar ++ ;
+        } else {
+            lrSeg.izOrgBeg = 0 ;
+            lrSeg.izOrgLen = mzMapOrg ;
+        }
+        lbWhl = (liOrg < 0) ;
+        lrSeg.izNewBeg = lrNew.izBeg ;
+        lrSeg.izNewLen = lrNew.izLen ;
+        lrSeg.iiRet = EXI_ERR ;
+    }
+
+    /* The regions of the new archive start at 0 and cover it completely */
+    if (miSegCnt == 0 || mpSeg[0].izNewBeg != 0)
+        return EXI_ARG ;
+    if (miVerbse > 0)
+        fprintf(JDebug::stddbg, "Archive: %d members found in the original, %d segments.\n",
+                miPar, miSegCnt) ;
+    return 0 ;
+}
+
+/*******************************************************************************
+* One segment
+*******************************************************************************/
+void JArcDiff::diff(rSeg &arSeg, FILE *apFilTmp){
+    // an index in proportion to the original region: members are often small
+    off_t lzMbt = 1 + arSeg.izOrgLen / IDXORG ;
+    int liMbt = (lzMbt < mrSet.iiHshMbt) ? (int) lzMbt : mrSet.iiHshMbt ;
+
+    JFileMap loOrg(mpMapOrg + arSeg.izOrgBeg, arSeg.izOrgLen, "Org") ;
+    JFileMap loNew(mpMapNew + arSeg.izNewBeg, arSeg.izNewLen, "New") ;
+    JOutBin loOut(apFilTmp) ;
+    JDiff loDif(&loOrg, &loNew, &loOut, liMbt, 0,
+                mrSet.ibSrcBkt, 1, mrSet.iiMchMax, mrSet.iiMchMin,
+                mrSet.izAhdMax, mrSet.ibCmpAll, null) ;
+    loDif.setCost(mrSet.ibCst) ;
+    loDif.setDefer(mrSet.ibDfr) ;
+    loDif.setNear(mrSet.ibNer) ;
+    loDif.setAdapt(mrSet.ibAdp) ;
+
+    arSeg.izOutBeg = jftell(apFilTmp) ;
+    arSeg.iiRet = loDif.jdiff() ;
+    if (fflush(apFilTmp) != 0)
+        arSeg.iiRet = EXI_WRI ;
+    arSeg.izOutLen = jftell(apFilTmp) - arSeg.izOutBeg ;
+    arSeg.izPosOrg = loOut.getPosOrg() ;
+    arSeg.ibDta = (loOut.gzOutBytDta > 0) ;
+}
+
+/*******************************************************************************
+* Stitch the segments
+*******************************************************************************/
+int JArcDiff::stitch(FILE *apFilOut, FILE * const *apFilTmp){
+    JOutBin loCon(apFilOut) ;       // connects the segments
+
+    for (int liSeg = 0; liSeg < miSegCnt; liSeg++) {
+        rSeg const &lrSeg = mpSeg[liSeg] ;
+        int liRet = loCon.putFrg(apFilTmp[lrSeg.iiThr], lrSeg.izOutBeg, lrSeg.izOutLen,
+                                 lrSeg.izOrgBeg, lrSeg.izOrgBeg + lrSeg.izPosOrg) ;
+        if (liRet != 0)
+            return liRet ;
+    }
+    return 0 ;
+}
+
+/*******************************************************************************
+* Diff
+*******************************************************************************/
+int JArcDiff::run(FILE *apFilOut){
+    int liThrCnt = (miSegCnt < miThr) ? miSegCnt : miThr ;
+    if (liThrCnt < 1)
+        return EXI_ARG ;
+
+    /* One temporary file per thread */
+    int liRet = EXI_OK ;
+    FILE **lpFilTmp = (FILE **) calloc(liThrCnt, sizeof(FILE *)) ;
+    if (lpFilTmp == null)
+        return EXI_MEM ;
+    for (int liThr = 0; liThr < liThrCnt; liThr++) {
+        lpFilTmp[liThr] = tmpfile() ;
+        if (lpFilTmp[liThr] == null)
+            liRet = EXI_OUT ;
+    }
+
+    /* Diff the segments on a pool of threads, each thread appends to its own file */
+    if (liRet == EXI_OK) {
+        atomic<int> liNxt(0) ;
+        auto lfWrk = [&](int aiThr) {
+            for (int liSeg = liNxt++; liSeg < miSegCnt; liSeg = liNxt++) {
+                mpSeg[liSeg].iiThr = aiThr ;
+                diff(mpSeg[liSeg], lpFilTmp[aiThr]) ;
+            }
+        } ;
+        thread *lpThr = new thread[liThrCnt - 1] ;
+        for (int liThr = 1; liThr < liThrCnt; liThr++)
+            lpThr[liThr - 1] = thread(lfWrk, liThr) ;
+        lfWrk(0) ;
+        for (int liThr = 1; liThr < liThrCnt; liThr++)
+            lpThr[liThr - 1].join() ;
+        delete [] lpThr ;
+    }
+
+    /* Combine the results */
+    bool lbDta = false ;
+    for (int liSeg = 0; liSeg < miSegCnt && liRet == EXI_OK; liSeg++) {
+        if (mpSeg[liSeg].iiRet != EXI_OK)
+            liRet = mpSeg[liSeg].iiRet ;
+        else if (mpSeg[liSeg].ibDta)
+            lbDta = true ;
+    }
+    if (liRet == EXI_OK)
+        liRet = stitch(apFilOut, lpFilTmp) ;
+    if (liRet == EXI_OK)
+        liRet = lbDta ? EXI_DIF : EXI_EQL ;
+
+    for (int liThr = 0; liThr < liThrCnt; liThr++)
+        if (lpFilTmp[liThr] != null)
+            fclose(lpFilTmp[liThr]) ;
+    free(lpFilTmp) ;
+    return liRet ;
+}
+
+} /* namespace JojoDiff */
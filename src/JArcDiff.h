@@ -0,0 +1,129 @@
+/*
+ * JArcDiff.h
+ *
+ * Copyright (C) 2002-2020 Joris Heirbaut
+ *
+ * This file is part of JojoDiff.
+ *
+ * JojoDiff is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *******************************************************************************
+ * Archive-aware diff: diff two tar or cpio archives member by member, or two
+ * ELF images section by section.
+ *
+ * 1) map both archives into memory (see JFileMap) and list their members
+ *    (see JArchive),
+ * 2) cut the new archive into segments, in archive order:
+ *    - a member found (by name) in the original: diffed against that member,
+ *    - consecutive members not found: diffed together against the whole original,
+ * 3) diff the segments on a pool of threads, each with its own small index,
+ *    into a temporary file per thread,
+ * 4) stitch the segments into one plain patch: before each segment, a DEL or
+ *    BKT moves to the start of its original region.
+ *
+ * The result is a standard patch that jdiff -u applies as usual.
+ *******************************************************************************/
+
+#ifndef JARCDIFF_H_
+#define JARCDIFF_H_
+
+#include <stdio.h>
+
+#include "JDefs.h"
+#include "JDiffJob.h"
+#include "JArchive.h"
+
+namespace JojoDiff {
+
+class JArcDiff {
+public:
+    JArcDiff(JArcDiff const&) = delete;
+    JArcDiff& operator=(JArcDiff const&) = delete;
+
+    /**
+     * @brief Create an archive-aware diff.
+     *
+     * @param arSet     JDiff settings
+     * @param aiThr     Maximum number of segments to diff in parallel
+     * @param aiVerbse  Verbose level
+     */
+    JArcDiff(JDiffJob::rSet const &arSet, int aiThr, int aiVerbse);
+
+    virtual ~JArcDiff();
+
+    /**
+     * @brief Map and parse both archives.
+     *
+     * @param asFilOrg  Original archive (a regular file)
+     * @param asFilNew  New archive (a regular file)
+     * @return 0=ok, EXI_FRT/EXI_SCD when a file cannot be opened,
+     *         EXI_ARG when the files cannot be diffed as archives
+     *         (no mapping, not an archive or ELF image, different formats)
+     */
+    int open(const char *asFilOrg, const char *asFilNew);
+
+    /**
+     * @brief Diff the opened archives.
+     *
+     * @param apFilOut  Output patch file
+     * @return EXI_DIF when the archives differ, EXI_EQL when not, error code otherwise
+     */
+    int run(FILE *apFilOut);
+
+private:
+    /**
+     * One segment of the new archive
+     */
+    typedef struct {
+        off_t izOrgBeg ;        /**< start of the original region           */
+        off_t izOrgLen ;        /**< length of the original region          */
+        off_t izNewBeg ;        /**< start of the new region                */
+        off_t izNewLen ;        /**< length of the new region               */
+        int   iiThr ;           /**< thread that diffed the segment         */
+        off_t izOutBeg ;        /**< start of its patch in the thread's file */
+        off_t izOutLen ;        /**< length of its patch                    */
+        off_t izPosOrg ;        /**< original position reached by its patch */
+        bool  ibDta ;           /**< any data (MOD/INS) ?                   */
+        int   iiRet ;           /**< result                                 */
+    } rSeg ;
+
+    /** @brief Cut the new archive into segments */
+    int segment() ;
+
+    /** @brief Diff one segment into the given file */
+    void diff(rSeg &arSeg, FILE *apFilTmp) ;
+
+    /** @brief Append the segments to the output */
+    int stitch(FILE *apFilOut, FILE * const *apFilTmp) ;
+
+    JDiffJob::rSet const mrSet ;    /**< Settings                           */
+    int const miThr ;               /**< Number of parallel diffs           */
+    int const miVerbse ;            /**< Verbose level                      */
+
+    jchar *mpMapOrg = null ;        /**< Mapping of the original            */
+    off_t mzMapOrg = 0 ;            /**< Size of the original               */
+    jchar *mpMapNew = null ;        /**< Mapping of the new archive         */
+    off_t mzMapNew = 0 ;            /**< Size of the new archive            */
+    JFile *mpFilOrg = null ;        /**< Cursor on the original             */
+    JFile *mpFilNew = null ;        /**< Cursor on the new archive          */
+    JArchive *mpArcOrg = null ;     /**< Members of the original            */
+    JArchive *mpArcNew = null ;     /**< Members of the new archive         */
+
+    rSeg *mpSeg = null ;            /**< Segments, in new archive order     */
+    int miSegCnt = 0 ;              /**< Number of segments                 */
+    int miPar = 0 ;                 /**< Number of members found in the original */
+};
+
+} /* namespace JojoDiff */
+#endif /* JARCDIFF_H_ */
@@ -0,0 +1,405 @@
+/*
+ * JArchive.cpp
+ *
+ * Copyright (C) 2002-2020 Joris Heirbaut
+ *
+ * This file is part of JojoDiff.
+ *
+ * JojoDiff is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+using namespace std;
+
+#include "JArchive.h"
+
+namespace JojoDiff {
+
+#define TARBLK  512         /**< Tar block size                     */
+#define CPIHDR  110         /**< Size of a cpio newc header         */
+#define NAMMAX  4096        /**< Longest name kept                  */
+
+JArchive::JArchive(JFile &apFil, off_t azSze)
+: mpFil(apFil), mzSze(azSze)
+{
+    if (parseTar())
+        miTyp = Tar ;
+    else if (parseCpio())
+        miTyp = Cpio ;
+    else if (parseElf())
+        miTyp = Elf ;
+    else
+        miTyp = None ;
+    if (miTyp != None)
+        finish() ;
+}
+
+JArchive::~JArchive() {
+    for (int liIdx = 0; liIdx < miCnt; liIdx++)
+        free(mpMbr[liIdx].isNam) ;
+    free(mpMbr) ;
+    free(mpIdx) ;
+}
+
+const char *JArchive::getTypNam() const {
+    switch (miTyp) {
+    case Tar:  return "tar" ;
+    case Cpio: return "cpio" ;
+    case Elf:  return "elf" ;
+    default:   return "none" ;
+    }
+}
+
+/*******************************************************************************
+* Helpers
+*******************************************************************************/
+int JArchive::read(off_t azPos, jchar *apBuf, int aiLen) {
+    int liLen ;
+    for (liLen = 0; liLen < aiLen; liLen++) {
+        off_t lzPos = azPos + liLen ;
+        int liVal = mpFil.get(lzPos) ;
+        if (liVal < 0)
+            break ;
+        apBuf[liLen] = (jchar) liVal ;
+    }
+    return liLen ;
+}
+
+bool JArchive::add(const char *asNam, int aiLen, off_t azBeg) {
+    if (miCnt == miMax) {
+        int liMax = (miMax == 0) ? 256 : miMax * 2 ;
+        rMbr *lpMbr = (rMbr *) realloc(mpMbr, liMax * sizeof(rMbr)) ;
+        if (lpMbr == null)
+            return false ;
+        mpMbr = lpMbr ;
+        miMax = liMax ;
+    }
+    char *lsNam = (char *) malloc(aiLen + 1) ;
+    if (lsNam == null)
+        return false ;
+    memcpy(lsNam, asNam, aiLen) ;
+    lsNam[aiLen] = 0 ;
+    mpMbr[miCnt].isNam = lsNam ;
+    mpMbr[miCnt].izBeg = azBeg ;
+    mpMbr[miCnt].izLen = 0 ;
+    miCnt ++ ;
+    return true ;
+}
+
+/** @brief Parse a number of a tar header: octal, or base-256 (GNU, high bit set) */
+static off_t ufTarNum(jchar const *apFld, int aiLen) {
+    off_t lzVal = 0 ;
+    if (apFld[0] & 0x80) {
+        lzVal = apFld[0] & 0x3f ;
+        for (int liIdx = 1; liIdx < aiLen; liIdx++)
+            lzVal = (lzVal << 8) | apFld[liIdx] ;
+        return lzVal ;
+    }
+    int liIdx = 0 ;
+    while (liIdx < aiLen && apFld[liIdx] == ' ')
+        liIdx ++ ;
+    for (; liIdx < aiLen && apFld[liIdx] >= '0' && apFld[liIdx] <= '7'; liIdx++)
+        lzVal = (lzVal << 3) + (apFld[liIdx] - '0') ;
+    return lzVal ;
+}
+
+/** @brief Parse a number of a cpio header: 8 hexadecimal digits, -1 on error */
+static off_t ufCpiNum(jchar const *apFld) {
+    off_t lzVal = 0 ;
+    for (int liIdx = 0; liIdx < 8; liIdx++) {
+        int liVal = apFld[liIdx] ;
+        if (liVal >= '0' && liVal <= '9')      liVal -= '0' ;
+        else if (liVal >= 'a' && liVal <= 'f') liVal -= 'a' - 10 ;
+        else if (liVal >= 'A' && liVal <= 'F') liVal -= 'A' - 10 ;
+        else return -1 ;
+        lzVal = (lzVal << 4) + liVal ;
+    }
+    return lzVal ;
+}
+
+/** @brief Length of a string within a fixed-size field */
+static int ufFldLen(jchar const *apFld, int aiMax) {
+    int liLen = 0 ;
+    while (liLen < aiMax && apFld[liLen] != 0)
+        liLen ++ ;
+    return liLen ;
+}
+
+/*******************************************************************************
+* Tar
+*******************************************************************************/
+bool JArchive::parseTar() {
+    jchar lcHdr[TARBLK] ;
+    char  lcNam[NAMMAX + 256] ;
+    int   liNam = -1 ;          // length of a pending long name, -1 = none
+    off_t lzPos = 0 ;           // current header
+    off_t lzBeg = 0 ;           // start of the current member's region
+
+    while (lzPos + TARBLK <= mzSze) {
+        if (read(lzPos, lcHdr, TARBLK) != TARBLK)
+            break ;
+
+        /* Verify the checksum (the checksum field counts as spaces) */
+        off_t lzSum = 0 ;
+        for (int liIdx = 0; liIdx < TARBLK; liIdx++)
+            lzSum += (liIdx >= 148 && liIdx < 156) ? ' ' : lcHdr[liIdx] ;
+        if (lzSum != ufTarNum(&lcHdr[148], 8) || lzSum == 8 * ' ') {
+            if (miCnt == 0 && lzPos == 0)
+                return false ;      // not a tar archive
+            break ;                 // end of archive (zero blocks) or garbage
+        }
+
+        off_t lzSze = ufTarNum(&lcHdr[124], 12) ;
+        off_t lzDta = (lzSze + TARBLK - 1) / TARBLK * TARBLK ;
+        int   lcTyp = lcHdr[156] ;
+
+        if (lcTyp == 'L' || lcTyp == 'x') {
+            /* GNU long name or pax header: applies to the next member */
+            int liLen = (lzSze > NAMMAX) ? NAMMAX : (int) lzSze ;
+            jchar lcDta[NAMMAX] ;
+            liLen = read(lzPos + TARBLK, lcDta, liLen) ;
+            if (lcTyp == 'L') {
+                liNam = ufFldLen(lcDta, liLen) ;
+                memcpy(lcNam, lcDta, liNam) ;
+            } else {
+                // records "<len> path=<name>\n"
+                for (int liIdx = 0; liIdx + 6 <= liLen; liIdx++) {
+                    if (memcmp(&lcDta[liIdx], " path=", 6) == 0) {
+                        int liEnd = liIdx + 6 ;
+                        while (liEnd < liLen && lcDta[liEnd] != '\n')
+                            liEnd ++ ;
+                        liNam = liEnd - liIdx - 6 ;
+                        memcpy(lcNam, &lcDta[liIdx + 6], liNam) ;
+                        break ;
+                    }
+                }
+            }
+        } else {
+            if (liNam < 0) {
+                /* ustar: prefix "/" name */
+                liNam = 0 ;
+                if (memcmp(&lcHdr[257], "ustar", 5) == 0 && lcHdr[345] != 0) {
+                    liNam = ufFldLen(&lcHdr[345], 155) ;
+                    memcpy(lcNam, &lcHdr[345], liNam) ;
+                    lcNam[liNam++] = '/' ;
+                }
+                int liLen = ufFldLen(lcHdr, 100) ;
+                memcpy(&lcNam[liNam], lcHdr, liLen) ;
+                liNam += liLen ;
+            }
+            if (! add(lcNam, liNam, lzBeg))
+                return false ;
+            liNam = -1 ;
+            lzBeg = lzPos + TARBLK + lzDta ;
+        }
+        lzPos += TARBLK + lzDta ;
+    }
+
+    /* The end-of-archive blocks (and whatever follows) */
+    if (miCnt == 0)
+        return false ;
+    if (lzBeg < mzSze && ! add("", 0, lzBeg))
+        return false ;
+    return true ;
+}
+
+/*******************************************************************************
+* Cpio
+*******************************************************************************/
+bool JArchive::parseCpio() {
+    jchar lcHdr[CPIHDR] ;
+    jchar lcNam[NAMMAX] ;
+    off_t lzPos = 0 ;
+
+    while (lzPos + CPIHDR <= mzSze) {
+        if (read(lzPos, lcHdr, CPIHDR) != CPIHDR)
+            break ;
+        if (memcmp(lcHdr, "070701", 6) != 0 && memcmp(lcHdr, "070702", 6) != 0)
+            break ;
+
+        off_t lzSze = ufCpiNum(&lcHdr[54]) ;
+        off_t lzNam = ufCpiNum(&lcHdr[94]) ;
+        if (lzSze < 0 || lzNam <= 0)
+            break ;
+
+        int liNam = read(lzPos + CPIHDR, lcNam, (lzNam > NAMMAX) ? NAMMAX : (int) lzNam) ;
+        liNam = ufFldLen(lcNam, liNam) ;
+        if (! add((char *) lcNam, liNam, lzPos))
+            return false ;
+
+        // header and name, then data, are padded to 4 bytes
+        lzPos = (lzPos + CPIHDR + lzNam + 3) & ~ (off_t) 3 ;
+        lzPos = (lzPos + lzSze + 3) & ~ (off_t) 3 ;
+        if (liNam == 10 && memcmp(lcNam, "TRAILER!!!", 10) == 0)
+            break ;
+    }
+    return miCnt > 0 ;
+}
+
+/*******************************************************************************
+* ELF
+*******************************************************************************/
+#define SHTNOB  8           /**< SHT_NOBITS: section without file contents  */
+#define SHNXIX  0xffff      /**< SHN_XINDEX: index in the first section     */
+
+/** @brief Parse an integer of an ELF header (little or big endian) */
+static off_t ufElfNum(jchar const *apFld, int aiLen, bool abBig) {
+    off_t lzVal = 0 ;
+    for (int liIdx = 0; liIdx < aiLen; liIdx++)
+        lzVal = (lzVal << 8) | apFld[abBig ? liIdx : aiLen - 1 - liIdx] ;
+    return lzVal ;
+}
+
+/** One section, before sorting on offset */
+typedef struct {
+    off_t izOff ;
+    int   iiNam ;           /**< offset of its name in the string table, -1 = none */
+    const char *isNam ;     /**< pseudo name, when iiNam < 0 */
+} rElfSec ;
+
+static int ufCmpOff(const void *apLft, const void *apRgt) {
+    off_t lzLft = ((const rElfSec *) apLft)->izOff ;
+    off_t lzRgt = ((const rElfSec *) apRgt)->izOff ;
+    return (lzLft < lzRgt) ? -1 : (lzLft > lzRgt) ? 1 : 0 ;
+}
+
+bool JArchive::parseElf() {
+    jchar lcHdr[64] ;
+    if (read(0, lcHdr, 64) < 52 || memcmp(lcHdr, "\x7f" "ELF", 4) != 0)
+        return false ;
+    bool lb64 = (lcHdr[4] == 2) ;
+    bool lbBig = (lcHdr[5] == 2) ;
+    if ((lcHdr[4] != 1 && lcHdr[4] != 2) || (lcHdr[5] != 1 && lcHdr[5] != 2))
+        return false ;
+
+    /* Section header table: offset, entry size, count and index of the names */
+    int liW = lb64 ? 8 : 4 ;                            // size of an address
+    off_t lzShOff = ufElfNum(&lcHdr[lb64 ? 0x28 : 0x20], liW, lbBig) ;
+    int liShEnt = (int) ufElfNum(&lcHdr[lb64 ? 0x3a : 0x2e], 2, lbBig) ;
+    off_t lzShNum = ufElfNum(&lcHdr[lb64 ? 0x3c : 0x30], 2, lbBig) ;
+    int liShStr = (int) ufElfNum(&lcHdr[lb64 ? 0x3e : 0x32], 2, lbBig) ;
+    int liOffOff = lb64 ? 0x18 : 0x10 ;                 // sh_offset within an entry
+    if (lzShOff <= 0 || lzShOff >= mzSze || liShEnt < liOffOff + 2 * liW || liShEnt > 64)
+        return false ;
+
+    // extended numbering: the real values are in the first entry
+    jchar lcEnt[64] ;
+    if (read(lzShOff, lcEnt, liShEnt) != liShEnt)
+        return false ;
+    if (lzShNum == 0)
+        lzShNum = ufElfNum(&lcEnt[liOffOff + liW], liW, lbBig) ;
+    if (liShStr == SHNXIX)
+        liShStr = (int) ufElfNum(&lcEnt[liOffOff + 2 * liW], 4, lbBig) ;
+    if (lzShNum <= 0 || lzShNum > 0xffffff || lzShOff + lzShNum * liShEnt > mzSze)
+        return false ;
+
+    /* The string table with the names */
+    off_t lzStrOff = -1 ;
+    off_t lzStrLen = 0 ;
+    if (liShStr > 0 && liShStr < lzShNum && read(lzShOff + (off_t) liShStr * liShEnt, lcEnt, liShEnt) == liShEnt) {
+        lzStrOff = ufElfNum(&lcEnt[liOffOff], liW, lbBig) ;
+        lzStrLen = ufElfNum(&lcEnt[liOffOff + liW], liW, lbBig) ;
+    }
+
+    /* Sections with contents, plus the headers and the section header table */
+    rElfSec *lpSec = (rElfSec *) malloc((lzShNum + 2) * sizeof(rElfSec)) ;
+    if (lpSec == null) {
+#ifdef JDIFF_THROW_BAD_ALLOC
+        throw bad_alloc() ;
+#else
+        return false ;
+#endif
+    }
+    int liSec = 0 ;
+    lpSec[liSec++] = {0, -1, "(header)"} ;
+    lpSec[liSec++] = {lzShOff, -1, "(section headers)"} ;
+    for (off_t lzIdx = 1; lzIdx < lzShNum; lzIdx++) {
+        if (read(lzShOff + lzIdx * liShEnt, lcEnt, liShEnt) != liShEnt)
+            break ;
+        off_t lzOff = ufElfNum(&lcEnt[liOffOff], liW, lbBig) ;
+        off_t lzLen = ufElfNum(&lcEnt[liOffOff + liW], liW, lbBig) ;
+        if (ufElfNum(&lcEnt[4], 4, lbBig) == SHTNOB || lzLen == 0 || lzOff <= 0 || lzOff >= mzSze)
+            continue ;
+        lpSec[liSec++] = {lzOff, (int) ufElfNum(&lcEnt[0], 4, lbBig), null} ;
+    }
+    qsort(lpSec, liSec, sizeof(rElfSec), ufCmpOff) ;
+
+    /* One member per distinct offset, in file order */
+    bool lbOk = true ;
+    char lcNam[NAMMAX] ;
+    for (int liIdx = 0; liIdx < liSec && lbOk; liIdx++) {
+        if (liIdx > 0 && lpSec[liIdx].izOff == lpSec[liIdx - 1].izOff)
+            continue ;
+        int liNam = 0 ;
+        if (lpSec[liIdx].iiNam < 0) {
+            liNam = (int) strlen(lpSec[liIdx].isNam) ;
+            memcpy(lcNam, lpSec[liIdx].isNam, liNam) ;
+        } else if (lzStrOff > 0 && lpSec[liIdx].iiNam < lzStrLen) {
+            off_t lzNam = lzStrOff + lpSec[liIdx].iiNam ;
+            liNam = read(lzNam, (jchar *) lcNam, NAMMAX) ;
+            liNam = ufFldLen((jchar *) lcNam, liNam) ;
+        }
+        lbOk = add(lcNam, liNam, lpSec[liIdx].izOff) ;
+    }
+    free(lpSec) ;
+    return lbOk && miCnt > 1 ;
+}
+
+/*******************************************************************************
+* Index
+*******************************************************************************/
+static JArchive::rMbr const *gpSrtMbr ;     /**< members being sorted (qsort has no context) */
+
+static int ufCmpNam(const void *apLft, const void *apRgt) {
+    int liLft = *(const int *) apLft ;
+    int liRgt = *(const int *) apRgt ;
+    int liCmp = strcmp(gpSrtMbr[liLft].isNam, gpSrtMbr[liRgt].isNam) ;
+    return (liCmp != 0) ? liCmp : liLft - liRgt ;   // first member first
+}
+
+void JArchive::finish() {
+    for (int liIdx = 0; liIdx < miCnt; liIdx++)
+        mpMbr[liIdx].izLen = ((liIdx + 1 < miCnt) ? mpMbr[liIdx + 1].izBeg : mzSze) - mpMbr[liIdx].izBeg ;
+
+    mpIdx = (int *) malloc(miCnt * sizeof(int)) ;
+    if (mpIdx == null)
+        return ;
+    for (int liIdx = 0; liIdx < miCnt; liIdx++)
+        mpIdx[liIdx] = liIdx ;
+    gpSrtMbr = mpMbr ;
+    qsort(mpIdx, miCnt, sizeof(int), ufCmpNam) ;
+}
+
+int JArchive::find(const char *asNam) const {
+    if (mpIdx == null)
+        return -1 ;
+
+    // lower bound: the first member with the name
+    int liLow = 0 ;
+    int liHig = miCnt ;
+    while (liLow < liHig) {
+        int liMid = (liLow + liHig) / 2 ;
+        if (strcmp(mpMbr[mpIdx[liMid]].isNam, asNam) < 0)
+            liLow = liMid + 1 ;
+        else
+            liHig = liMid ;
+    }
+    if (liLow < miCnt && strcmp(mpMbr[mpIdx[liLow]].isNam, asNam) == 0)
+        return mpIdx[liLow] ;
+    return -1 ;
+}
+
+} /* namespace JojoDiff */
@@ -0,0 +1,119 @@
+/*
+ * JArchive.h
+ *
+ * Copyright (C) 2002-2020 Joris Heirbaut
+ *
+ * This file is part of JojoDiff.
+ *
+ * JojoDiff is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *******************************************************************************
+ * Members of a tar or cpio archive, or sections of an ELF image.
+ *
+ * The archive is read through a JFile and cut into consecutive regions, one per
+ * member: its header(s), its data and the padding up to the next member.
+ * Together, the regions cover the whole file:
+ * - tar (ustar, gnu, pax): GNU long names ('L') and pax headers ('x') belong to
+ *   the region of the member that follows them. What follows the last member
+ *   (the end-of-archive blocks) is a region with an empty name.
+ * - cpio (newc, crc): the trailer "TRAILER!!!" is the last region, up to EOF.
+ * - ELF (32/64 bit, little/big endian): one region per section with file
+ *   contents, in file order, up to the next section. The ELF and program
+ *   headers are region "(header)", the section header table is region
+ *   "(section headers)". Sections move between builds: they are paired by name.
+ *******************************************************************************/
+
+#ifndef JARCHIVE_H_
+#define JARCHIVE_H_
+
+#include "JDefs.h"
+#include "JFile.h"
+
+namespace JojoDiff {
+
+class JArchive {
+public:
+    JArchive(JArchive const&) = delete;
+    JArchive& operator=(JArchive const&) = delete;
+
+    /** Archive formats */
+    enum eTyp { None, Tar, Cpio, Elf } ;
+
+    /** One member */
+    typedef struct {
+        char  *isNam ;      /**< name (empty for the end of a tar archive)  */
+        off_t  izBeg ;      /**< start of its region in the archive         */
+        off_t  izLen ;      /**< length of its region                       */
+    } rMbr ;
+
+    /**
+     * @brief Parse an archive.
+     *
+     * @param apFil     Archive (read by position)
+     * @param azSze     Size of the archive
+     */
+    JArchive(JFile &apFil, off_t azSze);
+
+    virtual ~JArchive();
+
+    /** @brief Format found: None when the file is no tar or cpio archive or ELF image */
+    eTyp getTyp() const { return miTyp ; }
+
+    /** @brief Name of the format */
+    const char *getTypNam() const ;
+
+    /** @brief Number of members */
+    int getCnt() const { return miCnt ; }
+
+    /** @brief Member by index (in archive order) */
+    rMbr const &getMbr(int aiIdx) const { return mpMbr[aiIdx] ; }
+
+    /**
+     * @brief Find a member by name.
+     *
+     * @return index of the first member with the given name, -1 = not found
+     */
+    int find(const char *asNam) const ;
+
+private:
+    JFile &mpFil ;              /**< Archive                            */
+    off_t const mzSze ;         /**< Size of the archive                */
+    eTyp  miTyp = None ;        /**< Format                             */
+
+    rMbr *mpMbr = null ;        /**< Members, in archive order          */
+    int   miCnt = 0 ;           /**< Number of members                  */
+    int   miMax = 0 ;           /**< Allocated members                  */
+    int  *mpIdx = null ;        /**< Members sorted by name             */
+
+    /** @brief Read up to aiLen bytes at the given position, return the number read */
+    int read(off_t azPos, jchar *apBuf, int aiLen) ;
+
+    /** @brief Add a member starting at azBeg (its length follows from the next one) */
+    bool add(const char *asNam, int aiLen, off_t azBeg) ;
+
+    /** @brief Parse as tar, false = not a tar archive */
+    bool parseTar() ;
+
+    /** @brief Parse as cpio (newc), false = not a cpio archive */
+    bool parseCpio() ;
+
+    /** @brief Parse the section headers of an ELF image, false = not an ELF image */
+    bool parseElf() ;
+
+    /** @brief Set the lengths and sort the index */
+    void finish() ;
+};
+
+} /* namespace JojoDiff */
+#endif /* JARCHIVE_H_ */
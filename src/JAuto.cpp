@@ -0,0 +1,392 @@
+/*
+ * JAuto.cpp
+ *
+ * Copyright (C) 2002-2020 Joris Heirbaut
+ *
+ * This file is part of JojoDiff.
+ *
+ * JojoDiff is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+using namespace std;
+
+#include "JAuto.h"
+#include "JDiff.h"
+#include "JHashPos.h"
+#include "JSketch.h"
+#include "JFileAheadStdio.h"
+#include "JOutBin.h"
+
+namespace JojoDiff {
+
+static const hkey KEYMUL = 0x9e3779b97f4a7c15ULL ;    /**< Key mixing (Fibonacci hashing)        */
+static const int  KEYSTP = 16 ;                       /**< Repeat rate: one sample every 16 bytes */
+
+/**
+ * @brief Lookup a key in an open addressing set and add it when not found.
+ * @return true = found
+ */
+static bool ufSetAdd(hkey *apSet, long alMsk, hkey akKey, bool abAdd) {
+    if (akKey == 0)
+        akKey = 1 ;
+    for (long llIdx = (long) (akKey >> 20) & alMsk; ; llIdx = (llIdx + 1) & alMsk) {
+        if (apSet[llIdx] == akKey)
+            return true ;
+        if (apSet[llIdx] == 0) {
+            if (abAdd)
+                apSet[llIdx] = akKey ;
+            return false ;
+        }
+    }
+}
+
+JAuto::JAuto(int aiVerbse) : miVerbse(aiVerbse)
+{
+    memset(&mrOrg, 0, sizeof(mrOrg)) ;
+    memset(&mrNew, 0, sizeof(mrNew)) ;
+    memset(mzPrb, 0, sizeof(mzPrb)) ;
+    memset(mdPrb, 0, sizeof(mdPrb)) ;
+}
+
+JAuto::~JAuto() {
+    if (mpPrbOrg != null)
+        fclose(mpPrbOrg) ;
+    if (mpPrbNew != null)
+        fclose(mpPrbNew) ;
+}
+
+/*******************************************************************************
+* Presets, see main
+*******************************************************************************/
+void JAuto::better(JDiffJob::rSet &arSet) {
+    arSet.ibCmpAll = true ;
+    arSet.ibSrcBkt = true ;
+    arSet.iiSrcScn = 1 ;
+    arSet.iiMchMin *= 2 ;
+    arSet.iiMchMax *= 4 ;
+    arSet.iiHshMbt *= 4 ;
+    arSet.ilBufOrg *= 4 ;
+}
+
+void JAuto::faster(JDiffJob::rSet &arSet) {
+    if (arSet.ibCmpAll) {
+        arSet.ibCmpAll = false ;
+        arSet.ibSrcBkt = true ;
+        arSet.iiSrcScn = 1 ;
+        arSet.iiMchMin *= 2 ;
+        arSet.iiMchMax /= 2 ;
+        arSet.ilBufOrg *= 16 ;
+    } else {
+        arSet.iiSrcScn = 0 ;
+        arSet.iiMchMin /= 2 ;
+        arSet.iiMchMax /= 2 ;
+    }
+    arSet.iiHshMbt /= 2 ;
+    if (arSet.iiHshMbt < 1)
+        arSet.iiHshMbt = 1 ;
+}
+
+/*******************************************************************************
+* Sampling
+*******************************************************************************/
+int JAuto::read(FILE *apFil, rSmp &arSmp, jchar *apBuf) {
+    long llCnt[256] ;
+    memset(llCnt, 0, sizeof(llCnt)) ;
+
+    /* set of samples for the repeat rate: twice the number of samples */
+    long llSetSze = 1024 ;
+    while (llSetSze < (long) miBlk * miLen / KEYSTP * 2)
+        llSetSze *= 2 ;
+    hkey *lpSet = (hkey *) calloc(llSetSze, sizeof(hkey)) ;
+    if (lpSet == null)
+        return EXI_MEM ;
+
+    long llKey = 0, llRep = 0 ;
+    for (int liBlk = 0; liBlk < miBlk; liBlk++) {
+        jchar *lpBlk = &apBuf[(long) liBlk * miLen] ;
+        int liLen = 0 ;
+        if (mzOff[liBlk] < arSmp.izSze) {
+            if (jfseek(apFil, mzOff[liBlk], SEEK_SET) != 0) {
+                free(lpSet) ;
+                return EXI_SEK ;
+            }
+            liLen = (int) jfread(lpBlk, 1, miLen, apFil) ;
+            if (liLen < miLen && ferror(apFil)) {
+                free(lpSet) ;
+                return EXI_RED ;
+            }
+        }
+        memset(&lpBlk[liLen], 0, miLen - liLen) ;
+        arSmp.izSmp += liLen ;
+
+        hkey lkHsh = 0 ;
+        int  liEql = 0, lcPrv = EOF ;
+        for (int liPos = 0; liPos < liLen; liPos++) {
+            llCnt[lpBlk[liPos]] ++ ;
+            lkHsh = JHashPos::hash(lkHsh, lcPrv, lpBlk[liPos], liEql) ;
+            if (liPos >= SMPSZE && (liPos % KEYSTP) == 0) {
+                llKey ++ ;
+                if (ufSetAdd(lpSet, llSetSze - 1, lkHsh * KEYMUL, true))
+                    llRep ++ ;
+            }
+        }
+    }
+    free(lpSet) ;
+
+    /* entropy */
+    arSmp.idEnt = 0 ;
+    for (int liVal = 0; liVal < 256; liVal++) {
+        if (llCnt[liVal] > 0) {
+            double ldPrb = (double) llCnt[liVal] / arSmp.izSmp ;
+            arSmp.idEnt -= ldPrb * log2(ldPrb) ;
+        }
+    }
+    arSmp.idRep = (llKey > 0) ? (double) llRep / llKey : 0.0 ;
+    return 0 ;
+}
+
+int JAuto::sample(JDiffJob::rSet const &arSet, const char *asFilOrg, const char *asFilNew) {
+    FILE *lfOrg = jfopen(asFilOrg, "rb") ;
+    if (lfOrg == null)
+        return EXI_FRT ;
+    FILE *lfNew = jfopen(asFilNew, "rb") ;
+    if (lfNew == null) {
+        jfclose(lfOrg) ;
+        return EXI_SCD ;
+    }
+
+    int liRet = 0 ;
+    if (jfseek(lfOrg, 0, SEEK_END) != 0 || (mrOrg.izSze = jftell(lfOrg)) < 0
+     || jfseek(lfNew, 0, SEEK_END) != 0 || (mrNew.izSze = jftell(lfNew)) < 0)
+        liRet = EXI_SEK ;
+
+    /* sample blocks at the same offsets in both files, small files completely */
+    off_t lzMax = (mrOrg.izSze > mrNew.izSze) ? mrOrg.izSze : mrNew.izSze ;
+    if (lzMax <= (off_t) SMPCNT * SMPBLK) {
+        miBlk = 1 ;
+        miLen = (lzMax > 0) ? (int) lzMax : 1 ;
+        mzOff[0] = 0 ;
+    } else {
+        miBlk = SMPCNT ;
+        miLen = SMPBLK ;
+        for (int liBlk = 0; liBlk < miBlk; liBlk++)
+            mzOff[liBlk] = (lzMax - SMPBLK) / (SMPCNT - 1) * liBlk ;
+    }
+
+    jchar *lpOrg = null ;
+    jchar *lpNew = null ;
+    if (liRet == 0) {
+        lpOrg = (jchar *) malloc((long) miBlk * miLen) ;
+        lpNew = (jchar *) malloc((long) miBlk * miLen) ;
+        if (lpOrg == null || lpNew == null)
+            liRet = EXI_MEM ;
+    }
+    if (liRet == 0)
+        liRet = read(lfOrg, mrOrg, lpOrg) ;
+    if (liRet == 0)
+        liRet = read(lfNew, mrNew, lpNew) ;
+
+    /* alignment: equal bytes at equal offsets, bytes beyond the end of one file are not equal */
+    if (liRet == 0) {
+        long llEql = 0, llTot = 0 ;
+        for (int liBlk = 0; liBlk < miBlk; liBlk++) {
+            long llOrg = (mrOrg.izSze - mzOff[liBlk] < miLen) ? (long) (mrOrg.izSze - mzOff[liBlk]) : miLen ;
+            long llNew = (mrNew.izSze - mzOff[liBlk] < miLen) ? (long) (mrNew.izSze - mzOff[liBlk]) : miLen ;
+            if (llOrg < 0) llOrg = 0 ;
+            if (llNew < 0) llNew = 0 ;
+            jchar *lpBlkOrg = &lpOrg[(long) liBlk * miLen] ;
+            jchar *lpBlkNew = &lpNew[(long) liBlk * miLen] ;
+            for (long llPos = 0; llPos < llOrg && llPos < llNew; llPos++)
+                if (lpBlkOrg[llPos] == lpBlkNew[llPos])
+                    llEql ++ ;
+            llTot += (llOrg > llNew) ? llOrg : llNew ;
+        }
+        mdAln = (llTot > 0) ? (double) llEql / llTot : 0.0 ;
+    }
+
+    /* containment: sketches of both files, see JSketch */
+    if (liRet == 0) {
+        JSketch loSkhOrg ;
+        JSketch loSkhNew ;
+        if (jfseek(lfOrg, 0, SEEK_SET) != 0 || jfseek(lfNew, 0, SEEK_SET) != 0) {
+            liRet = EXI_SEK ;
+        } else {
+            JFileAheadStdio loFilOrg(lfOrg, "Skh", arSet.ilBufOrg, arSet.iiBlkSze, false);
+            JFileAheadStdio loFilNew(lfNew, "Skh", arSet.ilBufNew, arSet.iiBlkSze, false);
+            liRet = loSkhOrg.build(&loFilOrg) ;
+            if (liRet == 0)
+                liRet = loSkhNew.build(&loFilNew) ;
+        }
+        if (liRet == 0) {
+            if (loSkhNew.getCnt() == 0)
+                mdCnt = mdAln ;         // no samples (e.g. only runs of equal bytes)
+            else
+                mdCnt = loSkhNew.containment(loSkhOrg) ;
+            if (mdCnt < mdAln)
+                mdCnt = mdAln ;
+        }
+    }
+    free(lpOrg) ;
+    free(lpNew) ;
+
+    /* probe windows: leading bytes of both files */
+    if (liRet == 0 && mrOrg.izSze > 0 && mrNew.izSze > 0) {
+        jchar *lpBuf = (jchar *) malloc(PRBSZE) ;
+        mpPrbOrg = tmpfile() ;
+        mpPrbNew = tmpfile() ;
+        if (lpBuf != null && mpPrbOrg != null && mpPrbNew != null) {
+            mbPrb = true ;
+            for (int liFil = 0; liFil < 2 && mbPrb; liFil++) {
+                FILE *lfInp = (liFil == 0) ? lfOrg : lfNew ;
+                FILE *lfPrb = (liFil == 0) ? mpPrbOrg : mpPrbNew ;
+                size_t llLen = 0 ;
+                if (jfseek(lfInp, 0, SEEK_SET) != 0)
+                    mbPrb = false ;
+                else
+                    llLen = jfread(lpBuf, 1, PRBSZE, lfInp) ;
+                if (llLen == 0 || fwrite(lpBuf, 1, llLen, lfPrb) != llLen || fflush(lfPrb) != 0)
+                    mbPrb = false ;
+            }
+        }
+        free(lpBuf) ;
+
+        /* probe the presets on the same settings as the real diff, except for the index */
+        JDiffJob::rSet lrPrb = arSet ;
+        lrPrb.iiVerbse = 0 ;
+        lrPrb.iiHshMbt = 1 ;
+        for (int liPre = Default; liPre <= Faster && mbPrb; liPre++) {
+            JDiffJob::rSet lrSet = lrPrb ;
+            if (liPre == Better)
+                better(lrSet) ;
+            else if (liPre == Faster)
+                faster(lrSet) ;
+            mzPrb[liPre] = probe(lrSet, mdPrb[liPre]) ;
+            if (mzPrb[liPre] < 0)
+                mbPrb = false ;
+        }
+    }
+
+    jfclose(lfOrg) ;
+    jfclose(lfNew) ;
+    return liRet ;
+}
+
+off_t JAuto::probe(JDiffJob::rSet const &arSet, double &adSec) {
+    FILE *lfOut = tmpfile() ;
+    if (lfOut == null)
+        return -1 ;
+
+    chrono::steady_clock::time_point ltBeg = chrono::steady_clock::now() ;
+    int liRet ;
+    {
+        JFileAheadStdio loFilOrg(mpPrbOrg, "Org", arSet.ilBufOrg, arSet.iiBlkSze, false);
+        JFileAheadStdio loFilNew(mpPrbNew, "New", arSet.ilBufNew, arSet.iiBlkSze, false);
+        JOutBin loOut(lfOut) ;
+        JDiff loJDiff(&loFilOrg, &loFilNew, &loOut,
+                      arSet.iiHshMbt, arSet.iiVerbse,
+                      arSet.ibSrcBkt, arSet.iiSrcScn, arSet.iiMchMax, arSet.iiMchMin,
+                      arSet.izAhdMax, arSet.ibCmpAll);
+        loJDiff.setCost(arSet.ibCst) ;
+        loJDiff.setDefer(arSet.ibDfr) ;
+        loJDiff.setNear(arSet.ibNer) ;
+        loJDiff.setAdapt(arSet.ibAdp) ;
+        liRet = loJDiff.jdiff() ;
+    }
+    off_t lzSze = -1 ;
+    if (liRet == EXI_OK && fflush(lfOut) == 0)
+        lzSze = jftell(lfOut) ;
+    adSec = chrono::duration<double>(chrono::steady_clock::now() - ltBeg).count() ;
+    fclose(lfOut) ;
+    return lzSze ;
+}
+
+/*******************************************************************************
+* Tuning
+*******************************************************************************/
+void JAuto::tune(JDiffJob::rSet &arSet) {
+    off_t lzMax = (mrOrg.izSze > mrNew.izSze) ? mrOrg.izSze : mrNew.izSze ;
+
+    /* Index: one entry (16 bytes) for every 64 bytes of the original file */
+    arSet.iiHshMbt = 1 ;
+    while (arSet.iiHshMbt < 1024 && ((off_t) arSet.iiHshMbt << 20) < mrOrg.izSze / 4)
+        arSet.iiHshMbt *= 2 ;
+    if (mdAln > 0.9 && arSet.iiHshMbt > 4)
+        arSet.iiHshMbt /= 4 ;       // changes in place: most solutions are found nearby
+
+    /* Blocks and buffers: small files fit in the buffers, large files read in large blocks */
+    if (lzMax <= 1024 * 1024) {
+        arSet.iiBlkSze = 4096 ;
+        arSet.ilBufNew = (lzMax + 4095) / 4096 * 4096 + 4096 ;
+        arSet.ilBufOrg = arSet.ilBufNew ;
+    } else if (lzMax >= ((off_t) 1 << 30)) {
+        arSet.iiBlkSze = 64 * 1024 ;
+        arSet.ilBufNew = 8 * 1024 * 1024 ;
+        arSet.ilBufOrg = 16 * 1024 * 1024 ;
+    }
+
+    /* Preset */
+    if (mdCnt < 0.05 && mrNew.idEnt > 7.5) {
+        miPreset = Lazy ;           // unrelated or compressed data: searching hard will not help
+    } else if (mbPrb && mzPrb[Better] < mzPrb[Default] * 0.97
+               && mdPrb[Better] < 4 * mdPrb[Default] + 0.01) {
+        miPreset = Better ;
+    } else if (lzMax > 64 * 1024 * 1024
+               && (mbPrb ? mzPrb[Faster] <= mzPrb[Default] * 1.01 : mdAln > 0.9)) {
+        miPreset = Faster ;         // large files: avoid compares outside the buffers when it costs nothing
+    } else {
+        miPreset = Default ;
+    }
+    switch (miPreset) {
+    case Better: better(arSet) ; break ;
+    case Faster: faster(arSet) ; break ;
+    case Lazy:   faster(arSet) ; faster(arSet) ; break ;
+    default: break ;
+    }
+    if (arSet.ilBufOrg > 64 * 1024 * 1024)
+        arSet.ilBufOrg = 64 * 1024 * 1024 ;
+
+    /* Repetitive data: many samples match without being a solution, look for more matches */
+    if (mrOrg.idRep > 0.5 || mrNew.idRep > 0.5)
+        arSet.iiMchMax *= 2 ;
+    if (arSet.iiMchMax <= arSet.iiMchMin)
+        arSet.iiMchMax = arSet.iiMchMin + 1 ;
+
+    /* Lookahead: the whole buffer, see main */
+    arSet.izAhdMax = arSet.ilBufNew - arSet.iiBlkSze ;
+    if (arSet.izAhdMax < 4096)
+        arSet.izAhdMax = 4096 ;
+}
+
+void JAuto::print(FILE *apFil, JDiffJob::rSet const &arSet) const {
+    static const char * const lsPreset[] = { "default", "better (-b)", "faster (-f)", "lazy (-ff)" } ;
+
+    fprintf(apFil, "Auto: original %12" PRIzd " bytes, entropy %.2f, repeats %3.0f%%\n",
+            mrOrg.izSze, mrOrg.idEnt, mrOrg.idRep * 100) ;
+    fprintf(apFil, "Auto: new      %12" PRIzd " bytes, entropy %.2f, repeats %3.0f%%\n",
+            mrNew.izSze, mrNew.idEnt, mrNew.idRep * 100) ;
+    fprintf(apFil, "Auto: containment %3.0f%%, aligned %3.0f%%\n", mdCnt * 100, mdAln * 100) ;
+    if (mbPrb && miVerbse > 0)
+        fprintf(apFil, "Auto: probes default %" PRIzd " (%.3fs), better %" PRIzd " (%.3fs), faster %" PRIzd " (%.3fs)\n",
+                mzPrb[Default], mdPrb[Default], mzPrb[Better], mdPrb[Better], mzPrb[Faster], mdPrb[Faster]) ;
+    fprintf(apFil, "Auto: %s, index %dMb, buffers %ldkb/%ldkb, block %dkb, search %" PRIzd "kb, matches %d-%d%s\n",
+            lsPreset[miPreset], arSet.iiHshMbt, arSet.ilBufOrg / 1024, arSet.ilBufNew / 1024,
+            arSet.iiBlkSze / 1024, arSet.izAhdMax / 1024, arSet.iiMchMin, arSet.iiMchMax,
+            arSet.iiSrcScn > 0 ? "" : " (no full index)") ;
+}
+
+} /* namespace JojoDiff */
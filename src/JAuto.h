@@ -0,0 +1,150 @@
+/*
+ * JAuto.h
+ *
+ * Copyright (C) 2002-2020 Joris Heirbaut
+ *
+ * This file is part of JojoDiff.
+ *
+ * JojoDiff is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *******************************************************************************
+ * Automatic parameter tuning (--auto).
+ *
+ * A quick pre-pass samples both files before diffing:
+ * - SMPCNT blocks of SMPBLK bytes, at the same offsets in both files
+ *   (small files are read completely),
+ * - per file: size, entropy (bits per byte) and repeat rate (fraction of
+ *   samples that already occurred earlier in the same file),
+ * - between files: containment (fraction of the new file found in the original
+ *   file, estimated from a JSketch of both files, as --best-base does) and
+ *   alignment (fraction of equal bytes at equal offsets in the sample blocks).
+ * Then a few probe diffs are run on the leading PRBSZE bytes of both files
+ * with the default, better (-b) and faster (-f) presets.
+ *
+ * From those, tune() selects index size, buffer and block sizes, lookahead,
+ * number of matches and a preset. The choice is reported by print().
+ *******************************************************************************/
+
+#ifndef JAUTO_H_
+#define JAUTO_H_
+
+#include <stdio.h>
+
+#include "JDefs.h"
+#include "JDiffJob.h"
+
+namespace JojoDiff {
+
+class JAuto {
+public:
+    JAuto(JAuto const&) = delete;
+    JAuto& operator=(JAuto const&) = delete;
+
+    /**
+     * @brief Create an auto-tuner.
+     *
+     * @param aiVerbse  Verbose level
+     */
+    JAuto(int aiVerbse);
+
+    virtual ~JAuto();
+
+    /**
+     * @brief Sample both files and run the probe diffs.
+     *
+     * @param arSet     Current settings (base for the probe diffs)
+     * @param asFilOrg  Original file name (a regular file)
+     * @param asFilNew  New file name (a regular file)
+     * @return 0=ok, or an error code (EXI_FRT, EXI_SCD, EXI_SEK, EXI_RED, EXI_MEM)
+     */
+    int sample(JDiffJob::rSet const &arSet, const char *asFilOrg, const char *asFilNew);
+
+    /**
+     * @brief Replace the settings by the ones chosen from the samples.
+     */
+    void tune(JDiffJob::rSet &arSet);
+
+    /**
+     * @brief Report samples and chosen settings.
+     */
+    void print(FILE *apFil, JDiffJob::rSet const &arSet) const;
+
+    /**
+     * @brief Apply the -b (better) preset.
+     */
+    static void better(JDiffJob::rSet &arSet);
+
+    /**
+     * @brief Apply the -f (faster) preset.
+     */
+    static void faster(JDiffJob::rSet &arSet);
+
+private:
+    static const int SMPBLK = 64 * 1024 ;       /**< Sample block size                  */
+    static const int SMPCNT = 64 ;              /**< Number of sample blocks per file   */
+    static const int PRBSZE = 1024 * 1024 ;     /**< Probe diff size                    */
+
+    /** Presets */
+    enum ePreset { Default = 0, Better, Faster, Lazy } ;
+
+    /**
+     * Samples of one file
+     */
+    typedef struct {
+        off_t izSze ;               /**< file size                              */
+        off_t izSmp ;               /**< number of bytes sampled                */
+        double idEnt ;              /**< entropy in bits per byte               */
+        double idRep ;              /**< repeat rate: 0.0 to 1.0                */
+    } rSmp ;
+
+    /**
+     * @brief Read the sample blocks of a file and collect its statistics.
+     *
+     * @param apFil     File
+     * @param arSmp     out: statistics
+     * @param apBuf     out: sample blocks (SMPCNT * SMPBLK bytes)
+     * @return 0=ok, EXI_SEK or EXI_RED
+     */
+    int read(FILE *apFil, rSmp &arSmp, jchar *apBuf);
+
+    /**
+     * @brief Run a probe diff on the leading bytes of both files.
+     *
+     * @param arSet     Settings to probe
+     * @param adSec     out: elapsed time in seconds
+     * @return size of the patch, -1 on error
+     */
+    off_t probe(JDiffJob::rSet const &arSet, double &adSec);
+
+    int const miVerbse ;        /**< Verbose level                              */
+
+    rSmp mrOrg ;                /**< Samples of the original file               */
+    rSmp mrNew ;                /**< Samples of the new file                    */
+    off_t mzOff[SMPCNT] ;       /**< Offsets of the sample blocks               */
+    int miBlk = 0 ;             /**< Number of sample blocks                    */
+    int miLen = 0 ;             /**< Length of the sample blocks                */
+    double mdCnt = 0 ;          /**< Containment of new in original: 0.0 to 1.0 */
+    double mdAln = 0 ;          /**< Aligned equal bytes: 0.0 to 1.0            */
+
+    FILE *mpPrbOrg = null ;     /**< Probe window of the original file          */
+    FILE *mpPrbNew = null ;     /**< Probe window of the new file               */
+    off_t mzPrb[3] ;            /**< Probe patch sizes: Default, Better, Faster */
+    double mdPrb[3] ;           /**< Probe times in seconds                     */
+    bool mbPrb = false ;        /**< Probe diffs done ?                         */
+
+    ePreset miPreset = Default ;/**< Chosen preset                              */
+};
+
+} /* namespace JojoDiff */
+#endif /* JAUTO_H_ */
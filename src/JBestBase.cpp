@@ -0,0 +1,235 @@
+/*
+ * JBestBase.cpp
+ *
+ * Copyright (C) 2002-2020 Joris Heirbaut
+ *
+ * This file is part of JojoDiff.
+ *
+ * JojoDiff is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <new>
+#include <thread>
+#include <atomic>
+using namespace std;
+
+#include "JBestBase.h"
+#include "JFileAheadStdio.h"
+#include "JDebug.h"
+
+namespace JojoDiff {
+
+static const char gcSkhExt[] = ".jsk" ;     /**< Extension of sketch cache files */
+
+JBestBase::JBestBase(JDiffJob::rSet const &arSet, int aiTop, int aiThr, int aiSkh, int aiVerbse)
+: mrSet(arSet), miTop(aiTop < 1 ? 1 : aiTop), miThr(aiThr < 1 ? 1 : aiThr),
+  miSkh(aiSkh), miVerbse(aiVerbse)
+{}
+
+JBestBase::~JBestBase() {
+}
+
+/**
+ * Sketching reads the whole file once, sequentially, through a JFileAheadStdio.
+ * A cache file is considered valid when it matches the size and mtime of the file.
+ */
+int JBestBase::sketch(const char *asFilNam, JSketch &arSkh, bool abCch){
+    struct stat lsSta ;
+    if (stat(asFilNam, &lsSta) != 0 || ! S_ISREG(lsSta.st_mode))
+        return EXI_FRT ;
+
+    char *lcCch = null ;
+    if (abCch) {
+        lcCch = (char *) malloc(strlen(asFilNam) + sizeof(gcSkhExt)) ;
+        if (lcCch == null)
+            return EXI_MEM ;
+        strcpy(lcCch, asFilNam) ;
+        strcat(lcCch, gcSkhExt) ;
+        if (arSkh.load(lcCch, lsSta.st_size, lsSta.st_mtime)) {
+            free(lcCch) ;
+            return 0 ;
+        }
+    }
+
+    int liRet ;
+    FILE *lfFil = jfopen(asFilNam, "rb") ;
+    if (lfFil == null) {
+        liRet = EXI_FRT ;
+    } else {
+        JFileAheadStdio loFil(lfFil, "Skh", mrSet.ilBufOrg, mrSet.iiBlkSze, false);
+        liRet = arSkh.build(&loFil) ;
+        jfclose(lfFil) ;
+    }
+
+    if (liRet == 0 && lcCch != null) {
+        if (! arSkh.save(lcCch, lsSta.st_mtime) && miVerbse > 0)
+            fprintf(JDebug::stddbg, "Warning: could not write sketch cache %s.\n", lcCch) ;
+    }
+    free(lcCch) ;
+    return liRet ;
+}
+
+int JBestBase::cmpCnd(const void *apOne, const void *apTwo){
+    rCnd const *lpOne = (rCnd const *) apOne ;
+    rCnd const *lpTwo = (rCnd const *) apTwo ;
+    if (lpOne->idCnt != lpTwo->idCnt)
+        return (lpOne->idCnt > lpTwo->idCnt) ? -1 : 1 ;
+    if (lpOne->idSim != lpTwo->idSim)
+        return (lpOne->idSim > lpTwo->idSim) ? -1 : 1 ;
+    if (lpOne->izDst != lpTwo->izDst)
+        return (lpOne->izDst < lpTwo->izDst) ? -1 : 1 ;
+    return 0 ;
+}
+
+int JBestBase::select(const char *asFilNew, int aiBseCnt, char * const asBseNam[], FILE *apFilOut){
+    int liRet ;
+
+    /* Sketch the new file */
+    JSketch loSkhNew(miSkh) ;
+    liRet = sketch(asFilNew, loSkhNew, false) ;
+    if (liRet != 0) {
+        fprintf(JDebug::stddbg, "Could not sketch new file %s (a regular file is required).\n", asFilNew) ;
+        return (liRet == EXI_FRT) ? EXI_SCD : liRet ;
+    }
+
+    /* Sketch and rank the candidates */
+    rCnd *lpCnd = (rCnd *) malloc(aiBseCnt * sizeof(rCnd)) ;
+    if (lpCnd == null)
+        return EXI_MEM ;
+
+    int liCndCnt = 0 ;
+    for (int liBse = 0; liBse < aiBseCnt; liBse++) {
+        JSketch loSkhBse(miSkh) ;
+        liRet = sketch(asBseNam[liBse], loSkhBse, true) ;
+        if (liRet != 0) {
+            fprintf(JDebug::stddbg, "Warning: skipping candidate %s (could not be read).\n", asBseNam[liBse]) ;
+            continue ;
+        }
+        rCnd &lrCnd = lpCnd[liCndCnt++] ;
+        lrCnd.isNam = asBseNam[liBse] ;
+        lrCnd.izSze = loSkhBse.getSze() ;
+        lrCnd.izDst = lrCnd.izSze - loSkhNew.getSze() ;
+        if (lrCnd.izDst < 0)
+            lrCnd.izDst = - lrCnd.izDst ;
+        lrCnd.idCnt = loSkhNew.containment(loSkhBse) ;
+        lrCnd.idSim = loSkhNew.similarity(loSkhBse) ;
+    }
+    if (liCndCnt == 0) {
+        free(lpCnd) ;
+        fprintf(JDebug::stddbg, "No readable candidate base.\n") ;
+        return EXI_FRT ;
+    }
+    qsort(lpCnd, liCndCnt, sizeof(rCnd), cmpCnd) ;
+
+    if (miVerbse > 0) {
+        fprintf(JDebug::stddbg, "\nCandidate ranking (containment, resemblance, size):\n") ;
+        for (int liCnd = 0; liCnd < liCndCnt; liCnd++) {
+            fprintf(JDebug::stddbg, "%c %5.1f%% %5.1f%% " P8zd " %s\n",
+                    (liCnd < miTop) ? '*' : ' ',
+                    lpCnd[liCnd].idCnt * 100.0, lpCnd[liCnd].idSim * 100.0,
+                    lpCnd[liCnd].izSze, lpCnd[liCnd].isNam) ;
+        }
+    }
+
+    /* Diff against the top-k candidates, each into a temporary file */
+    int liJobCnt = (liCndCnt < miTop) ? liCndCnt : miTop ;
+    JDiffJob::rSet lrSet = mrSet ;
+    lrSet.iiVerbse = 0 ;            // progress output of parallel jobs would get mixed up
+
+    FILE **lpTmp = (FILE **) calloc(liJobCnt, sizeof(FILE *)) ;
+    JDiffJob **lpJob = (JDiffJob **) calloc(liJobCnt, sizeof(JDiffJob *)) ;
+    if (lpTmp == null || lpJob == null) {
+        free(lpTmp) ;
+        free(lpJob) ;
+        free(lpCnd) ;
+        return EXI_MEM ;
+    }
+    for (int liJob = 0; liJob < liJobCnt; liJob++) {
+        lpTmp[liJob] = tmpfile() ;
+        if (lpTmp[liJob] != null)
+            lpJob[liJob] = new JDiffJob(lrSet, lpCnd[liJob].isNam, asFilNew, lpTmp[liJob]) ;
+    }
+
+    /* Run the jobs on a pool of threads */
+    atomic<int> liNxt(0) ;
+    auto lfWrk = [&]() {
+        for (int liJob = liNxt++; liJob < liJobCnt; liJob = liNxt++)
+            if (lpJob[liJob] != null)
+                lpJob[liJob]->run() ;
+    } ;
+    int liThrCnt = (liJobCnt < miThr) ? liJobCnt : miThr ;
+    thread *lpThr = new thread[liThrCnt - 1] ;
+    for (int liThr = 0; liThr < liThrCnt - 1; liThr++)
+        lpThr[liThr] = thread(lfWrk) ;
+    lfWrk() ;
+    for (int liThr = 0; liThr < liThrCnt - 1; liThr++)
+        lpThr[liThr].join() ;
+    delete [] lpThr ;
+
+    /* Select the smallest patch */
+    int liBst = -1 ;
+    liRet = EXI_ERR ;
+    for (int liJob = 0; liJob < liJobCnt; liJob++) {
+        if (lpJob[liJob] == null) {
+            liRet = EXI_OUT ;
+            continue ;
+        }
+        int liJobRet = lpJob[liJob]->getRet() ;
+        if (miVerbse > 0)
+            fprintf(JDebug::stddbg, "Patch size " P8zd " (rc=%d) for %s\n",
+                    lpJob[liJob]->getOutSze(), liJobRet, lpJob[liJob]->getFilOrg()) ;
+        if (liJobRet == EXI_DIF || liJobRet == EXI_EQL) {
+            if (liBst < 0 || lpJob[liJob]->getOutSze() < lpJob[liBst]->getOutSze())
+                liBst = liJob ;
+        } else if (liBst < 0) {
+            liRet = liJobRet ;
+        }
+    }
+
+    /* Copy the smallest patch to the output */
+    if (liBst >= 0) {
+        liRet = lpJob[liBst]->getRet() ;
+        msBse = lpJob[liBst]->getFilOrg() ;
+        mzBseOutSze = lpJob[liBst]->getOutSze() ;
+
+        jchar lcBuf[32 * 1024] ;
+        size_t liLen ;
+        rewind(lpTmp[liBst]) ;
+        while ((liLen = jfread(lcBuf, 1, sizeof(lcBuf), lpTmp[liBst])) > 0) {
+            if (fwrite(lcBuf, 1, liLen, apFilOut) != liLen) {
+                liRet = EXI_WRI ;
+                break ;
+            }
+        }
+        if (ferror(lpTmp[liBst]))
+            liRet = EXI_RED ;
+        if (fflush(apFilOut) != 0)
+            liRet = EXI_WRI ;
+    }
+
+    for (int liJob = 0; liJob < liJobCnt; liJob++) {
+        delete lpJob[liJob] ;
+        if (lpTmp[liJob] != null)
+            fclose(lpTmp[liJob]) ;
+    }
+    free(lpTmp) ;
+    free(lpJob) ;
+    free(lpCnd) ;
+    return liRet ;
+}
+
+} /* namespace JojoDiff */
@@ -0,0 +1,114 @@
+/*
+ * JBestBase.h
+ *
+ * Copyright (C) 2002-2020 Joris Heirbaut
+ *
+ * This file is part of JojoDiff.
+ *
+ * JojoDiff is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *******************************************************************************
+ * Best-base selection: given a new file and a library of candidate originals,
+ * find the original that yields the smallest patch.
+ *
+ * 1) sketch the new file and all candidates (see JSketch), candidate sketches
+ *    are cached in "<candidate>.jsk" files so that they are only computed once,
+ * 2) rank the candidates on the estimated fraction of the new file they contain
+ *    (then on resemblance),
+ * 3) diff the new file against the top-k candidates, in parallel, each into
+ *    its own temporary file,
+ * 4) copy the smallest patch to the output.
+ *******************************************************************************/
+
+#ifndef JBESTBASE_H_
+#define JBESTBASE_H_
+
+#include <stdio.h>
+
+#include "JDefs.h"
+#include "JDiffJob.h"
+#include "JSketch.h"
+
+namespace JojoDiff {
+
+class JBestBase {
+public:
+    JBestBase(JBestBase const&) = delete;
+    JBestBase& operator=(JBestBase const&) = delete;
+
+    /**
+     * @brief Create a best-base selector.
+     *
+     * @param arSet     JDiff settings for the trial diffs
+     * @param aiTop     Number of best ranked candidates to diff (k)
+     * @param aiThr     Maximum number of diffs to run in parallel
+     * @param aiSkh     Sketch size (number of samples)
+     * @param aiVerbse  Verbose level
+     */
+    JBestBase(JDiffJob::rSet const &arSet, int aiTop, int aiThr, int aiSkh, int aiVerbse);
+
+    virtual ~JBestBase();
+
+    /**
+     * @brief Select the best base and write the smallest patch to the output.
+     *
+     * @param asFilNew  New file name (must be a regular file)
+     * @param aiBseCnt  Number of candidate originals
+     * @param asBseNam  Candidate original file names
+     * @param apFilOut  Output for the patch
+     * @return EXI_DIF or EXI_EQL on success, error code otherwise
+     */
+    int select(const char *asFilNew, int aiBseCnt, char * const asBseNam[], FILE *apFilOut);
+
+    /** @brief Name of the selected base (null if none) */
+    const char *getBse() const {return msBse;}
+
+    /** @brief Size of the selected patch */
+    off_t getBseOutSze() const {return mzBseOutSze;}
+
+private:
+    /**
+     * Candidate base
+     */
+    typedef struct {
+        const char *isNam ;     /**< file name                              */
+        off_t izSze ;           /**< file size                              */
+        off_t izDst ;           /**< size difference with the new file      */
+        double idCnt ;          /**< estimated containment of the new file  */
+        double idSim ;          /**< estimated resemblance with new file    */
+    } rCnd ;
+
+    /**
+     * @brief Sketch a file, using or refreshing its cache when requested.
+     * @return 0=ok, error code otherwise
+     */
+    int sketch(const char *asFilNam, JSketch &arSkh, bool abCch);
+
+    /**
+     * @brief Compare two candidates for ranking (qsort callback, best first).
+     */
+    static int cmpCnd(const void *apOne, const void *apTwo);
+
+    JDiffJob::rSet const mrSet ;    /**< Settings for the trial diffs       */
+    int const miTop ;               /**< Number of candidates to diff       */
+    int const miThr ;               /**< Number of parallel diffs           */
+    int const miSkh ;               /**< Sketch size                        */
+    int const miVerbse ;            /**< Verbose level                      */
+
+    const char *msBse = null ;      /**< Selected base                      */
+    off_t mzBseOutSze = -1 ;        /**< Selected patch size                */
+};
+
+} /* namespace JojoDiff */
+#endif /* JBESTBASE_H_ */
@@ -0,0 +1,238 @@
+/*
+ * JCpu.cpp
+ *
+ * Copyright (C) 2002-2020 Joris Heirbaut
+ *
+ * This file is part of JojoDiff.
+ *
+ * JojoDiff is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include <stdint.h>
+
+#include "JCpu.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define JCPU_X86
+#include <immintrin.h>
+#include <cpuid.h>
+#endif
+
+namespace JojoDiff {
+
+/*******************************************************************************
+* Scalar kernels: 8 bytes at a time
+*******************************************************************************/
+static long eqlLenScalar(const jchar *apOne, const jchar *apTwo, long alLen) {
+    long llPos = 0 ;
+    for ( ; llPos + 8 <= alLen; llPos += 8) {
+        uint64_t lkOne, lkTwo ;
+        memcpy(&lkOne, &apOne[llPos], 8) ;
+        memcpy(&lkTwo, &apTwo[llPos], 8) ;
+        if (lkOne != lkTwo)
+            break ;
+    }
+    while (llPos < alLen && apOne[llPos] == apTwo[llPos])
+        llPos ++ ;
+    return llPos ;
+}
+
+static long fndBytScalar(const jchar *apDta, long alLen, int acByt) {
+    const jchar *lpFnd = (const jchar *) memchr(apDta, acByt, alLen) ;
+    return (lpFnd == null) ? alLen : lpFnd - apDta ;
+}
+
+#ifdef JCPU_X86
+/*******************************************************************************
+* SSE2 kernels: 16 bytes at a time
+*******************************************************************************/
+__attribute__((target("sse2")))
+static long eqlLenSse2(const jchar *apOne, const jchar *apTwo, long alLen) {
+    long llPos = 0 ;
+    for ( ; llPos + 16 <= alLen; llPos += 16) {
+        __m128i lxOne = _mm_loadu_si128((const __m128i *) &apOne[llPos]) ;
+        __m128i lxTwo = _mm_loadu_si128((const __m128i *) &apTwo[llPos]) ;
+        unsigned int liMsk = ~_mm_movemask_epi8(_mm_cmpeq_epi8(lxOne, lxTwo)) & 0xffff ;
+        if (liMsk != 0)
+            return llPos + __builtin_ctz(liMsk) ;
+    }
+    return llPos + eqlLenScalar(&apOne[llPos], &apTwo[llPos], alLen - llPos) ;
+}
+
+__attribute__((target("sse2")))
+static long fndBytSse2(const jchar *apDta, long alLen, int acByt) {
+    __m128i lxByt = _mm_set1_epi8((char) acByt) ;
+    long llPos = 0 ;
+    for ( ; llPos + 16 <= alLen; llPos += 16) {
+        __m128i lxDta = _mm_loadu_si128((const __m128i *) &apDta[llPos]) ;
+        unsigned int liMsk = _mm_movemask_epi8(_mm_cmpeq_epi8(lxDta, lxByt)) ;
+        if (liMsk != 0)
+            return llPos + __builtin_ctz(liMsk) ;
+    }
+    return llPos + fndBytScalar(&apDta[llPos], alLen - llPos, acByt) ;
+}
+
+/*******************************************************************************
+* AVX2 kernels: 32 bytes at a time
+*******************************************************************************/
+__attribute__((target("avx2")))
+static long eqlLenAvx2(const jchar *apOne, const jchar *apTwo, long alLen) {
+    long llPos = 0 ;
+    for ( ; llPos + 32 <= alLen; llPos += 32) {
+        __m256i lxOne = _mm256_loadu_si256((const __m256i *) &apOne[llPos]) ;
+        __m256i lxTwo = _mm256_loadu_si256((const __m256i *) &apTwo[llPos]) ;
+        unsigned int liMsk = ~(unsigned int) _mm256_movemask_epi8(_mm256_cmpeq_epi8(lxOne, lxTwo)) ;
+        if (liMsk != 0)
+            return llPos + __builtin_ctz(liMsk) ;
+    }
+    return llPos + eqlLenScalar(&apOne[llPos], &apTwo[llPos], alLen - llPos) ;
+}
+
+__attribute__((target("avx2")))
+static long fndBytAvx2(const jchar *apDta, long alLen, int acByt) {
+    __m256i lxByt = _mm256_set1_epi8((char) acByt) ;
+    long llPos = 0 ;
+    for ( ; llPos + 32 <= alLen; llPos += 32) {
+        __m256i lxDta = _mm256_loadu_si256((const __m256i *) &apDta[llPos]) ;
+        unsigned int liMsk = (unsigned int) _mm256_movemask_epi8(_mm256_cmpeq_epi8(lxDta, lxByt)) ;
+        if (liMsk != 0)
+            return llPos + __builtin_ctz(liMsk) ;
+    }
+    return llPos + fndBytScalar(&apDta[llPos], alLen - llPos, acByt) ;
+}
+
+/*******************************************************************************
+* AVX-512 kernels: 64 bytes at a time, masked tail
+*******************************************************************************/
+__attribute__((target("avx512f,avx512bw")))
+static long eqlLenAvx512(const jchar *apOne, const jchar *apTwo, long alLen) {
+    long llPos = 0 ;
+    for ( ; llPos < alLen; llPos += 64) {
+        __mmask64 lkLod = (alLen - llPos >= 64) ? ~(__mmask64) 0 : ((__mmask64) 1 << (alLen - llPos)) - 1 ;
+        __m512i lxOne = _mm512_maskz_loadu_epi8(lkLod, &apOne[llPos]) ;
+        __m512i lxTwo = _mm512_maskz_loadu_epi8(lkLod, &apTwo[llPos]) ;
+        __mmask64 lkMsk = _mm512_mask_cmpneq_epi8_mask(lkLod, lxOne, lxTwo) ;
+        if (lkMsk != 0)
+            return llPos + __builtin_ctzll(lkMsk) ;
+    }
+    return alLen ;
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static long fndBytAvx512(const jchar *apDta, long alLen, int acByt) {
+    __m512i lxByt = _mm512_set1_epi8((char) acByt) ;
+    long llPos = 0 ;
+    for ( ; llPos < alLen; llPos += 64) {
+        __mmask64 lkLod = (alLen - llPos >= 64) ? ~(__mmask64) 0 : ((__mmask64) 1 << (alLen - llPos)) - 1 ;
+        __m512i lxDta = _mm512_maskz_loadu_epi8(lkLod, &apDta[llPos]) ;
+        __mmask64 lkMsk = _mm512_mask_cmpeq_epi8_mask(lkLod, lxDta, lxByt) ;
+        if (lkMsk != 0)
+            return llPos + __builtin_ctzll(lkMsk) ;
+    }
+    return alLen ;
+}
+#endif /* JCPU_X86 */
+
+/*******************************************************************************
+* Dispatch
+*******************************************************************************/
+JCpu::eCpu JCpu::giCpu = JCpu::Scalar ;
+long (*JCpu::gfEqlLen)(const jchar *, const jchar *, long) = eqlLenScalar ;
+long (*JCpu::gfFndByt)(const jchar *, long, int) = fndBytScalar ;
+
+#ifdef JCPU_X86
+/**
+ * @brief Register states enabled by the OS (XCR0), 0 when XGETBV is not available.
+ */
+static uint64_t xcr0() {
+    unsigned int liEax, liEbx, liEcx, liEdx ;
+    if (! __get_cpuid(1, &liEax, &liEbx, &liEcx, &liEdx) || (liEcx & bit_OSXSAVE) == 0)
+        return 0 ;
+    __asm__ ("xgetbv" : "=a" (liEax), "=d" (liEdx) : "c" (0)) ;
+    return ((uint64_t) liEdx << 32) | liEax ;
+}
+#endif
+
+JCpu::eCpu JCpu::detect() {
+#ifdef JCPU_X86
+    // the OS must save the YMM (SSE and AVX state) and ZMM registers (opmask and both ZMM halves)
+    uint64_t lkXcr = xcr0() ;
+    bool lbYmm = (lkXcr & 0x06) == 0x06 ;
+    bool lbZmm = (lkXcr & 0xE6) == 0xE6 ;
+
+    __builtin_cpu_init() ;
+    if (lbZmm && __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw"))
+        return Avx512 ;
+    if (lbYmm && __builtin_cpu_supports("avx2"))
+        return Avx2 ;
+    if (__builtin_cpu_supports("sse2"))
+        return Sse2 ;
+#endif
+    return Scalar ;
+}
+
+JCpu::eCpu JCpu::init(eCpu aiCpu) {
+    eCpu liMax = detect() ;
+    if (aiCpu == Auto || aiCpu > liMax)
+        aiCpu = liMax ;
+
+    switch (aiCpu) {
+#ifdef JCPU_X86
+    case Avx512:
+        gfEqlLen = eqlLenAvx512 ;
+        gfFndByt = fndBytAvx512 ;
+        break ;
+    case Avx2:
+        gfEqlLen = eqlLenAvx2 ;
+        gfFndByt = fndBytAvx2 ;
+        break ;
+    case Sse2:
+        gfEqlLen = eqlLenSse2 ;
+        gfFndByt = fndBytSse2 ;
+        break ;
+#endif
+    default:
+        aiCpu = Scalar ;
+        gfEqlLen = eqlLenScalar ;
+        gfFndByt = fndBytScalar ;
+        break ;
+    }
+    giCpu = aiCpu ;
+    return giCpu ;
+}
+
+static const char * const gsCpuNam[] = { "scalar", "sse2", "avx2", "avx512" } ;
+
+const char *JCpu::name(eCpu aiCpu) {
+    if (aiCpu < Scalar || aiCpu > Avx512)
+        return "auto" ;
+    return gsCpuNam[aiCpu] ;
+}
+
+bool JCpu::parse(const char *asNam, eCpu &aiCpu) {
+    if (strcmp(asNam, "auto") == 0) {
+        aiCpu = Auto ;
+        return true ;
+    }
+    for (int liCpu = Scalar; liCpu <= Avx512; liCpu++) {
+        if (strcmp(asNam, gsCpuNam[liCpu]) == 0) {
+            aiCpu = (eCpu) liCpu ;
+            return true ;
+        }
+    }
+    return false ;
+}
+
+} /* namespace JojoDiff */
@@ -0,0 +1,116 @@
+/*
+ * JCpu.h
+ *
+ * Copyright (C) 2002-2020 Joris Heirbaut
+ *
+ * This file is part of JojoDiff.
+ *
+ * JojoDiff is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *******************************************************************************
+ * Runtime CPU-feature dispatch for the vectorized kernels.
+ *
+ * Binaries are built for the baseline instruction set (no -march=native), so
+ * that they run everywhere. The kernels below are compiled for several
+ * instruction sets (using function target attributes) and the best variant
+ * supported by the running CPU is selected once, at startup, by init().
+ *
+ * Kernels:
+ * - eqlLen:  length of the equal prefix of two buffers, used to skip runs of
+ *            equal bytes in JDiff::jdiff and JMatchTable::check,
+ * - fndByt:  position of the first occurrence of a byte, used to copy data
+ *            up to the next ESC in JPatcht.
+ *
+ * Until init() is called, the scalar variants are used.
+ *******************************************************************************/
+
+#ifndef JCPU_H_
+#define JCPU_H_
+
+#include "JDefs.h"
+
+namespace JojoDiff {
+
+class JCpu {
+public:
+    /**
+     * Kernel variants, in increasing order of preference
+     */
+    enum eCpu { Auto = -1, Scalar = 0, Sse2, Avx2, Avx512 } ;
+
+    /**
+     * @brief Select the kernels for the running CPU.
+     *
+     * @param aiCpu     Requested variant, Auto = best supported one.
+     *                  An unsupported variant is lowered to the best supported one.
+     * @return selected variant
+     */
+    static eCpu init(eCpu aiCpu = Auto) ;
+
+    /**
+     * @brief Best variant supported by the running CPU.
+     */
+    static eCpu detect() ;
+
+    /**
+     * @brief Currently selected variant.
+     */
+    static eCpu get() { return giCpu ; }
+
+    /**
+     * @brief Name of a variant (scalar, sse2, avx2, avx512).
+     */
+    static const char *name(eCpu aiCpu) ;
+
+    /**
+     * @brief Parse a variant name (auto, scalar, sse2, avx2, avx512).
+     *
+     * @param asNam     name
+     * @param aiCpu     out: variant
+     * @return false = unknown name
+     */
+    static bool parse(const char *asNam, eCpu &aiCpu) ;
+
+    /**
+     * @brief Length of the equal prefix of two buffers.
+     *
+     * @param apOne     first buffer
+     * @param apTwo     second buffer
+     * @param alLen     number of bytes to compare
+     * @return number of leading bytes that are equal (alLen if all)
+     */
+    static inline long eqlLen(const jchar *apOne, const jchar *apTwo, long alLen) {
+        return gfEqlLen(apOne, apTwo, alLen) ;
+    }
+
+    /**
+     * @brief Find a byte in a buffer.
+     *
+     * @param apDta     buffer
+     * @param alLen     number of bytes to search
+     * @param acByt     byte to find
+     * @return position of the first occurrence of acByt (alLen if none)
+     */
+    static inline long fndByt(const jchar *apDta, long alLen, int acByt) {
+        return gfFndByt(apDta, alLen, acByt) ;
+    }
+
+private:
+    static eCpu giCpu ;                                                 /**< selected variant   */
+    static long (*gfEqlLen)(const jchar *, const jchar *, long) ;       /**< eqlLen kernel      */
+    static long (*gfFndByt)(const jchar *, long, int) ;                 /**< fndByt kernel      */
+};
+
+} /* namespace JojoDiff */
+#endif /* JCPU_H_ */
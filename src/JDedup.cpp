@@ -0,0 +1,273 @@
+/*
+ * JDedup.cpp
+ *
+ * Copyright (C) 2002-2020 Joris Heirbaut
+ *
+ * This file is part of JojoDiff.
+ *
+ * JojoDiff is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+#include <thread>
+#include <atomic>
+using namespace std;
+
+#include "JDedup.h"
+#include "JSha256.h"
+#include "JDebug.h"
+
+namespace JojoDiff {
+
+const int SEGSZE = 16 * 1024 * 1024 ;   /**< Segment size for parallel chunking (> max chunk size) */
+const int CHKMIN = 1024 ;               /**< Lowest  average chunk size */
+const int CHKMAX = 1024 * 1024 ;        /**< Highest average chunk size */
+
+JDedup::JDedup(JOutDedup * const apOut, int aiChkAvg, int aiThr, int aiVerbse)
+: mpOut(apOut), miThr(aiThr < 1 ? 1 : aiThr), miVerbse(aiVerbse)
+{
+    /* average chunk size: power of two, between CHKMIN and CHKMAX */
+    int liBit = 0 ;
+    while ((1 << liBit) < CHKMIN)
+        liBit ++ ;
+    while ((1 << liBit) < aiChkAvg && (1 << liBit) < CHKMAX)
+        liBit ++ ;
+    miChkAvg = 1 << liBit ;
+    miChkMin = miChkAvg / 4 ;
+    miChkMax = miChkAvg * 8 ;
+
+    /* normalized chunking: 2 bits more before, 2 bits less after the average size */
+    mkMskSml = ~((uint64_t) 0) << (64 - (liBit + 2)) ;
+    mkMskLrg = ~((uint64_t) 0) << (64 - (liBit - 2)) ;
+
+    /* gear table: fixed pseudo-random values (splitmix64), chunks must be reproducible */
+    uint64_t lkSed = 0x4a6f6a6f44696666ULL ;
+    for (int liIdx = 0; liIdx < 256; liIdx++) {
+        uint64_t lkVal = (lkSed += 0x9e3779b97f4a7c15ULL) ;
+        lkVal = (lkVal ^ (lkVal >> 30)) * 0xbf58476d1ce4e5b9ULL ;
+        lkVal = (lkVal ^ (lkVal >> 27)) * 0x94d049bb133111ebULL ;
+        mkGea[liIdx] = lkVal ^ (lkVal >> 31) ;
+    }
+}
+
+JDedup::~JDedup() {
+    free(mpIdx) ;
+    mpIdx = null ;
+}
+
+int JDedup::cut(const jchar *apDta, int aiLen) const {
+    if (aiLen <= miChkMin)
+        return aiLen ;
+
+    int liMax = (aiLen > miChkMax) ? miChkMax : aiLen ;
+    int liNrm = (liMax < miChkAvg) ? liMax : miChkAvg ;
+    uint64_t lkHsh = 0 ;
+    int liIdx = miChkMin ;
+
+    for (; liIdx < liNrm; liIdx++) {
+        lkHsh = (lkHsh << 1) + mkGea[apDta[liIdx]] ;
+        if ((lkHsh & mkMskSml) == 0)
+            return liIdx + 1 ;
+    }
+    for (; liIdx < liMax; liIdx++) {
+        lkHsh = (lkHsh << 1) + mkGea[apDta[liIdx]] ;
+        if ((lkHsh & mkMskLrg) == 0)
+            return liIdx + 1 ;
+    }
+    return liMax ;
+}
+
+void JDedup::chunk(rSeg &arSeg, const char *asFilNam, jchar *apBuf) const {
+    int liLen = (int) (arSeg.izEnd - arSeg.izBeg) ;
+
+    /* read the segment */
+    FILE *lfFil = jfopen(asFilNam, "rb") ;
+    if (lfFil == null) {
+        arSeg.iiRet = EXI_FRT ;
+        return ;
+    }
+    if (jfseek(lfFil, arSeg.izBeg, SEEK_SET) != 0) {
+        arSeg.iiRet = EXI_SEK ;
+    } else if (jfread(apBuf, 1, liLen, lfFil) != (size_t) liLen) {
+        arSeg.iiRet = EXI_RED ;
+    }
+    jfclose(lfFil) ;
+    if (arSeg.iiRet != 0)
+        return ;
+
+    /* chunk and hash */
+    int liMax = liLen / miChkMin + 1 ;
+    arSeg.ipChk = (rChk *) malloc(liMax * sizeof(rChk)) ;
+    if (arSeg.ipChk == null) {
+        arSeg.iiRet = EXI_MEM ;
+        return ;
+    }
+
+    jchar lcDig[JSha256::DIGSZE] ;
+    for (int liPos = 0; liPos < liLen; ) {
+        rChk &lrChk = arSeg.ipChk[arSeg.iiCnt++] ;
+        lrChk.iiLen = cut(&apBuf[liPos], liLen - liPos) ;
+        lrChk.izPos = arSeg.izBeg + liPos ;
+        lrChk.iiFil = arSeg.iiFil ;
+        JSha256::digest(&apBuf[liPos], lrChk.iiLen, lcDig) ;
+        memcpy(lrChk.icDig, lcDig, DIGSZE) ;
+        liPos += lrChk.iiLen ;
+    }
+}
+
+JDedup::rChk const *JDedup::lookup(rChk const *apChk) {
+    uint64_t lkHsh ;
+    memcpy(&lkHsh, apChk->icDig, sizeof(lkHsh)) ;
+    for (long llIdx = (long) (lkHsh & mlIdxMsk); ; llIdx = (llIdx + 1) & mlIdxMsk) {
+        rChk const *lpFnd = mpIdx[llIdx] ;
+        if (lpFnd == null) {
+            mpIdx[llIdx] = apChk ;
+            return null ;
+        }
+        if (lpFnd->iiLen == apChk->iiLen && memcmp(lpFnd->icDig, apChk->icDig, DIGSZE) == 0)
+            return lpFnd ;
+    }
+}
+
+int JDedup::dedup(int aiFilCnt, char * const asFilNam[]){
+    int liRet = 0 ;
+
+    /* Split files into segments */
+    long llSegCnt = 0 ;
+    off_t *lzFilSze = (off_t *) malloc(aiFilCnt * sizeof(off_t)) ;
+    if (lzFilSze == null)
+        return EXI_MEM ;
+    for (int liFil = 0; liFil < aiFilCnt; liFil++) {
+        FILE *lfFil = jfopen(asFilNam[liFil], "rb") ;
+        if (lfFil == null) {
+            fprintf(JDebug::stddbg, "Could not open file %s for reading.\n", asFilNam[liFil]) ;
+            free(lzFilSze) ;
+            return EXI_FRT ;
+        }
+        if (jfseek(lfFil, 0, SEEK_END) != 0 || (lzFilSze[liFil] = jftell(lfFil)) < 0) {
+            fprintf(JDebug::stddbg, "Could not seek file %s (a regular file is required).\n", asFilNam[liFil]) ;
+            jfclose(lfFil) ;
+            free(lzFilSze) ;
+            return EXI_SEK ;
+        }
+        jfclose(lfFil) ;
+        llSegCnt += (lzFilSze[liFil] + SEGSZE - 1) / SEGSZE ;
+        mzScnByt += lzFilSze[liFil] ;
+    }
+
+    rSeg *lpSeg = (rSeg *) calloc(llSegCnt > 0 ? llSegCnt : 1, sizeof(rSeg)) ;
+    if (lpSeg == null) {
+        free(lzFilSze) ;
+        return EXI_MEM ;
+    }
+    long llSeg = 0 ;
+    for (int liFil = 0; liFil < aiFilCnt; liFil++) {
+        for (off_t lzPos = 0; lzPos < lzFilSze[liFil]; lzPos += SEGSZE) {
+            lpSeg[llSeg].iiFil = liFil ;
+            lpSeg[llSeg].izBeg = lzPos ;
+            lpSeg[llSeg].izEnd = (lzFilSze[liFil] - lzPos > SEGSZE) ? lzPos + SEGSZE : lzFilSze[liFil] ;
+            llSeg ++ ;
+        }
+    }
+    free(lzFilSze) ;
+
+    /* Chunk all segments on a pool of threads */
+    atomic<long> llNxt(0) ;
+    auto lfWrk = [&]() {
+        jchar *lpBuf = (jchar *) malloc(SEGSZE) ;
+        for (long llCur = llNxt++; llCur < llSegCnt; llCur = llNxt++) {
+            if (lpBuf == null)
+                lpSeg[llCur].iiRet = EXI_MEM ;
+            else
+                chunk(lpSeg[llCur], asFilNam[lpSeg[llCur].iiFil], lpBuf) ;
+        }
+        free(lpBuf) ;
+    } ;
+    int liThrCnt = (llSegCnt < miThr) ? (int) llSegCnt : miThr ;
+    if (liThrCnt < 1)
+        liThrCnt = 1 ;
+    thread *lpThr = new thread[liThrCnt - 1] ;
+    for (int liThr = 0; liThr < liThrCnt - 1; liThr++)
+        lpThr[liThr] = thread(lfWrk) ;
+    lfWrk() ;
+    for (int liThr = 0; liThr < liThrCnt - 1; liThr++)
+        lpThr[liThr].join() ;
+    delete [] lpThr ;
+
+    /* Allocate the index: at least twice the number of chunks */
+    long llChkTot = 0 ;
+    for (llSeg = 0; llSeg < llSegCnt; llSeg++) {
+        if (lpSeg[llSeg].iiRet != 0 && liRet == 0)
+            liRet = lpSeg[llSeg].iiRet ;
+        llChkTot += lpSeg[llSeg].iiCnt ;
+    }
+    if (liRet == 0) {
+        long llIdxSze = 1024 ;
+        while (llIdxSze < llChkTot * 2)
+            llIdxSze *= 2 ;
+        mpIdx = (rChk const **) calloc(llIdxSze, sizeof(rChk *)) ;
+        mlIdxMsk = llIdxSze - 1 ;
+        if (mpIdx == null)
+            liRet = EXI_MEM ;
+    }
+
+    /* Resolve duplicates in file order, merge adjacent duplicates into regions */
+    if (liRet == 0) {
+        bool lbRng = false ;            // pending region ?
+        int liRngDup = 0, liRngSrc = 0 ;
+        off_t lzRngDup = 0, lzRngSrc = 0, lzRngLen = 0 ;
+
+        for (llSeg = 0; llSeg < llSegCnt; llSeg++) {
+            for (int liChk = 0; liChk < lpSeg[llSeg].iiCnt; liChk++) {
+                rChk const *lpChk = &lpSeg[llSeg].ipChk[liChk] ;
+                rChk const *lpFst = lookup(lpChk) ;
+                mlChkCnt ++ ;
+                if (lpFst != null && lbRng
+                        && lpChk->iiFil == liRngDup && lpChk->izPos == lzRngDup + lzRngLen
+                        && lpFst->iiFil == liRngSrc && lpFst->izPos == lzRngSrc + lzRngLen) {
+                    lzRngLen += lpChk->iiLen ;
+                    continue ;
+                }
+                if (lbRng) {
+                    mpOut->put(asFilNam[liRngDup], lzRngDup, asFilNam[liRngSrc], lzRngSrc, lzRngLen) ;
+                    lbRng = false ;
+                }
+                if (lpFst == null) {
+                    mlUnqCnt ++ ;
+                } else {
+                    lbRng = true ;
+                    liRngDup = lpChk->iiFil ;
+                    lzRngDup = lpChk->izPos ;
+                    liRngSrc = lpFst->iiFil ;
+                    lzRngSrc = lpFst->izPos ;
+                    lzRngLen = lpChk->iiLen ;
+                }
+            }
+        }
+        if (lbRng)
+            mpOut->put(asFilNam[liRngDup], lzRngDup, asFilNam[liRngSrc], lzRngSrc, lzRngLen) ;
+    }
+
+    for (llSeg = 0; llSeg < llSegCnt; llSeg++)
+        free(lpSeg[llSeg].ipChk) ;
+    free(lpSeg) ;
+
+    if (liRet != 0)
+        return liRet ;
+    return (mlChkCnt > mlUnqCnt) ? EXI_DIF : EXI_EQL ;
+}
+
+} /* namespace JojoDiff */
@@ -0,0 +1,157 @@
+/*
+ * JDedup.h
+ *
+ * Copyright (C) 2002-2020 Joris Heirbaut
+ *
+ * This file is part of JojoDiff.
+ *
+ * JojoDiff is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *******************************************************************************
+ * Deduplication: find duplicate regions within and across files.
+ *
+ * Files are cut into content-defined chunks (FastCDC):
+ * - a gear hash  h = (h << 1) + G[byte]  is rolled over the data, so that the
+ *   highest bit of h depends on the last 64 bytes only,
+ * - a chunk ends where the high bits of h are all zero. Normalized chunking uses
+ *   a stricter mask before the average chunk size and a looser one after it,
+ *   which narrows the chunk size distribution,
+ * - chunks are never smaller than avg/4 (the first avg/4 bytes are not even
+ *   hashed) nor larger than avg*8.
+ * Because cut points depend on the content only, an insertion only changes the
+ * chunks around it: equal data yields equal chunks, whatever its position.
+ *
+ * Every chunk gets a SHA-256 digest. A chunk whose digest has been seen before is
+ * a duplicate of that first occurrence. Adjacent duplicate chunks that also have
+ * adjacent first occurrences are merged into one duplicate region, which is sent
+ * to JOutDedup.
+ *
+ * Chunking and hashing run in parallel: files are split into segments of SEGSZE
+ * bytes that are processed by a pool of threads. Segment starts are forced cut
+ * points, chunking resynchronizes with the content after the first cut.
+ * Duplicates are resolved afterwards, in file order, by a single thread.
+ *******************************************************************************/
+
+#ifndef JDEDUP_H_
+#define JDEDUP_H_
+
+#include <stdint.h>
+
+#include "JDefs.h"
+#include "JOutDedup.h"
+
+namespace JojoDiff {
+
+class JDedup {
+public:
+    JDedup(JDedup const&) = delete;
+    JDedup& operator=(JDedup const&) = delete;
+
+    /**
+     * @brief Create a deduplication engine.
+     *
+     * @param apOut     Output for duplicate regions
+     * @param aiChkAvg  Average chunk size in bytes (rounded to a power of two)
+     * @param aiThr     Number of chunking threads
+     * @param aiVerbse  Verbose level
+     */
+    JDedup(JOutDedup * const apOut, int aiChkAvg, int aiThr, int aiVerbse);
+
+    virtual ~JDedup();
+
+    /**
+     * @brief Chunk the given files and report all duplicate regions.
+     *
+     * @param aiFilCnt  Number of files
+     * @param asFilNam  File names (regular files)
+     * @return EXI_DIF = duplicates found, EXI_EQL = no duplicates, or an error code
+     */
+    int dedup(int aiFilCnt, char * const asFilNam[]);
+
+    /* statistics */
+    off_t getScnByt() const {return mzScnByt;}  /**< number of bytes scanned    */
+    long  getChkCnt() const {return mlChkCnt;}  /**< number of chunks           */
+    long  getUnqCnt() const {return mlUnqCnt;}  /**< number of unique chunks    */
+    int   getChkAvg() const {return miChkAvg;}  /**< average chunk size         */
+
+private:
+    static const int DIGSZE = 16 ;              /**< digest bytes kept (truncated SHA-256) */
+
+    /**
+     * Chunk
+     */
+    typedef struct {
+        off_t izPos ;               /**< position in file               */
+        int   iiLen ;               /**< length                         */
+        int   iiFil ;               /**< file index                     */
+        jchar icDig[DIGSZE] ;       /**< digest                         */
+    } rChk ;
+
+    /**
+     * Segment: unit of parallel work
+     */
+    typedef struct {
+        int   iiFil ;               /**< file index                     */
+        off_t izBeg ;               /**< first position                 */
+        off_t izEnd ;               /**< position after last byte       */
+        rChk  *ipChk ;              /**< chunks found                   */
+        int   iiCnt ;               /**< number of chunks               */
+        int   iiRet ;               /**< result: 0 or error code        */
+    } rSeg ;
+
+    /**
+     * @brief Find the next cut point (FastCDC).
+     *
+     * @param apDta     data
+     * @param aiLen     number of bytes available
+     * @return length of the chunk
+     */
+    int cut(const jchar *apDta, int aiLen) const ;
+
+    /**
+     * @brief Read, chunk and hash one segment (runs on a worker thread).
+     *
+     * @param arSeg     segment to process
+     * @param asFilNam  name of the segment's file
+     * @param apBuf     work buffer of SEGSZE bytes
+     */
+    void chunk(rSeg &arSeg, const char *asFilNam, jchar *apBuf) const ;
+
+    /**
+     * @brief Lookup a chunk in the index and insert it when not found.
+     * @return first occurrence, or null when the chunk is new
+     */
+    rChk const *lookup(rChk const *apChk) ;
+
+    JOutDedup * const mpOut ;   /**< Output                                     */
+    int miChkAvg ;              /**< Average chunk size                         */
+    int miChkMin ;              /**< Minimum chunk size                         */
+    int miChkMax ;              /**< Maximum chunk size                         */
+    uint64_t mkMskSml ;         /**< Cut mask for chunks below average size     */
+    uint64_t mkMskLrg ;         /**< Cut mask for chunks above average size     */
+    uint64_t mkGea[256] ;       /**< Gear table                                 */
+    int const miThr ;           /**< Number of threads                          */
+    int const miVerbse ;        /**< Verbose level                              */
+
+    rChk const **mpIdx = null ; /**< Index: open addressing on digest           */
+    long mlIdxMsk = 0 ;         /**< Index size - 1 (size is a power of two)    */
+
+    /* Statistics */
+    off_t mzScnByt = 0 ;        /**< Bytes scanned                              */
+    long  mlChkCnt = 0 ;        /**< Chunks                                     */
+    long  mlUnqCnt = 0 ;        /**< Unique chunks                              */
+};
+
+} /* namespace JojoDiff */
+#endif /* JDEDUP_H_ */
@@ -19,6 +19,8 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include "JDefs.h"
+
 namespace JojoDiff {
 
 /* List of primes we select from when size is specified on commandline
@@ -34,11 +36,11 @@ const int giPme[24] = { 2147483647, 1073741789, 536870909,  268435399,
 * @param   number     Number to check
 * @return  true = a prime, false = not a prime
 */
-bool isPrime(int number){
+bool isPrime(off_t number){
     if(number < 2) return 0;
     if(number == 2) return 1;
     if(number % 2 == 0) return 0;
-    for(int  i=3; number/i >= i; i+=2){
+    for(off_t i=3; number/i >= i; i+=2){
         if(number % i == 0 ) return false;
     }
     return true;
@@ -47,11 +49,11 @@ bool isPrime(int number){
 /**
 * @brief Get highest lower prime.
 *
-* @param    aiNum   number to get a prime for
-* @return   > 0     largest prime lower than aiNum
+* @param    azNum   number to get a prime for
+* @return   > 0     largest prime lower than azNum
 */
-int getLowerPrime(int aiNum){
-    switch (aiNum){
+off_t getLowerPrime(off_t azNum){
+    switch (azNum){
         case 1024: return 1021 ;
         case  32 * 1024 * 1024  : return 33554393 ;
         case  16 * 1024 * 1024  : return 16777213 ;
@@ -59,11 +61,11 @@ int getLowerPrime(int aiNum){
         case 128 * 1024 * 1024 : return 134217689 ;
         case 512 * 1024 * 1024 : return 536870909 ;
         default:
-            for (; aiNum > 0; aiNum --)
-                if (isPrime(aiNum))
-                    return aiNum ;
+            for (; azNum > 0; azNum --)
+                if (isPrime(azNum))
+                    return azNum ;
     }
-    return aiNum;
+    return azNum;
 }
 
 } /* namespace JojoDiff */
@@ -46,7 +46,9 @@
  *   JDIFF_LARGEFILE        to support files > 2GB
  *   JDIFF_STDIO_ONLY       to remove istream support
  *   JDIFF_THROW_BAD_ALLOC  to throw bad alloc exception when a malloc fails
- *   JDIFF_DEDUP            to include deduplication feature (linux only)
+ *   JDIFF_DEDUP            to include deduplication feature
+ *   JDIFF_PROBES           to include USDT probes (see JProbe.h)
+ *   JDIFF_NO_PROBES        to leave them out
  */
 
 // Indicate JDIFF that files may be larger that 2GB
@@ -76,9 +78,14 @@
 #endif // __MINGW64__
 
 // Include deduplication feature ?
-#ifdef __linux__
-//#define JDIFF_DEDUP
-#endif // __linux__
+#define JDIFF_DEDUP
+
+// Include USDT probes when systemtap's <sys/sdt.h> is available ?
+#if defined(__linux__) && defined(__has_include) && ! defined(JDIFF_NO_PROBES)
+#if __has_include(<sys/sdt.h>)
+#define JDIFF_PROBES
+#endif
+#endif
 
 /*
  * Some utilities
@@ -175,10 +182,10 @@ namespace JojoDiff {
     /**
     * @brief Get highest lower prime.
     *
-    * @param    aiNum   number to get a prime for
-    * @return   > 0     largest prime lower than aiNum
+    * @param    azNum   number to get a prime for
+    * @return   > 0     largest prime lower than azNum
     */
-    int getLowerPrime(int aiNum) ;
+    off_t getLowerPrime(off_t azNum) ;
 
 } /* namespace jojodiff */
 
@@ -27,6 +27,7 @@
  * If you want to reuse JojoDiff, you need following files:
  * - JDiff.h/cpp        The main JojoDiff class
  * - JHashPos.h/cpp     The hash table collection of (sample-key, position)
+ * - JHashNear.h/cpp    The near index around the read position
  * - JMatchTable.h/cpp  The matching table logic
  * - JDefs.h            Global definitions
  * - JDebug.h/cpp       Debugging definitions
@@ -65,6 +66,8 @@
  *******************************************************************************/
 #include "JDefs.h"
 #include "JDiff.h"
+#include "JCpu.h"
+#include "JProbe.h"
 #include <limits.h>
 
 #ifdef _FILE_OFFSET_BITS
@@ -95,6 +98,19 @@
 #define PGSMRK 0x100000    /**< Progress mark: show progress in Mb (1024 * 1024 or 0x400 x 0x400)  */
 #define PGSMSK 0x1ffffff   /**< Progress mask: show progress every 32Mb when (lzPos & PGSMSK == 0) */
 
+#define DSTMIN 16          /**< Adaptive lookahead: distances needed before adapting                     */
+#define DSTAGE 256         /**< Adaptive lookahead: halve the histogram after 256 distances              */
+#define DSTPCT 0.95        /**< Adaptive lookahead: fraction of the distances to cover                   */
+#define DSTFAC 8           /**< Adaptive lookahead: window = DSTFAC times the covering distance          */
+#define NERBCK 4096        /**< Near index: bytes to cover before the read position                      */
+#define NERAHD 4096        /**< Near index: minimum bytes to cover after the read position               */
+#define SPCPUB 255         /**< Speculation: publish the lookahead position every 256 bytes              */
+
+#define BDGLVL 6           /**< Budget: max effort reduction level (lookahead/matches divided by 2^6)    */
+#define BDGRSV 0.1         /**< Budget: fraction of the budget kept in reserve                          */
+#define BDGLIN 0x2000000   /**< Budget: assumed speed (bytes/s) for finishing the diff without searching */
+#define BDGINT 0.01        /**< Budget: minimum interval (s) between effort adaptations                  */
+
 namespace JojoDiff {
 
 /*
@@ -110,26 +126,38 @@ JDiff::JDiff(
     const int aiSrcScn,         /* Scan source-file: 0=no, 1=yes, 2=done */
     const int aiMchMax,         /* Maximum matches to search for */
     const int aiMchMin,         /* Minimum matches to search for */
-    const int aiAhdMax,         /* Lookahead maximum (in bytes) */
-    const bool abCmpAll         /* Compare all matches ? */
+    const off_t azAhdMax,       /* Lookahead maximum (in bytes) */
+    const bool abCmpAll,        /* Compare all matches ? */
+    JHashPos * const apHsh      /* Shared index, already built (null = own index) */
 ) : mpFilOrg(apFilOrg), mpFilNew(apFilNew), mpOut(apOut),
-    gpHsh(null), gpMch(null),
+    gpHsh(null), gpMch(null), gpNer(null),
     miVerbse(aiVerbse), mbSrcBkt(abSrcBkt),
     miMchMax(aiMchMax),
     miMchMin(aiMchMin > miMchMax ? miMchMax - 1 : aiMchMin),
-    miAhdMax(aiAhdMax<1024?1024:aiAhdMax),
-    mbCmpAll(abCmpAll), miSrcScn(aiSrcScn)
+    mzAhdMax(azAhdMax<1024?1024:azAhdMax),
+    mbCmpAll(abCmpAll), miSrcScn(aiSrcScn),
+    mzAhdCur(mzAhdMax), miMchCur(miMchMax), mzAhdAdp(mzAhdMax)
 {
-	gpHsh = new JHashPos(aiHshSze) ;
-	gpMch = new JMatchTable(gpHsh, mpFilOrg, mpFilNew, aiMchMax, abCmpAll, aiAhdMax);
+	if (apHsh != null) {
+	    gpHsh = apHsh ;
+	    mbHshOwn = false ;
+	    miSrcScn = 2 ;
+	    miRlb = gpHsh->get_reliability() ;
+	} else {
+	    gpHsh = new JHashPos(aiHshSze) ;
+	}
+	gpMch = new JMatchTable(gpHsh, mpFilOrg, mpFilNew, aiMchMax, abCmpAll, azAhdMax);
 }
 
 /*
  * Destructor
  */
 JDiff::~JDiff() {
-	delete gpHsh ;
+	delete gpSpc ;      // stop the helper before the index goes
+	if (mbHshOwn)
+	    delete gpHsh ;
 	delete gpMch ;
+	delete gpNer ;
 }
 
 /**
@@ -183,8 +211,8 @@ int JDiff::jdiff()
 
         /* Incremental source scan */
         if (miSrcScn == 0 && lzPosOrg == mzAhdOrg) {
-            mlHshOrg = hash(mlHshOrg, miPrvOrg, lcOrg, miEqlOrg) ;
-            gpHsh->add(mlHshOrg, mzAhdOrg, miEqlOrg) ;
+            mlHshOrg = JHashPos::hash(mlHshOrg, miPrvOrg, lcOrg, miEqlOrg) ;
+            gpHsh->add(mlHshOrg, mzAhdOrg, miEqlOrg, lcOrg) ;
             mzAhdOrg ++ ;
         }
 
@@ -203,8 +231,8 @@ int JDiff::jdiff()
                 while (lcOrg == lcNew && lcNew >= 0 && lzPosNew < lzLapSml){
                     lzCnt ++ ;
                     if (lzPosOrg == mzAhdOrg) {
-                        mlHshOrg = hash(mlHshOrg, miPrvOrg, lcOrg, miEqlOrg) ;
-                        gpHsh->add(mlHshOrg, mzAhdOrg, miEqlOrg) ;
+                        mlHshOrg = JHashPos::hash(mlHshOrg, miPrvOrg, lcOrg, miEqlOrg) ;
+                        gpHsh->add(mlHshOrg, mzAhdOrg, miEqlOrg, lcOrg) ;
                         mzAhdOrg ++ ;
                     }
                     lcOrg = mpFilOrg->get(++ lzPosOrg, JFile::Read) ;
@@ -216,6 +244,9 @@ int JDiff::jdiff()
                 lzCnt = 0;
                 while (lcOrg == lcNew && lcNew >= 0 && lzPosNew < lzLapSml){
                     lzCnt ++ ;
+                    lzCnt += skipEql(lzPosOrg, lzPosNew, lzLapSml) ;
+                    if (gpSpc != null)
+                        gpSpc->publish(lzPosNew > mzAhdNew ? lzPosNew : mzAhdNew + 1) ;
                     lcOrg = mpFilOrg->get(++ lzPosOrg, JFile::Read) ;
                     lcNew = mpFilNew->get(++ lzPosNew, JFile::Read) ;
                 }
@@ -251,7 +282,7 @@ int JDiff::jdiff()
             liFnd = 0 ;
 
             // Report the miss to the user
-            miHshErr++ ;
+            mzHshErr++ ;
             if (miVerbse>2 && mbCmpAll){
               fprintf(JDebug::stddbg, "\nInaccurate solution at positions %" PRIzd "/%" PRIzd "!\n", lzPosOrg, lzPosNew);
               fprintf(JDebug::stddbg, "Comparing : ...           ");
@@ -275,6 +306,7 @@ int JDiff::jdiff()
 
             /* Find a new equals-reqion */
             liFnd = search(lzPosOrg, lzPosNew, lzSkpOrg, lzSkpNew, lzAhd) ;
+            JPROBE4(search_end, liFnd, lzSkpOrg, lzSkpNew, lzAhd) ;
             if (liFnd < 0)
                 return liFnd;
             #if debug
@@ -334,6 +366,40 @@ int JDiff::jdiff()
     return EXI_OK;
 } /* jdiff */
 
+/**
+ * @brief Skip equal bytes within the read buffers of both files
+ *
+ * Compares the buffered bytes following the last bytes read (at azPosOrg and azPosNew)
+ * with the vectorized kernel, and skips the equal ones on both files.
+ *
+ * @param azPosOrg  in/out: last position read on the original file
+ * @param azPosNew  in/out: last position read on the new file
+ * @param azMax     do not skip up to this position on the new file
+ * @return number of bytes skipped
+ */
+off_t JDiff::skipEql(off_t &azPosOrg, off_t &azPosNew, const off_t azMax) {
+    long llOrg ;
+    long llNew ;
+    jchar const *lpOrg = mpFilOrg->getRed(azPosOrg + 1, llOrg) ;
+    jchar const *lpNew = mpFilNew->getRed(azPosNew + 1, llNew) ;
+
+    if (llNew > llOrg)
+        llNew = llOrg ;
+    if (llNew > azMax - azPosNew - 1)
+        llNew = azMax - azPosNew - 1 ;
+    if (llNew <= 0)
+        return 0 ;
+
+    long llEql = JCpu::eqlLen(lpOrg, lpNew, llNew) ;
+    if (llEql > 0) {
+        mpFilOrg->skipRed(llEql) ;
+        mpFilNew->skipRed(llEql) ;
+        azPosOrg += llEql ;
+        azPosNew += llEql ;
+    }
+    return llEql ;
+}
+
 /**
  * @brief Flush pending EQL's
  */
@@ -346,31 +412,6 @@ void JDiff::flushEql(const off_t &lzPosOrg, const off_t &lzPosNew, off_t &lzEql,
     lbEql=false;
 } /* ufPutEql */
 
-/**
- * @brief The hash function
- *
- * Generate a new hash value by adding a new byte.
- * Old bytes are shifted out from the hash value in such a way that
- * the new value corresponds to a sample of 32 bytes (the lowest bit of the 32'th
- * byte still influences the highest bit of the hash value).
- *
- * @param   acNew       character to hash
- * @param   akCurHsh    hash key (in & out)
- * @param   aiEql       equal-chars count
- */
-inline hkey JDiff::hash ( hkey const akCurHsh, int &acOld, int const acNew, int &aiEql) const {
-    if (acOld == acNew) {
-        if (aiEql < SMPSZE)
-            aiEql ++;
-    } else {
-        acOld = acNew ;
-        if (aiEql != 0)     // improves performance
-            aiEql = 0;
-    }
-    return (akCurHsh * 2) + acNew + aiEql ; // multiplication by 2 is faster than << 2
-}
-
-
 /**
  * @brief Find Ahead function
  *        Read ahead on both files until an equal series of 32 bytes is found.
@@ -398,8 +439,12 @@ int JDiff::search (
     off_t lzBseOrg;     /**< Base position on original file                      */
     off_t lzLap=0;      /**< Stop-lap for progress counter                       */
 
-    int liMax;          /**< Max number of bytes to look ahead              */
-    int liBck;          /**< Number of bytes to look back                   */
+    off_t lzMax;        /**< Max number of bytes to look ahead              */
+    off_t lzBck;        /**< Number of bytes to look back                   */
+    bool lbHit;         /**< Sample found in the hashtable or run index     */
+    bool lbRun=false;   /**< Run index already consulted for current run    */
+
+    JPROBE2(search_start, azRedOrg, azRedNew) ;
 
     /* Set Lap for progress counter */
     if (miVerbse > 1) lzLap = azRedNew + PGSMRK ;
@@ -408,11 +453,13 @@ int JDiff::search (
     switch (miSrcScn) {
     case 1: {
             // do a full prescan
-            int liRet = buildFullIndex() ;
+            int liRet = prescan() ;
             if (liRet < 0)
                 return liRet ;
-            miSrcScn = 2 ;
-            miRlb = gpHsh->get_reliability() ;
+
+            // the index is complete: start speculating
+            if (mpFilSpc != null)
+                gpSpc = new JSpeculate(gpHsh, mpFilSpc) ;
         }
         break ;
 
@@ -421,25 +468,25 @@ int JDiff::search (
             mpFilOrg->set_lookahead_base(azRedOrg);
             if (mbSrcBkt){
                 // Backtrace allowed: go ahead as far as possible
-                liMax = miAhdMax ;
+                lzMax = mzAhdMax ;
             } else {
                 // Backtrace not allowed:
-                // - keep (mzAhdMax - azRedOrg) == miAhdMax / 2
-                // - except at the start of the file (azRedOrg < miAhdMax)
-                if (mzAhdOrg < (miAhdMax / 2))
-                    liMax = miAhdMax - mzAhdOrg ;
+                // - keep (mzAhdMax - azRedOrg) == mzAhdMax / 2
+                // - except at the start of the file (azRedOrg < mzAhdMax)
+                if (mzAhdOrg < (mzAhdMax / 2))
+                    lzMax = mzAhdMax - mzAhdOrg ;
                 else
-                    liMax = miAhdMax / 2 - (mzAhdOrg - azRedOrg) ;
+                    lzMax = mzAhdMax / 2 - (mzAhdOrg - azRedOrg) ;
             }
 
             // scan ahead till EOB or EOF
             int lcOrg ;
-            for ( ; liMax > 0 ; liMax --) {
+            for ( ; lzMax > 0 ; lzMax --) {
                 lcOrg = mpFilOrg->get(mzAhdOrg, JFile::SoftAhead) ;
                 if (lcOrg <= EOF)
                     break ;
-                mlHshOrg = hash(mlHshOrg, miPrvOrg, lcOrg, miEqlOrg) ;
-                gpHsh->add(mlHshOrg, mzAhdOrg, miEqlOrg) ;
+                mlHshOrg = JHashPos::hash(mlHshOrg, miPrvOrg, lcOrg, miEqlOrg) ;
+                gpHsh->add(mlHshOrg, mzAhdOrg, miEqlOrg, lcOrg) ;
                 mzAhdOrg ++ ;
             }
             miRlb = gpHsh->get_reliability() ;
@@ -447,6 +494,14 @@ int JDiff::search (
         break ;
     } /* switch scan source file - build hashtable */
 
+    /* Out of time: stop searching, the remainder is output as it is compared */
+    if (mdBdgSec > 0 && budget(azRedNew)) {
+        azSkpOrg = 0 ;
+        azSkpNew = 0 ;
+        azAhd = MAX_OFF_T ;
+        return 0 ;
+    }
+
     /*
     * How many bytes to look ahead (search) ?
     * As far as possible, but going too far makes no sense.
@@ -461,13 +516,29 @@ int JDiff::search (
     * range. Once a minimum number of potential solutions is found, the lookahead
     * may again be reduced to the reliability range (see below).
     */
+    off_t lzAhd = (mzAhdAdp < mzAhdCur) ? mzAhdAdp : mzAhdCur ;    /**< Lookahead window */
+    if (lzAhd < mzAhdLow || mzAhdLow < 0)
+        mzAhdLow = lzAhd ;
+    if (lzAhd > mzAhdHig)
+        mzAhdHig = lzAhd ;
+    mzAhdSum += lzAhd ;
+    mzAhdNum ++ ;
+
+    /* Keep the near index on par with the lookahead window around the diagonal */
+    if (gpNer != null) {
+        off_t lzNer = (lzAhd < NERAHD) ? NERAHD : lzAhd ;
+        if (lzNer > JHashNear::NERCOV - NERBCK)
+            lzNer = JHashNear::NERCOV - NERBCK ;
+        indexNear(azRedOrg, azRedOrg + lzNer) ;
+    }
+
     if (mzAhdNew > azRedNew)
-        liMax = miAhdMax - (mzAhdNew - azRedNew) ;
+        lzMax = lzAhd - (mzAhdNew - azRedNew) ;
     else
-        liMax = miAhdMax ;
+        lzMax = lzAhd ;
 
-    if (liMax < miRlb)
-        liMax = miRlb  ;    // search at least the reliability distance
+    if (lzMax < miRlb)
+        lzMax = miRlb  ;    // search at least the reliability distance
 
     /*
     * How many bytes to look back ?
@@ -478,13 +549,13 @@ int JDiff::search (
     * - looking back allows to keep the existing match-table up-to-date
     * Therefore, we allow for some look back.
     */
-    liBck = (azRedNew - mzAhdNew);
-    if (liBck < 0)
+    lzBck = (azRedNew - mzAhdNew);
+    if (lzBck < 0)
         // mzAhdNew is stil ahead of azRedNew from a previous lookahead
         // continue where the previous left off
-        liBck= 0 ;
-    else if (liBck > miRlb + 2 * SMPSZE - 1)
-        liBck = miRlb + 2 * SMPSZE - 1;   // 2 * SMPSZE to anticipate a reinitialization
+        lzBck= 0 ;
+    else if (lzBck > miRlb + 2 * SMPSZE - 1)
+        lzBck = miRlb + 2 * SMPSZE - 1;   // 2 * SMPSZE to anticipate a reinitialization
 
 
     /* Do not backtrace before lzBseOrg */
@@ -492,23 +563,23 @@ int JDiff::search (
 
     /* Cleanup the old matches */
     int liFnd=0;          /**< Number of matches found                        */
-    switch (gpMch->cleanup(lzBseOrg, azRedNew)){
+    switch (gpMch->cleanup(lzBseOrg, azRedOrg, azRedNew)){
     case JMatchTable::Error:
     case JMatchTable::Full: // table is full
-        liFnd = miMchMax ;
+        liFnd = miMchCur ;
         break ;
 
     case JMatchTable::Best: // a good match is already available : reduce search
     case JMatchTable::Good: // a good match is already available : reduce search
-        if (liMax > miRlb * 2)
-            liMax = miRlb * 2 ;   // reduce search (but not to zero)
+        if (lzMax > miRlb * 2)
+            lzMax = miRlb * 2 ;   // reduce search (but not to zero)
         break ;
 
     default: ;
     }
 
     /* If there's room to work */
-    if (liFnd < miMchMax) {
+    if (liFnd < miMchCur) {
         // Set lookahead base position
         mpFilNew->set_lookahead_base(azRedNew);
 
@@ -519,14 +590,19 @@ int JDiff::search (
         * Re-Initialize hash function (read 31 or 63 bytes) if
         * - ahead position has been reset, or
         * - read position has jumped over the ahead position
+        *
+        * The ahead position never moves backwards, so no byte of the new file
+        * is hashed twice: successive searches either continue the hash stream
+        * where the previous one left off, or restart beyond it (after an equal
+        * region). Only the warm-up of a restart is overhead, see getIniByt().
         */
-        if (mzAhdNew == 0 || mzAhdNew + liBck < azRedNew)  {
+        if (mzAhdNew == 0 || mzAhdNew + lzBck < azRedNew)  {
             // Don't go back more than the buffer allows (to avoid EOB)
             mzAhdNew = mpFilNew->getBufPos() ;
 
             // Set looking back position, but never before the buffer
-            if (azRedNew > mzAhdNew + liBck){
-                mzAhdNew = azRedNew - liBck;
+            if (azRedNew > mzAhdNew + lzBck){
+                mzAhdNew = azRedNew - lzBck;
                 if (mzAhdNew < 0)
                     mzAhdNew = 0;
             }
@@ -536,20 +612,22 @@ int JDiff::search (
             // in a worst case, we first need SMPSZE to initialize miEqlNew and
             // then another SMPSZE to initialize the hash
             if (mzAhdNew == 0)
-                liBck = SMPSZE - 1 ;        // to initialize mkHsh (miEql=0 is correct)
+                lzBck = SMPSZE - 1 ;        // to initialize mkHsh (miEql=0 is correct)
             else
-                liBck = SMPSZE * 2 - 1 ;    // to initialize mkHsh and miEql
+                lzBck = SMPSZE * 2 - 1 ;    // to initialize mkHsh and miEql
+            mzIniCnt ++ ;
+            mzIniByt -= mzAhdNew ;
             mzAhdNew -- ; // switch to pre-increments
             mlHshNew = 0;
             miEqlNew = 0;
             miPrvNew = EOF;
-            for (int liIdx = 0 ; liIdx < liBck; liIdx++) {
+            for (int liIdx = 0 ; liIdx < lzBck; liIdx++) {
                 miValNew = mpFilNew->get(++ mzAhdNew, liSftNew) ;
                 if (miValNew <= EOF){
                     mzAhdNew --;
                     break ;
                 }
-                mlHshNew = hash(mlHshNew, miPrvNew, miValNew, miEqlNew) ;
+                mlHshNew = JHashPos::hash(mlHshNew, miPrvNew, miValNew, miEqlNew) ;
 
                 // The following line needs some explication.
                 // The goal of this line is to terminate the initialization ASAP.
@@ -567,31 +645,54 @@ int JDiff::search (
                 // As soon as miEql is reset to 0 by miPrv != miVal, miEql becomes correct
                 // and initialization will be ok after SMPSZE-1 bytes (position D in the example)
                 // Reset can be detected by miEql != liIdx. Hence, when miEql != liIdx,
-                // we can reduce liMax to liIdx + SMPSZE - 1.
-                if (liIdx != miEqlNew && liBck > liIdx + (SMPSZE - 1))
-                    liBck = liIdx + (SMPSZE - 1) ;
+                // we can reduce lzMax to liIdx + SMPSZE - 1.
+                if (liIdx != miEqlNew && lzBck > liIdx + (SMPSZE - 1))
+                    lzBck = liIdx + (SMPSZE - 1) ;
             }
+            mzIniByt += mzAhdNew + 1 ;
         }
 
-        /* Add the resulting look-back to liMax */
+        /* Add the resulting look-back to lzMax */
         if (mzAhdNew < azRedNew)
-            liMax += (azRedNew - mzAhdNew) ;
+            lzMax += (azRedNew - mzAhdNew) ;
 
         /*
         * Build the table of matches
         */
-        while ((liMax > 0)) {
+        while ((lzMax > 0)) {
             /* hash the new value */
             miValNew = mpFilNew->get(++ mzAhdNew, liSftNew) ;
             if (miValNew <= EOF){
                 mzAhdNew --;
                 break ;
             }
-            mlHshNew = hash(mlHshNew, miPrvNew, miValNew, miEqlNew) ;
-            liMax --;
+            mlHshNew = JHashPos::hash(mlHshNew, miPrvNew, miValNew, miEqlNew) ;
+            lzMax --;
 
-            /* lookup the new value in the hashtable and add it to the table of matches...*/
-            if (gpHsh->get(mlHshNew, lzFndOrg)) {
+            /* keep the helper ahead */
+            if (gpSpc != null && (mzAhdNew & SPCPUB) == 0)
+                gpSpc->publish(mzAhdNew) ;
+
+            /* lookup the new value in the hashtable, or within a run of equal bytes,
+             * in the run index (once per run), and add it to the table of matches...
+             * With a near index, a hit there saves the (cache missing) hashtable lookup. */
+            if (miEqlNew < JHashPos::RUNEQL) {
+                lbRun = false ;
+                lbHit = gpNer != null && JHashNear::sample(mlHshNew) && gpNer->get(mlHshNew, lzFndOrg) ;
+                if (! lbHit && (gpSpc == null || ! gpSpc->get(mzAhdNew, mlHshNew, lbHit, lzFndOrg))) {
+                    lbHit = gpHsh->get(mlHshNew, lzFndOrg) ;
+                    if (lbHit)
+                        mzHshHit ++ ;
+                }
+            } else if (! lbRun) {
+                lbRun = true ;
+                lbHit = gpHsh->getRun(miValNew, mzAhdNew + (azRedOrg - azRedNew), miEqlNew, lzBseOrg, lzFndOrg) ;
+                if (lbHit)
+                    mzRunHit ++ ;
+            } else {
+                lbHit = false ;
+            }
+            if (lbHit) {
                 /* ...unless it's not usable because we've been instructed not to backtrack on source file */
                 if (lzFndOrg > lzBseOrg) {
                     /* it's usable: add to the table of matches */
@@ -603,10 +704,11 @@ int JDiff::search (
                     // no break: continue with next case
 
                     case JMatchTable::Full:         // Table is full
-                        liMax = 0;
+                        lzMax = 0;
                         continue ;
 
                     case JMatchTable::Enlarged:     // Existing solution has been enlarged
+                    case JMatchTable::Pending:      // Verification deferred till getbest
                     case JMatchTable::Invalid:      // Match does not point to a valid solution
                         break ;                     // Do nothing
 
@@ -621,8 +723,8 @@ int JDiff::search (
                         // to search before finding all solutions hidden behind the unreliability.
                         // So after the (estimated) reliability range, no better solution should be found anymore.
                         // reduce the lookahead to be sure and to improve performance
-                        if (liMax > miRlb)
-                            liMax = miRlb ;
+                        if (lzMax > miRlb)
+                            lzMax = miRlb ;
                     // no break: continue with next case
 
                     case JMatchTable::Valid:        // solution added
@@ -630,8 +732,8 @@ int JDiff::search (
                         if (mzAhdNew > azRedNew) {
                             if (liFnd >= miMchMin)
                                 liSftNew=JFile::SoftAhead ;   // switch to soft reading
-                            if (liFnd >= miMchMax){
-                                liMax = 0; continue ;         // stop lookahead
+                            if (liFnd >= miMchCur){
+                                lzMax = 0; continue ;         // stop lookahead
                             }
                         }
                     } /* switch */
@@ -645,6 +747,10 @@ int JDiff::search (
             }
         } /* while ! EOF */
     } /* if liFnd <= miMchMax */
+
+    /* Speculate beyond the lookahead while comparing */
+    if (gpSpc != null)
+        gpSpc->publish(mzAhdNew + 1) ;
 
     /* Check for errors  */
     if (miValNew < EOB ) {
@@ -668,6 +774,8 @@ int JDiff::search (
     }
 
     /* Calculate the resulting offsets */
+    if (mbAdp)
+        resync(lbFnd ? lzFndNew - azRedNew : -1) ;
     if (! lbFnd)  {
         // No solution has been found. Maybe the search window size is too small, or
         // the hashtable, or the buffers, or maybe the files are simply different.
@@ -717,6 +825,60 @@ int JDiff::search (
     }
 } /* search */
 
+/**
+ * @brief   Extend the near index up to the given position on the original file.
+ *
+ *          The near index covers the original file from NERBCK bytes before
+ *          the read position. Hashing continues where the previous call left off,
+ *          or restarts when the read position jumped outside the indexed region.
+ */
+void JDiff::indexNear(const off_t azRedOrg, const off_t azEnd)
+{
+    int liSkp = 0 ;     // number of bytes needed to (re)initialize the hash
+
+    if (mzNerOrg < 0 || mzNerOrg < azRedOrg - NERBCK || mzNerOrg > azEnd + JHashNear::NERCOV) {
+        mzNerOrg = azRedOrg - NERBCK ;
+        if (mzNerOrg <= 0) {
+            mzNerOrg = 0 ;
+            liSkp = SMPSZE - 1 ;        // initialize the hash (miEql=0 is correct)
+        } else {
+            liSkp = SMPSZE * 2 - 1 ;    // initialize the hash and miEql
+        }
+        mlHshNer = 0 ;
+        miPrvNer = EOF ;
+        miEqlNer = 0 ;
+    }
+
+    for ( ; mzNerOrg < azEnd ; mzNerOrg ++) {
+        int lcOrg = mpFilOrg->get(mzNerOrg, JFile::HardAhead) ;
+        if (lcOrg <= EOF)
+            break ;
+        mlHshNer = JHashPos::hash(mlHshNer, miPrvNer, lcOrg, miEqlNer) ;
+        if (liSkp > 0)
+            liSkp -- ;
+        else if (miEqlNer < JHashPos::RUNEQL && JHashNear::sample(mlHshNer))
+            gpNer->add(mlHshNer, mzNerOrg) ;
+    }
+}
+
+/**
+ * @brief   Build the full index now, when the settings ask for one and it is not done yet.
+ *
+ * @return 0 = ok, < 0 = error reading the original file
+ */
+int JDiff::prescan ()
+{
+    if (miSrcScn != 1)
+        return 0 ;
+
+    int liRet = buildFullIndex() ;
+    if (liRet < 0)
+        return liRet ;
+    miSrcScn = 2 ;
+    miRlb = gpHsh->get_reliability() ;
+    return 0 ;
+}
+
 /**
  * @brief   Prescan the original file.
  *
@@ -742,18 +904,18 @@ int JDiff::buildFullIndex ()
         lcValOrg = mpFilOrg->get(++ lzPosOrg, JFile::HardAhead);
         if (lcValOrg <= EOF)
             break ;
-        lkHshOrg = hash(lkHshOrg, lcValPrv, lcValOrg, liEqlOrg) ;
+        lkHshOrg = JHashPos::hash(lkHshOrg, lcValPrv, lcValOrg, liEqlOrg) ;
     }
 
     /* Build hashtable */
-    if (miVerbse > 1) {
-        /* slow version with user feedback */
+    if (miVerbse > 1 || mdBdgSec > 0) {
+        /* slow version with user feedback or time budget */
         while (lcValOrg > EOF) {
             lcValOrg = mpFilOrg->get(++ lzPosOrg, JFile::HardAhead);
             if (lcValOrg <= EOF)
                 break ;
-            lkHshOrg = hash(lkHshOrg, lcValPrv, lcValOrg, liEqlOrg) ;
-            gpHsh->add(lkHshOrg, lzPosOrg, liEqlOrg) ;
+            lkHshOrg = JHashPos::hash(lkHshOrg, lcValPrv, lcValOrg, liEqlOrg) ;
+            gpHsh->add(lkHshOrg, lzPosOrg, liEqlOrg, lcValOrg) ;
 
             #if debug
             if (JDebug::gbDbg[DBGAHH])
@@ -761,9 +923,12 @@ int JDiff::buildFullIndex ()
                         lcValOrg, lkHshOrg, lzPosOrg, 0);
             #endif
 
-            /* output position every 16MB */
+            /* output position every 32MB, stop indexing when out of time */
             if ((lzPosOrg & PGSMSK) == 0) {
-              fprintf(JDebug::stddbg, "\b\b\b\b\b\b\b\b\b\b\b\b\b\b%12" PRIzd "Mb", lzPosOrg / PGSMRK);
+              if (miVerbse > 1)
+                fprintf(JDebug::stddbg, "\b\b\b\b\b\b\b\b\b\b\b\b\b\b%12" PRIzd "Mb", lzPosOrg / PGSMRK);
+              if (mdBdgSec > 0 && budget(-1))
+                break ;
             }
         }
     } else {
@@ -772,8 +937,8 @@ int JDiff::buildFullIndex ()
             lcValOrg = mpFilOrg->get(++ lzPosOrg, JFile::HardAhead);
             if (lcValOrg <= EOF)
                 break ;
-            lkHshOrg = hash(lkHshOrg, lcValPrv, lcValOrg, liEqlOrg) ;
-            gpHsh->add(lkHshOrg, lzPosOrg, liEqlOrg) ;
+            lkHshOrg = JHashPos::hash(lkHshOrg, lcValPrv, lcValOrg, liEqlOrg) ;
+            gpHsh->add(lkHshOrg, lzPosOrg, liEqlOrg, lcValOrg) ;
         }
     }
 
@@ -792,4 +957,175 @@ int JDiff::buildFullIndex ()
         return 0 ;
 } /* buildFullIndex */
 
+/*******************************************************************************
+* Adaptive lookahead
+*******************************************************************************/
+/**
+ * @brief Record a resync distance and adapt the lookahead window to it.
+ *
+ * Distances go into a histogram of log2 buckets, which is halved regularly
+ * so that it reflects the current region of the files. The window then covers
+ * DSTPCT of the recent distances with a margin of DSTFAC: small when edits are
+ * local, large after big insertions. A miss counts as twice the current window,
+ * so that repeated misses quickly enlarge the window up to the maximum.
+ *
+ * This is a trade-off, not a free lunch: a smaller window collects fewer
+ * candidate solutions, so the best one may be missed. Searches get much faster,
+ * the patch gets a bit smaller on some files and a few percent larger on others,
+ * so it is only done on request (setAdapt). The window never exceeds -a, which
+ * also bounds the lookahead on sequential (unspooled) input, see JFileAhead::getbuf.
+ *
+ * @param azDst     distance on the new file, -1 = no solution found
+ */
+void JDiff::resync(const off_t azDst)
+{
+    off_t lzDst = (azDst < 0) ? mzAhdAdp * 2 : azDst ;
+    int liBkt = 0 ;
+    while (liBkt < DSTBKT - 1 && ((off_t) 1 << liBkt) <= lzDst)
+        liBkt ++ ;
+    miDstHst[liBkt] ++ ;
+    miDstCnt ++ ;
+
+    if (miDstCnt >= DSTAGE) {
+        miDstCnt = 0 ;
+        for (liBkt = 0; liBkt < DSTBKT; liBkt++) {
+            miDstHst[liBkt] /= 2 ;
+            miDstCnt += miDstHst[liBkt] ;
+        }
+    }
+    if (miDstCnt < DSTMIN)
+        return ;
+
+    int liTgt = (int) (miDstCnt * DSTPCT) ;
+    int liCum = 0 ;
+    for (liBkt = 0; liBkt < DSTBKT - 1; liBkt++) {
+        liCum += miDstHst[liBkt] ;
+        if (liCum >= liTgt)
+            break ;
+    }
+    off_t lzWin = ((off_t) 1 << liBkt) * DSTFAC ;
+    if (lzWin > mzAhdMax)
+        mzAhdAdp = mzAhdMax ;
+    else if (lzWin < 1024)
+        mzAhdAdp = 1024 ;
+    else
+        mzAhdAdp = lzWin ;
+}
+
+/*******************************************************************************
+* Cost model
+*******************************************************************************/
+void JDiff::setCost(bool abCst)
+{
+    gpMch->setCost(abCst) ;
+}
+
+/*******************************************************************************
+* Deferred compares
+*******************************************************************************/
+void JDiff::setDefer(bool abDfr)
+{
+    gpMch->setDefer(abDfr) ;
+}
+
+/*******************************************************************************
+* Adaptive lookahead
+*******************************************************************************/
+void JDiff::setAdapt(bool abAdp)
+{
+    mbAdp = abAdp ;
+}
+
+/*******************************************************************************
+* Near index
+*******************************************************************************/
+void JDiff::setNear(bool abNer)
+{
+    if (! abNer) {
+        delete gpNer ;
+        gpNer = null ;
+    } else if (gpNer == null && miSrcScn != 0 && mbSrcBkt)
+        gpNer = new JHashNear() ;
+}
+
+/*******************************************************************************
+* Speculative lookups
+*******************************************************************************/
+void JDiff::setSpeculate(JFile * const apFilSpc)
+{
+    mpFilSpc = apFilSpc ;
+}
+
+/*******************************************************************************
+* Time budget
+*******************************************************************************/
+void JDiff::setBudget(double adBdgSec)
+{
+    mdBdgSec = adBdgSec ;
+    mtBdgBeg = std::chrono::steady_clock::now() ;
+    mtBdgChk = mtBdgBeg ;
+    miBdgLvl = 0 ;
+    miBdgMax = 0 ;
+    mzBdgPnc = -1 ;
+}
+
+/**
+ * @brief Check progress against the time budget and adapt the effort.
+ *
+ * The budget minus a reserve is spread linearly over the new file: when
+ * we are behind schedule, lookahead and number of matches are halved (one
+ * level per check), when we are well ahead they are doubled again (up to
+ * the configured values). When the remaining time only suffices to compare
+ * the remainder of the files, searching stops altogether.
+ *
+ * @param azPosNew  current position in the new file, -1 = while indexing
+ * @return true = out of time, stop searching
+ */
+bool JDiff::budget(const off_t azPosNew)
+{
+    if (mzBdgPnc >= 0)
+        return true ;
+
+    std::chrono::steady_clock::time_point ltNow = std::chrono::steady_clock::now() ;
+    double ldEla = std::chrono::duration<double>(ltNow - mtBdgBeg).count() ;
+    double ldSch = mdBdgSec * (1 - BDGRSV) ;
+    off_t  lzSze = mpFilNew->getEofPos() ;
+
+    /* Out of time ? Keep enough time to compare the remainder without searching */
+    double ldLin = 0 ;
+    if (lzSze > azPosNew)
+        ldLin = (double) (lzSze - (azPosNew < 0 ? 0 : azPosNew)) / BDGLIN ;
+    if (ldEla + ldLin >= ldSch) {
+        mzBdgPnc = (azPosNew < 0) ? 0 : azPosNew ;
+        if (miVerbse > 1)
+            fprintf(JDebug::stddbg, "\nTime budget exhausted at %" PRIzd ": no more searching.\n", mzBdgPnc) ;
+        return true ;
+    }
+
+    /* Adapt the effort to the schedule */
+    if (azPosNew >= 0 && lzSze > 0
+      && std::chrono::duration<double>(ltNow - mtBdgChk).count() >= BDGINT) {
+        double ldExp = ldSch * azPosNew / lzSze ;   // expected elapsed time at this position
+
+        mtBdgChk = ltNow ;
+        if (ldEla > ldExp && miBdgLvl < BDGLVL)
+            miBdgLvl ++ ;
+        else if (ldEla < ldExp / 2 && miBdgLvl > 0)
+            miBdgLvl -- ;
+        else
+            return false ;
+
+        if (miBdgLvl > miBdgMax)
+            miBdgMax = miBdgLvl ;
+        mzAhdCur = mzAhdMax >> miBdgLvl ;
+        if (mzAhdCur < 1024)
+            mzAhdCur = 1024 ;
+        miMchCur = miMchMax >> miBdgLvl ;
+        if (miMchCur <= miMchMin)
+            miMchCur = (miMchMin + 1 < miMchMax) ? miMchMin + 1 : miMchMax ;
+        gpMch->setCmpAll(mbCmpAll && miBdgLvl < 2) ;
+    }
+    return false ;
+}
+
 } /* namespace */
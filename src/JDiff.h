@@ -135,9 +135,13 @@
 
 #ifndef JDIFF_H_
 #define JDIFF_H_
+#include <chrono>
+
 #include "JDefs.h"
 #include "JFile.h"
 #include "JHashPos.h"
+#include "JHashNear.h"
+#include "JSpeculate.h"
 #include "JMatchTable.h"
 #include "JOut.h"
 
@@ -161,8 +165,10 @@ public:
      * @param aiSrcScn  Prescan source file: 0=no, 1=yes (default = yes)
      * @param aiMchMax  Maximum entries in matching table (default = 1024)
      * @param aiMchMin  Minimum entries in matching table (default = 2)
-     * @param aiAhdMax  Maximum bytes to find ahead (default = 256kB)
+     * @param azAhdMax  Maximum bytes to find ahead (default = 256kB)
      * @param abCmpAll  Compare all matches or only buffered matches ? (default true)
+     * @param apHsh     Shared index, already built by another JDiff's prescan (default = none).
+     *                  The index is only read, so it may serve several JDiffs in parallel.
      */
     JDiff(JFile * const apFilOrg, JFile * const apFilNew, JOut * const apOut,
         const int aiHshSze=8,
@@ -171,8 +177,9 @@ public:
         const int aiSrcScn=true,
         const int aiMchMax=1024,
         const int aiMchMin=2,
-        const int aiAhdMax=256*1024,
-        const bool abCmpAll = true);
+        const off_t azAhdMax=256*1024,
+        const bool abCmpAll = true,
+        JHashPos * const apHsh = null);
 
 	/**
 	 * Destroys JDiff object.
@@ -197,10 +204,88 @@ public:
 	*/
 	int jdiff ();
 
+	/**
+	 * @brief Set a time budget.
+	 *
+	 * JDiff then monitors its progress on the new file against the budget, lowers
+	 * its search effort (lookahead, number of matches, verification of matches)
+	 * when running behind schedule and restores it when running ahead of schedule.
+	 * When time runs out, searching stops and the remainder of the new file is
+	 * output without searching, so that a valid patch is always produced.
+	 *
+	 * @param adBdgSec  time budget in seconds, 0 = no budget
+	 */
+	void setBudget(double adBdgSec) ;
+
+	/**
+	 * @brief Elect solutions on their encoded cost instead of their distance.
+	 *
+	 * Among the matches found, take the one that needs the least patch bytes
+	 * to reach (see JMatchTable::setCost), rather than the nearest one.
+	 *
+	 * @param abCst     true = cost model, false = nearest match (default)
+	 */
+	void setCost(bool abCst) ;
+
+	/**
+	 * @brief Defer out-of-buffer compares till the end of each search and run
+	 *        them in source order (see JMatchTable::setDefer).
+	 *
+	 * @param abDfr     true = defer, false = compare at once (default)
+	 */
+	void setDefer(bool abDfr) ;
+
+	/**
+	 * @brief Look up samples in a near index of the original file around the
+	 *        read position first, and in the full index only when it misses
+	 *        (see JHashNear). Only with a prescan and backtracking allowed.
+	 *
+	 * @param abNer     true = near index, false = full index only (default)
+	 */
+	void setNear(bool abNer) ;
+
+	/**
+	 * @brief Adapt the lookahead window to the distances at which solutions
+	 *        are found, up to -a (see resync): faster, other patch sizes.
+	 *
+	 * @param abAdp     true = adaptive window, false = always -a (default)
+	 */
+	void setAdapt(bool abAdp) ;
+
+	/**
+	 * @brief Speculate index lookups on a helper thread.
+	 *
+	 * Only used with a full prescan: once the index is complete, a helper thread
+	 * reads the new file ahead of JDiff, through the given reader, and looks up
+	 * its samples in the index (see JSpeculate).
+	 *
+	 * @param apFilSpc  second reader on the new file, owned by the caller
+	 */
+	void setSpeculate(JFile * const apFilSpc) ;
+
+	/**
+	 * @brief Build the full index of the original file now, instead of on the
+	 *        first search, e.g. to share it with other JDiffs (see getHsh).
+	 *
+	 * @return 0 = ok, < 0 = error reading the original file
+	 */
+	int prescan() ;
+
 	/* getters */
 	JHashPos * getHsh(){return gpHsh;};     /**< get jdiff's internal hash table */
+	JHashNear * getNer(){return gpNer;};    /**< get jdiff's near index (null = none) */
+	JSpeculate * getSpc(){return gpSpc;};   /**< get jdiff's speculative lookups (null = none) */
 	JMatchTable * getMch(){return gpMch;};  /**< get jdiff's internal matching table */
-	int getHshErr(){return miHshErr;};      /**< get number of false hash hits */
+	off_t getHshHit(){return mzHshHit;};    /**< get number of hits found in the index */
+	off_t getRunHit(){return mzRunHit;};    /**< get number of hits found in the run index */
+	off_t getHshErr(){return mzHshErr;};    /**< get number of false hash hits */
+	int getBdgLvl(){return miBdgMax;};      /**< get highest effort reduction level reached */
+	off_t getBdgPnc(){return mzBdgPnc;};    /**< get position where searching stopped (-1 = none) */
+	off_t getAhdLow(){return mzAhdNum > 0 ? mzAhdLow : 0;};             /**< get smallest lookahead window used */
+	off_t getAhdHig(){return mzAhdHig;};                                /**< get largest lookahead window used  */
+	off_t getAhdAvg(){return mzAhdNum > 0 ? mzAhdSum / mzAhdNum : 0;};  /**< get average lookahead window */
+	off_t getIniCnt(){return mzIniCnt;};    /**< get number of hash restarts on the new file */
+	off_t getIniByt(){return mzIniByt;};    /**< get number of bytes hashed to warm up those restarts */
 
 private:
 
@@ -221,25 +306,40 @@ private:
 	  off_t &azAhd                  /* number of bytes to go before similarity is reached */
 	);
 
-	/**
-     * @brief The hash function
-     *
-     * Generate a new hash value by adding a new byte.
-     * Old bytes are shifted out from the hash value in such a way that
-     * the new value corresponds to a sample of 32 bytes (the lowest bit of the 32'th
-     * byte still influences the highest bit of the hash value).
-     *
-     * @param   acNew       character to hash
-     * @param   akCurHsh    hash key (in & out)
-     * @param   aiEql       equal-chars count
-     */
-    inline hkey hash ( hkey const akCurHsh, int &acOld, int const acNew, int &aiEql) const ;
-
     /**
      * @brief Scans the original file and fills up the hashtable.
      */
     int buildFullIndex () ;
 
+	/**
+	 * @brief Extend the near index up to the given position on the original file
+	 *
+	 * @param azRedOrg  read position on the original file
+	 * @param azEnd     index the original file up to this position
+	 */
+	void indexNear(const off_t azRedOrg, const off_t azEnd) ;
+
+	/**
+	 * @brief Adapt the search effort to the time budget
+	 *
+	 * @param azPosNew  current position in the new file
+	 * @return true = out of time, stop searching
+	 */
+	bool budget(const off_t azPosNew) ;
+
+	/**
+	 * @brief Record a resync distance and adapt the lookahead window to it
+	 *
+	 * @param azDst     distance from the read position to the solution on the new file,
+	 *                  -1 = no solution found within the lookahead window
+	 */
+	void resync(const off_t azDst) ;
+
+	/**
+	 * @brief Skip equal bytes within the read buffers of both files
+	 */
+	off_t skipEql(off_t &azPosOrg, off_t &azPosNew, const off_t azMax) ;
+
 	/**
 	 * @brief Flush pending output
 	 */
@@ -250,14 +350,18 @@ private:
 	JFile * const mpFilNew ;    /**< New file to read                           */
 	JOut  * const mpOut ;       /**< Output handler                             */
 	JHashPos * gpHsh ;          /**< Hashtable containing hashes from mpFilOrg. */
+	bool mbHshOwn = true ;      /**< gpHsh is ours (not shared) ?               */
 	JMatchTable * gpMch ;       /**< Table of matches                           */
+	JHashNear * gpNer ;         /**< Near index around the read position (null = none)  */
+	JFile * mpFilSpc = null ;   /**< Second reader on the new file for speculation   */
+	JSpeculate * gpSpc = null ; /**< Speculative lookups (started after the prescan) */
 
 	/* Settings */
 	const int miVerbse;     /**< Vebosity level                                 */
 	const bool mbSrcBkt;    /**< Allow bactrace on original file?               */
 	const int miMchMax;     /**< Max number of matches to find                  */
 	const int miMchMin;     /**< Min number oif matches to find                 */
-	const int miAhdMax ;    /**< Max number of bytes to look ahead              */
+	const off_t mzAhdMax ;  /**< Max number of bytes to look ahead              */
     const bool mbCmpAll ;   /**< Compare all matches, even if data not in buffer? */
     int  miSrcScn;          /**< Prescan original file: 0=no, 1=yes, 2=done     */
 
@@ -272,11 +376,42 @@ private:
 	int miEqlOrg=0;         /**< Indicator for equal bytes in current sample    */
 	int miEqlNew=0;         /**< Indicator for equal bytes in current sample    */
     int miRlb=0;            /**< Reliability range for current hashtable        */
+    off_t mzIniCnt=0;       /**< Number of hash restarts on the new file        */
+    off_t mzIniByt=0;       /**< Number of bytes hashed to warm up restarts     */
+
+    /* Near index state */
+    off_t mzNerOrg=-1;      /**< Next position to add to the near index (-1 = none) */
+    hkey mlHshNer=0;        /**< Current hash value for the near index          */
+    int miPrvNer=EOF;       /**< Previous file value                            */
+    int miEqlNer=0;         /**< Indicator for equal bytes in current sample    */
+
+    /* Time budget */
+    double mdBdgSec=0;      /**< Time budget in seconds (0 = none)              */
+    std::chrono::steady_clock::time_point mtBdgBeg ;   /**< Start time              */
+    std::chrono::steady_clock::time_point mtBdgChk ;   /**< Last adaptation         */
+    int miBdgLvl=0;         /**< Effort reduction level (0 = full effort)       */
+    int miBdgMax=0;         /**< Highest effort reduction level reached         */
+    off_t mzBdgPnc=-1;      /**< Position where searching stopped (-1 = none)   */
+    off_t mzAhdCur ;        /**< Current lookahead (reduced by the budget)      */
+    int miMchCur ;          /**< Current max number of matches (idem)           */
+
+    /* Adaptive lookahead */
+    static const int DSTBKT = 32 ;  /**< Number of buckets (log2 of the distance)   */
+    int miDstHst[DSTBKT] = {0} ;    /**< Histogram of recent resync distances       */
+    int miDstCnt=0;         /**< Number of distances in the histogram           */
+    bool  mbAdp=false;      /**< Adapt the lookahead window (setAdapt)?         */
+    off_t mzAhdAdp ;        /**< Lookahead window adapted to the distances      */
+    off_t mzAhdLow=-1;      /**< Smallest lookahead window used (-1 = none)     */
+    off_t mzAhdHig=0;       /**< Largest lookahead window used                  */
+    off_t mzAhdSum=0;       /**< Sum of lookahead windows used                  */
+    off_t mzAhdNum=0;       /**< Number of lookahead windows used               */
 
     /*
      * Statistics about operations
      */
-    int miHshErr ;         /**< Number of false hash hits                       */
+    off_t mzHshHit=0;      /**< Number of hits found in the index               */
+    off_t mzRunHit=0;      /**< Number of hits found in the run index           */
+    off_t mzHshErr=0;      /**< Number of false hash hits                       */
 
 }; // class JDiff
 
@@ -0,0 +1,82 @@
+/*
+ * JDiffJob.cpp
+ *
+ * Copyright (C) 2002-2020 Joris Heirbaut
+ *
+ * This file is part of JojoDiff.
+ *
+ * JojoDiff is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "JDiffJob.h"
+#include "JDiff.h"
+#include "JFileAheadStdio.h"
+#include "JOutBin.h"
+
+namespace JojoDiff {
+
+JDiffJob::JDiffJob(rSet const &arSet, const char *asFilOrg, const char *asFilNew, FILE *apFilOut)
+: mrSet(arSet), msFilOrg(asFilOrg), msFilNew(asFilNew), mpFilOut(apFilOut)
+{}
+
+JDiffJob::~JDiffJob() {
+}
+
+void JDiffJob::run(){
+    FILE *lfFilOrg = jfopen(msFilOrg, "rb") ;
+    if (lfFilOrg == null) {
+        miRet = EXI_FRT ;
+        return ;
+    }
+    FILE *lfFilNew = jfopen(msFilNew, "rb") ;
+    if (lfFilNew == null) {
+        jfclose(lfFilOrg) ;
+        miRet = EXI_SCD ;
+        return ;
+    }
+    off_t lzOutBeg = jftell(mpFilOut) ;
+
+    {
+        JFileAheadStdio loFilOrg(lfFilOrg, "Org", mrSet.ilBufOrg, mrSet.iiBlkSze, false);
+        JFileAheadStdio loFilNew(lfFilNew, "New", mrSet.ilBufNew, mrSet.iiBlkSze, false);
+        JOutBin loOut(mpFilOut, mrSet.ibEnt) ;
+        JDiff loJDiff(&loFilOrg, &loFilNew, &loOut,
+                      mrSet.iiHshMbt, mrSet.iiVerbse,
+                      mrSet.ibSrcBkt, mrSet.iiSrcScn, mrSet.iiMchMax, mrSet.iiMchMin,
+                      mrSet.izAhdMax, mrSet.ibCmpAll);
+        loJDiff.setCost(mrSet.ibCst) ;
+        loJDiff.setDefer(mrSet.ibDfr) ;
+        loJDiff.setNear(mrSet.ibNer) ;
+        loJDiff.setAdapt(mrSet.ibAdp) ;
+
+        miRet = loJDiff.jdiff();
+        if (miRet == EXI_OK) {
+            if (loOut.gzOutBytDta > 0)
+                miRet=EXI_DIF ;
+            else
+                miRet=EXI_EQL ;
+        }
+    }
+
+    if (fflush(mpFilOut) != 0) {
+        miRet = EXI_WRI ;
+    } else if (lzOutBeg >= 0) {
+        mzOutSze = jftell(mpFilOut) - lzOutBeg ;
+    }
+
+    jfclose(lfFilOrg) ;
+    jfclose(lfFilNew) ;
+}
+
+} /* namespace JojoDiff */
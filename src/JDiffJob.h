@@ -0,0 +1,99 @@
+/*
+ * JDiffJob.h
+ *
+ * Copyright (C) 2002-2020 Joris Heirbaut
+ *
+ * This file is part of JojoDiff.
+ *
+ * JojoDiff is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef JDIFFJOB_H_
+#define JDIFFJOB_H_
+
+#include <stdio.h>
+
+#include "JDefs.h"
+
+namespace JojoDiff {
+
+/**
+ * @brief A self-contained JDiff run between two named files, writing a binary patch.
+ *
+ * Each job opens its own files and buffers, so that multiple jobs can run on
+ * separate threads (JDiff, JHashPos, JMatchTable and JOutBin keep no global state).
+ */
+class JDiffJob {
+public:
+    JDiffJob(JDiffJob const&) = delete;
+    JDiffJob& operator=(JDiffJob const&) = delete;
+
+    /**
+     * JDiff settings, see JDiff::JDiff and main.
+     */
+    typedef struct {
+        int  iiHshMbt ;     /**< Hashtable size in MB                   */
+        int  iiVerbse ;     /**< Verbose level                          */
+        bool ibSrcBkt ;     /**< Backtrace on sourcefile allowed?       */
+        int  iiSrcScn ;     /**< Prescan source file: 0=no, 1=do        */
+        int  iiMchMax ;     /**< Maximum entries in matching table      */
+        int  iiMchMin ;     /**< Minimum entries in matching table      */
+        off_t izAhdMax ;    /**< Lookahead range                        */
+        bool ibCmpAll ;     /**< Compare even if data not in buffer?    */
+        long ilBufOrg ;     /**< Source-file buffer in bytes            */
+        long ilBufNew ;     /**< Destination-file buffer in bytes       */
+        int  iiBlkSze ;     /**< Block size in bytes                    */
+        bool ibCst ;        /**< Elect matches on encoded cost?         */
+        bool ibDfr ;        /**< Defer out-of-buffer compares?          */
+        bool ibNer ;        /**< Look up in a near index first?         */
+        bool ibAdp ;        /**< Adapt the lookahead window?            */
+        bool ibEnt ;        /**< Entropy code the patch?                */
+    } rSet ;
+
+    /**
+     * @brief Prepare a job.
+     *
+     * @param arSet     JDiff settings
+     * @param asFilOrg  Original file name
+     * @param asFilNew  New file name
+     * @param apFilOut  Output file (binary patch), not closed by the job
+     */
+    JDiffJob(rSet const &arSet, const char *asFilOrg, const char *asFilNew, FILE *apFilOut);
+
+    virtual ~JDiffJob();
+
+    /**
+     * @brief Execute the job: open files, diff and flush output.
+     *
+     * Result is available through getRet() and getOutSze().
+     */
+    void run();
+
+    /* getters */
+    int getRet() const {return miRet;}              /**< EXI_DIF, EXI_EQL or error code  */
+    off_t getOutSze() const {return mzOutSze;}      /**< size of the written patch       */
+    const char *getFilOrg() const {return msFilOrg;}/**< original file name              */
+
+private:
+    rSet const mrSet ;          /**< Settings                   */
+    const char * const msFilOrg;/**< Original file name         */
+    const char * const msFilNew;/**< New file name              */
+    FILE * const mpFilOut ;     /**< Output file                */
+
+    int   miRet = EXI_ERR ;     /**< Result                     */
+    off_t mzOutSze = -1 ;       /**< Size of output             */
+};
+
+} /* namespace JojoDiff */
+#endif /* JDIFFJOB_H_ */
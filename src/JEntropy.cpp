@@ -0,0 +1,223 @@
+/*
+ * JEntropy.cpp
+ *
+ * Copyright (C) 2002-2020 Joris Heirbaut
+ *
+ * This file is part of JojoDiff.
+ *
+ * JojoDiff is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <math.h>
+
+#include "JEntropy.h"
+
+namespace JojoDiff {
+
+/*******************************************************************************
+* Models: all probabilities start at 1/2
+*******************************************************************************/
+JEntropy::JEntropy()
+{
+    uint16_t *lpPrb[] = {&mpLitMod[0][0], &mpLitIns[0][0], &mpMor[0], &mpRaw[0], &mpOpr[0][0],
+                         &mpLenBit[0][0], &mpLenVal[0][0]} ;
+    size_t llSze[] = {sizeof(mpLitMod), sizeof(mpLitIns), sizeof(mpMor), sizeof(mpRaw), sizeof(mpOpr),
+                      sizeof(mpLenBit), sizeof(mpLenVal)} ;
+    for (int liTab = 0; liTab < 7; liTab++)
+        for (size_t llIdx = 0; llIdx < llSze[liTab] / sizeof(uint16_t); llIdx++)
+            lpPrb[liTab][llIdx] = PRBONE / 2 ;
+}
+
+/*******************************************************************************
+* Encoder
+*******************************************************************************/
+JEntOut::JEntOut(FILE *apFilOut) : mpFilOut(apFilOut)
+{
+    putc(ESC, mpFilOut) ;
+    putc(ESC, mpFilOut) ;
+    putc(ENTMGC, mpFilOut) ;
+
+    miCst[0] = 16 * PRBBIT ;
+    for (int liPrb = 1; liPrb < PRBONE; liPrb++)
+        miCst[liPrb] = (uint16_t) (16.0 * (PRBBIT - log2((double) liPrb)) + 0.5) ;
+}
+
+/* ---------------------------------------------------------------
+ * shift outputs the top byte of mkLow. As a carry may still ripple
+ * into it, the byte is kept pending (miCch), together with the 0xff
+ * bytes that follow it (mzCch), until the carry is known.
+ * ---------------------------------------------------------------*/
+void JEntOut::shift()
+{
+    if ((uint32_t) mkLow < 0xFF000000 || (mkLow >> 32) != 0) {
+        int liCry = (int) (mkLow >> 32) ;
+        int liByt = miCch ;
+        do {
+            putc((liByt + liCry) & 0xff, mpFilOut) ;
+            mzSze ++ ;
+            liByt = 0xff ;
+        } while (--mzCch != 0) ;
+        miCch = (int) ((mkLow >> 24) & 0xff) ;
+    }
+    mzCch ++ ;
+    mkLow = (mkLow & 0x00FFFFFF) << 8 ;
+}
+
+void JEntOut::putOpr(int aiOpr)
+{
+    if (miLit > 0) {
+        bool lbFul = (miLit == LITBLK) ;
+        putBlk() ;
+        if (lbFul)
+            putBit(mpMor[miOpr == OprMod ? 0 : 1], 0) ;
+    }
+    int liOpr = toOpr(aiOpr) ;
+    putTre(mpOpr[miOpr], 3, liOpr) ;
+    miOpr = liOpr ;
+}
+
+void JEntOut::putLen(off_t azLen)
+{
+    uint64_t lkLen = (uint64_t) azLen ;
+    int liBit = 1 ;
+    while (liBit < 64 && (lkLen >> liBit) != 0)
+        liBit ++ ;
+    putTre(mpLenBit[miOpr], 6, liBit - 1) ;
+    for (int liPos = liBit - 2; liPos >= 0; liPos--)
+        putBit(mpLenVal[liBit - 1][liPos], (int) ((lkLen >> liPos) & 1)) ;
+}
+
+void JEntOut::putLit(int aiNew)
+{
+    if (miLit == LITBLK) {
+        putBlk() ;
+        putBit(mpMor[miOpr == OprMod ? 0 : 1], 1) ;
+    }
+    mcLitNew[miLit] = (jchar) aiNew ;
+    miLit ++ ;
+}
+
+/* ---------------------------------------------------------------
+ * estimate codes the block as putBlk would, but only adds up the
+ * cost of the bits, and then restores the probabilities.
+ * ---------------------------------------------------------------*/
+uint64_t JEntOut::estimate(int aiLit)
+{
+    uint64_t lkCst = 0 ;
+    int liUnd = 0 ;
+    int liPrv = miPrv ;
+    for (int liLit = 0; liLit < aiLit; liLit++) {
+        uint16_t *lpPrb = (miOpr == OprMod) ? mpLitMod[liPrv] : mpLitIns[liPrv] ;
+        int liVal = mcLitNew[liLit] ;
+        int liIdx = 1 ;
+        for (int liBit = 7; liBit >= 0; liBit--) {
+            int liCur = (liVal >> liBit) & 1 ;
+            uint16_t &liPrb = lpPrb[liIdx] ;
+            lkCst += miCst[liCur ? PRBONE - liPrb : liPrb] ;
+            mpUndPrb[liUnd] = &liPrb ;
+            miUndVal[liUnd ++] = liPrb ;
+            liPrb += adapt(liPrb, 0 - (uint32_t) liCur) ;
+            liIdx = (liIdx << 1) | liCur ;
+        }
+        liPrv = liVal ;
+    }
+    while (liUnd > 0) {
+        liUnd -- ;
+        *mpUndPrb[liUnd] = miUndVal[liUnd] ;
+    }
+    return lkCst ;
+}
+
+/* ---------------------------------------------------------------
+ * putBlk outputs the buffered literals. A raw block flushes the
+ * coder (all of mkLow is written, the state is back to the initial
+ * one, pending byte 0 included), writes the literals as they are,
+ * and restarts the coder after them, as the decoder does.
+ * ---------------------------------------------------------------*/
+void JEntOut::putBlk()
+{
+    int liLit = miLit ;
+    miLit = 0 ;
+    putLen(liLit) ;
+    if (liLit >= LITMIN) {
+        // the flush and restart cost about 5 bytes
+        uint64_t lkRaw = (uint64_t) (liLit + 5) * 8 * 16 ;
+        bool lbRaw = (estimate(liLit) * LITGAN > lkRaw * (LITGAN - 1)) ;
+        putBit(mpRaw[miOpr == OprMod ? 0 : 1], lbRaw) ;
+        if (lbRaw) {
+            for (int liCnt = 0; liCnt < 5; liCnt++)
+                shift() ;
+            mkRng = 0xFFFFFFFF ;
+            fwrite(mcLitNew, 1, liLit, mpFilOut) ;
+            mzSze += liLit ;
+            miPrv = mcLitNew[liLit - 1] ;
+            return ;
+        }
+    }
+    for (int liIdx = 0; liIdx < liLit; liIdx++) {
+        int liNew = mcLitNew[liIdx] ;
+        putTre(miOpr == OprMod ? mpLitMod[miPrv] : mpLitIns[miPrv], 8, liNew) ;
+        miPrv = liNew ;
+    }
+}
+
+void JEntOut::flush()
+{
+    for (int liCnt = 0; liCnt < 5; liCnt++)
+        shift() ;
+}
+
+/*******************************************************************************
+* Decoder
+*******************************************************************************/
+JEntInp::JEntInp(JFile &apFilInp) : mpFilInp(apFilInp)
+{
+    start() ;
+}
+
+void JEntInp::start()
+{
+    // the first byte is always 0 (the initial pending byte)
+    mkRng = 0xFFFFFFFF ;
+    mkCod = 0 ;
+    for (int liCnt = 0; liCnt < 5; liCnt++)
+        mkCod = (mkCod << 8) | getByt() ;
+}
+
+int JEntInp::getBlk(bool abFst)
+{
+    if (mbRaw) {
+        start() ;
+        mbRaw = false ;
+    }
+    if (! abFst && (miBlk < LITBLK || ! getBit(mpMor[miOpr == OprMod ? 0 : 1])))
+        return 0 ;
+    miBlk = (int) getLen() ;
+    if (miBlk > LITBLK)
+        miBlk = LITBLK ;        // corrupt patch
+    if (miBlk >= LITMIN)
+        mbRaw = getBit(mpRaw[miOpr == OprMod ? 0 : 1]) ;
+    return miBlk ;
+}
+
+off_t JEntInp::getLen()
+{
+    int liBit = getTre(mpLenBit[miOpr], 6) + 1 ;
+    uint64_t lkLen = 1 ;
+    for (int liPos = liBit - 2; liPos >= 0; liPos--)
+        lkLen = (lkLen << 1) | getBit(mpLenVal[liBit - 1][liPos]) ;
+    return (off_t) lkLen ;
+}
+
+} /* namespace JojoDiff */
@@ -0,0 +1,305 @@
+/*
+ * JEntropy.h
+ *
+ * Copyright (C) 2002-2020 Joris Heirbaut
+ *
+ * This file is part of JojoDiff.
+ *
+ * JojoDiff is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *******************************************************************************
+ * Entropy coding of patch files (--entropy).
+ *
+ * An entropy coded patch starts with ESC ESC ENTMGC, a sequence that never
+ * starts a plain patch (JOutBin only doubles an ESC before an opcode or ESC),
+ * followed by one stream of an adaptive binary range coder.
+ *
+ * The stream holds the same operations as a plain patch, without escapes:
+ *   <opcode> (<length> | <block> (<more> <block>)* <stop>)
+ * where
+ *   <opcode>   MOD, INS, DEL, EQL, BKT or END, in the context of the previous opcode
+ *   <length>   number of significant bits, then the bits, in the context of the opcode
+ *   <block>    <length> of 1 to LITBLK literals, <raw> when at least LITMIN,
+ *              then the literals
+ *   <literal>  8 bits, in the context of the previous literal (MOD and INS apart)
+ *   <raw>      1 = the literals follow as plain bytes, the coder being flushed
+ *              before and restarted after them
+ *   <more>     after a full block only: 1 = another block follows, <stop> = 0
+ *
+ * Each bit is coded with an adaptive probability (11 bits, adapting by 1/32
+ * of the error), so that both sides learn the same statistics on the fly:
+ * no tables are stored and there is no second pass. Nothing depends on the
+ * original file, so that a patch can be listed without it (jdiff --list).
+ *
+ * Decoding a literal takes 8 binary decodes, which is slow next to a plain copy.
+ * So the encoder first estimates what a block would cost (adapting the
+ * probabilities and undoing it afterwards), and only codes it when that
+ * saves at least 1/LITGAN of the bytes: other blocks are raw, at plain speed.
+ * The probabilities do not learn from raw blocks.
+ *******************************************************************************/
+
+#ifndef JENTROPY_H_
+#define JENTROPY_H_
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "JDefs.h"
+#include "JFile.h"
+
+namespace JojoDiff {
+
+#define ENTMGC  'Z'     /**< Third byte of an entropy coded patch */
+
+/**
+ * @brief Models shared by the encoder and the decoder.
+ */
+class JEntropy {
+public:
+    JEntropy(JEntropy const&) = delete;
+    JEntropy& operator=(JEntropy const&) = delete;
+
+    /** Opcodes within the stream */
+    enum eOpr { OprMod, OprIns, OprDel, OprEql, OprBkt, OprEnd } ;
+
+    /** @brief Stream opcode of a patch operator (MOD, INS, DEL, EQL or BKT) */
+    static inline int toOpr (int aiOpr) {
+        switch (aiOpr) {
+        case MOD: return OprMod ;
+        case INS: return OprIns ;
+        case DEL: return OprDel ;
+        case EQL: return OprEql ;
+        case BKT: return OprBkt ;
+        default:  return OprEnd ;
+        }
+    }
+
+    /** @brief Patch operator of a stream opcode (EOF for END) */
+    static inline int frOpr (int aiOpr) {
+        static const int gcOpr[8] = {MOD, INS, DEL, EQL, BKT, EOF, EOF, EOF} ;
+        return gcOpr[aiOpr & 7] ;
+    }
+
+protected:
+    JEntropy() ;
+    virtual ~JEntropy() {} ;
+
+    static const int PRBBIT = 11 ;              /**< Bits of precision of a probability */
+    static const int PRBONE = 1 << PRBBIT ;     /**< Probability 1                      */
+    static const int PRBSFT = 5 ;               /**< Adaptation speed                   */
+    static const uint32_t RNGTOP = 1 << 24 ;    /**< Normalize below this range         */
+    static const int LITBLK = 16384 ;           /**< Literals per block                 */
+    static const int LITMIN = 64 ;              /**< Smaller blocks are never raw       */
+    static const int LITGAN = 16 ;              /**< Code a block if it saves 1/16      */
+
+    /**
+     * @brief Adaptation of a probability (of a 0) after a bit, without branches:
+     *        bit 0 (mask 0): + (PRBONE - p) / 32, bit 1 (mask ~0): - p / 32 (rounded down).
+     */
+    static inline int adapt (int aiPrb, uint32_t akMsk) {
+        return ((int) ((PRBONE & ~akMsk) | (((1 << PRBSFT) - 1) & akMsk)) - aiPrb) >> PRBSFT ;
+    }
+
+    uint16_t mpLitMod[256][256] ;   /**< MOD literals, by previous literal  */
+    uint16_t mpLitIns[256][256] ;   /**< INS literals, by previous literal  */
+    uint16_t mpMor[2] ;             /**< More blocks ?, by MOD/INS          */
+    uint16_t mpRaw[2] ;             /**< Raw block ?, by MOD/INS            */
+    uint16_t mpOpr[8][8] ;          /**< Opcodes, by previous opcode        */
+    uint16_t mpLenBit[8][64] ;      /**< Number of bits of a length, by opcode */
+    uint16_t mpLenVal[64][64] ;     /**< Bits of a length, by number of bits   */
+
+    int miOpr = OprEnd ;            /**< Previous opcode                    */
+    int miPrv = 0 ;                 /**< Previous literal                   */
+};
+
+/**
+ * @brief Range encoder, writing to a FILE.
+ */
+class JEntOut : public JEntropy {
+public:
+    /**
+     * @brief Start an entropy coded patch: write the ESC ESC ENTMGC header.
+     */
+    JEntOut(FILE *apFilOut) ;
+    virtual ~JEntOut() {} ;
+
+    /** @brief Output an opcode (MOD, INS, DEL, EQL, BKT or ESC = END) */
+    void putOpr (int aiOpr) ;
+
+    /** @brief Output a length (>= 1) */
+    void putLen (off_t azLen) ;
+
+    /** @brief Output a literal of the current MOD/INS operation */
+    void putLit (int aiNew) ;
+
+    /** @brief Flush the coder (after END), without closing the file */
+    void flush () ;
+
+    /** @brief Number of bytes written */
+    off_t getSze () const { return mzSze ; }
+
+private:
+    FILE *mpFilOut ;                /**< Output file                        */
+    uint64_t mkLow = 0 ;            /**< Low end of the range (33 bits)     */
+    uint32_t mkRng = 0xFFFFFFFF ;   /**< Range                              */
+    int  miCch = 0 ;                /**< Pending byte (carry may add one)   */
+    off_t mzCch = 1 ;               /**< Number of pending bytes            */
+    off_t mzSze = 3 ;               /**< Number of bytes written            */
+
+    int miLit = 0 ;                 /**< Literals in the block (0 = no run) */
+    jchar mcLitNew[LITBLK] ;        /**< Literals of the block              */
+    uint16_t *mpUndPrb[8 * LITBLK] ;/**< Probabilities changed by estimate  */
+    uint16_t miUndVal[8 * LITBLK] ; /**< Their values before estimate       */
+    uint16_t miCst[PRBONE] ;        /**< Cost of a bit of probability p, in 1/16 bits */
+
+    /** @brief Output the top byte of mkLow, propagating the carry */
+    void shift () ;
+
+    /** @brief Output the block of literals */
+    void putBlk () ;
+
+    /** @brief Cost of coding the first aiLit literals of the block, in 1/16 bits */
+    uint64_t estimate (int aiLit) ;
+
+    /** @brief Output one bit with an adaptive probability */
+    inline void putBit (uint16_t &aiPrb, int aiBit) {
+        uint32_t lkBnd = (mkRng >> PRBBIT) * aiPrb ;
+        uint32_t lkMsk = 0 - (uint32_t) aiBit ;
+        mkLow += lkBnd & lkMsk ;
+        mkRng = (lkBnd & ~lkMsk) | ((mkRng - lkBnd) & lkMsk) ;
+        aiPrb += adapt(aiPrb, lkMsk) ;
+        if (mkRng < RNGTOP) {
+            mkRng <<= 8 ;
+            shift() ;
+        }
+    }
+
+    /** @brief Output the low aiBit bits of aiVal on a binary tree of probabilities */
+    inline void putTre (uint16_t *apPrb, int aiBit, int aiVal) {
+        int liIdx = 1 ;
+        for (int liBit = aiBit - 1; liBit >= 0; liBit--) {
+            int liCur = (aiVal >> liBit) & 1 ;
+            putBit(apPrb[liIdx], liCur) ;
+            liIdx = (liIdx << 1) | liCur ;
+        }
+    }
+};
+
+/**
+ * @brief Range decoder, reading from a JFile.
+ */
+class JEntInp : public JEntropy {
+public:
+    /**
+     * @brief Start decoding, the ESC ESC ENTMGC header having been read.
+     */
+    JEntInp(JFile &apFilInp) ;
+    virtual ~JEntInp() {} ;
+
+    /** @brief Read an opcode: MOD, INS, DEL, EQL, BKT or EOF (END) */
+    inline int getOpr () {
+        int liOpr = getTre(mpOpr[miOpr], 3) ;
+        miOpr = liOpr ;
+        return frOpr(liOpr) ;
+    }
+
+    /** @brief Read a length */
+    off_t getLen () ;
+
+    /**
+     * @brief Read the size of the next block of literals of the current MOD/INS.
+     *
+     * @param abFst     first block of the operation ?
+     * @return number of literals, 0 at the end of the operation
+     */
+    int getBlk (bool abFst) ;
+
+    /** @brief Are the literals of the block raw ? */
+    inline bool isRaw () const { return mbRaw ; }
+
+    /**
+     * @brief Read raw literals of the block at once, as far as they are buffered.
+     *
+     * @param apDta     out: the literals, valid until the next read
+     * @param alMax     number of literals left in the block
+     * @return number of literals read, 0 when none are buffered (use getLit)
+     */
+    inline long getRaw (jchar const *&apDta, long alMax) {
+        long llLen ;
+        apDta = mpFilInp.getRed(llLen) ;
+        if (llLen > alMax)
+            llLen = alMax ;
+        if (llLen > 0) {
+            mpFilInp.skipRed(llLen) ;
+            miPrv = apDta[llLen - 1] ;
+        }
+        return llLen ;
+    }
+
+    /**
+     * @brief Read a literal of the block.
+     *
+     * @param aiOpr     MOD or INS
+     */
+    inline int getLit (int aiOpr) {
+        if (mbRaw)
+            miPrv = (int) getByt() ;
+        else
+            miPrv = getTre(aiOpr == MOD ? mpLitMod[miPrv] : mpLitIns[miPrv], 8) ;
+        return miPrv ;
+    }
+
+private:
+    JFile &mpFilInp ;               /**< Input file                         */
+    uint32_t mkRng = 0xFFFFFFFF ;   /**< Range                              */
+    uint32_t mkCod = 0 ;            /**< Code within the range              */
+    int miBlk = 0 ;                 /**< Size of the current block          */
+    bool mbRaw = false ;            /**< Current block is raw ?             */
+
+    /** @brief (Re)start decoding at the current position */
+    void start () ;
+
+    /** @brief Next byte of the stream (0 beyond the end) */
+    inline uint32_t getByt () {
+        int liByt = mpFilInp.get() ;
+        return (liByt < 0) ? 0 : (uint32_t) liByt ;
+    }
+
+    /** @brief Read one bit with an adaptive probability */
+    inline int getBit (uint16_t &aiPrb) {
+        // branch-free: on literals the bits are hard to predict
+        uint32_t lkBnd = (mkRng >> PRBBIT) * aiPrb ;
+        int liBit = (mkCod >= lkBnd) ;
+        uint32_t lkMsk = 0 - (uint32_t) liBit ;
+        mkCod -= lkBnd & lkMsk ;
+        mkRng = (lkBnd & ~lkMsk) | ((mkRng - lkBnd) & lkMsk) ;
+        aiPrb += adapt(aiPrb, lkMsk) ;
+        if (mkRng < RNGTOP) {
+            mkRng <<= 8 ;
+            mkCod = (mkCod << 8) | getByt() ;
+        }
+        return liBit ;
+    }
+
+    /** @brief Read aiBit bits on a binary tree of probabilities */
+    inline int getTre (uint16_t *apPrb, int aiBit) {
+        int liIdx = 1 ;
+        for (int liBit = 0; liBit < aiBit; liBit++)
+            liIdx = (liIdx << 1) | getBit(apPrb[liIdx]) ;
+        return liIdx - (1 << aiBit) ;
+    }
+};
+
+} /* namespace JojoDiff */
+#endif /* JENTROPY_H_ */
@@ -0,0 +1,209 @@
+/*
+ * JFanout.cpp
+ *
+ * Copyright (C) 2002-2020 Joris Heirbaut
+ *
+ * This file is part of JojoDiff.
+ *
+ * JojoDiff is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <thread>
+using namespace std;
+
+#include "JFanout.h"
+#include "JDebug.h"
+#include "JFileMap.h"
+#include "JFileAheadStdio.h"
+
+namespace JojoDiff {
+
+static const char gcOutExt[] = ".jdf" ;     /**< Extension of the output files */
+
+JFanout::JFanout(JDiffJob::rSet const &arSet, int aiThr, int aiVerbse)
+: mrSet(arSet), miThr(aiThr < 1 ? 1 : aiThr), miVerbse(aiVerbse)
+{}
+
+JFanout::~JFanout() {
+    JFileMap::unmap(mpMap, mzMapSze) ;
+}
+
+/*******************************************************************************
+* One diff
+*******************************************************************************/
+int JFanout::open(rJob &arJob, JHashPos * const apHsh){
+    arJob.ipFilNew = jfopen(arJob.isNew, "rb") ;
+    if (arJob.ipFilNew == null)
+        return arJob.iiRet = EXI_SCD ;
+    if (mpMap != null) {
+        arJob.ipOrg = new JFileMap(mpMap, mzMapSze, "Org") ;
+    } else {
+        arJob.ipFilOrg = jfopen(msFilOrg, "rb") ;
+        if (arJob.ipFilOrg == null)
+            return arJob.iiRet = EXI_FRT ;
+        arJob.ipOrg = new JFileAheadStdio(arJob.ipFilOrg, "Org", mrSet.ilBufOrg, mrSet.iiBlkSze, false) ;
+    }
+    arJob.ipNew = new JFileAheadStdio(arJob.ipFilNew, "New", mrSet.ilBufNew, mrSet.iiBlkSze, false) ;
+
+    arJob.ipFilOut = fopen(arJob.isOut, "wb") ;
+    if (arJob.ipFilOut == null)
+        return arJob.iiRet = EXI_OUT ;
+    arJob.ipOut = new JOutBin(arJob.ipFilOut, mrSet.ibEnt) ;
+
+    // progress output of parallel diffs would get mixed up: verbose 0
+    arJob.ipDif = new JDiff(arJob.ipOrg, arJob.ipNew, arJob.ipOut,
+                            mrSet.iiHshMbt, 0,
+                            mrSet.ibSrcBkt, 1, mrSet.iiMchMax, mrSet.iiMchMin,
+                            mrSet.izAhdMax, mrSet.ibCmpAll, apHsh) ;
+    arJob.ipDif->setCost(mrSet.ibCst) ;
+    arJob.ipDif->setDefer(mrSet.ibDfr) ;
+    arJob.ipDif->setNear(mrSet.ibNer) ;
+    arJob.ipDif->setAdapt(mrSet.ibAdp) ;
+    return 0 ;
+}
+
+void JFanout::diff(rJob &arJob){
+    if (arJob.ipDif == null)
+        return ;
+
+    arJob.iiRet = arJob.ipDif->jdiff() ;
+    if (arJob.iiRet == EXI_OK) {
+        if (arJob.ipOut->gzOutBytDta > 0)
+            arJob.iiRet = EXI_DIF ;
+        else
+            arJob.iiRet = EXI_EQL ;
+    }
+    if (fflush(arJob.ipFilOut) != 0)
+        arJob.iiRet = EXI_WRI ;
+    else
+        arJob.izOutSze = jftell(arJob.ipFilOut) ;
+}
+
+void JFanout::close(rJob &arJob){
+    delete arJob.ipDif ;
+    delete arJob.ipOut ;
+    delete arJob.ipNew ;
+    delete arJob.ipOrg ;
+    arJob.ipDif = null ;
+    arJob.ipOut = null ;
+    arJob.ipNew = null ;
+    arJob.ipOrg = null ;
+    if (arJob.ipFilOut != null && fclose(arJob.ipFilOut) != 0 && arJob.iiRet >= 0)
+        arJob.iiRet = EXI_WRI ;
+    if (arJob.ipFilNew != null)
+        jfclose(arJob.ipFilNew) ;
+    if (arJob.ipFilOrg != null)
+        jfclose(arJob.ipFilOrg) ;
+    arJob.ipFilOut = null ;
+    arJob.ipFilNew = null ;
+    arJob.ipFilOrg = null ;
+}
+
+/*******************************************************************************
+* Fan-out
+*******************************************************************************/
+int JFanout::run(const char *asFilOrg, int aiNewCnt, char * const asNewNam[]){
+    if (aiNewCnt <= 0)
+        return EXI_ARG ;
+    msFilOrg = asFilOrg ;
+
+    /* Map the original once */
+    FILE *lfFilOrg = jfopen(asFilOrg, "rb") ;
+    if (lfFilOrg == null)
+        return EXI_FRT ;
+    mpMap = JFileMap::map(lfFilOrg, mzMapSze) ;
+    jfclose(lfFilOrg) ;
+    if (miVerbse > 0)
+        fprintf(JDebug::stddbg, "Fan-out: %d new files against %s (%s)\n",
+                aiNewCnt, asFilOrg, mpMap != null ? "mapped" : "not mapped") ;
+
+    rJob *lpJob = (rJob *) calloc(aiNewCnt, sizeof(rJob)) ;
+    if (lpJob == null)
+        return EXI_MEM ;
+    for (int liJob = 0; liJob < aiNewCnt; liJob++) {
+        lpJob[liJob].isNew = asNewNam[liJob] ;
+        lpJob[liJob].isOut = (char *) malloc(strlen(asNewNam[liJob]) + sizeof(gcOutExt)) ;
+        if (lpJob[liJob].isOut != null) {
+            strcpy(lpJob[liJob].isOut, asNewNam[liJob]) ;
+            strcat(lpJob[liJob].isOut, gcOutExt) ;
+        }
+        lpJob[liJob].iiRet = EXI_ERR ;
+        lpJob[liJob].izOutSze = -1 ;
+    }
+
+    /* The first diff builds the index, the others share it */
+    int liRet = EXI_OK ;
+    JHashPos *lpHsh = null ;
+    if (lpJob[0].isOut == null) {
+        liRet = EXI_MEM ;
+    } else if (open(lpJob[0], null) == 0) {
+        liRet = lpJob[0].ipDif->prescan() ;
+        if (liRet == 0)
+            lpHsh = lpJob[0].ipDif->getHsh() ;
+    } else {
+        liRet = lpJob[0].iiRet ;
+    }
+
+    /* Run all diffs on a pool of threads */
+    if (lpHsh != null) {
+        atomic<int> liNxt(0) ;
+        auto lfWrk = [&]() {
+            for (int liJob = liNxt++; liJob < aiNewCnt; liJob = liNxt++) {
+                if (liJob == 0) {
+                    diff(lpJob[0]) ;        // opened above, closed below: it owns the index
+                } else if (lpJob[liJob].isOut == null) {
+                    lpJob[liJob].iiRet = EXI_MEM ;
+                } else {
+                    if (open(lpJob[liJob], lpHsh) == 0)
+                        diff(lpJob[liJob]) ;
+                    close(lpJob[liJob]) ;
+                }
+            }
+        } ;
+        int liThrCnt = (aiNewCnt < miThr) ? aiNewCnt : miThr ;
+        thread *lpThr = new thread[liThrCnt - 1] ;
+        for (int liThr = 0; liThr < liThrCnt - 1; liThr++)
+            lpThr[liThr] = thread(lfWrk) ;
+        lfWrk() ;
+        for (int liThr = 0; liThr < liThrCnt - 1; liThr++)
+            lpThr[liThr].join() ;
+        delete [] lpThr ;
+    }
+    close(lpJob[0]) ;
+
+    /* Report and combine the results */
+    if (liRet == EXI_OK) {
+        liRet = EXI_EQL ;
+        for (int liJob = 0; liJob < aiNewCnt; liJob++) {
+            int liJobRet = lpJob[liJob].iiRet ;
+            if (miVerbse > 0 || (liJobRet != EXI_DIF && liJobRet != EXI_EQL))
+                fprintf(JDebug::stddbg, "Patch size " P8zd " (rc=%d) for %s\n",
+                        lpJob[liJob].izOutSze, liJobRet, lpJob[liJob].isNew) ;
+            if (liJobRet == EXI_DIF && liRet == EXI_EQL)
+                liRet = EXI_DIF ;
+            else if (liJobRet < 0 && liRet >= 0)
+                liRet = liJobRet ;
+        }
+    }
+
+    for (int liJob = 0; liJob < aiNewCnt; liJob++)
+        free(lpJob[liJob].isOut) ;
+    free(lpJob) ;
+    return liRet ;
+}
+
+} /* namespace JojoDiff */
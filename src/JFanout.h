@@ -0,0 +1,122 @@
+/*
+ * JFanout.h
+ *
+ * Copyright (C) 2002-2020 Joris Heirbaut
+ *
+ * This file is part of JojoDiff.
+ *
+ * JojoDiff is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *******************************************************************************
+ * Fan-out: diff one original against many new files, in parallel.
+ *
+ * 1) map the original file into memory once (see JFileMap),
+ * 2) build the full index of the original once, with the first diff,
+ * 3) run all diffs on a pool of threads: each diff has its own cursor on the
+ *    mapping, its own new file, table of matches and output "<new file>.jdf",
+ *    while the index is shared (it is only read once built).
+ *
+ * Without a mapping (Windows, or when mapping fails), each diff reads the
+ * original through its own buffers; the index is still shared.
+ *******************************************************************************/
+
+#ifndef JFANOUT_H_
+#define JFANOUT_H_
+
+#include <stdio.h>
+
+#include "JDefs.h"
+#include "JDiffJob.h"
+#include "JFile.h"
+#include "JOutBin.h"
+#include "JDiff.h"
+
+namespace JojoDiff {
+
+class JFanout {
+public:
+    JFanout(JFanout const&) = delete;
+    JFanout& operator=(JFanout const&) = delete;
+
+    /**
+     * @brief Create a fan-out.
+     *
+     * @param arSet     JDiff settings (a full index is always used)
+     * @param aiThr     Maximum number of diffs to run in parallel
+     * @param aiVerbse  Verbose level
+     */
+    JFanout(JDiffJob::rSet const &arSet, int aiThr, int aiVerbse);
+
+    virtual ~JFanout();
+
+    /**
+     * @brief Diff the original against every new file, into "<new file>.jdf".
+     *
+     * @param asFilOrg  Original file name (must be a regular file)
+     * @param aiNewCnt  Number of new files
+     * @param asNewNam  New file names
+     * @return EXI_DIF when any new file differs, EXI_EQL when none,
+     *         the first error code otherwise
+     */
+    int run(const char *asFilOrg, int aiNewCnt, char * const asNewNam[]);
+
+    /** @brief Is the original read through one mapping (otherwise through buffers per diff) ? */
+    bool isMapped() const {return mpMap != null;}
+
+private:
+    /**
+     * One diff of the fan-out
+     */
+    typedef struct {
+        const char *isNew ;     /**< new file name                          */
+        char *isOut ;           /**< output file name                       */
+        FILE *ipFilOrg ;        /**< original file (without mapping)        */
+        FILE *ipFilNew ;        /**< new file                               */
+        FILE *ipFilOut ;        /**< output file                            */
+        JFile *ipOrg ;          /**< reader on the original                 */
+        JFile *ipNew ;          /**< reader on the new file                 */
+        JOutBin *ipOut ;        /**< output                                 */
+        JDiff *ipDif ;          /**< the diff                               */
+        int iiRet ;             /**< result                                 */
+        off_t izOutSze ;        /**< size of the patch                      */
+    } rJob ;
+
+    /**
+     * @brief Open the files of a diff and create the diff.
+     * @param apHsh     shared index, null = build an index
+     * @return 0=ok, error code otherwise (also in iiRet)
+     */
+    int open(rJob &arJob, JHashPos * const apHsh);
+
+    /**
+     * @brief Run an opened diff and flush its output.
+     */
+    void diff(rJob &arJob);
+
+    /**
+     * @brief Delete the diff and close its files.
+     */
+    void close(rJob &arJob);
+
+    JDiffJob::rSet const mrSet ;    /**< Settings                           */
+    int const miThr ;               /**< Number of parallel diffs           */
+    int const miVerbse ;            /**< Verbose level                      */
+
+    const char *msFilOrg = null ;   /**< Original file name                 */
+    jchar *mpMap = null ;           /**< Mapping of the original            */
+    off_t mzMapSze = 0 ;            /**< Size of the mapping                */
+};
+
+} /* namespace JojoDiff */
+#endif /* JFANOUT_H_ */
@@ -92,6 +92,38 @@ public:
         return get(mzPosRed, aiSft);
     } ;
 
+    /**
+     * @brief Peek at the buffered bytes that get() would return next, without reading them.
+     *
+     * The bytes are contiguous in memory and remain valid until the next call to get().
+     *
+     * @param   azPos   position of the next byte to read
+     * @param   alLen   out: number of bytes available (0 = none, not an error)
+     * @return          pointer to the byte at azPos (only when alLen > 0)
+     */
+    inline jchar const *getRed (const off_t &azPos, long &alLen) const {
+        alLen = (azPos == mzPosRed) ? miRedSze : 0 ;
+        return mpRed ;
+    }
+
+    /**
+     * @brief Peek at the buffered bytes following the last byte read.
+     */
+    inline jchar const *getRed (long &alLen) const {
+        return getRed(mzPosRed, alLen) ;
+    }
+
+    /**
+     * @brief Skip bytes obtained by getRed, as if they were read by get().
+     *
+     * @param   alLen   number of bytes to skip (not more than available)
+     */
+    inline void skipRed (const long alLen) {
+        mzPosRed += alLen ;
+        miRedSze -= alLen ;
+        mpRed += alLen ;
+    }
+
 	/**
 	 * @brief Set lookahead base: soft lookahead will fail when reading after base + buffer size
 	 *
@@ -132,6 +164,19 @@ public:
 	 */
 	virtual long getBufSze() { return -1 ; }
 
+	/**
+	 * @brief Can the given position be read without repositioning the file,
+	 *        i.e. is it buffered or can the buffer be extended up to it ?
+	 */
+	virtual bool isNear(const off_t azPos) { return false ; }
+
+	/**
+	 * @brief Return the size of the file, when known
+	 *
+	 * @return  -1=unknown (not yet reached on a sequential file), >= 0 : EOF-position
+	 */
+	off_t getEofPos() const { return mzPosEof == MAX_OFF_T ? -1 : mzPosEof ; }
+
 	 /**
 	 * @brief Get access to (fast) buffered read.
 	 *
@@ -176,7 +221,6 @@ protected:
     bool mbSeq ;                    /**< Sequential file                                    */
     long miRedSze=0;                /**< distance between izPosRed and izPosInp             */
     jchar *mpRed=null;              /**< last position read from buffer				        */
-    off_t mzPosInp=0;               /**< current position in file                           */
     off_t mzPosRed=0;               /**< last position read from buffer				        */
     off_t mzPosEof ;                /**< EOF-position                                       */
 
@@ -23,13 +23,12 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <exception>
-#if debug
-#include <string.h>
-#endif
 
 #include "JFileAhead.h"
 #include "JDebug.h"
+#include "JProbe.h"
 
 namespace JojoDiff {
 
@@ -56,21 +55,31 @@ JFileAhead::JFileAhead(char const * const asJid, const long alBufSze, const int
         fprintf(JDebug::stddbg, "Warning: Buffer size cannot be zero: set to %ld.\n", mlBufSze);
     }
 
-    // Allocate buffer
-    mpBuf = (jchar *) malloc(mlBufSze) ;
+    // Ring buffer: power-of-two sizes, so that position & mask gives the slot
+    // and blocks never straddle the end of the ring
+    mlBufSze = ringSze(mlBufSze, miBlkSze) ;
+    while ((miBlkSze & (miBlkSze - 1)) != 0)
+        miBlkSze &= miBlkSze - 1 ;
+
+    // Allocate buffers: the lookahead window gets the buffer size,
+    // the read window a quarter of it (sequential files do not have one)
+    mrWinAhd.ilSze = mlBufSze ;
+    mrWinAhd.ilMsk = mlBufSze - 1 ;
+    mrWinAhd.ipBuf = (jchar *) malloc(mrWinAhd.ilSze) ;
+    if (! abSeq) {
+        mrWinRed.ilSze = (mlBufSze / 4 > miBlkSze) ? mlBufSze / 4 : miBlkSze ;
+        mrWinRed.ilMsk = mrWinRed.ilSze - 1 ;
+        mrWinRed.ipBuf = (jchar *) malloc(mrWinRed.ilSze) ;
+    }
 #ifdef JDIFF_THROW_BAD_ALLOC
-    if (mpBuf == null){
+    if (mrWinAhd.ipBuf == null || (! abSeq && mrWinRed.ipBuf == null)){
         throw bad_alloc() ;
     }
 #endif
 
     // Initialize buffer logic
-    mpMax = mpBuf + mlBufSze ;
-    mpInp = mpBuf;
-    mpRed = mpInp;
+    mpRed = mrWinAhd.ipBuf;
 
-    miBufUsd = 0;
-    mzPosInp = 0;
     mzPosEof = MAX_OFF_T ;
     mzPosRed = 0 ;
     mzPosBse = 0 ;
@@ -78,13 +87,23 @@ JFileAhead::JFileAhead(char const * const asJid, const long alBufSze, const int
 
 #if debug
     if (JDebug::gbDbg[DBGBUF])
-        fprintf(JDebug::stddbg, "ufFabOpn(%s):(buf=%p,max=%p,sze=%ld)\n",
-                asJid, mpBuf, mpMax, mlBufSze);
+        fprintf(JDebug::stddbg, "ufFabOpn(%s):(buf=%p,sze=%ld,red=%p,sze=%ld)\n",
+                asJid, mrWinAhd.ipBuf, mrWinAhd.ilSze, mrWinRed.ipBuf, mrWinRed.ilSze);
 #endif
 }
 
+long JFileAhead::ringSze(long alBufSze, int aiBlkSze) {
+    while ((aiBlkSze & (aiBlkSze - 1)) != 0)
+        aiBlkSze &= aiBlkSze - 1 ;
+    long llBufSze = aiBlkSze ;
+    while (llBufSze * 2 <= alBufSze)
+        llBufSze *= 2 ;
+    return llBufSze ;
+}
+
 JFileAhead::~JFileAhead() {
-	if (mpBuf != null) free(mpBuf) ;
+	if (mrWinAhd.ipBuf != null) free(mrWinAhd.ipBuf) ;
+	if (mrWinRed.ipBuf != null) free(mrWinRed.ipBuf) ;
 }
 
 /**
@@ -100,7 +119,7 @@ long JFileAhead::seekcount() const {
  * @return  -1=no buffering, > 0 : first position in buffer
  */
 off_t JFileAhead::getBufPos(){
-    return mzPosInp - miBufUsd ;
+    return mrWinAhd.izInp - mrWinAhd.ilUsd ;
 }
 
 /**
@@ -112,6 +131,15 @@ long JFileAhead::getBufSze() {
     return mlBufSze ;
 }
 
+/**
+ * @brief Is the given position in the lookahead or read window, or can the
+ *        lookahead window be appended up to it (no Reset nor Scrollback) ?
+ */
+bool JFileAhead::isNear(const off_t azPos) {
+    return (azPos >= mrWinAhd.izInp - mrWinAhd.ilUsd && azPos < mrWinAhd.izInp + mrWinAhd.ilSze)
+        || inwin(mrWinRed, azPos) ;
+}
+
 /**
  * @brief Set lookahead base: soft lookahead will fail when reading after base + buffer size
  *
@@ -149,24 +177,13 @@ int JFileAhead::get_frombuffer (
 	    #if debug
 	    // double-verify contents of the buffer
         if (JDebug::gbDbg[DBGRED]) {
-            // detect buffer logic failure
-            int lzDbg ;
-            jchar *lpDbg ;
-            lzDbg = (mzPosInp - azPos) ;
-            lpDbg = (mpInp - lzDbg) ;
-            if (lpDbg < mpBuf || lpDbg >= mpMax)
-                lpDbg += mlBufSze ;
-            if (lpDbg != lpDta){
-                fprintf(JDebug::stddbg, "JFileAhead(%s," P8zd ",%d)->%c=%2x (mem %p): pos-error !\n",
-                   msJid, azPos, aiSft, *lpDta, *lpDta, lpDta );
-            }
-
             // detect buffer contents failure
             static jchar lcTst[1024*1024] ;
             int liDne ;
             int liCmp ;
             int liLen ;
             jseek(azPos) ;
+            mzPosFil = -1 ;
             if (lzLen > (off_t) sizeof(lcTst))
                 liLen = sizeof(lcTst);
             else
@@ -181,7 +198,6 @@ int JFileAhead::get_frombuffer (
                 fprintf(JDebug::stddbg, "JFileAhead(%s," P8zd ",%d)->%c=%2x (mem %p): buf-error !\n",
                    msJid, azPos, aiSft, *lpDta, *lpDta, lpDta );
             }
-            jseek(mzPosInp);
 	    }
 	    #endif
 
@@ -189,9 +205,6 @@ int JFileAhead::get_frombuffer (
         mzPosRed = azPos + 1;
         miRedSze = lzLen - 1;
         mpRed = lpDta + 1;
-        if (mpRed == mpMax) {
-            mpRed = mpBuf ;
-        }
 
         // return data at current position
         return *lpDta ;
@@ -210,15 +223,27 @@ int JFileAhead::get_frombuffer (
 jchar * JFileAhead::getbuf(const off_t azPos, off_t &azLen, const eAhead aiSft) {
 	jchar *lpDta=null ;
 
+	// Lookahead uses the lookahead window, reading uses the read window.
+	// A sequential file (e.g. a pipe found by chkSeq after construction) cannot
+	// go back to refill the read window, so it only uses the lookahead window.
+	rWin &lrWin = (aiSft == Read && mrWinRed.ipBuf != null && ! mbSeq) ? mrWinRed : mrWinAhd ;
+	rWin *lpWin = &lrWin ;
+
 	if (azPos >= mzPosEof) {
         /* eof */
         azLen = EOF ;
         return null ;
-	} else if (azPos < mzPosInp && azPos >= mzPosInp - miBufUsd){
+	} else if (inwin(lrWin, azPos)){
 	    // Data is already in the buffer
+	} else if (inwin(mrWinAhd, azPos)){
+	    // Data is in the other window: use it from there
+	    lpWin = &mrWinAhd ;
+	} else if (inwin(mrWinRed, azPos)){
+	    lpWin = &mrWinRed ;
 	} else {
-	    // Get data from underlying file
-        switch (get_fromfile(azPos, aiSft)) {
+	    // Get data from underlying file (get's fast path may point into the window)
+	    miRedSze = 0 ;
+        switch (get_fromfile(lrWin, azPos, aiSft)) {
         case EndOfBuffer: azLen = EOB ;    return null ;
         case EndOfFile:   azLen = EOF ;    return null ;
         case SeekError:   azLen = EXI_SEK; return null ;
@@ -228,22 +253,14 @@ jchar * JFileAhead::getbuf(const off_t azPos, off_t &azLen, const eAhead aiSft)
         } // switch get_fromfile
     } // if elseif else azPos
 
-    // Calculate position of azPos
-    azLen = mzPosInp - azPos ;
-    if (azLen <= mpInp - mpBuf){
-        lpDta = mpInp - azLen ;
-    } else {
-        lpDta = mpInp + mlBufSze - azLen ;
-        azLen = mpMax - lpDta ;
-    }
+    // Calculate position of azPos: contiguous up to the end of the data or the ring
+    lpDta = lpWin->ipBuf + (azPos & lpWin->ilMsk) ;
+    azLen = lpWin->izInp - azPos ;
+    if (azLen > lpWin->ilSze - (azPos & lpWin->ilMsk))
+        azLen = lpWin->ilSze - (azPos & lpWin->ilMsk) ;
 
     #if debug
-    if (lpDta < mpBuf || lpDta >= mpMax){
-        fprintf(JDebug::stddbg, "JFileAhead::getbuf(%s,%" PRIzd ",%" PRIzd ",%d)->   (sto %p) out of bounds !\n",
-                msJid, azPos, azLen, aiSft, lpDta);
-        exit(- EXI_SEK);
-    }
-    if (azPos >= mzPosInp || azPos < mzPosInp - miBufUsd) {
+    if (! inwin(*lpWin, azPos)) {
         fprintf(JDebug::stddbg, "JFileAhead::getbuf(%s,%" PRIzd ",%" PRIzd ",%d)->%2x (sto %p) failed !\n",
                 msJid, azPos, azLen, aiSft, *lpDta, lpDta);
         exit(- EXI_SEK);
@@ -257,6 +274,7 @@ jchar * JFileAhead::getbuf(const off_t azPos, off_t &azLen, const eAhead aiSft)
  * Retrieve requested position into the buffer, trying to keep the buffer as
  * large as possible (i.e. invalidating/overwriting as less as possible).
  *
+ * @param arWin     window to read into
  * @param azPos     position to read from
  * @param azLen     out: > 0 : available bytes in buffer, < 0 : EOF or EOB.
  * @param aiSft     0=read, 1=hard ahead, 2=soft ahead
@@ -267,14 +285,16 @@ jchar * JFileAhead::getbuf(const off_t azPos, off_t &azLen, const eAhead aiSft)
  * @return 3 = partial read, unaligned/broken read
  */
 JFileAhead::eBufDne JFileAhead::get_fromfile (
+    rWin &arWin,            /**< window to read into                  */
     const off_t azPos,      /**< position to read from                */
     const eAhead aiSft      /**< 0=read, 1=hard ahead, 2=soft ahead   */
 ){
     eBufOpr liSek ;         /**< buffer logic operation type    */
-    int liDne ;             /**< number of bytes read           */
+    long llDne ;            /**< number of bytes read           */
+    off_t lzBeg = arWin.izInp - arWin.ilUsd ;   /**< first position in the buffer */
 
     /* Preparation: Check what should be done and set liSek accordingly */
-    if (azPos < mzPosInp - miBufUsd ) {
+    if (azPos < lzBeg) {
         // Reading before the start of the buffer:
         // - not allowed in sequential nor soft-reading mode
         // - either cancel the whole buffer: easiest, but we loose all data in the buffer
@@ -286,11 +306,11 @@ JFileAhead::eBufDne JFileAhead::get_fromfile (
                 return EndOfBuffer ;
             else
                 return SeekError ;
-        } else if (azPos + mlBufSze - miBlkSze > mzPosInp - miBufUsd)
+        } else if (azPos + arWin.ilSze - miBlkSze > lzBeg)
             liSek = Scrollback;
         else
             liSek = Reset ;
-    } else if (azPos >= mzPosInp + mlBufSze) {
+    } else if (azPos >= arWin.izInp + arWin.ilSze) {
         // Advancing more than the size of the buffer:
         // - not allowed when soft-reading
         // - just reset
@@ -300,7 +320,7 @@ JFileAhead::eBufDne JFileAhead::get_fromfile (
             liSek = Reset ;
     } else {
         // Append to the buffer if possible
-        if (aiSft == SoftAhead && azPos > mzPosBse + mlBufSze - miBlkSze)
+        if (aiSft == SoftAhead && azPos > mzPosBse + arWin.ilSze - miBlkSze)
             return EndOfBuffer;
         else
             liSek = Append ;
@@ -310,75 +330,53 @@ JFileAhead::eBufDne JFileAhead::get_fromfile (
     case Reset:
         if (! mbSeq){
             // Calculate position and length
-            mzPosInp = (azPos / miBlkSze) * miBlkSze ;
+            arWin.izInp = (azPos / miBlkSze) * miBlkSze ;
         } else {
             // In sequential mode: jump forward and then append, keep the buffer as large as possible
-            mzPosInp = ((azPos - mlBufSze + miBlkSze) / miBlkSze) * miBlkSze ;
+            arWin.izInp = ((azPos - arWin.ilSze + miBlkSze) / miBlkSze) * miBlkSze ;
         }
 
-        // Reset buffer
-        mpInp    = mpBuf;
-        mzPosBse = mzPosInp ;
-        miBufUsd = 0 ;
+        JPROBE2(ahead_reset, azPos, arWin.izInp) ;
 
-        // Seek
-        if (jseek(mzPosInp) != EXI_OK)
-            return SeekError ;
-        mlFabSek++ ;
+        // Reset buffer
+        if (&arWin == &mrWinAhd)
+            mzPosBse = arWin.izInp ;
+        arWin.ilUsd = 0 ;
 
         // Read
-        liDne = readblocks(mpInp, mzPosInp, azPos);
-        if (liDne == EOF)
+        llDne = readblocks(arWin, azPos);
+        if (llDne == EOF)
             return EndOfFile ;
+        if (llDne == EXI_SEK)
+            return SeekError ;
     break ;
 
     case Append:
-        liDne = readblocks(mpInp, mzPosInp, azPos);
-        if (liDne == EOF)
+        llDne = readblocks(arWin, azPos);
+        if (llDne == EOF)
             return EndOfFile ;
+        if (llDne == EXI_SEK)
+            return SeekError ;
     break ;
 
     case Scrollback: {
-        // Calculate scrollback position
-        off_t  lzPos = (azPos / miBlkSze) * miBlkSze ;   /**< position to seek               */
-        off_t  lzLen = mzPosInp - lzPos ;                /**< new potential buffer length    */
-        jchar* lpInp = mpInp - lzLen ;
-        if (lzLen  > mpInp - mpBuf) {
-            lpInp += mlBufSze ;
-        }
-
-        // Make room in the buffer for the scrollback
-        if (lzLen > mlBufSze){
-            lzLen    = lzLen - mlBufSze ;
-            miBufUsd = miBufUsd - lzLen ;
-            mzPosInp = lzPos + mlBufSze ;
-            if (lzLen  > mpInp - mpBuf)
-                lpInp += mlBufSze ;
-            mpInp    = lpInp ;
-        }
+        // Scrollback position: the slots before the buffer are the ones at its end,
+        // drop data at the end of the buffer to make room
+        off_t lzPos = (azPos / miBlkSze) * miBlkSze ;
+        if (arWin.izInp - lzPos > arWin.ilSze)
+            arWin.izInp = lzPos + arWin.ilSze ;
+        JPROBE3(ahead_scrollback, azPos, lzPos, lzBeg) ;
 
-        // Seek
-        if (jseek(lzPos) != EXI_OK)
-            return SeekError ;
-        mlFabSek++ ;
-
-        // Read loop
-        liDne = readblocks(lpInp, lzPos, mzPosInp - miBufUsd - 1);
-        if (liDne == EOF){
+        llDne = fill(arWin, lzPos, lzBeg) ;
+        if (llDne != lzBeg - lzPos){
             // A scrollback cannot issue an EOF unless there's a hardware error
             // or the file is being truncated while we're reading it.
             // In both cases, the outcome will probably be unusable.
-            // The buffer variables are set here just for the sake of "correctness".
-            mpInp = lpInp ;
-            mzPosInp = lzPos ;
-            miBufUsd = liDne ;
-            return ReadError ;
-        }
-
-        // @Seek
-        if (jseek(mzPosInp) != EXI_OK)
-            return SeekError ;
-        mlFabSek++ ;
+            // The buffer is emptied here just for the sake of "correctness".
+            arWin.ilUsd = 0 ;
+            return (llDne == EXI_SEK) ? SeekError : ReadError ;
+        }
+        arWin.ilUsd = arWin.izInp - lzPos ;
         } // scrollback
     break ;
     } /* switch liSek */
@@ -387,47 +385,103 @@ JFileAhead::eBufDne JFileAhead::get_fromfile (
 } /* get_fromfile */
 
 /**
-* @brief Read blocks till the specified end
+* @brief Read from the underlying file: positional read if available, seek and read otherwise
 */
-int JFileAhead::readblocks(jchar* &apInp, off_t &azInp, off_t const azEnd)
+long JFileAhead::readat(jchar * const apDta, const long alLen, const off_t azPos)
 {
-    int liTdo ;   /**< Number of bytes to read */
-    int liDne=0 ; /**< Number of bytes read */
+    long llDne ;
+    if (mbPrd) {
+        llDne = (long) jpread(apDta, alLen, azPos) ;
+    } else {
+        if (azPos != mzPosFil) {
+            if (jseek(azPos) != EXI_OK) {
+                mzPosFil = -1 ;
+                return EXI_SEK ;
+            }
+            mlFabSek++ ;
+        }
+        llDne = (long) jread(apDta, alLen) ;
+        mzPosFil = azPos + llDne ;
+    }
+    JPROBE3(ahead_read, azPos, alLen, llDne) ;
+    return llDne ;
+}
 
-    // Read loop
-    while (azInp <= azEnd){
-        // Prepare
-        liTdo = miBlkSze ;
-        if (apInp == mpMax)
-            apInp = mpBuf ;
-        else if (mpMax - apInp < liTdo)
-            liTdo = mpMax - apInp ;
+/**
+* @brief Fill a range of a window: the part held by the other window is copied,
+*        the rest is read (one read per contiguous part of the ring)
+*/
+long JFileAhead::fill(rWin &arWin, const off_t azBeg, const off_t azEnd)
+{
+    rWin const &lrOth = (&arWin == &mrWinAhd) ? mrWinRed : mrWinAhd ;
+    off_t lzOth = lrOth.izInp - lrOth.ilUsd ;   /**< first position in the other window */
+    off_t lzPos = azBeg ;
 
-        // Read
-        liDne = jread(apInp, liTdo) ;
+    while (lzPos < azEnd && lzPos < mzPosEof) {
+        long llOff = (long) (lzPos & arWin.ilMsk) ;
+        long llLen = (azEnd - lzPos < arWin.ilSze - llOff) ? (long) (azEnd - lzPos) : arWin.ilSze - llOff ;
+        long llDne ;
+
+        if (lzPos >= lzOth && lzPos < lrOth.izInp) {
+            // Copy from the other window
+            long llOth = (long) (lzPos & lrOth.ilMsk) ;
+            if (llLen > lrOth.izInp - lzPos)
+                llLen = (long) (lrOth.izInp - lzPos) ;
+            if (llLen > lrOth.ilSze - llOth)
+                llLen = lrOth.ilSze - llOth ;
+            memcpy(&arWin.ipBuf[llOff], &lrOth.ipBuf[llOth], llLen) ;
+            llDne = llLen ;
+        } else {
+            // Read up to the start of the other window
+            if (lzPos < lzOth && llLen > lzOth - lzPos)
+                llLen = (long) (lzOth - lzPos) ;
+            llDne = readat(&arWin.ipBuf[llOff], llLen, lzPos) ;
+            if (llDne < 0)
+                return llDne ;
+            if (llDne < llLen) {
+                lzPos += llDne ;
+                break ;
+            }
+        }
+        lzPos += llDne ;
+    }
+    return (long) (lzPos - azBeg) ;
+}
+
+/**
+* @brief Read blocks till the specified end
+*/
+long JFileAhead::readblocks(rWin &arWin, off_t const azEnd)
+{
+    long llDne=0 ; /**< Number of bytes read */
+
+    // Read loop: blocks are aligned, so they never straddle the end of the ring
+    while (arWin.izInp <= azEnd){
+        llDne = fill(arWin, arWin.izInp, arWin.izInp + miBlkSze) ;
+        if (llDne < 0)
+            return llDne ;
 
         // Update buffer vars
-        apInp    += liDne ;
-        azInp    += liDne ;
-        miBufUsd += liDne ;
+        arWin.izInp += llDne ;
+        arWin.ilUsd += llDne ;
 
         // Handle EOF
-        if (liDne < liTdo){
-            mzPosEof = azInp ;
-            if ( miBufUsd > mlBufSze )
-                miBufUsd = mlBufSze ;
+        if (llDne < miBlkSze){
+            mzPosEof = arWin.izInp ;
+            if ( arWin.ilUsd > arWin.ilSze )
+                arWin.ilUsd = arWin.ilSze ;
             if ( azEnd >= mzPosEof )
                 return EOF ;
             else
-                return liDne ;
+                return llDne ;
         }
     }
 
     // Update buffer vars
-    if ( miBufUsd > mlBufSze )
-        miBufUsd = mlBufSze ;
+    if ( arWin.ilUsd > arWin.ilSze )
+        arWin.ilUsd = arWin.ilSze ;
 
-    return liDne ;
+    return llDne ;
 } /* readblocks */
 
 } /* namespace JojoDiff */
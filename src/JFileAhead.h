@@ -33,6 +33,19 @@ namespace JojoDiff {
  * Buffered JFile access: optimized buffering logic for the specific way JDiff
  * accesses files, that is reading ahead to find equal regions and then coming
  * back to the base position for actual comparisons.
+ *
+ * The buffer is a ring of a power-of-two size: file position p is kept at
+ * slot (p & mask), so moving the window forward (append) or backward
+ * (scrollback) only reads the blocks that come in, into the slots freed at
+ * the other end. With positional reads (jpread), neither needs a seek.
+ *
+ * Each file has two such windows: a lookahead window for searching (HardAhead,
+ * SoftAhead) and a smaller read window for comparing (Read). Searching far
+ * ahead or checking matches far away therefore never evicts the data the
+ * comparison is about to consume. A request is served from the other window
+ * when that one holds the data, and blocks held by the other window are copied
+ * instead of read when a window moves. Sequential files only have a lookahead
+ * window.
  */
 class JFileAhead: public JFile {
     JFileAhead(JFileAhead const&) = delete;
@@ -42,6 +55,13 @@ public:
     JFileAhead(char const * const asFid, const long alBufSze = 256*1024,
                const int aiBlkSze = 8192, const bool abSeq = false);
     virtual ~JFileAhead();
+
+    /**
+     * @brief Size of the lookahead window for a requested buffer size: the largest
+     *        power-of-two multiple of the (power-of-two) block size that does not
+     *        exceed the request, so that the buffer size stays an upper bound.
+     */
+    static long ringSze(long alBufSze, int aiBlkSze) ;
 
 	 /**
 	 * @brief Get access to (fast) buffered read.
@@ -79,6 +99,12 @@ public:
 	 */
 	long getBufSze() ;
 
+    /**
+	 * @brief Is the given position in the lookahead or read window, or can the
+	 *        lookahead window be appended up to it ?
+	 */
+	bool isNear(const off_t azPos) ;
+
     /**
      * Return number of seek operations performed.
      */
@@ -109,6 +135,18 @@ protected:
     */
     virtual size_t jread(jchar * const ptr, const size_t count) = 0 ;
 
+    /**
+    * @brief Positional read abstraction, for override by subclasses that set mbPrd
+    *
+    * Reads at the given position without moving the current position, so that
+    * reading before or after the buffer does not need a seek.
+    *
+    * @param >= 0: number of bytes read
+    */
+    virtual size_t jpread(jchar * const ptr, const size_t count, const off_t azPos) { return 0 ; }
+
+    bool mbPrd = false ;    /**< Positional reads (jpread) available?           */
+
 
 private:
     enum eBufOpr { Append, Reset, Scrollback } ;
@@ -133,39 +171,69 @@ private:
      * large as possible (i.e. invalidating/overwriting as less as possible).
      * Calls get_frombuffer afterwards to get the data from the buffer.
      *
+     * @param arWin		window to read into
      * @param azPos		position to read from
      * @param aiSft		0=read, 1=hard ahead, 2=soft ahead
      * @return 1 = data read
      * @return 2 = buffer cycled
      * @return 3 = unaligned/broken read
      */
+    /**
+     * A window on the file: ring buffer with file positions [izInp - ilUsd, izInp),
+     * position p being kept at slot (p & ilMsk).
+     */
+    typedef struct {
+        jchar *ipBuf ;      /**< ring buffer                                  */
+        long ilSze ;        /**< ring size (power of two)                     */
+        long ilMsk ;        /**< ilSze - 1: position & ilMsk = buffer slot    */
+        long ilUsd ;        /**< number of bytes used in the ring             */
+        off_t izInp ;       /**< position after the last byte in the ring     */
+    } rWin ;
+
+    /** Is azPos in the window ? */
+    static inline bool inwin(rWin const &arWin, const off_t azPos) {
+        return azPos < arWin.izInp && azPos >= arWin.izInp - arWin.ilUsd ;
+    }
+
     eBufDne get_fromfile(
+        rWin &arWin,        /* window to read into                  */
         const off_t azPos,  /* position to read from                */
         const eAhead aiSft  /* 0=read, 1=hard ahead, 2=soft ahead   */
     );
 
     /**
-    * @brief Read blocks of data
-    * @param apInp      input buffer
-    * @param azInp      input position
+    * @brief Read blocks of data at the end of the buffer
+    * @param arWin      window to read into
     * @param azEnd      stop reading when end position in reached
+    * @return bytes read by the last read, EOF or EXI_SEK
     */
-    int readblocks(
-        jchar* &apInp,      /* input buffer     */
-        off_t &azInp,       /* input position   */
-        const off_t azEnd   /* end position     */
+    long readblocks(
+        rWin &arWin,        /* window to read into  */
+        const off_t azEnd   /* end position         */
     );
 
+    /**
+    * @brief Fill positions [azBeg, azEnd) of a window: copy what the other window
+    *        holds, read the remainder from the underlying file
+    * @return bytes filled (less at EOF) or EXI_SEK
+    */
+    long fill(rWin &arWin, const off_t azBeg, const off_t azEnd);
+
+    /**
+    * @brief Read from the underlying file at the given position
+    * @return bytes read or EXI_SEK
+    */
+    long readat(jchar * const apDta, const long alLen, const off_t azPos);
+
 private:
     /* Settings */
-    long mlBufSze;      /**< File lookahead buffer size                   */
+    long mlBufSze;      /**< File lookahead buffer size (power of two)    */
     int miBlkSze;       /**< Block size: read from file in blocks         */
 
     /* Buffer state */
-    long miBufUsd=0;    /**< number of bytes used in buffer               */
-    jchar *mpBuf=null;  /**< read-ahead buffer                            */
-    jchar *mpMax=null;  /**< read-ahead buffer end                        */
-    jchar *mpInp=null;  /**< current position in buffer                   */
+    rWin mrWinAhd = {null, 0, 0, 0, 0} ;   /**< lookahead window         */
+    rWin mrWinRed = {null, 0, 0, 0, 0} ;   /**< read (compare) window    */
+    off_t mzPosFil=0;   /**< current position in the underlying file      */
     off_t mzPosBse=0;   /**< base position for soft reading               */
 };
 }/* namespace */
@@ -18,6 +18,9 @@
  * You should have received a copy of the GNU General Public License
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
+#ifndef _WIN32
+#include <unistd.h>
+#endif
 #include "JFileAheadStdio.h"
 
 namespace JojoDiff {
@@ -28,6 +31,9 @@ JFileAheadStdio::JFileAheadStdio(FILE * const apFil, char const * const asFid,
 , mpFil(apFil)
 {
     chkSeq() ;  // Check if file is sequential or not
+#ifndef _WIN32
+    mbPrd = ! mbSeq ;
+#endif
 }
 
 JFileAheadStdio::~JFileAheadStdio()
@@ -71,6 +77,26 @@ size_t JFileAheadStdio::jread(jchar * const apInp, const size_t aiLen) {
     return jfread(apInp, sizeof(jchar), aiLen, mpFil) ;
 } ;
 
+/**
+* @brief Positional read (pread), not available on Windows
+*
+* @param >= 0: number of bytes read
+*/
+size_t JFileAheadStdio::jpread(jchar * const apInp, const size_t aiLen, const off_t azPos) {
+#ifndef _WIN32
+    size_t liDne = 0 ;
+    while (liDne < aiLen) {
+        ssize_t liRed = pread(fileno(mpFil), &apInp[liDne], aiLen - liDne, azPos + liDne) ;
+        if (liRed <= 0)
+            break ;
+        liDne += liRed ;
+    }
+    return liDne ;
+#else
+    return 0 ;
+#endif
+} ;
+
 /**
 * @brief Get underlying file descriptor.
 */
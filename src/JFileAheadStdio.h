@@ -68,6 +68,13 @@ protected:
     */
     virtual size_t jread(jchar * const ptr, const size_t count) ;
 
+    /**
+    * @brief Positional read (pread), not available on Windows
+    *
+    * @param >= 0: number of bytes read
+    */
+    virtual size_t jpread(jchar * const ptr, const size_t count, const off_t azPos) ;
+
 private:
     FILE * const mpFil;        /**< file handle    */
 };
@@ -0,0 +1,108 @@
+/*
+ * JFileMap.cpp
+ *
+ * Copyright (C) 2002-2020 Joris Heirbaut
+ *
+ * This file is part of JojoDiff.
+ *
+ * JojoDiff is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <limits.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+#include "JFileMap.h"
+
+namespace JojoDiff {
+
+/*******************************************************************************
+* Mapping
+*******************************************************************************/
+jchar *JFileMap::map(FILE * const apFil, off_t &azSze)
+{
+#ifdef _WIN32
+    azSze = -1 ;
+    return null ;
+#else
+    if (jfseek(apFil, 0, SEEK_END) != 0)
+        return null ;
+    azSze = jftell(apFil) ;
+    jfseek(apFil, 0, SEEK_SET) ;
+    if (azSze <= 0 || (off_t) (size_t) azSze != azSze)
+        return null ;
+
+    void *lpMap = mmap(null, (size_t) azSze, PROT_READ, MAP_SHARED, fileno(apFil), 0) ;
+    if (lpMap == MAP_FAILED)
+        return null ;
+    return (jchar *) lpMap ;
+#endif
+}
+
+void JFileMap::unmap(jchar * const apMap, const off_t azSze)
+{
+#ifndef _WIN32
+    if (apMap != null)
+        munmap(apMap, (size_t) azSze) ;
+#endif
+}
+
+/*******************************************************************************
+* Cursor
+*******************************************************************************/
+JFileMap::JFileMap(jchar * const apMap, const off_t azSze, char const * const asFid)
+: JFile(asFid, false), mpMap(apMap), mzSze(azSze)
+{
+    chkSeq() ;
+}
+
+JFileMap::~JFileMap()
+{
+}
+
+jchar *JFileMap::getbuf(const off_t azPos, off_t &azLen, const eAhead aiSft)
+{
+    if (azPos >= mzSze || azPos < 0) {
+        azLen = EOF ;
+        return null ;
+    }
+    azLen = mzSze - azPos ;
+    return &mpMap[azPos] ;
+}
+
+long JFileMap::getBufSze()
+{
+    return (mzSze > LONG_MAX) ? LONG_MAX : (long) mzSze ;
+}
+
+int JFileMap::get_frombuffer(const off_t azPos, const eAhead aiSft)
+{
+    off_t lzLen ;
+    jchar *lpDta = getbuf(azPos, lzLen, aiSft) ;
+    if (lpDta == null) {
+        mzPosRed = -1 ;
+        mpRed = null ;
+        miRedSze = 0 ;
+        return (int) lzLen ;
+    }
+
+    // prepare next reading position
+    mzPosRed = azPos + 1 ;
+    miRedSze = (lzLen - 1 > LONG_MAX) ? LONG_MAX : (long) (lzLen - 1) ;
+    mpRed = lpDta + 1 ;
+    return *lpDta ;
+}
+
+} /* namespace JojoDiff */
@@ -0,0 +1,100 @@
+/*
+ * JFileMap.h
+ *
+ * Copyright (C) 2002-2020 Joris Heirbaut
+ *
+ * This file is part of JojoDiff.
+ *
+ * JojoDiff is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *******************************************************************************
+ * Memory-mapped access to a regular file.
+ *
+ * The whole file is one read-only mapping, created by map() and released by
+ * unmap(). A JFileMap is only a cursor on such a mapping: several of them,
+ * on as many threads, can read the same file without buffers of their own,
+ * and the pages are shared by all of them (see JFanout).
+ *
+ * Mapping is not available on Windows: map() then returns null and the caller
+ * falls back to buffered access (JFileAheadStdio).
+ *******************************************************************************/
+
+#ifndef JFILEMAP_H_
+#define JFILEMAP_H_
+
+#include <stdio.h>
+
+#include "JDefs.h"
+#include "JFile.h"
+
+namespace JojoDiff {
+
+class JFileMap : public JFile
+{
+    JFileMap(JFileMap const&) = delete;
+    JFileMap& operator=(JFileMap const&) = delete;
+
+public:
+    /**
+     * @brief Map a regular file into memory, read-only.
+     *
+     * @param apFil     File to map (may be closed once mapped)
+     * @param azSze     out: size of the file
+     * @return          the mapping, null = not possible (error, empty file, Windows)
+     */
+    static jchar *map(FILE * const apFil, off_t &azSze) ;
+
+    /**
+     * @brief Release a mapping obtained from map().
+     */
+    static void unmap(jchar * const apMap, const off_t azSze) ;
+
+    /**
+     * @brief Create a cursor on a mapping, which must outlive the cursor.
+     *
+     * @param apMap     Mapping (see map)
+     * @param azSze     Size of the mapping
+     * @param asFid     File id (for debugging)
+     */
+    JFileMap(jchar * const apMap, const off_t azSze, char const * const asFid);
+    virtual ~JFileMap();
+
+    /**
+     * @brief Get access to the mapping: the whole remainder of the file.
+     */
+    jchar *getbuf(const off_t azPos, off_t &azLen, const eAhead aiSft = Read) ;
+
+    /** @brief Nothing to do: all of the file is "buffered" */
+    void set_lookahead_base (const off_t azBse) {}
+
+    /** @brief The buffer starts at the beginning of the file */
+    off_t getBufPos() { return 0 ; }
+
+    /** @brief The buffer holds the whole file */
+    long getBufSze() ;
+
+    /** @brief Any position can be read without a seek */
+    bool isNear(const off_t azPos) { return true ; }
+
+protected:
+    off_t jeofpos() { return mzSze ; }
+    int get_frombuffer(const off_t azPos, const eAhead aiSft) ;
+
+private:
+    jchar * const mpMap ;   /**< Mapping (not owned)        */
+    off_t const mzSze ;     /**< Size of the mapping        */
+};
+
+} /* namespace JojoDiff */
+#endif /* JFILEMAP_H_ */
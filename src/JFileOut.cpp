@@ -83,6 +83,16 @@ int JFileOut::putc(const int aiDta){
     return fputc(aiDta, mpFil) ;
 } /* putc */
 
+/**
+* @brief    Write a series of bytes to the output.
+* @param    apDta   data to write
+* @param    alLen   number of bytes
+* @return   number of bytes written
+*/
+long JFileOut::write(const jchar *apDta, const long alLen){
+    return fwrite(apDta, sizeof(jchar), alLen, mpFil) ;
+} /* write */
+
 
 
 } /* namespace */
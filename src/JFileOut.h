@@ -53,6 +53,14 @@ class JFileOut
         */
         virtual int putc(const int aiDta) ;
 
+        /**
+        * @brief    Write a series of bytes to the output.
+        * @param    apDta   data to write
+        * @param    alLen   number of bytes
+        * @return   number of bytes written
+        */
+        virtual long write(const jchar *apDta, const long alLen) ;
+
         /**
         * @brief    Copy a series of bytes from input to output.
         * @param    apFilInp    Input file
@@ -0,0 +1,202 @@
+/*
+ * JFileSpool.cpp
+ *
+ * Copyright (C) 2002-2020 Joris Heirbaut
+ *
+ * This file is part of JojoDiff.
+ *
+ * JojoDiff is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+using namespace std;
+
+#include "JFileSpool.h"
+#include "JDebug.h"
+
+namespace JojoDiff {
+
+JFileSpool::JFileSpool(JFile * const apSrc, char const * const asFid,
+                       const long alBufSze, const int aiBlkSze, const long alMemMax)
+: JFileAhead(asFid, alBufSze, aiBlkSze, false)
+, mpSrc(apSrc), mlMemMax(alMemMax / SPLCHK * SPLCHK)
+{
+    mbPrd = true ;
+
+    /* chunk table for the memory part */
+    int liChkMax = (int) (mlMemMax / SPLCHK) ;
+    mpChk = (jchar **) calloc(liChkMax > 0 ? liChkMax : 1, sizeof(jchar *)) ;
+#ifdef JDIFF_THROW_BAD_ALLOC
+    if (mpChk == null){
+        throw bad_alloc() ;
+    }
+#endif
+
+    /* EOF position is unknown until spooling is done: EOF is found by reading */
+    moThr = thread(&JFileSpool::spool, this) ;
+}
+
+JFileSpool::~JFileSpool()
+{
+    if (moThr.joinable())
+        moThr.join() ;
+    for (int liChk = 0; liChk < miChkCnt; liChk++)
+        free(mpChk[liChk]) ;
+    free(mpChk) ;
+    if (mpTmp != null)
+        fclose(mpTmp) ;
+    delete mpSrc ;
+}
+
+/*******************************************************************************
+* Spool thread
+*******************************************************************************/
+void JFileSpool::spool()
+{
+    off_t lzPos = 0 ;
+    bool lbOk = true ;
+    while (lbOk) {
+        off_t lzLen ;
+        jchar *lpDta = mpSrc->getbuf(lzPos, lzLen, JFile::Read) ;
+        if (lpDta == null) {
+            if (lzLen != EOF)
+                fprintf(JDebug::stddbg, "Error %d spooling %s at " P8zd ": input truncated.\n",
+                        (int) lzLen, msJid, lzPos) ;
+            break ;
+        }
+
+        /* memory part: fill up the last chunk or add a new one */
+        while (lzLen > 0 && lzPos < mlMemMax) {
+            long llOff = (long) (lzPos % SPLCHK) ;
+            long llCpy = (lzLen < SPLCHK - llOff) ? (long) lzLen : SPLCHK - llOff ;
+            if (llOff == 0) {
+                jchar *lpChk = (jchar *) malloc(SPLCHK) ;
+                if (lpChk == null) {
+                    fprintf(JDebug::stddbg, "Error allocating memory spooling %s: input truncated.\n", msJid) ;
+                    lbOk = false ;
+                    break ;
+                }
+                lock_guard<mutex> loLck(moMtx) ;
+                mpChk[miChkCnt++] = lpChk ;
+            }
+            memcpy(&mpChk[lzPos / SPLCHK][llOff], lpDta, llCpy) ;
+            lpDta += llCpy ;
+            lzLen -= llCpy ;
+            lzPos += llCpy ;
+
+            lock_guard<mutex> loLck(moMtx) ;
+            mzSpl = lzPos ;
+            moCnd.notify_all() ;
+        }
+
+        /* file part */
+        if (lbOk && lzLen > 0) {
+            lock_guard<mutex> loLck(moMtx) ;
+            if (mpTmp == null)
+                mpTmp = tmpfile() ;
+            if (mpTmp == null
+              || jfseek(mpTmp, lzPos - mlMemMax, SEEK_SET) != 0
+              || fwrite(lpDta, 1, lzLen, mpTmp) != (size_t) lzLen) {
+                fprintf(JDebug::stddbg, "Error writing spool file for %s: input truncated.\n", msJid) ;
+                lbOk = false ;
+            } else {
+                lzPos += lzLen ;
+                mzSpl = lzPos ;
+                moCnd.notify_all() ;
+            }
+        }
+    }
+
+    lock_guard<mutex> loLck(moMtx) ;
+    mbDne = true ;
+    moCnd.notify_all() ;
+}
+
+/*******************************************************************************
+* JFileAhead
+*******************************************************************************/
+int JFileSpool::jseek(const off_t azPos)
+{
+    mzRed = azPos ;
+    return EXI_OK ;
+}
+
+size_t JFileSpool::jpread(jchar * const apDta, const size_t aiLen, const off_t azPos)
+{
+    mzRed = azPos ;
+    return jread(apDta, aiLen) ;
+}
+
+off_t JFileSpool::jeofpos()
+{
+    lock_guard<mutex> loLck(moMtx) ;
+    return mbDne ? mzSpl : EXI_SEK ;
+}
+
+size_t JFileSpool::jread(jchar * const apDta, const size_t aiLen)
+{
+    /* wait until the requested data has been spooled */
+    off_t lzEnd ;
+    {
+        unique_lock<mutex> loLck(moMtx) ;
+        moCnd.wait(loLck, [&]{ return mbDne || mzSpl >= mzRed + (off_t) aiLen ; }) ;
+        lzEnd = (mzSpl < mzRed + (off_t) aiLen) ? mzSpl : mzRed + (off_t) aiLen ;
+    }
+
+    size_t liDne = 0 ;
+    while (mzRed < lzEnd) {
+        if (mzRed < mlMemMax) {
+            /* chunks never move once spooled */
+            jchar *lpChk ;
+            {
+                lock_guard<mutex> loLck(moMtx) ;
+                lpChk = mpChk[mzRed / SPLCHK] ;
+            }
+            long llOff = (long) (mzRed % SPLCHK) ;
+            long llCpy = (lzEnd - mzRed < SPLCHK - llOff) ? (long) (lzEnd - mzRed) : SPLCHK - llOff ;
+            memcpy(&apDta[liDne], &lpChk[llOff], llCpy) ;
+            liDne += llCpy ;
+            mzRed += llCpy ;
+        } else {
+            lock_guard<mutex> loLck(moMtx) ;
+            size_t liRed = 0 ;
+            if (jfseek(mpTmp, mzRed - mlMemMax, SEEK_SET) == 0)
+                liRed = jfread(&apDta[liDne], 1, lzEnd - mzRed, mpTmp) ;
+            if (liRed == 0)
+                break ;
+            liDne += liRed ;
+            mzRed += liRed ;
+        }
+    }
+    return liDne ;
+}
+
+/*******************************************************************************
+* Statistics
+*******************************************************************************/
+off_t JFileSpool::getSplSze()
+{
+    lock_guard<mutex> loLck(moMtx) ;
+    return mzSpl ;
+}
+
+off_t JFileSpool::getSplTmp()
+{
+    lock_guard<mutex> loLck(moMtx) ;
+    return (mzSpl > mlMemMax) ? mzSpl - mlMemMax : 0 ;
+}
+
+} /* namespace JojoDiff */
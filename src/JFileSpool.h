@@ -0,0 +1,102 @@
+/*
+ * JFileSpool.h
+ *
+ * Copyright (C) 2002-2020 Joris Heirbaut
+ *
+ * This file is part of JojoDiff.
+ *
+ * JojoDiff is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *******************************************************************************
+ * Spooled access to a sequential file (stdin, pipe).
+ *
+ * A background thread copies the sequential file, from start to end, into a
+ * spool: memory chunks up to a given size, an (unlinked) temporary file beyond.
+ * Reads are served from the spool, waiting for the spool thread when needed,
+ * so that the file can be accessed randomly, as a seekable file.
+ *
+ * Spooling runs in parallel with diffing: while JDiff indexes the original
+ * file, a new file on stdin is being spooled, and an original file on stdin
+ * is indexed as it arrives.
+ *******************************************************************************/
+
+#ifndef JFILESPOOL_H_
+#define JFILESPOOL_H_
+
+#include <stdio.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "JFileAhead.h"
+
+namespace JojoDiff {
+
+class JFileSpool : public JFileAhead
+{
+    JFileSpool(JFileSpool const&) = delete;
+    JFileSpool& operator=(JFileSpool const&) = delete;
+
+public:
+    /**
+     * @brief Start spooling a sequential file.
+     *
+     * @param apSrc     Sequential file to spool, deleted together with the spool
+     * @param asFid     File id (for debugging)
+     * @param alBufSze  Buffer size (see JFileAhead)
+     * @param aiBlkSze  Block size (see JFileAhead)
+     * @param alMemMax  Bytes to spool in memory, the remainder goes to a temporary file
+     */
+    JFileSpool(JFile * const apSrc, char const * const asFid,
+               const long alBufSze, const int aiBlkSze, const long alMemMax);
+
+    /** Waits for the spool thread to finish */
+    virtual ~JFileSpool();
+
+    /* statistics */
+    off_t getSplSze() ;                     /**< number of bytes spooled                */
+    off_t getSplTmp() ;                     /**< number of bytes in the temporary file  */
+
+protected:
+    virtual int jseek(const off_t azPos) ;
+    virtual off_t jeofpos() ;
+    virtual size_t jread(jchar * const apDta, const size_t aiLen) ;
+    virtual size_t jpread(jchar * const apDta, const size_t aiLen, const off_t azPos) ;
+
+private:
+    static const long SPLCHK = 1024 * 1024 ;    /**< Memory chunk size */
+
+    /**
+     * @brief Spool thread: copy the source file into the spool.
+     */
+    void spool() ;
+
+    JFile * const mpSrc ;           /**< Sequential source file                     */
+    long const mlMemMax ;           /**< Max bytes in memory (multiple of SPLCHK)   */
+
+    jchar **mpChk = null ;          /**< Memory chunks                              */
+    int miChkCnt = 0 ;              /**< Number of memory chunks                    */
+    FILE *mpTmp = null ;            /**< Temporary file                             */
+
+    off_t mzSpl = 0 ;               /**< Number of bytes spooled                    */
+    bool mbDne = false ;            /**< Spooling done ?                            */
+    off_t mzRed = 0 ;               /**< Current read position                      */
+
+    std::mutex moMtx ;              /**< Protects mzSpl, mbDne, mpChk and mpTmp     */
+    std::condition_variable moCnd ; /**< Signals progress of the spool thread       */
+    std::thread moThr ;             /**< Spool thread                               */
+};
+
+} /* namespace JojoDiff */
+#endif /* JFILESPOOL_H_ */
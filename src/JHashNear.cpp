@@ -0,0 +1,49 @@
+/*
+ * JHashNear.cpp
+ *
+ * Copyright (C) 2002-2020 Joris Heirbaut
+ *
+ * This file is part of JojoDiff.
+ *
+ * JojoDiff is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <new>
+using namespace std;
+
+#include "JHashNear.h"
+
+namespace JojoDiff {
+
+JHashNear::JHashNear()
+{
+    mpTbl = (rEnt *) malloc(NERSZE * sizeof(rEnt)) ;
+#ifdef JDIFF_THROW_BAD_ALLOC
+    if (mpTbl == null){
+        throw bad_alloc() ;
+    }
+#endif
+    for (int liIdx = 0; liIdx < NERSZE; liIdx++) {
+        mpTbl[liIdx].ikHsh = 0 ;
+        mpTbl[liIdx].izPos = -1 ;
+    }
+}
+
+JHashNear::~JHashNear()
+{
+    free(mpTbl) ;
+}
+
+} /* namespace JojoDiff */
@@ -0,0 +1,131 @@
+/*
+ * JHashNear.h
+ *
+ * Copyright (C) 2002-2020 Joris Heirbaut
+ *
+ * This file is part of JojoDiff.
+ *
+ * JojoDiff is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *******************************************************************************
+ * Near index: a small hashtable of the original file around the read position.
+ *
+ * Most matches lie close to the current diagonal, while the global index
+ * (JHashPos) covers the whole original file and, when overloaded, loses
+ * samples to collisions. The near index only covers the region of the
+ * original file around the current read position:
+ * - JDiff adds samples as the read position on the original file advances,
+ * - newer samples simply override older ones (direct-mapped),
+ * - only a content-defined fraction (1 / 2^NERSMP) of the samples is kept,
+ *   so that the table covers a larger region while staying cache-resident.
+ *
+ * Lookups consult the near index first and the global index only when it
+ * misses, which saves most cache misses on the global index. The near index
+ * only keeps the latest position of a sample, which need not be the best
+ * one, so it is optional (JDiff::setNear): it pays off when the global
+ * index is overloaded and loses nearby samples.
+ *******************************************************************************/
+
+#ifndef JHASHNEAR_H_
+#define JHASHNEAR_H_
+
+#include <stdint.h>
+
+#include "JDefs.h"
+
+namespace JojoDiff {
+
+class JHashNear {
+public:
+    /** Number of elements in the table (a power of two) */
+    static const int NERSZE = 16384 ;
+
+    /** Content-defined sampling: 1 out of 2^NERSMP samples is kept */
+    static const int NERSMP = 2 ;
+
+    /** Number of bytes of the original file covered by the table (on average) */
+    static const int NERCOV = NERSZE << NERSMP ;
+
+    /**
+     * @brief Create an empty near index.
+     */
+    JHashNear();
+
+    virtual ~JHashNear();
+    JHashNear(JHashNear const&) = delete ;
+    JHashNear& operator=(JHashNear const&) = delete ;
+
+    /**
+     * @brief Should this sample be kept in (and looked up from) the near index ?
+     *
+     * The same selection applies to both files, so a sample of the new file
+     * that is not selected can not be found and the lookup can be skipped.
+     */
+    static inline bool sample (hkey const akHsh) {
+        return (mix(akHsh) >> (64 - NERSMP)) == 0 ;
+    }
+
+    /**
+     * @brief Add a selected sample, overriding whatever was there.
+     *
+     * @param akHsh     Key
+     * @param azPos     Position of the sample in the original file
+     */
+    inline void add (hkey const akHsh, off_t const azPos) {
+        rEnt &lrEnt = mpTbl[(mix(akHsh) >> 32) & NERMSK] ;
+        lrEnt.ikHsh = akHsh ;
+        lrEnt.izPos = azPos ;
+    }
+
+    /**
+     * @brief Lookup a selected sample.
+     *
+     * @param akHsh     in:  Key
+     * @param azPos     out: Position of the sample in the original file
+     * @return false = key not found, true = key found
+     */
+    inline bool get (hkey const akHsh, off_t &azPos) {
+        rEnt const &lrEnt = mpTbl[(mix(akHsh) >> 32) & NERMSK] ;
+        if (lrEnt.ikHsh == akHsh && lrEnt.izPos >= 0) {
+            mzHit ++ ;
+            azPos = lrEnt.izPos ;
+            return true ;
+        }
+        return false ;
+    }
+
+    /**
+     * @brief return number of hits found by the near index
+     */
+    off_t get_hits(){return mzHit;}
+
+private:
+    static const int NERMSK = NERSZE - 1 ;
+
+    /** Spread the bits of a key (the rolling hash is weak in the low bits) */
+    static inline uint64_t mix (hkey const akHsh) {
+        return (uint64_t) akHsh * 0x9E3779B97F4A7C15ULL ;
+    }
+
+    typedef struct {
+        hkey ikHsh ;            /**< Key                                        */
+        off_t izPos ;           /**< Position in the original file, -1 = empty  */
+    } rEnt ;
+
+    rEnt *mpTbl ;               /**< Table of NERSZE elements                   */
+    off_t mzHit = 0 ;           /**< Number of hits                             */
+};
+
+} /* namespace JojoDiff */
+#endif /* JHASHNEAR_H_ */
@@ -26,6 +26,7 @@
 using namespace std;
 
 #include "JHashPos.h"
+#include "JProbe.h"
 
 
 namespace JojoDiff {
@@ -33,6 +34,8 @@ namespace JojoDiff {
 const int COLLISION_THRESHOLD = 4 ; /* override when collision counter exceeds threshold  */
 const int COLLISION_HIGH = 4 ;      /* rate at which high quality samples should override */
 const int COLLISION_LOW = 1 ;       /* rate at which low quality samples should override  */
+const int RUN_RATIO = 16 ;          /* max number of runs = hashtable size / RUN_RATIO    */
+const int RUN_INI = 16 ;            /* initial number of runs allocated by byte value     */
 
 /**
   * @brief Create a new hash-table with size (number of elements) not larger that the given size.
@@ -43,36 +46,43 @@ const int COLLISION_LOW = 1 ;       /* rate at which low quality samples should
   *
   * One element may be 4, 6 or 8 bytes.
   *
-  * @param aiSze   size, in number of elements.
+  * @param aiSze   size, in MB (converted to 64-bit before sizing).
   */
 JHashPos::JHashPos(int aiSze)
 :  miHshColMax(COLLISION_THRESHOLD), miHshColCnt(COLLISION_THRESHOLD),
-   miHshRlb(SMPSZE + SMPSZE / 2), miHshHit(0)
+   miHshRlb(SMPSZE + SMPSZE / 2)
 {
     /* get largest prime < aiSze */
-    int liSzeIdx ;
+    off_t lzSzeIdx ;
     if (aiSze < 1)
-        liSzeIdx = 1 ;
+        lzSzeIdx = 1 ;
     else
-        liSzeIdx = aiSze ;
-    liSzeIdx = (liSzeIdx * 1024 * 1024) /                   // convert Mb to number of elements
-                    (sizeof(hkey)+sizeof(off_t));
-    liSzeIdx = getLowerPrime(liSzeIdx);                     // find nearest lower prime
+        lzSzeIdx = aiSze ;
+    lzSzeIdx = (lzSzeIdx * 1024 * 1024) /                   // convert Mb to number of elements
+                    (off_t) (sizeof(hkey)+sizeof(off_t));
+    lzSzeIdx = getLowerPrime(lzSzeIdx);                     // find nearest lower prime
 
     /* allocate hashtable */
-    miHshPme = liSzeIdx ;                                   // keep for reference
-    miHshSze = miHshPme * (sizeof(off_t) + sizeof(hkey));   // convert to bytes
-    mzHshTblPos = (off_t *) malloc(miHshPme *               // allocate and initialize
-                        (sizeof(off_t) + sizeof(hkey))) ;
-    mkHshTblHsh = (hkey *) &mzHshTblPos[miHshPme] ;         // set address of hashes
-    miLodCnt = miHshPme ;
+    mzHshPme = lzSzeIdx ;                                   // keep for reference
+    mzHshSze = mzHshPme * (off_t) (sizeof(off_t) + sizeof(hkey));   // convert to bytes
+    mzHshTblPos = (off_t *) malloc((size_t) mzHshSze) ;     // allocate and initialize
+    mkHshTblHsh = (hkey *) &mzHshTblPos[mzHshPme] ;         // set address of hashes
+    mzLodCnt = mzHshPme ;
+
+    /* run index: allocated as runs are found */
+    memset(mpRun, 0, sizeof(mpRun)) ;
+    memset(mzRunCnt, 0, sizeof(mzRunCnt)) ;
+    memset(mzRunCap, 0, sizeof(mzRunCap)) ;
+    mzRunMax = mzHshPme / RUN_RATIO ;
+    mrRunCur.izBeg = -1 ;
+    mrRunCur.izEnd = -1 ;
 
     #if debug
       if (JDebug::gbDbg[DBGHSH])
-        fprintf(JDebug::stddbg, "Hash Ini sizeof=%2ld+%2ld=%2ld, %d samples, %d bytes, address=%p-%p,%p-%p.\n",
+        fprintf(JDebug::stddbg, "Hash Ini sizeof=%2ld+%2ld=%2ld, %" PRIzd " samples, %" PRIzd " bytes, address=%p-%p,%p-%p.\n",
             sizeof(hkey), sizeof(off_t), sizeof(hkey) + sizeof(off_t),
-            miHshPme, miHshSze,
-            mzHshTblPos, &mzHshTblPos[miHshPme], mkHshTblHsh, &mkHshTblHsh[miHshPme]) ;
+            mzHshPme, mzHshSze,
+            mzHshTblPos, &mzHshTblPos[mzHshPme], mkHshTblHsh, &mkHshTblHsh[mzHshPme]) ;
     #endif
     #ifdef JDIFF_THROW_BAD_ALLOC
       if ( mzHshTblPos == null ) {
@@ -88,6 +98,10 @@ JHashPos::~JHashPos() {
 	free(mzHshTblPos);
 	mzHshTblPos = null ;
 	mkHshTblHsh = null ;
+	for (int liVal = 0; liVal < 256; liVal++) {
+	    free(mpRun[liVal]) ;
+	    mpRun[liVal] = null ;
+	}
 }
 
 /**
@@ -95,18 +109,31 @@ JHashPos::~JHashPos() {
  * @param alCurHsh      Hash key to add
  * @param azPos         Position to add
  * @param aiEqlCnt      Quality of the sample
+ * @param acVal         Byte value at the position
  */
-void JHashPos::add (hkey akCurHsh, off_t azPos, int aiEqlCnt ){
+void JHashPos::add (hkey akCurHsh, off_t azPos, int aiEqlCnt, int acVal ){
+    /* Samples lying completely within a run of equal bytes go to the run index */
+    if (aiEqlCnt >= RUNEQL) {
+        if (mrRunCur.izEnd != azPos - 1 || miRunVal != acVal) {
+            addRun() ;
+            mrRunCur.izBeg = azPos - aiEqlCnt ;
+            miRunVal = acVal ;
+        }
+        mrRunCur.izEnd = azPos ;
+        return ;
+    }
+
     /* Every time the load factor increases by 1
      * - increase miHshColMax: the ratio at which we store values to achieve a uniform distribution of samples
      * - increase miHshRlb: the number of bytes to verify (reliability range) to be sure there is no match
      */
-    if ( miLodCnt > 0 ) {
-        miLodCnt -- ;
+    if ( mzLodCnt > 0 ) {
+        mzLodCnt -- ;
     } else {
-        miLodCnt = miHshPme ;
+        mzLodCnt = mzHshPme ;
         miHshColMax += COLLISION_THRESHOLD ;
         miHshRlb += 4 ;
+        JPROBE2(hash_overload, miHshColMax, miHshRlb) ;
     }
 
     /* Increase the collision strategy counter
@@ -121,19 +148,19 @@ void JHashPos::add (hkey akCurHsh, off_t azPos, int aiEqlCnt ){
     /* store key and value when the collision counter reaches the collision threshold */
     if (miHshColCnt <= 0 ) {
         /* calculate the index in the hashtable for the given key */
-        int liIdx = (akCurHsh % miHshPme) ;
+        off_t lzIdx = (akCurHsh % mzHshPme) ;
 
         /* debug */
         #if debug
         if (JDebug::gbDbg[DBGHSH])
-            fprintf(JDebug::stddbg, "Hash Add %8d " P8zd " %8" PRIhkey " %c\n",
-                    liIdx, azPos, akCurHsh,
-                    (mkHshTblHsh[liIdx] == 0)?'.':'!');
+            fprintf(JDebug::stddbg, "Hash Add " P8zd " " P8zd " %8" PRIhkey " %c\n",
+                    lzIdx, azPos, akCurHsh,
+                    (mkHshTblHsh[lzIdx] == 0)?'.':'!');
         #endif
 
         /* store */
-        mkHshTblHsh[liIdx] = akCurHsh ;
-        mzHshTblPos[liIdx] = azPos ;
+        mkHshTblHsh[lzIdx] = akCurHsh ;
+        mzHshTblPos[lzIdx] = azPos ;
         miHshColCnt = miHshColMax ; // reset subsequent lost collisions counter
     }
 } /* ufHshAdd */
@@ -142,11 +169,49 @@ void JHashPos::add (hkey akCurHsh, off_t azPos, int aiEqlCnt ){
 * @brief  Hashtable reset: consider table to be empty
 */
 void JHashPos::reset () {
-    miLodCnt = miHshPme ;
+    mzLodCnt = mzHshPme ;
     miHshColMax = COLLISION_THRESHOLD;
     miHshColCnt = COLLISION_THRESHOLD;
     miHshRlb = SMPSZE + SMPSZE / 2;
+    memset(mzRunCnt, 0, sizeof(mzRunCnt)) ;
+    mzRunTot = 0 ;
+    mrRunCur.izBeg = -1 ;
+    mrRunCur.izEnd = -1 ;
 };
+
+/**
+ * @brief Move the current run into the run index.
+ *
+ * The run index is an optimization: when it is full, or when memory runs out,
+ * the run is simply lost.
+ */
+void JHashPos::addRun () {
+    if (mrRunCur.izEnd < 0)
+        return ;
+
+    if (mzRunCnt[miRunVal] == mzRunCap[miRunVal]) {
+        if (mzRunTot >= mzRunMax) {
+            mzRunLst ++ ;
+            return ;
+        }
+        off_t lzCap = (mzRunCap[miRunVal] == 0) ? RUN_INI : mzRunCap[miRunVal] * 2 ;
+        rRun *lpRun = (rRun *) realloc(mpRun[miRunVal], (size_t) lzCap * sizeof(rRun)) ;
+        if (lpRun == null) {
+            mzRunLst ++ ;
+            return ;
+        }
+        mpRun[miRunVal] = lpRun ;
+        mzRunCap[miRunVal] = lzCap ;
+    }
+    mpRun[miRunVal][mzRunCnt[miRunVal]++] = mrRunCur ;
+    mzRunTot ++ ;
+
+    #if debug
+    if (JDebug::gbDbg[DBGHSH])
+        fprintf(JDebug::stddbg, "Hash Run %02x " P8zd "-" P8zd "\n",
+                miRunVal, mrRunCur.izBeg, mrRunCur.izEnd) ;
+    #endif
+}
 
 
 /**
@@ -155,31 +220,98 @@ void JHashPos::reset () {
  * @param lzPos     out: position found
  * @return true=found, false=notfound
  */
-bool JHashPos::get (const hkey akCurHsh, off_t &azPos)
-{ int   liIdx ;
+bool JHashPos::get (const hkey akCurHsh, off_t &azPos) const
+{ off_t lzIdx ;
 
   /* calculate key and the corresponding entries' address */
-  liIdx    = (akCurHsh % miHshPme) ;
+  lzIdx    = (akCurHsh % mzHshPme) ;
 
   /* lookup value into hashtable for new file */
-  if (mkHshTblHsh[liIdx] == akCurHsh)  {
-    miHshHit++;
-    azPos = mzHshTblPos[liIdx];
+  if (mkHshTblHsh[lzIdx] == akCurHsh)  {
+    azPos = mzHshTblPos[lzIdx];
     return true ;
   }
   return false ;
 }
 
+/**
+ * @brief Run index lookup
+ * @param acVal     in:  byte value of the run
+ * @param azDgn     in:  preferred position (on the current diagonal)
+ * @param azLen     in:  number of equal bytes preceding the sample in the new file
+ * @param azMin     in:  found position must be larger than this position
+ * @param azPos     out: position found
+ * @return true=found, false=notfound
+ */
+bool JHashPos::getRun (int acVal, off_t azDgn, off_t azLen, off_t azMin, off_t &azPos) const
+{
+    rRun const *lpBef = null ;  // last run starting on or before azDgn
+    rRun const *lpAft = null ;  // first run starting after azDgn
+
+    /* binary search: first run starting after azDgn */
+    off_t lzLow = 0 ;
+    off_t lzHig = mzRunCnt[acVal] ;
+    while (lzLow < lzHig) {
+        off_t lzMid = (lzLow + lzHig) / 2 ;
+        if (mpRun[acVal][lzMid].izBeg <= azDgn)
+            lzLow = lzMid + 1 ;
+        else
+            lzHig = lzMid ;
+    }
+    if (lzLow > 0)
+        lpBef = &mpRun[acVal][lzLow - 1] ;
+    if (lzLow < mzRunCnt[acVal])
+        lpAft = &mpRun[acVal][lzLow] ;
+
+    /* the current run lies after all runs in the index */
+    if (mrRunCur.izEnd >= 0 && miRunVal == acVal) {
+        if (mrRunCur.izBeg <= azDgn)
+            lpBef = &mrRunCur ;
+        else if (lpAft == null)
+            lpAft = &mrRunCur ;
+    }
+
+    /* discard unusable runs */
+    if (lpBef != null && lpBef->izEnd <= azMin)
+        lpBef = null ;
+    if (lpAft != null && lpAft->izEnd <= azMin)
+        lpAft = null ;
+
+    /* the diagonal falls within a run: stay on the diagonal */
+    if (lpBef != null && lpBef->izEnd >= azDgn && azDgn > azMin) {
+        azPos = azDgn ;
+    } else {
+        /* otherwise take the nearest run, aligned with the start of the run */
+        if (lpBef != null && lpAft != null) {
+            if (azDgn - lpBef->izEnd <= lpAft->izBeg - azDgn)
+                lpAft = null ;
+            else
+                lpBef = null ;
+        }
+        if (lpBef == null)
+            lpBef = lpAft ;
+        if (lpBef == null)
+            return false ;
+
+        azPos = lpBef->izBeg + azLen ;
+        if (azPos > lpBef->izEnd)
+            azPos = lpBef->izEnd ;
+        if (azPos <= azMin)
+            azPos = azMin + 1 ;
+    }
+    return true ;
+}
+
 /**
  * @brief Print hashtable content (for debugging or auditing)
  */
 void JHashPos::print(){
-    int liHshIdx;
+    off_t lzHshIdx;
 
-    for (liHshIdx = 0; liHshIdx < miHshPme; liHshIdx ++)  {
-        if (mzHshTblPos[liHshIdx] != 0) {
-            fprintf(JDebug::stddbg, "Hash Pnt %12d " P8zd "-%08" PRIhkey "x\n", liHshIdx,
-                    mzHshTblPos[liHshIdx], mkHshTblHsh[liHshIdx]) ;
+    for (lzHshIdx = 0; lzHshIdx < mzHshPme; lzHshIdx ++)  {
+        if (mzHshTblPos[lzHshIdx] != 0) {
+            fprintf(JDebug::stddbg, "Hash Pnt %12" PRIzd " " P8zd "-%08" PRIhkey "x\n", lzHshIdx,
+                    mzHshTblPos[lzHshIdx], mkHshTblHsh[lzHshIdx]) ;
         }
     }
 }
@@ -190,50 +322,51 @@ void JHashPos::print(){
  * @param aiBck     Number of buckets
  */
 void JHashPos::dist(off_t azMax, int aiBck){
-    int liHshIdx;
-    int liHshDiv;   // Number of positions by bucket
-    int *liBckCnt;  // Number of elements by bucket
+    off_t lzHshIdx;
+    off_t lzHshDiv; // Number of positions by bucket
+    off_t *lzBckCnt;// Number of elements by bucket
     int liIdx;
 
-    int liCnt = 0 ;
-    int liMin = INT_MAX ;
-    int liMax = 0;
+    off_t lzCnt = 0 ;
+    off_t lzMin = -1 ;
+    off_t lzMax = 0;
 
     fprintf(JDebug::stddbg, "Hash Dist Overload    = %d\n", miHshColMax / COLLISION_THRESHOLD - 1);
     fprintf(JDebug::stddbg, "Hash Dist Reliability = %d\n", miHshRlb);
 
-    liBckCnt = (int *) malloc(aiBck * sizeof(int));
-    if (liBckCnt != null){
+    lzBckCnt = (off_t *) malloc(aiBck * sizeof(off_t));
+    if (lzBckCnt != null){
     	/* Init mem */
-    	memset(liBckCnt, 0, aiBck * sizeof(int));
+    	memset(lzBckCnt, 0, aiBck * sizeof(off_t));
 
     	/* Fill the buckets */
-    	liHshDiv = (azMax / aiBck) ;
-        for (liHshIdx = 0; liHshIdx < miHshPme; liHshIdx ++)  {
-            if (mzHshTblPos[liHshIdx] > 0 && mzHshTblPos[liHshIdx] <= azMax) {
-            	liIdx =mzHshTblPos[liHshIdx] / liHshDiv ;
-            	if (liIdx >= aiBck) {
-            		liIdx = 0 ;
-            	} else {
-            		liBckCnt[liIdx] ++ ;
+    	lzHshDiv = (azMax / aiBck) ;
+    	if (lzHshDiv < 1)
+    	    lzHshDiv = 1 ;
+        for (lzHshIdx = 0; lzHshIdx < mzHshPme; lzHshIdx ++)  {
+            if (mzHshTblPos[lzHshIdx] > 0 && mzHshTblPos[lzHshIdx] <= azMax) {
+            	off_t lzBck = mzHshTblPos[lzHshIdx] / lzHshDiv ;
+            	if (lzBck < aiBck) {
+            		lzBckCnt[lzBck] ++ ;
             	}
             }
         }
 
         /* Printout */
         for (liIdx = 0; liIdx < aiBck; liIdx ++)  {
-        	liCnt += liBckCnt[liIdx] ;
-        	if (liBckCnt[liIdx] < liMin) liMin = liBckCnt[liIdx] ;
-        	if (liBckCnt[liIdx] > liMax) liMax = liBckCnt[liIdx] ;
+        	lzCnt += lzBckCnt[liIdx] ;
+        	if (lzBckCnt[liIdx] < lzMin || lzMin < 0) lzMin = lzBckCnt[liIdx] ;
+        	if (lzBckCnt[liIdx] > lzMax) lzMax = lzBckCnt[liIdx] ;
 
-        	fprintf(JDebug::stddbg, "Hash Dist %8d Pos=" P8zd ":" P8zd " Cnt=%8d Rlb=%d\n",
-        			liIdx, (off_t) liIdx * liHshDiv, (off_t) (liIdx + 1) * liHshDiv, liBckCnt[liIdx],
-        			(liBckCnt[liIdx]==0)?-1:liHshDiv / liBckCnt[liIdx]) ;
+        	fprintf(JDebug::stddbg, "Hash Dist %8d Pos=" P8zd ":" P8zd " Cnt=" P8zd " Rlb=%" PRIzd "\n",
+        			liIdx, (off_t) liIdx * lzHshDiv, (off_t) (liIdx + 1) * lzHshDiv, lzBckCnt[liIdx],
+        			(lzBckCnt[liIdx]==0)?(off_t) -1:lzHshDiv / lzBckCnt[liIdx]) ;
         }
-        fprintf(JDebug::stddbg, "Hash Dist Avg/Min/Max/%% = %d/%d/%d/%d%%\n",
-                liCnt / aiBck, liMin, liMax, liMax > 0 ? (100 - (liMin / (liMax / 100))) : -1);
-        fprintf(JDebug::stddbg, "Hash Dist Load          = %d/%d=%d%%\n",
-                liCnt, miHshPme, miHshPme > 0 ? (liCnt / (miHshPme / 100)) : -1);
+        fprintf(JDebug::stddbg, "Hash Dist Avg/Min/Max/%% = %" PRIzd "/%" PRIzd "/%" PRIzd "/%d%%\n",
+                lzCnt / aiBck, lzMin, lzMax, lzMax > 0 ? (int) (100 - lzMin * 100 / lzMax) : -1);
+        fprintf(JDebug::stddbg, "Hash Dist Load          = %" PRIzd "/%" PRIzd "=%d%%\n",
+                lzCnt, mzHshPme, mzHshPme > 0 ? (int) (lzCnt * 100 / mzHshPme) : -1);
+        free(lzBckCnt) ;
     }
 } /* JHasPos::dist */
 
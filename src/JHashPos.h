@@ -28,7 +28,7 @@
  * of the file at that position. This way, we can efficiently find regions
  * that are equal between both files.
  *
- * Hash function (see JDiff.cpp::hash) on array of bytes:
+ * Hash function (see JHashPos::hash) on array of bytes:
  *
  * Principles:
  * -----------
@@ -85,6 +85,25 @@
  * Only samples from the original file are stored.
  * Samples from the new file are looked up.
  *
+ * Run index:
+ * ----------
+ * A sample lying (almost) completely within a run of equal bytes yields (almost)
+ * the same hash for every run of that byte: the few bytes before the run only
+ * influence the highest bits of the hash. After SMPSZE x 2 bytes, e[x] saturates
+ * and all samples of the run get exactly the same hash. Such samples carry little
+ * information besides the byte value, yet on files full of padding they crowd out
+ * the useful samples and they match any run anywhere in the file.
+ * Therefore, samples with e[x] >= RUNEQL (3/4 of the sample) are kept out of the
+ * hashtable. Instead, the run itself is stored as (byte, start, end) in a
+ * separate run index.
+ * Samples on the borders of a run (entering or leaving the run) are still stored
+ * in the hashtable as they determine where a run starts or ends.
+ *
+ * When the new file contains a run, getRun looks up a run of the same byte in
+ * the original file and calculates a matching position arithmetically:
+ * on the current diagonal if it falls within a run, otherwise aligned with
+ * the start of the nearest run.
+ *
  * The investigated region is either
  * - the whole file when the prescan option is used (default)
  * - the look-ahead region otherwise (option -ff)
@@ -123,23 +142,77 @@ public:
 	JHashPos(JHashPos const&) = delete ;
 	JHashPos& operator=(JHashPos const&) = delete ;
 
+	/** Samples with this equal-chars count (or higher) lie (almost) completely within a run */
+	static const int RUNEQL = SMPSZE - SMPSZE / 4 ;
+
+    /**
+     * @brief The hash function
+     *
+     * Generate a new hash value by adding a new byte.
+     * Old bytes are shifted out from the hash value in such a way that
+     * the new value corresponds to a sample of 32 bytes (the lowest bit of the 32'th
+     * byte still influences the highest bit of the hash value).
+     *
+     * @param   akCurHsh    current hash key
+     * @param   acOld       previous character (in & out)
+     * @param   acNew       character to hash
+     * @param   aiEql       equal-chars count (in & out)
+     * @return  new hash key
+     */
+    static inline hkey hash ( hkey const akCurHsh, int &acOld, int const acNew, int &aiEql) {
+        if (acOld == acNew) {
+            if (aiEql < SMPSZE)
+                aiEql ++;
+        } else {
+            acOld = acNew ;
+            if (aiEql != 0)     // improves performance
+                aiEql = 0;
+        }
+        return (akCurHsh * 2) + acNew + aiEql ; // multiplication by 2 is faster than << 2
+    }
+
 	/**
 	* @brief Add key and position to the index hashtable.
 	*
 	* @param hkey   akCurHsh   Key
 	* @param azPos  azPos      Associated file position
 	* @param int    aiEqlCnt   Indication of equal byte within associated sample sequence
+	* @param int    acVal      Byte value at the associated file position
 	*/
-	void add (hkey akCurHsh, off_t azPos, int aiEqlCnt ) ;
+	void add (hkey akCurHsh, off_t azPos, int aiEqlCnt, int acVal ) ;
 
 	/**
-	* @brief  Hashtable lookup
+	* @brief  Hashtable lookup. Lookups do not change the table, so they are
+	*         safe from several threads as long as the table is not being modified.
 	*
 	* @param  akCurHsh  Input:  Hashkey
 	* @param  &azPos    Output: Associated file position
 	* @return false = key not found, true = key found
 	*/
-	bool get (const hkey akCurHsh, off_t &azPos) ;
+	bool get (const hkey akCurHsh, off_t &azPos) const ;
+
+	/**
+	* @brief  Prefetch the table element for a key into the cache (before a lookup).
+	*/
+	inline void prefetch (const hkey akCurHsh) const {
+	#ifdef __GNUC__
+	    off_t lzIdx = (akCurHsh % mzHshPme) ;
+	    __builtin_prefetch(&mkHshTblHsh[lzIdx]) ;
+	    __builtin_prefetch(&mzHshTblPos[lzIdx]) ;
+	#endif
+	}
+
+	/**
+	* @brief  Run index lookup: find a position within a run of equal bytes
+	*
+	* @param  acVal     Input:  Byte value of the run
+	* @param  azDgn     Input:  Preferred position (on the current diagonal)
+	* @param  azLen     Input:  Number of equal bytes preceding the sample in the new file
+	* @param  azMin     Input:  Found position must be larger than this position
+	* @param  &azPos    Output: Position within a run of acVal
+	* @return false = no run found, true = run found
+	*/
+	bool getRun (int acVal, off_t azDgn, off_t azLen, off_t azMin, off_t &azPos) const ;
 
 	/**
 	* @brief  Hashtable reset: consider table to be empty
@@ -171,12 +244,12 @@ public:
 	/**
     * @brief return hashtable prime number
     */
-	int get_hashprime(){return miHshPme;}
+	off_t get_hashprime(){return mzHshPme;}
 
 	/**
 	* @brief return hashtable size in bytes
 	*/
-	int get_hashsize(){return miHshSze;}
+	off_t get_hashsize(){return mzHshSze;}
 
 	/**
 	* @brief return hastable collision override threshold
@@ -184,11 +257,29 @@ public:
 	int get_hashcolmax(){return miHshColMax;}
 
 	/**
-	* @brief return number of hits found by this hashtable
+	* @brief return number of runs in the run index
+	*/
+	off_t get_runcount(){return mzRunTot + (mrRunCur.izEnd >= 0 ? 1 : 0);}
+
+	/**
+	* @brief return number of runs lost because the run index was full
 	*/
-	int get_hashhits(){return miHshHit;}
+	off_t get_runlost(){return mzRunLst;}
 
 private:
+	/**
+	 * Run of equal bytes within the original file
+	 */
+	typedef struct {
+	    off_t izBeg ;       /**< position of the first byte                           */
+	    off_t izEnd ;       /**< position of the last byte                            */
+	} rRun ;
+
+	/**
+	* @brief Move the current run into the run index
+	*/
+	void addRun () ;
+
 	/* The hash table. Using a struct causes certain compilers (gcc) to align        */
 	/* fields on 64-bit boundaries, causing 25% memory loss. Therefore, I use        */
 	/* two arrays instead of an array of structs.                                    */
@@ -196,17 +287,26 @@ private:
 	hkey  *mkHshTblHsh=null ;    /**< Hash keys                                             */
 
 	/* Size */
-	int miHshPme=0  ;       /**< prime number for size and hashing              				*/
-	int miHshSze=0 ;        /**< Actual size in bytes of the hashtable          				*/
+	off_t mzHshPme=0  ;     /**< prime number for size and hashing              				*/
+	off_t mzHshSze=0 ;      /**< Actual size in bytes of the hashtable          				*/
 
     /* State */
 	int miHshColMax;        /**< max number of collisions before override       			  */
 	int miHshColCnt;        /**< current number of subsequent collisions.               	  */
 	int miHshRlb ;          /**< hashtable reliability: decreases as the overloading grows 	  */
-    int miLodCnt=0 ;        /**< hashtable load-counter                                       */
+    off_t mzLodCnt=0 ;      /**< hashtable load-counter                                       */
+
+    /* Run index: runs by byte value, in ascending order of position */
+    rRun *mpRun[256] ;      /**< runs for every byte value                                    */
+    off_t mzRunCnt[256] ;   /**< number of runs for every byte value                          */
+    off_t mzRunCap[256] ;   /**< allocated runs for every byte value                          */
+    off_t mzRunTot=0 ;      /**< total number of runs                                         */
+    off_t mzRunMax=0 ;      /**< maximum number of runs                                       */
+    rRun mrRunCur ;         /**< current run (izEnd < 0 if none)                              */
+    int miRunVal=0 ;        /**< byte value of the current run                                */
 
     /* Statistics */
-    int miHshHit;           /**< number of hits found by this hashtable                       */
+    off_t mzRunLst=0 ;      /**< number of runs lost because the run index was full           */
 };
 }
 #endif /* JHASHPOS_H_ */
@@ -27,6 +27,9 @@
 using namespace std;
 
 #include "JDebug.h"
+#include "JCpu.h"
+#include "JOutBin.h"
+#include "JProbe.h"
 
 namespace JojoDiff {
 
@@ -81,20 +84,21 @@ JMatchTable::JMatchTable (
     JFile  * const apFilNew,
     const int  aiMchSze,
     const bool abCmpAll,
-    const int aiAhdMax)
+    const off_t azAhdMax)
 : mpHsh(apHsh), miMchSze(aiMchSze < 13 ? 13 : aiMchSze), miMchFre(miMchSze)
-, mpFilOrg(apFilOrg), mpFilNew(apFilNew), mbCmpAll(abCmpAll), miAhdMax(aiAhdMax)
+, mpFilOrg(apFilOrg), mpFilNew(apFilNew), mbCmpAll(abCmpAll), mzAhdMax(azAhdMax)
 {
     // allocate matching table
     msMch = (rMch *) malloc(sizeof(rMch) * miMchSze) ;
+    mpPnd = (rPnd *) malloc(sizeof(rPnd) * miMchSze) ;
     #ifdef JDIFF_THROW_BAD_ALLOC
-    if ( msMch == null ) {
+    if ( msMch == null || mpPnd == null ) {
         throw bad_alloc() ;
     }
     #endif
 
     // allocate and initialize the hashtable
-    miMchPme = getLowerPrime(aiMchSze * 2);
+    miMchPme = (int) getLowerPrime(aiMchSze * 2);
     mpCol = (tMch **) calloc(miMchPme, sizeof(tMch *));
     mpGld = (tMch **) calloc(miMchPme, sizeof(tMch *));
     #ifdef JDIFF_THROW_BAD_ALLOC
@@ -107,6 +111,7 @@ JMatchTable::JMatchTable (
 /* Destructor */
 JMatchTable::~JMatchTable() {
     free(msMch);
+    free(mpPnd);
     free(mpCol);
     free(mpGld);
 }
@@ -120,6 +125,9 @@ bool JMatchTable::getbest (
   off_t &azBstOrg,          // best position found on original file
   off_t &azBstNew           // best position found on new file
 ) {
+    // Run the deferred verifications
+    verify(azRedNew) ;
+
     // Re-evaluate enlarged EOB's (because they are evaluated based on iiCnt)
     if (! mbCmpAll) {
         // join old and new lists
@@ -167,6 +175,7 @@ bool JMatchTable::getbest (
     }
     #endif
 
+     JPROBE4(match_best, mpBst != null, azBstOrg, azBstNew, azRedNew) ;
      return mpBst != null ;
 } /* getbest() */
 
@@ -295,6 +304,7 @@ JMatchTable::eMatchReturn JMatchTable::add (
         lpCur->iiGld = 0 ;
         lpCur->iiCmp = 0 ;
         lpCur->izTst = -1 ;
+        lpCur->ibPnd = false ;
 
         // add to colliding hashtable
         lpCur->ipCol = mpCol[liIdxDlt];
@@ -316,7 +326,7 @@ JMatchTable::eMatchReturn JMatchTable::add (
         case Invalid:
             if (lpCur->izTst >= lpCur->izNew){
                 // Invalids are marked -1 for reuse (unless they were incompletely evaluated)
-                miHshRpr++ ;
+                mzHshRpr++ ;
                 lpCur->iiCmp = CMPINV ;  // mark as invalid for reuse
 
                 // put new invalid elements in front of the new list to be reused
@@ -333,7 +343,8 @@ JMatchTable::eMatchReturn JMatchTable::add (
         case Valid:
         case Good:
         case Best:
-            // put new valid elements on the new elements list
+        case Pending:
+            // put new valid (or not yet verified) elements on the new elements list
             if (lpCur->iiCnt == 1)
                 addNew(lpCur) ;
             break ;
@@ -345,6 +356,11 @@ JMatchTable::eMatchReturn JMatchTable::add (
             break ;
         } /* switch */
 
+        // A solution at the read position shortens the search: first verify the
+        // deferred candidates, so that a farther but longer solution is not lost
+        if ((liRet == Good || liRet == Best) && miPnd > 0)
+            verify(azRedNew) ;
+
         // debug reporting
         #if debug
         if (JDebug::gbDbg[DBGMCH])
@@ -366,13 +382,23 @@ JMatchTable::eMatchReturn JMatchTable::add (
  * @brief Cleanup, check free space and fastcheck best match.
  *
  * @param       azRedNew    Current reading position
+ * @param       azRedOrg    Current reading position on the original file
  * @param       azBseNew    Cleanup all mathes before this position
  *
  * @return Full, GoodMatch or Added
  * ---------------------------------------------------------------------------*/
-JMatchTable::eMatchReturn JMatchTable::cleanup ( off_t const azBseOrg, off_t const azRedNew){
+JMatchTable::eMatchReturn JMatchTable::cleanup ( off_t const azBseOrg, off_t const azRedOrg, off_t const azRedNew){
     rMch *lpCur ;               /**< Current element from matchtable    */
 
+    // keep the original reading position for cost(), restart counting escapes
+    mzRedOrg = azRedOrg ;
+    if (azRedNew != mzEscBeg) {
+        mzEscBeg = azRedNew ;
+        mzEscEnd = azRedNew ;
+        miEscPrv = EOF ;
+        miEsc = 0 ;
+    }
+
     // get actual reliability distance
     miRlb = mpHsh->get_reliability();
 
@@ -406,6 +432,10 @@ JMatchTable::eMatchReturn JMatchTable::cleanup ( off_t const azBseOrg, off_t con
         else
             isGoodOrBest(azRedNew, lpCur) ;
 
+    // verify the existing entries now, in original file order: they determine
+    // whether the search can be reduced
+    verify(azRedNew, false) ;
+
     // prepare the oldlist
     nextold(azRedNew) ;
 
@@ -442,7 +472,8 @@ JMatchTable::eMatchReturn JMatchTable::cleanup ( off_t const azBseOrg, off_t con
 */
 JMatchTable::eMatchReturn JMatchTable::isGoodOrBest(
     off_t const azRedNew,       /**< Current read position */
-    rMch *lpCur                 /**< Element to evaluate */
+    rMch *lpCur,                /**< Element to evaluate */
+    bool const abDfr            /**< Defer out-of-buffer verification ? */
 ){
     int  liCurCmp=0 ;       /**< current match compare state                  */
     bool lbGld ;            /**< gliding match under investigation              */
@@ -478,6 +509,20 @@ JMatchTable::eMatchReturn JMatchTable::isGoodOrBest(
         liCurCmp = lpCur->izTst - lzTstNew + lpCur->iiCmp ;
     } else {
         // The previous test result cannot be reused: check (again)
+        // Out of buffer: queue the check, getbest will do it in original file order
+        if (abDfr && mbDfr && mbCmpAll && ! mpFilOrg->isNear(lzTstOrg)) {
+            if (lpCur->ibPnd)
+                return Pending ;
+            if (miPnd < miMchSze) {
+                lpCur->ibPnd = true ;
+                mpPnd[miPnd].izOrg = lzTstOrg ;
+                mpPnd[miPnd].ipMch = lpCur ;
+                miPnd ++ ;
+                mzChkDfr ++ ;
+                return Pending ;
+            }
+        }
+
         // determine number of bytes to check
         lzDst = lpCur->izBeg - lzTstNew ;
         if (lzDst < MINDST)
@@ -537,6 +582,123 @@ JMatchTable::eMatchReturn JMatchTable::isGoodOrBest(
         return Valid ;
 } /* isGoodOrBest */
 
+/**
+* @brief Run the deferred verifications, in original file order
+*/
+void JMatchTable::verify(off_t const azRedNew, bool const abRpr){
+    if (miPnd == 0)
+        return ;
+
+    qsort(mpPnd, miPnd, sizeof(rPnd), cmpPnd) ;
+    for (int liPnd = 0; liPnd < miPnd; liPnd++) {
+        rMch *lpCur = mpPnd[liPnd].ipMch ;
+        if (! lpCur->ibPnd)
+            continue ;      // queued twice
+        lpCur->ibPnd = false ;
+
+        // New invalids are marked for reuse, as in add() (not in cleanup())
+        if (isGoodOrBest(azRedNew, lpCur, false) == Invalid && abRpr && lpCur->izTst >= lpCur->izNew){
+            mzHshRpr++ ;
+            lpCur->iiCmp = CMPINV ;
+        }
+    }
+    miPnd = 0 ;
+}
+
+/**
+* @brief Number of patch bytes needed to continue with the given match.
+*
+* Follows the order in which JDiff and JOutBin write a solution:
+* - a DEL (forward) or BKT (backward) with its length aligns the original file,
+*   or an INS outputs the bytes by which the new file runs ahead,
+* - the data bytes up to azTstNew follow as MOD, which needs no operator after
+*   a DEL, BKT or EQL, and an ESC MOD after an INS,
+* - every ESC followed by an opcode in the data gets an extra ESC (see escapes),
+* - the match itself costs an ESC EQL and a length. Up to MINEQL equal bytes
+*   after data are written as data though, and the EQL is still to come.
+*
+* The length of the EQL is counted as one byte: compares stop at EQLMAX, so the
+* real run length is not known. For the same reason the equal bytes are not
+* deducted from the cost: a longer match only wins among equally costly ones
+* (see isBest).
+*/
+off_t JMatchTable::cost(off_t const azTstOrg, off_t const azTstNew, off_t const azRedNew, int const aiCmp)
+{
+    off_t lzNew = azTstNew - azRedNew ;             // data bytes to output
+    off_t lzOrg = azTstOrg - mzRedOrg ;             // bytes to skip on the original file
+    off_t lzCst = lzNew ;
+
+    if (lzOrg > lzNew)
+        lzCst += 2 + JOutBin::getLenSze(lzOrg - lzNew) ;    // ESC DEL + length
+    else if (lzOrg < 0)
+        lzCst += 2 + JOutBin::getLenSze(lzNew - lzOrg) ;    // ESC BKT + length
+    else if (lzOrg < lzNew)
+        lzCst += (lzOrg > 0) ? 4 : 2 ;                      // ESC INS (+ ESC MOD)
+    lzCst += escapes(azTstNew) ;                            // ESC ESC <opcode>
+
+    if (aiCmp <= MINEQL && lzNew > 0)
+        lzCst += aiCmp ;                                    // equal bytes as data
+    lzCst += 2 + JOutBin::getLenSze(1) ;                    // ESC EQL + length
+
+    return lzCst ;
+}
+
+/**
+* @brief Number of data escapes on the new file from the reading position up
+*        to the given position.
+*
+* An ESC followed by a byte from BKT to ESC in the data is protected by an
+* extra ESC. Escapes are counted on the buffered data only, once per reading
+* position: the positions found are kept in mpEsc, up to ESCMAX of them.
+*/
+int JMatchTable::escapes(off_t const azEnd)
+{
+    // count further, up to azEnd
+    while (mzEscEnd < azEnd) {
+        int lcNew = mpFilNew->get(mzEscEnd, JFile::SoftAhead) ;
+        if (lcNew < 0)
+            break ;                 // EOF or EOB: count no further
+        if (miEscPrv == ESC && lcNew >= BKT && lcNew <= ESC && miEsc < ESCMAX)
+            mpEsc[miEsc++] = mzEscEnd ;
+        miEscPrv = lcNew ;
+        mzEscEnd ++ ;
+
+        // skip to the next ESC within the buffer
+        long llRed ;
+        jchar const *lpRed = mpFilNew->getRed(mzEscEnd, llRed) ;
+        if (llRed > azEnd - mzEscEnd)
+            llRed = azEnd - mzEscEnd ;
+        if (llRed > 0) {
+            long llRun = JCpu::fndByt(lpRed, llRed, ESC) ;
+            if (llRun > 0) {
+                miEscPrv = lpRed[llRun - 1] ;
+                mpFilNew->skipRed(llRun) ;
+                mzEscEnd += llRun ;
+            }
+        }
+    }
+
+    // number of escapes before azEnd
+    int liLow = 0 ;
+    int liHig = miEsc ;
+    while (liLow < liHig) {
+        int liMid = (liLow + liHig) / 2 ;
+        if (mpEsc[liMid] < azEnd)
+            liLow = liMid + 1 ;
+        else
+            liHig = liMid ;
+    }
+    return liLow ;
+}
+
+int JMatchTable::cmpPnd(const void *apOne, const void *apTwo){
+    rPnd const *lpOne = (rPnd const *) apOne ;
+    rPnd const *lpTwo = (rPnd const *) apTwo ;
+    if (lpOne->izOrg != lpTwo->izOrg)
+        return (lpOne->izOrg < lpTwo->izOrg) ? -1 : 1 ;
+    return 0 ;
+}
+
 /**
 * @brief Check if given solution is the best one.
 */
@@ -588,12 +750,19 @@ bool JMatchTable::isBest(
 
     /* Elect the best one */
     if (liCurCmp > 0){
+        off_t lzCurCst = mbCst ? cost(lzTstOrg, lzTstNew, azRedNew, liCurCmp) : 0 ;
         if (mpBst == NULL)
             mpBst=lpCur ;   // first one, take it
         else if (liCurCmp < 2 && miBstCmp > 4)
             ; // do nothing to avoid using low-quality matches (liCurCmp < 2 == low quality)
         else if (miBstCmp < 2 && liCurCmp > 4)
             mpBst=lpCur ;   // avoid using low-quality matches (liBstCmp < 2 == low quality)
+        else if (mbCst) {
+            if (lzCurCst < mzBstCst)
+                mpBst=lpCur ;   // new one is cheaper to reach
+            else if (lzCurCst == mzBstCst && lzTstNew - liCurCmp < mzBstNew - miBstCmp)
+                mpBst=lpCur ;   // as cheap, but longer
+        }
         else if (lzTstNew + FZY < mzBstNew)
             mpBst=lpCur ;   // new one is clearly better (nearer)
         else if (lzTstNew <= mzBstNew + FZY) {
@@ -614,6 +783,7 @@ bool JMatchTable::isBest(
             mzBstNew = lzTstNew ;
             mzBstOrg = lzTstOrg ;
             miBstCmp = liCurCmp ;
+            mzBstCst = lzCurCst ;
 
             // Determine the limit for being old:
             // - current mpBst runs till izTst + iiCmp, so all matches before this point are useless
@@ -731,6 +901,8 @@ bool JMatchTable::nextold(off_t const azRedNew){
 * Adversely, skipping a useful match will reduce accuracy, so we need to be careful.
 */
 bool JMatchTable::isOld2Skip(rMch const * const lpCur, off_t const azRedNew){
+    if (lpCur->ibPnd)
+        return false ;      // not verified yet
     switch (lpCur->iiCmp){
         case CMPSKP: return true ;
         case CMPINV:
@@ -753,6 +925,8 @@ bool JMatchTable::isOld2Skip(rMch const * const lpCur, off_t const azRedNew){
 * A match is still usable when it contains information that might be usable in the future.
 */
 bool JMatchTable::isOld2Reuse(rMch const * const lpCur, off_t const azRedNew){
+    if (lpCur->ibPnd)
+        return false ;      // not verified yet
     switch (lpCur->iiCmp){
         case CMPSKP: return true ;
         case CMPINV: return true ;
@@ -840,6 +1014,25 @@ int JMatchTable::check (
             azPosOrg ++ ;
             azPosNew ++ ;
             liEql ++ ;
+
+            // skip further equal bytes within the buffers
+            long llOrg ;
+            long llNew ;
+            jchar const *lpOrg = mpFilOrg->getRed(azPosOrg, llOrg) ;
+            jchar const *lpNew = mpFilNew->getRed(azPosNew, llNew) ;
+            if (llNew > llOrg)
+                llNew = llOrg ;
+            if (llNew > EQLMAX - liEql)
+                llNew = EQLMAX - liEql ;
+            if (llNew > 0) {
+                int liSkp = JCpu::eqlLen(lpOrg, lpNew, llNew) ;
+                mpFilOrg->skipRed(liSkp) ;
+                mpFilNew->skipRed(liSkp) ;
+                azPosOrg += liSkp ;
+                azPosNew += liSkp ;
+                liEql += liSkp ;
+                aiLen -= liSkp ;
+            }
         } else if (liEql >= EQLSZE) {
             break ;
         } else if (aiLen <= 0) {
@@ -929,7 +1122,7 @@ void JMatchTable::delCol(rMch * const apCol ) {
 /**
 * @brief Get number of hash repairs (matches repaired by comparing).
 */
-int JMatchTable::getHshRpr ( ) { return miHshRpr ; }
+off_t JMatchTable::getHshRpr ( ) { return mzHshRpr ; }
 
 } /* namespace JojoDiff */
 
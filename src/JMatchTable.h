@@ -45,12 +45,12 @@ public:
 	* @param  abCmpAll  Compare all matches, or only those available within the filebuffers
 	*/
 	JMatchTable(JHashPos const * cpHsh,  JFile  * apFilOrg, JFile  * apFilNew,
-             const int aiMchSze, const bool abCmpAll, const int aiAhdMax);
+             const int aiMchSze, const bool abCmpAll, const off_t azAhdMax);
 
 	/* Destructor */
 	virtual ~JMatchTable();
 
-	enum eMatchReturn {Error, Full, Enlarged, Invalid, Good, Best, Valid};
+	enum eMatchReturn {Error, Full, Enlarged, Invalid, Good, Best, Valid, Pending};
 
 	/**
 	 * @brief Add given match to the array of matches
@@ -59,7 +59,7 @@ public:
 	 * - Add at the end of the list, or
 	 * - Override an old match if posible
 	 *
-	 * @return FullError, Full, Enlarged, Invalid, GoodMatch, BestMatch, Added
+	 * @return FullError, Full, Enlarged, Invalid, GoodMatch, BestMatch, Added, Pending (verification deferred)
 	 */
 	eMatchReturn add (
 	  off_t const &azFndOrgAdd,      /* match to add               */
@@ -88,16 +88,43 @@ public:
      * @brief Cleanup, check free space and fastcheck best match.
      *
      * @param       azBseOrg    Cleanup all matches before this position
+     * @param       azRedOrg    Current reading position on the original file
      * @param       azRedNew    Current reading position
      *
      * @return  Full, GoodMatch or Added
      */
-    eMatchReturn cleanup ( off_t const azBseOrg, off_t const azRedNew);
+    eMatchReturn cleanup ( off_t const azBseOrg, off_t const azRedOrg, off_t const azRedNew);
 
     /**
     * @brief Get number of hash repairs (matches repaired by comparing).
     */
-    int getHshRpr ();
+    off_t getHshRpr ();
+
+    /**
+    * @brief Get number of deferred (out-of-buffer) verifications.
+    */
+    off_t getChkDfr () { return mzChkDfr ; }
+
+    /**
+     * @brief Compare all matches, even if data not in buffer (used to reduce effort on a time budget).
+     */
+    void setCmpAll(bool abCmpAll) { mbCmpAll = abCmpAll ; }
+
+    /**
+     * @brief Elect the best match on its encoded cost instead of its distance.
+     *
+     * The cost of a match is the number of patch bytes needed to reach and
+     * start it (data bytes and their escapes, operators, DEL, BKT and EQL
+     * lengths as encoded by JOutBin, see cost), ties are broken in favour of
+     * the longer match.
+     */
+    void setCost(bool abCst) { mbCst = abCst ; }
+
+    /**
+     * @brief Defer out-of-buffer verifications till getbest, and run them in
+     *        original file order (fewer source seeks, slightly other matches).
+     */
+    void setDefer(bool abDfr) { mbDfr = abDfr ; }
 
 private:
     /**
@@ -116,8 +143,17 @@ private:
 	    off_t izDlt ;           /**< delta: izOrg = izNew + izDlt                       */
 	    off_t izTst ;           /**< result of last compare                             */
 	    int iiCmp ;             /**< result of last compare                             */
+	    bool ibPnd ;            /**< verification pending (queued in mpPnd)             */
 	} rMch ;
 
+	/**
+	* Deferred verification: match to verify at given original file position
+	*/
+	typedef struct {
+	    off_t izOrg ;           /**< position to verify on the original file            */
+	    rMch *ipMch ;           /**< match to verify                                    */
+	} rPnd ;
+
 	/**
 	 * Matchtable elements
 	 */
@@ -136,36 +172,83 @@ private:
 	off_t mzBstOrg = 0;         /**< Current best source position */
 	off_t mzBstNew = 0;         /**< Current best destin position */
 	int   miBstCmp = 0;         /**< Current best (estimated) length */
+	off_t mzBstCst = 0;         /**< Current best cost (with mbCst) */
+	off_t mzRedOrg = 0;         /**< Current reading position on the original file */
+
+    /**
+     * Data escapes on the new file from the reading position (see escapes)
+     */
+    static const int ESCMAX = 256 ; /**< Maximum number of escapes kept          */
+    off_t mpEsc[ESCMAX] ;       /**< Positions of the escapes found             */
+    int   miEsc = 0 ;           /**< Number of escapes found                    */
+    int   miEscPrv = EOF ;      /**< Byte before mzEscEnd                       */
+    off_t mzEscBeg = -1 ;       /**< Reading position the escapes are counted from */
+    off_t mzEscEnd = 0 ;        /**< Escapes are counted up to here             */
     off_t mzOld = 0 ;           /**< Limit for being old :-( */
 
+    rPnd *mpPnd = null ;        /**< Queue of deferred verifications (miMchSze) */
+    int   miPnd = 0 ;           /**< Number of queued verifications             */
+
     /**
 	 * Context: we need access to the two source files
 	 */
 	JFile * const mpFilOrg ;    /**< Source file */
 	JFile * const mpFilNew ;    /**< Destination file */
-	bool const mbCmpAll ;       /**< Compare all matches, even if data not in buffer? */
-	int  const miAhdMax ;       /**< Lookahead & lookback range                       */
+	bool mbCmpAll ;             /**< Compare all matches, even if data not in buffer? */
+	bool mbCst = false ;        /**< Elect the best match on its encoded cost?        */
+	bool mbDfr = false ;        /**< Defer out-of-buffer verifications?               */
+	off_t const mzAhdMax ;      /**< Lookahead & lookback range                       */
 	int  miRlb=0;               /**< Current reliability range from mpHsh             */
 
 	/**
 	* Statistics
 	*/
-	int miHshRpr;               /**< Number of repaired hash hits (by compare)   */
+	off_t mzHshRpr=0;           /**< Number of repaired hash hits (by compare)   */
+	off_t mzChkDfr=0;           /**< Number of deferred verifications            */
 
     /**
     * @brief Evaluate a match
     */
     eMatchReturn isGoodOrBest(
         off_t const azRedNew,       /**< Current read position */
-        rMch *lpCur                 /**< Element to evaluate */
+        rMch *lpCur,                /**< Element to evaluate */
+        bool const abDfr = true     /**< Defer out-of-buffer verification ? */
     ) ;
 
+    /**
+    * @brief Run the deferred verifications
+    *
+    * Out-of-buffer verifications are queued by isGoodOrBest and executed here,
+    * in original file order, so that the source file is read forward and
+    * neighbouring candidates are served by the same buffer fill.
+    *
+    * @param azRedNew  Current read position
+    * @param abRpr     Mark invalid matches for reuse, as add() does (not for the
+    *                  existing matches re-evaluated by cleanup())
+    */
+    void verify(off_t const azRedNew, bool const abRpr = true) ;
+
+    /**
+    * @brief Compare two deferred verifications on original file position (qsort callback).
+    */
+    static int cmpPnd(const void *apOne, const void *apTwo) ;
+
     /**
     * @brief Check if given solution is the best one.
     */
     bool isBest(rMch * const lpCur, off_t const azRedNew,
                 off_t lzTstOrg, off_t lzTstNew, int liCurCmp) ;
 
+    /**
+    * @brief Number of patch bytes needed to continue with the given match.
+    */
+    off_t cost(off_t const azTstOrg, off_t const azTstNew, off_t const azRedNew, int const aiCmp) ;
+
+    /**
+    * @brief Number of data escapes on the new file from the reading position.
+    */
+    int escapes(off_t const azEnd) ;
+
     /**
     * @brief Check if a match can be reused (deleted)
     *
@@ -21,13 +21,21 @@
 
 #include "JDefs.h"
 #include "JOutBin.h"
+#include "JCpu.h"
 
 namespace JojoDiff {
 
-JOutBin::JOutBin(FILE *apFilOut ) : mpFilOut(apFilOut), miOprCur(MOD), mzEqlCnt(0), mbOutEsc(false) {
+JOutBin::JOutBin(FILE *apFilOut, bool abEnt ) : mpFilOut(apFilOut), mpEnt(null), miOprCur(MOD), mzEqlCnt(0), mbOutEsc(false), mzPosOrg(0), mbFrg(false), miDtaLen(0) {
+  if (abEnt) {
+    mpEnt = new JEntOut(apFilOut) ;
+    miOprCur = 0 ;      // no operator yet: the first one is always coded
+  }
 }
 
 JOutBin::~JOutBin() {
+  if (miDtaLen > 0)
+    ufPutDta() ;
+  delete mpEnt ;
 }
 
 /*******************************************************************************
@@ -50,6 +58,9 @@ JOutBin::~JOutBin() {
 *        0x10000 <= x < 0x100000000        5 bytes:  254, xxxx
 *                          9 bytes:  255, xxxxxxxx
 *
+* With entropy coding (mpEnt), operators, lengths and data go to the range
+* coder instead (see JEntropy). The statistics still count plain bytes.
+*
 *******************************************************************************/
 
 /* ---------------------------------------------------------------
@@ -63,7 +74,10 @@ JOutBin::~JOutBin() {
  * 255    xxxxxxxx       253 + 256 + xxxxxxxx a 64-bit number
  * ---------------------------------------------------------------*/
 void JOutBin::ufPutLen ( off_t azLen  )
-{ if (azLen <= 252) {
+{ if (mpEnt != null) {
+    mpEnt->putLen(azLen) ;
+    gzOutBytCtl += getLenSze(azLen) ;
+  } else if (azLen <= 252) {
     putc(azLen - 1, mpFilOut) ;
     gzOutBytCtl += 1;
   } else if (azLen <= 508) {
@@ -108,14 +122,28 @@ void JOutBin::ufPutLen ( off_t azLen  )
  * data stream.
  * ---------------------------------------------------------------*/
 void JOutBin::ufPutOpr ( int aiOpr )
-{   // first output a pending escape
+{   // entropy coding: every operator is coded, ESC ends the patch
+    if (mpEnt != null) {
+        if (aiOpr != miOprCur || (aiOpr != MOD && aiOpr != INS)) {
+            mpEnt->putOpr(aiOpr) ;
+            if (aiOpr == ESC)
+                mpEnt->flush() ;
+            else
+                gzOutBytCtl+=2;
+        }
+        miOprCur = aiOpr ;
+        return ;
+    }
+
+    // first output the buffered data and a pending escape
     // as a real escape will follow, the data escape must be protected
+    if (miDtaLen > 0)
+        ufPutDta() ;
     if (mbOutEsc) {
         putc(ESC, mpFilOut) ;
         putc(ESC, mpFilOut) ;
         mbOutEsc = false ;
         gzOutBytEsc++ ;
-        gzOutBytDta++ ;
     }
 
     if ( aiOpr != ESC ) {
@@ -130,35 +158,61 @@ void JOutBin::ufPutOpr ( int aiOpr )
 }
 
 /* ---------------------------------------------------------------
- * ufPutByt outputs a byte, prefixing a data sequence <esc> <opcode>
- * with an addition <esc> byte.
+ * ufPutDta writes the buffered data bytes, prefixing a data
+ * sequence <esc> <opcode> with an addition <esc> byte.
+ * The runs between escapes are found with JCpu::fndByt and
+ * written as a whole.
  * ---------------------------------------------------------------*/
-void JOutBin::ufPutByt ( int aiByt )
-{
-  // handle a pending escape data byte
-  if (mbOutEsc) {
-    mbOutEsc = false;
-    if (aiByt >= BKT && aiByt <= ESC) {
-      // an <es><opcode> sequence within the datastrem,
-      // is protected by an additional <esc>
+void JOutBin::ufPutDta ( )
+{
+  const jchar *lpDta = mcDta ;
+  long llLen = miDtaLen ;
+
+  miDtaLen = 0 ;
+  while (llLen > 0) {
+    // handle a pending escape data byte
+    if (mbOutEsc) {
+      mbOutEsc = false;
+      if (*lpDta >= BKT && *lpDta <= ESC) {
+        // an <es><opcode> sequence within the datastrem,
+        // is protected by an additional <esc>
+        putc(ESC, mpFilOut) ;
+        gzOutBytEsc++ ;
+      }
+      // write the pending escape
       putc(ESC, mpFilOut) ;
-      gzOutBytEsc++ ;
-    }
-    // write the pending escape
-    putc(ESC, mpFilOut) ;
-    gzOutBytDta++;
-  }
-  // output the incoming byte
-  if (aiByt == ESC) {
-    // do not output now, wait to see what follows
-    mbOutEsc = true ;
-  } else {
-    // output byte
-    putc(aiByt, mpFilOut) ;
-    gzOutBytDta++;
+    }
+
+    // output the bytes up to the next escape
+    long llRun = JCpu::fndByt(lpDta, llLen, ESC) ;
+    if (llRun > 0)
+      fwrite(lpDta, 1, llRun, mpFilOut) ;
+    if (llRun < llLen) {
+      // do not output the escape now, wait to see what follows
+      mbOutEsc = true ;
+      llRun++ ;
+    }
+    lpDta += llRun ;
+    llLen -= llRun ;
   }
 }
 
+/* ---------------------------------------------------------------
+ * ufPutByt outputs a byte: buffered for a plain patch (see ufPutDta).
+ * ---------------------------------------------------------------*/
+void JOutBin::ufPutByt ( int aiByt, int aiOrg )
+{
+  gzOutBytDta++;
+  if (mpEnt != null) {
+    mpEnt->putLit(aiByt) ;
+    return ;
+  }
+
+  mcDta[miDtaLen++] = (jchar) aiByt ;
+  if (miDtaLen == DTASZE)
+    ufPutDta() ;
+}
+
 /* ---------------------------------------------------------------
  * ufOutBytBin: binary output function for generating patch files
  * ---------------------------------------------------------------*/
@@ -184,8 +238,9 @@ bool JOutBin::put (
         ufPutOpr(MOD) ;
       }
       for (int liCnt=0; liCnt < mzEqlCnt; liCnt++)
-        ufPutByt(miEqlBuf[liCnt]) ;
+        ufPutByt(miEqlBuf[liCnt], miEqlBuf[liCnt]) ;
     }
+    mzPosOrg+=mzEqlCnt;
     mzEqlCnt=0;
   }
 
@@ -200,7 +255,9 @@ bool JOutBin::put (
       if (miOprCur != aiOpr) {
         ufPutOpr(aiOpr) ;
       }
-      ufPutByt(aiNew) ;
+      ufPutByt(aiNew, aiOrg) ;
+      if (aiOpr == MOD)
+        mzPosOrg++;
       break;
 
     case DEL :
@@ -208,6 +265,7 @@ bool JOutBin::put (
       ufPutLen(azLen);
 
       gzOutBytDel+=azLen;
+      mzPosOrg+=azLen;
       break;
 
     case BKT :
@@ -215,6 +273,7 @@ bool JOutBin::put (
       ufPutLen(azLen);
 
       gzOutBytBkt+=azLen;
+      mzPosOrg-=azLen;
       break;
 
     case EQL :
@@ -230,4 +289,38 @@ bool JOutBin::put (
 
   return false ;
 } /* put() */
+
+/* ---------------------------------------------------------------
+ * putFrg appends a patch fragment: after a fragment, the patcher
+ * may be within a MOD or INS, so a DEL 1 + BKT 1 resets it when
+ * the next one starts where the previous one ended.
+ * ---------------------------------------------------------------*/
+int JOutBin::putFrg ( FILE *apFrg, off_t azBeg, off_t azLen, off_t azOrgBeg, off_t azOrgEnd )
+{
+  jchar lcBuf[64 * 1024] ;
+
+  if (azOrgBeg > mzPosOrg) {
+    put(DEL, azOrgBeg - mzPosOrg, 0, 0, mzPosOrg, 0) ;
+  } else if (azOrgBeg < mzPosOrg) {
+    put(BKT, mzPosOrg - azOrgBeg, 0, 0, mzPosOrg, 0) ;
+  } else if (mbFrg) {
+    put(DEL, 1, 0, 0, mzPosOrg, 0) ;
+    put(BKT, 1, 0, 0, mzPosOrg, 0) ;
+  }
+
+  if (jfseek(apFrg, azBeg, SEEK_SET) != 0)
+    return EXI_SEK ;
+  for (off_t lzRem = azLen; lzRem > 0; ) {
+    size_t llLen = (lzRem < (off_t) sizeof(lcBuf)) ? (size_t) lzRem : sizeof(lcBuf) ;
+    if (jfread(lcBuf, 1, llLen, apFrg) != llLen)
+      return EXI_RED ;
+    if (fwrite(lcBuf, 1, llLen, mpFilOut) != llLen)
+      return EXI_WRI ;
+    lzRem -= llLen ;
+  }
+
+  mzPosOrg = azOrgEnd ;
+  mbFrg = true ;
+  return 0 ;
+} /* putFrg() */
 } /* namespace */
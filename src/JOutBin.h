@@ -24,8 +24,10 @@
 
 #include <stdio.h>
 #include "JOut.h"
+#include "JEntropy.h"
 
 #define MINEQL 2    // start EQL-sequence on 3'rd byte
+#define DTASZE 4096 // data bytes buffered before scanning them for escapes
 
 namespace JojoDiff {
 
@@ -34,7 +36,13 @@ class JOutBin: public JOut {
     JOutBin& operator=(JOutBin const&) = delete;
 
 public:
-    JOutBin(FILE *apFilOut );
+    /**
+     * @brief Binary patch output.
+     *
+     * @param apFilOut  Output file
+     * @param abEnt     Entropy code the patch (see JEntropy) ?
+     */
+    JOutBin(FILE *apFilOut, bool abEnt = false);
     virtual ~JOutBin();
 
     virtual bool put (
@@ -46,16 +54,67 @@ public:
       off_t azPosNew
     );
 
+    /**
+     * @brief Number of bytes ufPutLen needs to output the given length
+     *        (length classes 1, 2, 3, 5 or 9 bytes).
+     */
+    static inline int getLenSze ( off_t azLen ) {
+        if (azLen <= 252)
+            return 1 ;
+        else if (azLen <= 508)
+            return 2 ;
+        else if (azLen <= 0xffff)
+            return 3 ;
+#ifdef JDIFF_LARGEFILE
+        else if (azLen <= 0xffffffff)
+            return 5 ;
+        else
+            return 9 ;
+#else
+        else
+            return 5 ;
+#endif
+    }
+
+    /** @brief Number of bytes written by the entropy coder (-1 = plain patch) */
+    off_t getEntSze() const { return mpEnt == null ? -1 : mpEnt->getSze() ; }
+
+    /** @brief Position in the original file the patch has reached, as the patcher will see it */
+    off_t getPosOrg() const { return mzPosOrg ; }
+
+    /**
+     * @brief Append a fragment of a plain patch, made by another JOutBin.
+     *
+     * A DEL or BKT first moves to the original position the fragment starts from
+     * (and resets the patcher to MOD), then the fragment is copied as it is.
+     *
+     * @param apFrg     File holding the fragment
+     * @param azBeg     Start of the fragment in that file
+     * @param azLen     Length of the fragment
+     * @param azOrgBeg  Original position the fragment starts from
+     * @param azOrgEnd  Original position the fragment ends on
+     * @return 0 = ok, EXI_SEK, EXI_RED or EXI_WRI otherwise
+     */
+    int putFrg ( FILE *apFrg, off_t azBeg, off_t azLen, off_t azOrgBeg, off_t azOrgEnd ) ;
+
 private:
     FILE *mpFilOut ;        /**< output file */
+    JEntOut *mpEnt ;        /**< entropy coder, null = plain patch */
 
     int   miOprCur ;        /**< current operand: INS, MOD, EQL or DEL. */
     off_t mzEqlCnt ;        /**< number of pending equal bytes */
     int   miEqlBuf[MINEQL]; /**< first four equal bytes */
     int   mbOutEsc;         /**< Pending escape character in data stream  ?*/
+    off_t mzPosOrg ;        /**< position in the original file (MOD, EQL, DEL and BKT move it) */
+    bool  mbFrg ;           /**< a fragment has been appended ? */
+    jchar mcDta[DTASZE] ;   /**< data bytes not yet written (plain patch) */
+    int   miDtaLen ;        /**< number of bytes in mcDta */
 
-    /**@brief Output one byte of data */
-    void ufPutByt ( int aiByt ) ;
+    /**@brief Output one byte of data (aiOrg = original byte, for MOD) */
+    void ufPutByt ( int aiByt, int aiOrg ) ;
+
+    /**@brief Write the buffered data bytes, escaping ESC <opcode> sequences */
+    void ufPutDta ( ) ;
 
     /**@brief Output an operator sequence */
     void ufPutOpr ( int aiOpr ) ;
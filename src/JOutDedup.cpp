@@ -0,0 +1,40 @@
+/*
+ * JOutDedup.cpp
+ *
+ * Copyright (C) 2002-2020 Joris Heirbaut
+ *
+ * This file is part of JojoDiff.
+ *
+ * JojoDiff is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "JOutDedup.h"
+
+namespace JojoDiff {
+
+JOutDedup::JOutDedup(FILE *apFilOut) : mpFilOut(apFilOut) {
+}
+
+JOutDedup::~JOutDedup() {
+}
+
+void JOutDedup::put(const char *asDupNam, off_t azDupPos,
+                    const char *asSrcNam, off_t azSrcPos, off_t azLen){
+    fprintf(mpFilOut, "%s " P8zd " %s " P8zd " DUP %" PRIzd "\n",
+            asDupNam, azDupPos, asSrcNam, azSrcPos, azLen) ;
+    gzOutBytDup += azLen ;
+    glOutRgnDup ++ ;
+}
+
+} /* namespace JojoDiff */
@@ -0,0 +1,70 @@
+/*
+ * JOutDedup.h
+ *
+ * Copyright (C) 2002-2020 Joris Heirbaut
+ *
+ * This file is part of JojoDiff.
+ *
+ * JojoDiff is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef JOUTDEDUP_H_
+#define JOUTDEDUP_H_
+
+#include <stdio.h>
+
+#include "JDefs.h"
+
+namespace JojoDiff {
+
+/**
+ * @brief Ascii output of duplicate regions found by JDedup.
+ *
+ * Every line has the form
+ *   <file> <position> <file> <position> DUP <length>
+ * meaning that <length> bytes at the first position are a duplicate
+ * of the data at the second position (which occurs first in the input).
+ */
+class JOutDedup {
+public:
+    JOutDedup(JOutDedup const&) = delete;
+    JOutDedup& operator=(JOutDedup const&) = delete;
+
+    JOutDedup(FILE *apFilOut);
+    virtual ~JOutDedup();
+
+    /**
+     * @brief Output one duplicate region.
+     *
+     * @param asDupNam  file containing the duplicate
+     * @param azDupPos  position of the duplicate
+     * @param asSrcNam  file containing the first occurrence
+     * @param azSrcPos  position of the first occurrence
+     * @param azLen     length of the region
+     */
+    virtual void put(const char *asDupNam, off_t azDupPos,
+                     const char *asSrcNam, off_t azSrcPos, off_t azLen);
+
+    /*
+     * Statistics
+     */
+    off_t gzOutBytDup = 0 ;     /**< Number of duplicate bytes (savings)    */
+    long  glOutRgnDup = 0 ;     /**< Number of duplicate regions            */
+
+private:
+    FILE *mpFilOut ;            /**< output file */
+};
+
+} /* namespace JojoDiff */
+#endif /* JOUTDEDUP_H_ */
@@ -24,6 +24,9 @@
 #include "JPatcht.h"
 #include "JDebug.h"
 #include "JDefs.h"
+#include "JCpu.h"
+#include "JEntropy.h"
+#include "JProbe.h"
 
 using namespace std;
 
@@ -31,15 +34,29 @@ namespace JojoDiff {
 
 JPatcht::JPatcht(JFile &apFilOrg, JFile &apFilPch, JFileOut &apFilOut,
                  const int aiVerbse)
-: mpFilOrg(apFilOrg), mpFilPch(apFilPch), mpFilOut(apFilOut)
-, miVerbse(aiVerbse)
+: mpFilOrg(&apFilOrg), mpFilPch(apFilPch), mpFilOut(&apFilOut)
+, mpFilLst(aiVerbse >= 1 ? JDebug::stddbg : null), miVerbse(aiVerbse)
+{
+
+}
+
+JPatcht::JPatcht(JFile &apFilPch, FILE *apFilLst, const int aiVerbse)
+: mpFilOrg(null), mpFilPch(apFilPch), mpFilOut(null)
+, mpFilLst(apFilLst), miVerbse(aiVerbse)
 {
 
 }
 
 JPatcht::~JPatcht()
 {
-    //dtor
+    free(mpRec) ;
+}
+
+int JPatcht::getRec( const rOpr *&apRec, long &alCnt ) const
+{
+    apRec = mpRec ;
+    alCnt = mlRecCnt ;
+    return mbRecMem ? EXI_MEM : EXI_OK ;
 }
 
 /** @brief Get an offset from the input file
@@ -96,7 +113,8 @@ off_t JPatcht::ufGetInt( JFile &apFil){
 int JPatcht::ufPutDta( off_t const lzPosOrg, off_t const lzPosOut,
                        int liOpr, int const aiDta, off_t azOff )
 {
-    mpFilOut.putc(aiDta) ;
+    if (mpFilOut != null)
+        mpFilOut->putc(aiDta) ;
     if (miVerbse > 1) {
         fprintf(JDebug::stddbg, P8zd " " P8zd " %s %02x %c\n",
                   lzPosOrg + ((liOpr == MOD) ? azOff : 0),
@@ -108,6 +126,54 @@ int JPatcht::ufPutDta( off_t const lzPosOrg, off_t const lzPosOut,
     return 1 ;
 }
 
+/** @brief Count and list an operation
+*
+* @param    azPosOrg    position on source file
+* @param    azPosOut    position on output file
+* @param    aiOpr       MOD, INS, DEL, EQL or BKT
+* @param    azOff       length
+*/
+void JPatcht::ufLstOpr( off_t const azPosOrg, off_t const azPosOut,
+                        int const aiOpr, off_t const azOff )
+{
+    static const char * const gcOprNam[] = {"BKT", "EQL", "DEL", "INS", "MOD"} ;
+
+    mzOprCnt[aiOpr - BKT] ++ ;
+    mzOprByt[aiOpr - BKT] += azOff ;
+    JPROBE4(patch_op, aiOpr, azPosOrg, azPosOut, azOff) ;
+
+    if (mbRec) {
+        if (mlRecCnt == mlRecMax) {
+            long llMax = (mlRecMax == 0) ? 1024 : mlRecMax * 2 ;
+            rOpr *lpRec = (rOpr *) realloc(mpRec, llMax * sizeof(rOpr)) ;
+            if (lpRec == null) {
+#ifdef JDIFF_THROW_BAD_ALLOC
+                throw bad_alloc() ;
+#else
+                mbRec = false ;
+                mbRecMem = true ;
+#endif
+            } else {
+                mpRec = lpRec ;
+                mlRecMax = llMax ;
+            }
+        }
+        if (mbRec) {
+            rOpr &lrRec = mpRec[mlRecCnt++] ;
+            lrRec.iiOpr = aiOpr ;
+            lrRec.izPosOrg = azPosOrg ;
+            lrRec.izPosOut = azPosOut ;
+            lrRec.izLen = azOff ;
+        }
+    }
+
+    // MOD and INS are listed byte by byte above verbose level 1
+    if (mpFilLst != null && (miVerbse <= 1 || (aiOpr != MOD && aiOpr != INS))) {
+        fprintf(mpFilLst, "" P8zd " " P8zd " %s %" PRIzd "\n",
+                azPosOrg, azPosOut, gcOprNam[aiOpr - BKT], azOff) ;
+    }
+}
+
 /** @brief Read a data sequence (INS or MOD)
 *
 * @param    azPosOrg    position on source file
@@ -139,7 +205,25 @@ int JPatcht::ufGetDta(off_t const lzPosOrg, off_t const lzPosOut,
     }
 
     /* Read loop */
-    while ((liInp = mpFilPch.get()) != EOF) {
+    for (;;) {
+        // Copy buffered data up to the next ESC at once (unless listing byte by byte)
+        if (miVerbse <= 1) {
+            long llLen ;
+            jchar const *lpDta = mpFilPch.getRed(llLen) ;
+            if (llLen > 0) {
+                llLen = JCpu::fndByt(lpDta, llLen, ESC) ;
+                if (llLen > 0) {
+                    if (mpFilOut != null)
+                        mpFilOut->write(lpDta, llLen) ;
+                    mpFilPch.skipRed(llLen) ;
+                    lzMod += llLen ;
+                }
+            }
+        }
+
+        if ((liInp = mpFilPch.get()) == EOF)
+            break ;
+
         // Handle ESC-code
         if (liInp == ESC) {
             liNew = mpFilPch.get();
@@ -212,16 +296,23 @@ int JPatcht::jpatch ()
     int liDbl = EOF ;   /**< 2nd Pending byte (EOF = no pending bye)*/
     int liOpr ;         /**< Current operand                        */
     int liRet;          /**< Return code from output file           */
+    bool lbRed = false; /**< Read the operator (first one is read)  */
 
     off_t lzOff ;       /**< Current operand's offset               */
     off_t lzPosOrg=0;   /**< Position in source file                */
     off_t lzPosOut=0;   /**< Position in destination file           */
 
+    liInp = mpFilPch.get();
+    if (ufIsEnt(liInp))
+        return ufPatchEnt() ;
+
     liOpr = 0 ;   // no operator
     while (liOpr != EOF) {
         // Read operator from input, unless this has already been done
         if (liOpr == 0) {
-            liInp = mpFilPch.get();
+            if (lbRed)
+                liInp = mpFilPch.get();
+            lbRed = true ;
             if (liInp == EOF)
                 break ;
 
@@ -262,20 +353,14 @@ int JPatcht::jpatch ()
         switch(liOpr) {
         case MOD:
             liOpr = ufGetDta(lzPosOrg, lzPosOut, liOpr, lzOff, liInp, liDbl) ;
-            if (miVerbse == 1) {
-                fprintf(JDebug::stddbg, "" P8zd " " P8zd " MOD %" PRIzd "\n",
-                        lzPosOrg, lzPosOut, lzOff) ;
-            }
+            ufLstOpr(lzPosOrg, lzPosOut, MOD, lzOff) ;
             lzPosOrg += lzOff ;
             lzPosOut += lzOff ;
             break ;
 
         case INS:
             liOpr = ufGetDta(lzPosOrg, lzPosOut, liOpr, lzOff, liInp, liDbl) ;
-            if (miVerbse == 1) {
-                fprintf(JDebug::stddbg, "" P8zd " " P8zd " INS %" PRIzd "\n",
-                        lzPosOrg, lzPosOut, lzOff)   ;
-            }
+            ufLstOpr(lzPosOrg, lzPosOut, INS, lzOff) ;
             lzPosOut += lzOff ;
             break ;
 
@@ -283,10 +368,7 @@ int JPatcht::jpatch ()
             lzOff = ufGetInt(mpFilPch);
             if (lzOff < 0)
                 return lzOff ;
-            if (miVerbse >= 1) {
-                fprintf(JDebug::stddbg, "" P8zd " " P8zd " DEL %" PRIzd "\n",
-                        lzPosOrg, lzPosOut, lzOff)  ;
-            }
+            ufLstOpr(lzPosOrg, lzPosOut, DEL, lzOff) ;
             lzPosOrg += lzOff ;
             liOpr = 0;    // to read next operator from input
             break ;
@@ -298,15 +380,14 @@ int JPatcht::jpatch ()
                 return lzOff ;
 
             /* show feedback */
-            if (miVerbse >= 1) {
-                fprintf(JDebug::stddbg, "" P8zd " " P8zd " EQL %" PRIzd "\n",
-                        lzPosOrg, lzPosOut, lzOff) ;
-            }
+            ufLstOpr(lzPosOrg, lzPosOut, EQL, lzOff) ;
 
             /* execute operation */
-            liRet = mpFilOut.copyfrom(mpFilOrg, lzPosOrg, lzOff) ;
-            if (liRet != EXI_OK){
-                return liRet ;
+            if (mpFilOut != null) {
+                liRet = mpFilOut->copyfrom(*mpFilOrg, lzPosOrg, lzOff) ;
+                if (liRet != EXI_OK){
+                    return liRet ;
+                }
             }
             lzPosOrg += lzOff ;
             lzPosOut += lzOff ;
@@ -319,22 +400,119 @@ int JPatcht::jpatch ()
             lzOff = ufGetInt(mpFilPch) ;
             if (lzOff < 0)
                 return lzOff ;
-            if (miVerbse >= 1) {
-                fprintf(JDebug::stddbg, "" P8zd " " P8zd " BKT %" PRIzd "\n",
-                        lzPosOrg, lzPosOut, lzOff)   ;
-            }
+            ufLstOpr(lzPosOrg, lzPosOut, BKT, lzOff) ;
             lzPosOrg -= lzOff ;
             liOpr = 0;  // to read next operator from input
             break ;
         }
     } /* while ! EOF */
 
-    if (miVerbse >= 1) {
-        fprintf(JDebug::stddbg, P8zd " " P8zd " EOF\n",
+    if (mpFilLst != null) {
+        fprintf(mpFilLst, P8zd " " P8zd " EOF\n",
                 lzPosOrg, lzPosOut)  ;
     }
 
     return EXI_OK ;
 } /* jpatch */
 
+/*******************************************************************************
+* Entropy coded patches
+*******************************************************************************
+* An entropy coded patch starts with ESC ESC ENTMGC: a plain patch only
+* starts with ESC ESC when an ESC or opcode follows (see JOutBin::ufPutByt).
+* The following bytes are peeked from the buffer, so that a plain patch is
+* read as before.
+*******************************************************************************/
+bool JPatcht::ufIsEnt( int const aiFst )
+{
+    if (aiFst != ESC)
+        return false ;
+
+    long llLen ;
+    jchar const *lpMgc = mpFilPch.getRed(llLen) ;
+    if (llLen < 2 || lpMgc[0] != ESC || lpMgc[1] != ENTMGC)
+        return false ;
+
+    mpFilPch.skipRed(2) ;
+    return true ;
+}
+
+int JPatcht::ufPatchEnt ()
+{
+    int liOpr ;         /**< Current operand                        */
+    int liRet;          /**< Return code from output file           */
+
+    off_t lzOff ;       /**< Current operand's offset               */
+    off_t lzPosOrg=0;   /**< Position in source file                */
+    off_t lzPosOut=0;   /**< Position in destination file           */
+
+    JEntInp loEnt(mpFilPch) ;
+
+    while ((liOpr = loEnt.getOpr()) != EOF) {
+        switch(liOpr) {
+        case MOD:
+        case INS:
+            /* blocks of literals */
+            lzOff = 0 ;
+            for (int liBlk = loEnt.getBlk(true); liBlk > 0; liBlk = loEnt.getBlk(false)) {
+                for (int liLit = 0; liLit < liBlk; ) {
+                    // Copy buffered raw literals at once (unless listing byte by byte)
+                    if (loEnt.isRaw() && miVerbse <= 1) {
+                        jchar const *lpDta ;
+                        long llLen = loEnt.getRaw(lpDta, liBlk - liLit) ;
+                        if (llLen > 0) {
+                            if (mpFilOut != null)
+                                mpFilOut->write(lpDta, llLen) ;
+                            lzOff += llLen ;
+                            liLit += llLen ;
+                            continue ;
+                        }
+                    }
+
+                    lzOff += ufPutDta(lzPosOrg, lzPosOut, liOpr, loEnt.getLit(liOpr), lzOff) ;
+                    liLit ++ ;
+                }
+            }
+
+            ufLstOpr(lzPosOrg, lzPosOut, liOpr, lzOff) ;
+            if (liOpr == MOD)
+                lzPosOrg += lzOff ;
+            lzPosOut += lzOff ;
+            break ;
+
+        case DEL:
+            lzOff = loEnt.getLen() ;
+            ufLstOpr(lzPosOrg, lzPosOut, DEL, lzOff) ;
+            lzPosOrg += lzOff ;
+            break ;
+
+        case EQL:
+            lzOff = loEnt.getLen() ;
+            ufLstOpr(lzPosOrg, lzPosOut, EQL, lzOff) ;
+            if (mpFilOut != null) {
+                liRet = mpFilOut->copyfrom(*mpFilOrg, lzPosOrg, lzOff) ;
+                if (liRet != EXI_OK){
+                    return liRet ;
+                }
+            }
+            lzPosOrg += lzOff ;
+            lzPosOut += lzOff ;
+            break ;
+
+        case BKT:
+            lzOff = loEnt.getLen() ;
+            ufLstOpr(lzPosOrg, lzPosOut, BKT, lzOff) ;
+            lzPosOrg -= lzOff ;
+            break ;
+        }
+    }
+
+    if (mpFilLst != null) {
+        fprintf(mpFilLst, P8zd " " P8zd " EOF\n",
+                lzPosOrg, lzPosOut)  ;
+    }
+
+    return EXI_OK ;
+} /* ufPatchEnt */
+
 } /* namespace */
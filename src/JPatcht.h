@@ -45,6 +45,16 @@ class JPatcht
         JPatcht(JFile &apFilOrg, JFile &apFilPch, JFileOut &apFilOut,
                 const int aiVerbse=0);
 
+        /**
+        * @brief    Create JPatcht object that only reads the patch (jpatch --list):
+        *           operations are counted and listed, the original is not needed.
+        *
+        * @param    apFilPch    Patch  file
+        * @param    apFilLst    Listing of the operations (null = count only)
+        * @param    aiVerbse    Verbosity level 0, 1 or 2
+        */
+        JPatcht(JFile &apFilPch, FILE *apFilLst, const int aiVerbse=0);
+
         /** Default destructor */
         virtual ~JPatcht();
 
@@ -72,14 +82,52 @@ class JPatcht
         */
         int jpatch ( ) ;
 
+        /** @brief Number of operations of a kind (MOD, INS, DEL, EQL or BKT) */
+        off_t getOprCnt( int const aiOpr ) const { return mzOprCnt[aiOpr - BKT] ; }
+
+        /** @brief Number of bytes of the operations of a kind (MOD, INS, DEL, EQL or BKT) */
+        off_t getOprByt( int const aiOpr ) const { return mzOprByt[aiOpr - BKT] ; }
+
+        /**
+        * @brief One operation of the patch, as recorded (see setRec)
+        */
+        typedef struct {
+            int   iiOpr ;       //!< MOD, INS, DEL, EQL or BKT
+            off_t izPosOrg ;    //!< position on source file
+            off_t izPosOut ;    //!< position on output file
+            off_t izLen ;       //!< length
+        } rOpr ;
+
+        /** @brief Record the operations (call before jpatch) */
+        void setRec( bool const abRec ) { mbRec = abRec ; }
+
+        /**
+        * @brief Get the recorded operations, in patch order
+        *
+        * @param    apRec       out: operations
+        * @param    alCnt       out: number of operations
+        * @return   EXI_OK or EXI_MEM (recording ran out of memory)
+        */
+        int getRec( const rOpr *&apRec, long &alCnt ) const ;
+
     protected:
 
     private:
-        JFile       &mpFilOrg;      //!< Source file
+        JFile       *mpFilOrg;      //!< Source file (null = listing only)
         JFile       &mpFilPch;      //!< Patch  file
-        JFileOut    &mpFilOut;      //!< Output file
+        JFileOut    *mpFilOut;      //!< Output file (null = listing only)
+        FILE        *mpFilLst;      //!< Listing of the operations (null = none)
         const int   miVerbse;      //!< Verbosity level
 
+        off_t mzOprCnt[5] = {0, 0, 0, 0, 0} ;   //!< Operations, by kind (BKT..MOD)
+        off_t mzOprByt[5] = {0, 0, 0, 0, 0} ;   //!< Bytes, by kind (BKT..MOD)
+
+        bool  mbRec = false ;       //!< Record the operations ?
+        bool  mbRecMem = false ;    //!< Recording ran out of memory ?
+        rOpr *mpRec = null ;        //!< Recorded operations
+        long  mlRecCnt = 0 ;        //!< Number of recorded operations
+        long  mlRecMax = 0 ;        //!< Room for recorded operations
+
         /** @brief Get an offset from the input file
         *
         * @param  lpFil  input file
@@ -99,6 +147,16 @@ class JPatcht
         int ufPutDta( off_t const azPosOrg, off_t const azPosNew,
                       int liOpr, int const aiDta, off_t aiOff );
 
+        /** @brief Count and list an operation
+        *
+        * @param    azPosOrg    position on source file
+        * @param    azPosOut    position on output file
+        * @param    aiOpr       MOD, INS, DEL, EQL or BKT
+        * @param    azOff       length
+        */
+        void ufLstOpr( off_t const azPosOrg, off_t const azPosOut,
+                       int const aiOpr, off_t const azOff );
+
         /** @brief Read a data sequence (INS or MOD)
         *
         * @param    azPosOrg    position on source file
@@ -111,6 +169,18 @@ class JPatcht
         int ufGetDta( off_t const azPosOrg, off_t const azPosNew,
                       int const liOpr, off_t &lzMod, int liPnd, int liDbl );
 
+        /** @brief Is the patch entropy coded ? Skips the ESC ESC ENTMGC header if so.
+        *
+        * @param    aiFst       First byte of the patch (already read)
+        */
+        bool ufIsEnt( int const aiFst );
+
+        /** @brief Apply an entropy coded patch (see JEntropy), header skipped
+        *
+        * @return   same as jpatch
+        */
+        int ufPatchEnt( );
+
 };
 
 } /* namespace */
@@ -0,0 +1,60 @@
+/*
+ * JProbe.h
+ *
+ * Copyright (C) 2002-2020 Joris Heirbaut
+ *
+ * This file is part of JojoDiff.
+ *
+ * JojoDiff is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *******************************************************************************
+ * USDT probes (static tracepoints) on the hot paths of jdiff.
+ *
+ * With JDIFF_PROBES (see JDefs.h: set when <sys/sdt.h> is available), each
+ * probe compiles to a single nop plus a note in the executable: it costs
+ * nothing until a tracer attaches. Without JDIFF_PROBES, probes vanish.
+ *
+ * Probes of provider "jdiff" and their arguments:
+ *   search_start      arg0 = position in original, arg1 = position in new file
+ *   search_end        arg0 = result (0 none, 1 found, < 0 error),
+ *                     arg1 = skip on original, arg2 = skip on new file, arg3 = ahead
+ *   match_best        arg0 = found (0/1), arg1 = position in original,
+ *                     arg2 = position in new file, arg3 = read position in new file
+ *   ahead_reset       arg0 = position asked, arg1 = new buffer start
+ *   ahead_scrollback  arg0 = position asked, arg1 = new buffer start, arg2 = old buffer start
+ *   ahead_read        arg0 = position, arg1 = length asked, arg2 = length read
+ *   hash_overload     arg0 = collision threshold, arg1 = reliability range
+ *   patch_op          arg0 = operation (BKT..MOD), arg1 = position in original,
+ *                     arg2 = position in output, arg3 = length
+ *
+ * E.g.: bpftrace -e 'usdt:./jdiff:jdiff:ahead_read { @[arg1] = count(); }'
+ *******************************************************************************/
+
+#ifndef JPROBE_H_
+#define JPROBE_H_
+
+#include "JDefs.h"
+
+#ifdef JDIFF_PROBES
+#include <sys/sdt.h>
+#define JPROBE2(name, a1, a2)           DTRACE_PROBE2(jdiff, name, a1, a2)
+#define JPROBE3(name, a1, a2, a3)       DTRACE_PROBE3(jdiff, name, a1, a2, a3)
+#define JPROBE4(name, a1, a2, a3, a4)   DTRACE_PROBE4(jdiff, name, a1, a2, a3, a4)
+#else
+#define JPROBE2(name, a1, a2)           do {} while (0)
+#define JPROBE3(name, a1, a2, a3)       do {} while (0)
+#define JPROBE4(name, a1, a2, a3, a4)   do {} while (0)
+#endif
+
+#endif /* JPROBE_H_ */
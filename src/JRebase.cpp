@@ -0,0 +1,317 @@
+/*
+ * JRebase.cpp
+ *
+ * Copyright (C) 2002-2020 Joris Heirbaut
+ *
+ * This file is part of JojoDiff.
+ *
+ * JojoDiff is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+using namespace std;
+
+#include "JRebase.h"
+#include "JDebug.h"
+#include "JFileMap.h"
+#include "JFileAheadStdio.h"
+#include "JFileOut.h"
+#include "JOutBin.h"
+#include "JDiff.h"
+
+namespace JojoDiff {
+
+#define RDFMIN  (2 * SMPSZE)    /**< Smallest changed region to re-diff     */
+
+JRebase::JRebase(JDiffJob::rSet const &arSet, int aiVerbse)
+: mrSet(arSet), miVerbse(aiVerbse)
+{}
+
+JRebase::~JRebase() {
+    delete mpIdx ;
+    delete mpIdxOut ;
+    delete mpFilOrg ;
+    delete mpFilNew ;
+    free(mpPch) ;
+    free(mpChg) ;
+    JFileMap::unmap(mpMapOrg, mzMapOrg) ;
+    JFileMap::unmap(mpMapOld, mzMapOld) ;
+    JFileMap::unmap(mpMapNew, mzMapNew) ;
+    if (mpTmpOld != null)
+        fclose(mpTmpOld) ;
+    if (mpTmpNew != null)
+        fclose(mpTmpNew) ;
+}
+
+/*******************************************************************************
+* Output
+*******************************************************************************/
+bool JRebase::Out::put(int aiOpr, off_t azLen, int aiOrg, int aiNew,
+                       off_t /* azPosOrg */, off_t /* azPosNew */){
+    off_t lzPosOrg = mzPosOrg ;
+    off_t lzPosNew = mzPosNew ;
+    switch (aiOpr) {
+    case ESC:           // the end of a re-diff is not the end of the patch
+        return false ;
+    case MOD:
+        mzPosOrg ++ ;
+        mzPosNew ++ ;
+        break ;
+    case INS:
+        mzPosNew ++ ;
+        break ;
+    case DEL:
+        mzPosOrg += azLen ;
+        break ;
+    case BKT:
+        mzPosOrg -= azLen ;
+        break ;
+    case EQL:
+        mzPosOrg += azLen ;
+        mzPosNew += azLen ;
+        break ;
+    }
+    bool lbRet = mpOut.put(aiOpr, azLen, aiOrg, aiNew, lzPosOrg, lzPosNew) ;
+    gzOutBytDta = mpOut.gzOutBytDta ;
+    return lbRet ;
+}
+
+/*******************************************************************************
+* Open
+*******************************************************************************/
+int JRebase::apply(jchar *apMapOrg, off_t azMapOrg, const char *asFilPch,
+                   FILE *&apTmp, jchar *&apMap, off_t &azMap,
+                   JPatcht::rOpr *&apRec, long &alRec){
+    FILE *lfFilPch = jfopen(asFilPch, "rb") ;
+    if (lfFilPch == null)
+        return EXI_SCD ;
+    apTmp = tmpfile() ;
+    if (apTmp == null) {
+        jfclose(lfFilPch) ;
+        return EXI_OUT ;
+    }
+
+    int liRet ;
+    {
+        JFileMap loOrg(apMapOrg, azMapOrg, "Org") ;
+        JFileAheadStdio loPch(lfFilPch, "Pch", 1024 * 1024, 64 * 1024, true) ;
+        JFileOut loOut(apTmp) ;
+        JPatcht loPatcht(loOrg, loPch, loOut, 0) ;
+        loPatcht.setRec(true) ;
+        liRet = loPatcht.jpatch() ;
+
+        const JPatcht::rOpr *lpRec ;
+        if (liRet == EXI_OK)
+            liRet = loPatcht.getRec(lpRec, alRec) ;
+        if (liRet == EXI_OK && alRec > 0) {
+            apRec = (JPatcht::rOpr *) malloc(alRec * sizeof(JPatcht::rOpr)) ;
+            if (apRec == null) {
+#ifdef JDIFF_THROW_BAD_ALLOC
+                throw bad_alloc() ;
+#else
+                liRet = EXI_MEM ;
+#endif
+            } else {
+                memcpy(apRec, lpRec, alRec * sizeof(JPatcht::rOpr)) ;
+            }
+        }
+    }
+    jfclose(lfFilPch) ;
+    if (liRet != EXI_OK)
+        return liRet ;
+    if (fflush(apTmp) != 0)
+        return EXI_WRI ;
+
+    /* An empty result has no mapping */
+    apMap = JFileMap::map(apTmp, azMap) ;
+    if (apMap == null && azMap != 0)
+        return EXI_ARG ;
+    return EXI_OK ;
+}
+
+int JRebase::open(const char *asFilOrg, const char *asFilPch, const char *asFilChg){
+    FILE *lfFil = jfopen(asFilOrg, "rb") ;
+    if (lfFil == null)
+        return EXI_FRT ;
+    mzMapOrg = -1 ;         // unless the size is known
+    mpMapOrg = JFileMap::map(lfFil, mzMapOrg) ;
+    jfclose(lfFil) ;
+
+    /* An empty source has no mapping */
+    if (mpMapOrg == null && mzMapOrg != 0)
+        return EXI_ARG ;
+
+    int liRet = apply(mpMapOrg, mzMapOrg, asFilPch, mpTmpOld, mpMapOld, mzMapOld, mpPch, mlPch) ;
+    if (liRet != EXI_OK)
+        return liRet ;
+    return apply(mpMapOld, mzMapOld, asFilChg, mpTmpNew, mpMapNew, mzMapNew, mpChg, mlChg) ;
+}
+
+/*******************************************************************************
+* Rebase
+*******************************************************************************/
+void JRebase::jump(Out &arOut, off_t azOrg){
+    if (azOrg > arOut.mzPosOrg)
+        arOut.put(DEL, azOrg - arOut.mzPosOrg, 0, 0, 0, 0) ;
+    else if (azOrg < arOut.mzPosOrg)
+        arOut.put(BKT, arOut.mzPosOrg - azOrg, 0, 0, 0, 0) ;
+}
+
+void JRebase::putEql(Out &arOut, off_t azOrg, off_t azLen){
+    jump(arOut, azOrg) ;
+
+    /* Byte by byte until the output accepts a length */
+    for (off_t lzPos = 0; lzPos < azLen; lzPos++) {
+        int lcEql = mpMapOrg[azOrg + lzPos] ;
+        if (arOut.put(EQL, 1, lcEql, lcEql, 0, 0)) {
+            if (lzPos + 1 < azLen)
+                arOut.put(EQL, azLen - lzPos - 1, 0, 0, 0, 0) ;
+            break ;
+        }
+    }
+}
+
+void JRebase::putDta(Out &arOut, int aiOpr, off_t azNew, off_t azLen){
+    for (off_t lzPos = azNew; lzPos < azNew + azLen; lzPos++) {
+        /* MOD within A only */
+        if (aiOpr == MOD && arOut.mzPosOrg < mzMapOrg)
+            arOut.put(MOD, 1, mpMapOrg[arOut.mzPosOrg], mpMapNew[lzPos], 0, 0) ;
+        else
+            arOut.put(INS, 1, 0, mpMapNew[lzPos], 0, 0) ;
+    }
+}
+
+void JRebase::putOld(Out &arOut, off_t azNew, off_t azOld, off_t azLen){
+    /* Last operation of A->B that starts at or before azOld */
+    long llLow = 0, llHig = mlPch ;
+    while (llLow < llHig) {
+        long llMid = llLow + (llHig - llLow) / 2 ;
+        if (mpPch[llMid].izPosOut <= azOld)
+            llLow = llMid + 1 ;
+        else
+            llHig = llMid ;
+    }
+
+    /* Step back to the one that produced azOld (not a DEL or BKT) */
+    long llRec = (llLow > 0) ? llLow - 1 : 0 ;
+    while (llRec > 0 && (mpPch[llRec].iiOpr == DEL || mpPch[llRec].iiOpr == BKT
+                         || mpPch[llRec].izPosOut + mpPch[llRec].izLen <= azOld))
+        llRec -- ;
+
+    for (; llRec < mlPch && azLen > 0; llRec++) {
+        const JPatcht::rOpr &lrRec = mpPch[llRec] ;
+        if (lrRec.iiOpr == DEL || lrRec.iiOpr == BKT || lrRec.izPosOut + lrRec.izLen <= azOld)
+            continue ;
+        off_t lzOff = azOld - lrRec.izPosOut ;
+        off_t lzLen = lrRec.izLen - lzOff ;
+        if (lzLen > azLen)
+            lzLen = azLen ;
+        switch (lrRec.iiOpr) {
+        case EQL:
+            putEql(arOut, lrRec.izPosOrg + lzOff, lzLen) ;
+            break ;
+        case MOD:
+            jump(arOut, lrRec.izPosOrg + lzOff) ;
+            putDta(arOut, MOD, azNew, lzLen) ;
+            break ;
+        case INS:
+            putDta(arOut, INS, azNew, lzLen) ;
+            break ;
+        }
+        azNew += lzLen ;
+        azOld += lzLen ;
+        azLen -= lzLen ;
+    }
+}
+
+int JRebase::putChg(Out &arOut, off_t azNew, off_t azLen){
+    if (azLen < RDFMIN) {
+        putDta(arOut, MOD, azNew, azLen) ;
+        return EXI_OK ;
+    }
+
+    /* One index of A for all re-diffs (its own diff is not used) */
+    if (mpIdx == null) {
+        mpFilOrg = new JFileMap(mpMapOrg, mzMapOrg, "Org") ;
+        mpFilNew = new JFileMap(mpMapNew, mzMapNew, "New") ;
+        mpIdxOut = new JOutBin(null) ;
+        mpIdx = new JDiff(mpFilOrg, mpFilNew, mpIdxOut, mrSet.iiHshMbt, 0,
+                          mrSet.ibSrcBkt, 1, mrSet.iiMchMax, mrSet.iiMchMin,
+                          mrSet.izAhdMax, mrSet.ibCmpAll, null) ;
+        int liRet = mpIdx->prescan() ;
+        if (liRet < 0)
+            return liRet ;
+    }
+
+    /* A re-diff starts at the start of A */
+    jump(arOut, 0) ;
+    JFileMap loOrg(mpMapOrg, mzMapOrg, "Org") ;
+    JFileMap loNew(mpMapNew + azNew, azLen, "New") ;
+    JDiff loDif(&loOrg, &loNew, &arOut, mrSet.iiHshMbt, 0,
+                mrSet.ibSrcBkt, 1, mrSet.iiMchMax, mrSet.iiMchMin,
+                mrSet.izAhdMax, mrSet.ibCmpAll, mpIdx->getHsh()) ;
+    loDif.setCost(mrSet.ibCst) ;
+    loDif.setDefer(mrSet.ibDfr) ;
+    loDif.setNear(mrSet.ibNer) ;
+    loDif.setAdapt(mrSet.ibAdp) ;
+    int liRet = loDif.jdiff() ;
+    mzRdf += azLen ;
+    mlRdf ++ ;
+    return (liRet < 0) ? liRet : EXI_OK ;
+}
+
+int JRebase::run(FILE *apFilOut){
+    JOutBin loOut(apFilOut, mrSet.ibEnt) ;
+    Out loRbs(loOut) ;
+    int liRet = EXI_OK ;
+
+    /* The change, in B' order: equal to B, or changed (consecutive MOD and INS) */
+    off_t lzChgBeg = 0, lzChgLen = 0 ;
+    for (long llRec = 0; llRec < mlChg && liRet == EXI_OK; llRec++) {
+        const JPatcht::rOpr &lrRec = mpChg[llRec] ;
+        if (lrRec.izLen == 0)
+            continue ;
+        switch (lrRec.iiOpr) {
+        case MOD:
+        case INS:
+            if (lzChgLen == 0)
+                lzChgBeg = lrRec.izPosOut ;
+            lzChgLen += lrRec.izLen ;
+            break ;
+        case EQL:
+            if (lzChgLen > 0) {
+                liRet = putChg(loRbs, lzChgBeg, lzChgLen) ;
+                lzChgLen = 0 ;
+            }
+            putOld(loRbs, lrRec.izPosOut, lrRec.izPosOrg, lrRec.izLen) ;
+            break ;
+        }
+    }
+    if (lzChgLen > 0 && liRet == EXI_OK)
+        liRet = putChg(loRbs, lzChgBeg, lzChgLen) ;
+    if (liRet != EXI_OK)
+        return liRet ;
+    loOut.put(ESC, 0, 0, 0, loRbs.mzPosOrg, loRbs.mzPosNew) ;
+
+    if (miVerbse > 0)
+        fprintf(JDebug::stddbg, "Rebase: %ld changed regions re-diffed (" P8zd " bytes) of " P8zd " bytes.\n",
+                mlRdf, mzRdf, mzMapNew) ;
+    if (loOut.gzOutBytDta > 0 || mzMapNew != mzMapOrg)
+        return EXI_DIF ;
+    return EXI_EQL ;
+}
+
+} /* namespace JojoDiff */
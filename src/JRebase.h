@@ -0,0 +1,148 @@
+/*
+ * JRebase.h
+ *
+ * Copyright (C) 2002-2020 Joris Heirbaut
+ *
+ * This file is part of JojoDiff.
+ *
+ * JojoDiff is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *******************************************************************************
+ * Patch rebasing: turn a patch A->B into a patch A->B', given a patch B->B'
+ * (the change), without diffing A and B' again.
+ *
+ * 1) apply both patches (A->B on A, B->B' on the result) into temporary files,
+ *    recording their operations (see JPatcht::setRec),
+ * 2) walk the operations of the change, in B' order:
+ *    - bytes of B' equal to B: map them through the operations of A->B, so that
+ *      EQL from A are kept as EQL and data (MOD/INS) as data,
+ *    - bytes of B' that changed: re-diff these regions against A, using one
+ *      index of A built for all of them (small regions are just data),
+ * 3) all of these go to one patch, which jdiff -u applies as usual.
+ *
+ * Not available on Windows (no mappings).
+ *******************************************************************************/
+
+#ifndef JREBASE_H_
+#define JREBASE_H_
+
+#include <stdio.h>
+
+#include "JDefs.h"
+#include "JDiffJob.h"
+#include "JFile.h"
+#include "JOut.h"
+#include "JPatcht.h"
+
+namespace JojoDiff {
+
+class JDiff ;
+
+class JRebase {
+public:
+    JRebase(JRebase const&) = delete;
+    JRebase& operator=(JRebase const&) = delete;
+
+    /**
+     * @brief Create a patch rebase.
+     *
+     * @param arSet     JDiff settings, for the changed regions
+     * @param aiVerbse  Verbose level
+     */
+    JRebase(JDiffJob::rSet const &arSet, int aiVerbse);
+
+    virtual ~JRebase();
+
+    /**
+     * @brief Map the source and apply both patches.
+     *
+     * @param asFilOrg  Source file A (a regular file)
+     * @param asFilPch  Patch A->B
+     * @param asFilChg  Patch B->B'
+     * @return 0=ok, EXI_FRT/EXI_SCD when a file cannot be opened,
+     *         EXI_ARG when a non-empty source cannot be mapped (or on Windows),
+     *         error code of the patches otherwise
+     */
+    int open(const char *asFilOrg, const char *asFilPch, const char *asFilChg);
+
+    /**
+     * @brief Write the patch A->B'.
+     *
+     * @param apFilOut  Output patch file
+     * @return EXI_DIF when A and B' differ, EXI_EQL when not, error code otherwise
+     */
+    int run(FILE *apFilOut);
+
+private:
+    /**
+     * Output that keeps track of the position on the original, for all
+     * operations: those of the rebase and those of the re-diffs.
+     */
+    class Out : public JOut {
+    public:
+        Out(JOut &apOut) : mpOut(apOut) {}
+        virtual bool put(int aiOpr, off_t azLen, int aiOrg, int aiNew,
+                         off_t azPosOrg, off_t azPosNew) ;
+        off_t mzPosOrg = 0 ;    /**< Position on the original           */
+        off_t mzPosNew = 0 ;    /**< Position on the new file           */
+    private:
+        JOut &mpOut ;           /**< Actual output                      */
+    } ;
+
+    /** @brief Apply a patch into a temporary file, map the result and record the operations */
+    int apply(jchar *apMapOrg, off_t azMapOrg, const char *asFilPch,
+              FILE *&apTmp, jchar *&apMap, off_t &azMap,
+              JPatcht::rOpr *&apRec, long &alRec) ;
+
+    /** @brief Move to the given position on the original */
+    void jump(Out &arOut, off_t azOrg) ;
+
+    /** @brief Output azLen bytes equal to the original at azOrg */
+    void putEql(Out &arOut, off_t azOrg, off_t azLen) ;
+
+    /** @brief Output azLen bytes of B' as data (MOD or INS) */
+    void putDta(Out &arOut, int aiOpr, off_t azNew, off_t azLen) ;
+
+    /** @brief Output a region of B' equal to B, through the operations of A->B */
+    void putOld(Out &arOut, off_t azNew, off_t azOld, off_t azLen) ;
+
+    /** @brief Output a changed region of B': re-diffed against A, or as data */
+    int putChg(Out &arOut, off_t azNew, off_t azLen) ;
+
+    JDiffJob::rSet const mrSet ;    /**< Settings                           */
+    int const miVerbse ;            /**< Verbose level                      */
+
+    jchar *mpMapOrg = null ;        /**< Mapping of A                       */
+    off_t mzMapOrg = 0 ;            /**< Size of A                          */
+    FILE *mpTmpOld = null ;         /**< B                                  */
+    jchar *mpMapOld = null ;        /**< Mapping of B                       */
+    off_t mzMapOld = 0 ;            /**< Size of B                          */
+    FILE *mpTmpNew = null ;         /**< B'                                 */
+    jchar *mpMapNew = null ;        /**< Mapping of B'                      */
+    off_t mzMapNew = 0 ;            /**< Size of B'                         */
+    JPatcht::rOpr *mpPch = null ;   /**< Operations of A->B                 */
+    long mlPch = 0 ;                /**< Number of operations of A->B       */
+    JPatcht::rOpr *mpChg = null ;   /**< Operations of B->B'                */
+    long mlChg = 0 ;                /**< Number of operations of B->B'      */
+
+    JFile *mpFilOrg = null ;        /**< Cursor on A, for the index         */
+    JFile *mpFilNew = null ;        /**< Cursor on B', for the index        */
+    JOut *mpIdxOut = null ;         /**< Output of the index owner (unused) */
+    JDiff *mpIdx = null ;           /**< Owner of the index of A            */
+    off_t mzRdf = 0 ;               /**< Bytes re-diffed                    */
+    long mlRdf = 0 ;                /**< Regions re-diffed                  */
+};
+
+} /* namespace JojoDiff */
+#endif /* JREBASE_H_ */
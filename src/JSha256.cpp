@@ -0,0 +1,127 @@
+/*
+ * JSha256.cpp
+ *
+ * Copyright (C) 2002-2020 Joris Heirbaut
+ *
+ * This file is part of JojoDiff.
+ *
+ * JojoDiff is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include "JSha256.h"
+
+namespace JojoDiff {
+
+static const uint32_t gkSha[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static inline uint32_t ror(uint32_t aiVal, int aiBit) {
+    return (aiVal >> aiBit) | (aiVal << (32 - aiBit)) ;
+}
+
+JSha256::JSha256() {
+    reset();
+}
+
+void JSha256::reset() {
+    miSta[0] = 0x6a09e667 ; miSta[1] = 0xbb67ae85 ; miSta[2] = 0x3c6ef372 ; miSta[3] = 0xa54ff53a ;
+    miSta[4] = 0x510e527f ; miSta[5] = 0x9b05688c ; miSta[6] = 0x1f83d9ab ; miSta[7] = 0x5be0cd19 ;
+    mlLen = 0 ;
+    miBuf = 0 ;
+}
+
+void JSha256::block(const jchar *apBlk) {
+    uint32_t w[64] ;
+    for (int i = 0; i < 16; i++)
+        w[i] = ((uint32_t) apBlk[i * 4] << 24) | ((uint32_t) apBlk[i * 4 + 1] << 16)
+             | ((uint32_t) apBlk[i * 4 + 2] << 8) | (uint32_t) apBlk[i * 4 + 3] ;
+    for (int i = 16; i < 64; i++) {
+        uint32_t s0 = ror(w[i - 15], 7) ^ ror(w[i - 15], 18) ^ (w[i - 15] >> 3) ;
+        uint32_t s1 = ror(w[i - 2], 17) ^ ror(w[i - 2], 19) ^ (w[i - 2] >> 10) ;
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1 ;
+    }
+
+    uint32_t a = miSta[0], b = miSta[1], c = miSta[2], d = miSta[3] ;
+    uint32_t e = miSta[4], f = miSta[5], g = miSta[6], h = miSta[7] ;
+    for (int i = 0; i < 64; i++) {
+        uint32_t t1 = h + (ror(e, 6) ^ ror(e, 11) ^ ror(e, 25)) + ((e & f) ^ (~e & g)) + gkSha[i] + w[i] ;
+        uint32_t t2 = (ror(a, 2) ^ ror(a, 13) ^ ror(a, 22)) + ((a & b) ^ (a & c) ^ (b & c)) ;
+        h = g ; g = f ; f = e ; e = d + t1 ;
+        d = c ; c = b ; b = a ; a = t1 + t2 ;
+    }
+    miSta[0] += a ; miSta[1] += b ; miSta[2] += c ; miSta[3] += d ;
+    miSta[4] += e ; miSta[5] += f ; miSta[6] += g ; miSta[7] += h ;
+}
+
+void JSha256::update(const jchar *apDta, size_t aiLen) {
+    mlLen += aiLen ;
+    if (miBuf > 0) {
+        size_t liCpy = 64 - miBuf ;
+        if (liCpy > aiLen)
+            liCpy = aiLen ;
+        memcpy(&mcBuf[miBuf], apDta, liCpy) ;
+        miBuf += liCpy ;
+        apDta += liCpy ;
+        aiLen -= liCpy ;
+        if (miBuf < 64)
+            return ;
+        block(mcBuf) ;
+        miBuf = 0 ;
+    }
+    while (aiLen >= 64) {
+        block(apDta) ;
+        apDta += 64 ;
+        aiLen -= 64 ;
+    }
+    if (aiLen > 0) {
+        memcpy(mcBuf, apDta, aiLen) ;
+        miBuf = aiLen ;
+    }
+}
+
+void JSha256::final(jchar *apDig) {
+    uint64_t llBit = mlLen * 8 ;
+    jchar lcPad[72] ;
+    int liPad = (miBuf < 56) ? 56 - miBuf : 120 - miBuf ;
+    memset(lcPad, 0, sizeof(lcPad)) ;
+    lcPad[0] = 0x80 ;
+    for (int i = 0; i < 8; i++)
+        lcPad[liPad + i] = (jchar) (llBit >> (56 - i * 8)) ;
+    update(lcPad, liPad + 8) ;
+
+    for (int i = 0; i < 8; i++) {
+        apDig[i * 4    ] = (jchar) (miSta[i] >> 24) ;
+        apDig[i * 4 + 1] = (jchar) (miSta[i] >> 16) ;
+        apDig[i * 4 + 2] = (jchar) (miSta[i] >> 8) ;
+        apDig[i * 4 + 3] = (jchar) (miSta[i]) ;
+    }
+}
+
+void JSha256::digest(const jchar *apDta, size_t aiLen, jchar *apDig) {
+    JSha256 loSha ;
+    loSha.update(apDta, aiLen) ;
+    loSha.final(apDig) ;
+}
+
+} /* namespace JojoDiff */
@@ -0,0 +1,64 @@
+/*
+ * JSha256.h
+ *
+ * Copyright (C) 2002-2020 Joris Heirbaut
+ *
+ * This file is part of JojoDiff.
+ *
+ * JojoDiff is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef JSHA256_H_
+#define JSHA256_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "JDefs.h"
+
+namespace JojoDiff {
+
+/**
+ * @brief SHA-256 message digest (FIPS 180-4), used as strong hash on data chunks.
+ */
+class JSha256 {
+public:
+    static const int DIGSZE = 32 ;      /**< Digest size in bytes */
+
+    JSha256();
+
+    /** @brief Restart a new digest */
+    void reset();
+
+    /** @brief Add data to the digest */
+    void update(const jchar *apDta, size_t aiLen);
+
+    /** @brief Finish the digest and write DIGSZE bytes to apDig */
+    void final(jchar *apDig);
+
+    /** @brief Digest of a single buffer */
+    static void digest(const jchar *apDta, size_t aiLen, jchar *apDig);
+
+private:
+    /** @brief Process one 64-byte block */
+    void block(const jchar *apBlk);
+
+    uint32_t miSta[8] ;         /**< Hash state                         */
+    uint64_t mlLen ;            /**< Total length in bytes              */
+    jchar    mcBuf[64] ;        /**< Pending partial block              */
+    int      miBuf ;            /**< Number of bytes in mcBuf           */
+};
+
+} /* namespace JojoDiff */
+#endif /* JSHA256_H_ */
@@ -0,0 +1,296 @@
+/*
+ * JShard.cpp
+ *
+ * Copyright (C) 2002-2020 Joris Heirbaut
+ *
+ * This file is part of JojoDiff.
+ *
+ * JojoDiff is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <errno.h>
+#include <new>
+using namespace std;
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#endif
+
+#include "JShard.h"
+#include "JDebug.h"
+#include "JFileMap.h"
+#include "JOutBin.h"
+#include "JDiff.h"
+
+namespace JojoDiff {
+
+#define SHDMIN  (1024 * 1024)   /**< Smallest shard */
+
+JShard::JShard(JDiffJob::rSet const &arSet, int aiShd, int aiVerbse)
+: mrSet(arSet), miShd(aiShd < 1 ? 1 : aiShd), miVerbse(aiVerbse)
+{}
+
+JShard::~JShard() {
+    if (mpShd != null) {
+        for (int liShd = 0; liShd < miShd; liShd++)
+            if (mpShd[liShd].ipFrg != null)
+                fclose(mpShd[liShd].ipFrg) ;
+        free(mpShd) ;
+    }
+    JFileMap::unmap(mpMapOrg, mzMapOrg) ;
+    JFileMap::unmap(mpMapNew, mzMapNew) ;
+}
+
+#ifdef _WIN32
+int JShard::open(const char *, const char *){
+    return EXI_ARG ;
+}
+int JShard::run(FILE *){
+    return EXI_ARG ;
+}
+void JShard::work(rShd &, int, JHashPos *){}
+int JShard::collect(){
+    return EXI_ARG ;
+}
+#else
+
+/*******************************************************************************
+* Open
+*******************************************************************************/
+int JShard::open(const char *asFilOrg, const char *asFilNew){
+    FILE *lfFil = jfopen(asFilOrg, "rb") ;
+    if (lfFil == null)
+        return EXI_FRT ;
+    mpMapOrg = JFileMap::map(lfFil, mzMapOrg) ;
+    jfclose(lfFil) ;
+
+    lfFil = jfopen(asFilNew, "rb") ;
+    if (lfFil == null)
+        return EXI_SCD ;
+    mpMapNew = JFileMap::map(lfFil, mzMapNew) ;
+    jfclose(lfFil) ;
+
+    if (mpMapOrg == null || mpMapNew == null)
+        return EXI_ARG ;
+
+    /* Shards of equal size, not too small */
+    if (miShd > 1 + mzMapNew / SHDMIN)
+        miShd = (int) (1 + mzMapNew / SHDMIN) ;
+    mpShd = (rShd *) calloc(miShd, sizeof(rShd)) ;
+    if (mpShd == null) {
+#ifdef JDIFF_THROW_BAD_ALLOC
+        throw bad_alloc() ;
+#else
+        return EXI_MEM ;
+#endif
+    }
+    for (int liShd = 0; liShd < miShd; liShd++) {
+        mpShd[liShd].izNewBeg = mzMapNew * liShd / miShd ;
+        mpShd[liShd].izNewLen = mzMapNew * (liShd + 1) / miShd - mpShd[liShd].izNewBeg ;
+        mpShd[liShd].iiPid = -1 ;
+        mpShd[liShd].iiSck = -1 ;
+        mpShd[liShd].iiRet = EXI_ERR ;
+    }
+    return 0 ;
+}
+
+/*******************************************************************************
+* Worker
+*******************************************************************************/
+void JShard::work(rShd &arShd, int aiSck, JHashPos *apHsh){
+    FILE *lfSck = fdopen(aiSck, "wb") ;
+    if (lfSck == null)
+        _exit(1) ;
+
+    JFileMap loOrg(mpMapOrg, mzMapOrg, "Org") ;
+    JFileMap loNew(mpMapNew + arShd.izNewBeg, arShd.izNewLen, "New") ;
+    JOutBin loOut(lfSck) ;
+    JDiff loDif(&loOrg, &loNew, &loOut, mrSet.iiHshMbt, 0,
+                mrSet.ibSrcBkt, 1, mrSet.iiMchMax, mrSet.iiMchMin,
+                mrSet.izAhdMax, mrSet.ibCmpAll, apHsh) ;
+    loDif.setCost(mrSet.ibCst) ;
+    loDif.setDefer(mrSet.ibDfr) ;
+    loDif.setNear(mrSet.ibNer) ;
+    loDif.setAdapt(mrSet.ibAdp) ;
+
+    rTrl lrTrl ;
+    lrTrl.iiRet = loDif.jdiff() ;
+    lrTrl.izPosOrg = loOut.getPosOrg() ;
+    lrTrl.izDta = loOut.gzOutBytDta ;
+    bool lbOk = (fwrite(&lrTrl, sizeof(rTrl), 1, lfSck) == 1) ;
+    if (fclose(lfSck) != 0)
+        lbOk = false ;
+
+    // leave without destructors: the index and mappings belong to the coordinator
+    _exit(lbOk ? 0 : 1) ;
+}
+
+/*******************************************************************************
+* Coordinator
+*******************************************************************************/
+int JShard::collect(){
+    struct pollfd *lpPol = (struct pollfd *) calloc(miShd, sizeof(struct pollfd)) ;
+    if (lpPol == null)
+        return EXI_MEM ;
+
+    jchar lcBuf[64 * 1024] ;
+    int liRet = 0 ;
+    int liOpn = miShd ;
+    while (liOpn > 0 && liRet == 0) {
+        int liCnt = 0 ;
+        for (int liShd = 0; liShd < miShd; liShd++) {
+            if (mpShd[liShd].iiSck >= 0) {
+                lpPol[liCnt].fd = mpShd[liShd].iiSck ;
+                lpPol[liCnt].events = POLLIN ;
+                lpPol[liCnt].revents = 0 ;
+                liCnt ++ ;
+            }
+        }
+        if (poll(lpPol, liCnt, -1) < 0) {
+            if (errno == EINTR)
+                continue ;
+            liRet = EXI_RED ;
+            break ;
+        }
+
+        /* Append what arrived to the fragments */
+        for (int liShd = 0, liPol = 0; liShd < miShd; liShd++) {
+            rShd &lrShd = mpShd[liShd] ;
+            if (lrShd.iiSck < 0)
+                continue ;
+            if (lpPol[liPol++].revents == 0)
+                continue ;
+            ssize_t llLen = read(lrShd.iiSck, lcBuf, sizeof(lcBuf)) ;
+            if (llLen < 0 && errno == EINTR)
+                continue ;
+            if (llLen > 0) {
+                if (fwrite(lcBuf, 1, llLen, lrShd.ipFrg) != (size_t) llLen)
+                    liRet = EXI_WRI ;
+            } else {
+                if (llLen < 0)
+                    liRet = EXI_RED ;
+                close(lrShd.iiSck) ;
+                lrShd.iiSck = -1 ;
+                liOpn -- ;
+            }
+        }
+    }
+    free(lpPol) ;
+    return liRet ;
+}
+
+int JShard::run(FILE *apFilOut){
+    /* Build the index once, with a diff on the whole files (its output is not used) */
+    JFileMap loOrg(mpMapOrg, mzMapOrg, "Org") ;
+    JFileMap loNew(mpMapNew, mzMapNew, "New") ;
+    JOutBin loNul(null) ;
+    JDiff loIdx(&loOrg, &loNew, &loNul, mrSet.iiHshMbt, 0,
+                mrSet.ibSrcBkt, 1, mrSet.iiMchMax, mrSet.iiMchMin,
+                mrSet.izAhdMax, mrSet.ibCmpAll, null) ;
+    int liRet = loIdx.prescan() ;
+    if (liRet < 0)
+        return liRet ;
+    JHashPos *lpHsh = loIdx.getHsh() ;
+    if (miVerbse > 0)
+        fprintf(JDebug::stddbg, "Shards: %d workers, " P8zd " bytes each.\n",
+                miShd, mpShd[0].izNewLen) ;
+
+    /* Fork the workers: pending output would be written twice */
+    fflush(apFilOut) ;
+    fflush(JDebug::stddbg) ;
+    for (int liShd = 0; liShd < miShd && liRet == 0; liShd++) {
+        rShd &lrShd = mpShd[liShd] ;
+        int liSck[2] ;
+        lrShd.ipFrg = tmpfile() ;
+        if (lrShd.ipFrg == null) {
+            liRet = EXI_OUT ;
+            break ;
+        }
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, liSck) != 0) {
+            liRet = EXI_OUT ;
+            break ;
+        }
+        lrShd.iiPid = fork() ;
+        if (lrShd.iiPid == 0) {
+            close(liSck[0]) ;
+            for (int liPrv = 0; liPrv < liShd; liPrv++)
+                close(mpShd[liPrv].iiSck) ;
+            work(lrShd, liSck[1], lpHsh) ;
+        }
+        close(liSck[1]) ;
+        if (lrShd.iiPid < 0) {
+            close(liSck[0]) ;
+            liRet = EXI_ERR ;
+            break ;
+        }
+        lrShd.iiSck = liSck[0] ;
+    }
+
+    /* Collect the fragments, then wait for the workers */
+    if (liRet == 0)
+        liRet = collect() ;
+    for (int liShd = 0; liShd < miShd; liShd++) {
+        rShd &lrShd = mpShd[liShd] ;
+        if (lrShd.iiSck >= 0)
+            close(lrShd.iiSck) ;
+        if (lrShd.iiPid <= 0)
+            continue ;
+        int liSts = -1 ;
+        while (waitpid(lrShd.iiPid, &liSts, 0) < 0 && errno == EINTR) ;
+        lrShd.iiRet = (WIFEXITED(liSts) && WEXITSTATUS(liSts) == 0) ? EXI_OK : EXI_ERR ;
+    }
+    if (liRet != 0)
+        return liRet ;
+
+    /* Split the trailers from the fragments */
+    bool lbDta = false ;
+    for (int liShd = 0; liShd < miShd; liShd++) {
+        rShd &lrShd = mpShd[liShd] ;
+        off_t lzLen = jftell(lrShd.ipFrg) ;
+        if (lrShd.iiRet == EXI_OK && lzLen >= (off_t) sizeof(rTrl)) {
+            lrShd.izFrgLen = lzLen - sizeof(rTrl) ;
+            if (jfseek(lrShd.ipFrg, lrShd.izFrgLen, SEEK_SET) != 0
+             || jfread(&lrShd.irTrl, sizeof(rTrl), 1, lrShd.ipFrg) != 1)
+                lrShd.iiRet = EXI_RED ;
+            else
+                lrShd.iiRet = (int) lrShd.irTrl.iiRet ;
+        } else {
+            lrShd.iiRet = EXI_ERR ;
+        }
+        if (miVerbse > 1 || lrShd.iiRet != EXI_OK)
+            fprintf(JDebug::stddbg, "Shard " P8zd " to " P8zd ": fragment " P8zd " (rc=%d)\n",
+                    lrShd.izNewBeg, lrShd.izNewBeg + lrShd.izNewLen, lrShd.izFrgLen, lrShd.iiRet) ;
+        if (lrShd.iiRet != EXI_OK)
+            return lrShd.iiRet ;
+        if (lrShd.irTrl.izDta > 0)
+            lbDta = true ;
+    }
+
+    /* Stitch: every fragment starts from the start of the original */
+    JOutBin loCon(apFilOut) ;
+    for (int liShd = 0; liShd < miShd; liShd++) {
+        rShd &lrShd = mpShd[liShd] ;
+        liRet = loCon.putFrg(lrShd.ipFrg, 0, lrShd.izFrgLen, 0, lrShd.irTrl.izPosOrg) ;
+        if (liRet != 0)
+            return liRet ;
+    }
+    return lbDta ? EXI_DIF : EXI_EQL ;
+}
+#endif // _WIN32
+
+} /* namespace JojoDiff */
@@ -0,0 +1,128 @@
+/*
+ * JShard.h
+ *
+ * Copyright (C) 2002-2020 Joris Heirbaut
+ *
+ * This file is part of JojoDiff.
+ *
+ * JojoDiff is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *******************************************************************************
+ * Sharded diff: a coordinator process and one worker process per shard.
+ *
+ * 1) the coordinator maps both files (see JFileMap) and builds the full index
+ *    of the original once,
+ * 2) it cuts the new file into shards of equal size and forks one worker per
+ *    shard: the workers share the mappings and the index with the coordinator
+ *    (copy-on-write, they only read them),
+ * 3) each worker diffs its shard against the whole original and sends its patch
+ *    fragment over a local socket, followed by a trailer (see rTrl),
+ * 4) the coordinator collects the fragments as they come, then stitches them
+ *    into one plain patch (see JOutBin::putFrg).
+ *
+ * The fragments travel over stream sockets: a worker only needs the original,
+ * the index and a connection, so it could as well run on another host.
+ * Not available on Windows (no fork).
+ *******************************************************************************/
+
+#ifndef JSHARD_H_
+#define JSHARD_H_
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "JDefs.h"
+#include "JDiffJob.h"
+#include "JFile.h"
+#include "JHashPos.h"
+
+namespace JojoDiff {
+
+class JShard {
+public:
+    JShard(JShard const&) = delete;
+    JShard& operator=(JShard const&) = delete;
+
+    /**
+     * @brief Create a sharded diff.
+     *
+     * @param arSet     JDiff settings (a full index is always used)
+     * @param aiShd     Number of shards (and worker processes)
+     * @param aiVerbse  Verbose level
+     */
+    JShard(JDiffJob::rSet const &arSet, int aiShd, int aiVerbse);
+
+    virtual ~JShard();
+
+    /**
+     * @brief Map both files.
+     *
+     * @param asFilOrg  Original file (a regular file)
+     * @param asFilNew  New file (a regular file)
+     * @return 0=ok, EXI_FRT/EXI_SCD when a file cannot be opened,
+     *         EXI_ARG when the files cannot be mapped (or no fork, on Windows)
+     */
+    int open(const char *asFilOrg, const char *asFilNew);
+
+    /**
+     * @brief Diff the opened files.
+     *
+     * @param apFilOut  Output patch file
+     * @return EXI_DIF when the files differ, EXI_EQL when not, error code otherwise
+     */
+    int run(FILE *apFilOut);
+
+private:
+    /**
+     * Trailer sent by a worker after its fragment
+     */
+    typedef struct {
+        int64_t izPosOrg ;      /**< original position reached by the fragment */
+        int64_t izDta ;         /**< number of data bytes (MOD/INS)         */
+        int64_t iiRet ;         /**< result of the diff                     */
+    } rTrl ;
+
+    /**
+     * One shard of the new file
+     */
+    typedef struct {
+        off_t izNewBeg ;        /**< start in the new file                  */
+        off_t izNewLen ;        /**< length                                 */
+        int   iiPid ;           /**< worker process                         */
+        int   iiSck ;           /**< coordinator's end of the socket        */
+        FILE *ipFrg ;           /**< fragment and trailer, as received      */
+        off_t izFrgLen ;        /**< length of the fragment                 */
+        rTrl  irTrl ;           /**< trailer                                */
+        int   iiRet ;           /**< result                                 */
+    } rShd ;
+
+    /** @brief Worker: diff one shard into the socket and exit */
+    void work(rShd &arShd, int aiSck, JHashPos *apHsh) ;
+
+    /** @brief Coordinator: receive the fragments of all workers */
+    int collect() ;
+
+    JDiffJob::rSet const mrSet ;    /**< Settings                           */
+    int miShd ;                     /**< Number of shards                   */
+    int const miVerbse ;            /**< Verbose level                      */
+
+    jchar *mpMapOrg = null ;        /**< Mapping of the original            */
+    off_t mzMapOrg = 0 ;            /**< Size of the original               */
+    jchar *mpMapNew = null ;        /**< Mapping of the new file            */
+    off_t mzMapNew = 0 ;            /**< Size of the new file               */
+    rShd *mpShd = null ;            /**< Shards                             */
+};
+
+} /* namespace JojoDiff */
+#endif /* JSHARD_H_ */
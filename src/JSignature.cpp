@@ -0,0 +1,355 @@
+/*
+ * JSignature.cpp
+ *
+ * Copyright (C) 2002-2020 Joris Heirbaut
+ *
+ * This file is part of JojoDiff.
+ *
+ * JojoDiff is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+using namespace std;
+
+#include "JSignature.h"
+#include "JDebug.h"
+#include "JHashPos.h"
+#include "JSha256.h"
+
+namespace JojoDiff {
+
+#define SIGHDR  16      /**< Size of the signature header                   */
+#define SIGREC  16      /**< Size of a block record (and of the trailer)    */
+#define SIGVER  1       /**< Signature version                              */
+#define SIGCHK  64      /**< Blocks with the same weak hash to check at most */
+
+/* Little endian integers */
+static void ufPut64(jchar *apBuf, uint64_t akVal){
+    for (int liByt = 0; liByt < 8; liByt++)
+        apBuf[liByt] = (jchar) (akVal >> (8 * liByt)) ;
+}
+static uint64_t ufGet64(const jchar *apBuf){
+    uint64_t lkVal = 0 ;
+    for (int liByt = 7; liByt >= 0; liByt--)
+        lkVal = (lkVal << 8) | apBuf[liByt] ;
+    return lkVal ;
+}
+
+JSignature::JSignature(int aiVerbse)
+: miVerbse(aiVerbse)
+{}
+
+JSignature::~JSignature() {
+    free(mpBlk) ;
+    free(mpWin) ;
+}
+
+/*******************************************************************************
+* Make
+*******************************************************************************/
+int JSignature::make(JFile &apFilOrg, FILE *apFilSig, int aiBlkSze){
+    jchar *lpBlk = (jchar *) malloc(aiBlkSze) ;
+    if (lpBlk == null) {
+#ifdef JDIFF_THROW_BAD_ALLOC
+        throw bad_alloc() ;
+#else
+        return EXI_MEM ;
+#endif
+    }
+
+    jchar lcRec[SIGREC] ;
+    jchar lcDig[JSha256::DIGSZE] ;
+    memset(lcRec, 0, sizeof(lcRec)) ;
+    lcRec[0] = 'J' ; lcRec[1] = 'D' ; lcRec[2] = 'S' ; lcRec[3] = SIGVER ;
+    lcRec[4] = (jchar) SMPSZE ;
+    for (int liByt = 0; liByt < 4; liByt++)
+        lcRec[8 + liByt] = (jchar) (aiBlkSze >> (8 * liByt)) ;
+    int liRet = (fwrite(lcRec, 1, SIGHDR, apFilSig) == SIGHDR) ? EXI_OK : EXI_WRI ;
+
+    /* One record per full block */
+    hkey lkHsh = 0 ;
+    int  liEql = 0, lcPrv = EOF ;
+    int  liLen = 0 ;
+    off_t lzSze = 0 ;
+    while (liRet == EXI_OK) {
+        int lcOrg = apFilOrg.get() ;
+        if (lcOrg < 0) {
+            if (lcOrg != EOF)
+                liRet = EXI_RED ;
+            break ;
+        }
+        lkHsh = JHashPos::hash(lkHsh, lcPrv, lcOrg, liEql) ;
+        lpBlk[liLen++] = (jchar) lcOrg ;
+        lzSze ++ ;
+        if (liLen == aiBlkSze) {
+            JSha256::digest(lpBlk, liLen, lcDig) ;
+            ufPut64(lcRec, (uint64_t) lkHsh) ;
+            memcpy(lcRec + 8, lcDig, 8) ;
+            if (fwrite(lcRec, 1, SIGREC, apFilSig) != SIGREC)
+                liRet = EXI_WRI ;
+            liLen = 0 ;
+        }
+    }
+
+    /* Trailer: strong hash of the partial block and size (known at the end on stdin) */
+    if (liRet == EXI_OK) {
+        memset(lcRec, 0, sizeof(lcRec)) ;
+        if (liLen > 0) {
+            JSha256::digest(lpBlk, liLen, lcDig) ;
+            memcpy(lcRec, lcDig, 8) ;
+        }
+        ufPut64(lcRec + 8, (uint64_t) lzSze) ;
+        if (fwrite(lcRec, 1, SIGREC, apFilSig) != SIGREC)
+            liRet = EXI_WRI ;
+    }
+    free(lpBlk) ;
+
+    if (miVerbse > 0 && liRet == EXI_OK)
+        fprintf(JDebug::stddbg, "Signature: " P8zd " blocks of %d bytes for " P8zd " bytes.\n",
+                lzSze / aiBlkSze, aiBlkSze, lzSze) ;
+    return liRet ;
+}
+
+/*******************************************************************************
+* Load
+*******************************************************************************/
+int JSignature::cmp(const void *apOne, const void *apTwo){
+    const rBlk *lpOne = (const rBlk *) apOne ;
+    const rBlk *lpTwo = (const rBlk *) apTwo ;
+    if (lpOne->ikWek != lpTwo->ikWek)
+        return (lpOne->ikWek < lpTwo->ikWek) ? -1 : 1 ;
+    if (lpOne->izBlk != lpTwo->izBlk)
+        return (lpOne->izBlk < lpTwo->izBlk) ? -1 : 1 ;
+    return 0 ;
+}
+
+int JSignature::load(FILE *apFilSig){
+    jchar lcRec[SIGREC] ;
+    if (fread(lcRec, 1, SIGHDR, apFilSig) != SIGHDR
+     || lcRec[0] != 'J' || lcRec[1] != 'D' || lcRec[2] != 'S' || lcRec[3] != SIGVER)
+        return EXI_FRT ;
+    if (lcRec[4] != SMPSZE) {
+        fprintf(JDebug::stddbg, "Signature made with %d-bit hashes, this jdiff uses %d-bit hashes.\n",
+                lcRec[4], SMPSZE) ;
+        return EXI_FRT ;
+    }
+    miBlkSze = lcRec[8] | lcRec[9] << 8 | lcRec[10] << 16 | lcRec[11] << 24 ;
+    if (miBlkSze < BLKMIN)
+        return EXI_FRT ;
+
+    /* Read the records (the size is in the trailer) */
+    off_t lzMax = 0 ;
+    off_t lzCnt = 0 ;
+    for (;;) {
+        size_t llLen = fread(lcRec, 1, SIGREC, apFilSig) ;
+        if (llLen == 0)
+            break ;
+        if (llLen != SIGREC)
+            return EXI_FRT ;
+        if (lzCnt == lzMax) {
+            lzMax = (lzMax == 0) ? 1024 : lzMax * 2 ;
+            rBlk *lpBlk = (rBlk *) realloc(mpBlk, lzMax * sizeof(rBlk)) ;
+            if (lpBlk == null) {
+#ifdef JDIFF_THROW_BAD_ALLOC
+                throw bad_alloc() ;
+#else
+                return EXI_MEM ;
+#endif
+            }
+            mpBlk = lpBlk ;
+        }
+        mpBlk[lzCnt].ikWek = ufGet64(lcRec) ;
+        mpBlk[lzCnt].ikStr = ufGet64(lcRec + 8) ;
+        mpBlk[lzCnt].izBlk = lzCnt ;
+        lzCnt ++ ;
+    }
+    if (ferror(apFilSig))
+        return EXI_RED ;
+    if (lzCnt == 0)
+        return EXI_FRT ;
+
+    /* Trailer */
+    mkTal = mpBlk[lzCnt - 1].ikWek ;
+    mzOrgSze = (off_t) mpBlk[lzCnt - 1].ikStr ;
+    mzBlkCnt = lzCnt - 1 ;
+    if (mzOrgSze < 0 || mzOrgSze / miBlkSze != mzBlkCnt)
+        return EXI_FRT ;
+
+    qsort(mpBlk, mzBlkCnt, sizeof(rBlk), cmp) ;
+    return EXI_OK ;
+}
+
+/*******************************************************************************
+* Delta
+*******************************************************************************/
+uint64_t JSignature::strong(off_t azBeg, int aiLen) const {
+    JSha256 loSha ;
+    jchar lcDig[JSha256::DIGSZE] ;
+    int liIdx = (int) (azBeg % miBlkSze) ;
+    int liOne = (aiLen < miBlkSze - liIdx) ? aiLen : miBlkSze - liIdx ;
+    loSha.update(mpWin + liIdx, liOne) ;
+    if (liOne < aiLen)
+        loSha.update(mpWin, aiLen - liOne) ;
+    loSha.final(lcDig) ;
+    return ufGet64(lcDig) ;
+}
+
+const JSignature::rBlk *JSignature::find(uint64_t akWek, off_t azPrf) const {
+    /* First block at or after (akWek, azPrf) */
+    off_t lzLow = 0, lzHig = mzBlkCnt ;
+    while (lzLow < lzHig) {
+        off_t lzMid = lzLow + (lzHig - lzLow) / 2 ;
+        const rBlk &lrMid = mpBlk[lzMid] ;
+        if (lrMid.ikWek < akWek || (lrMid.ikWek == akWek && lrMid.izBlk < azPrf))
+            lzLow = lzMid + 1 ;
+        else
+            lzHig = lzMid ;
+    }
+    return (lzLow < mzBlkCnt && mpBlk[lzLow].ikWek == akWek) ? &mpBlk[lzLow] : null ;
+}
+
+void JSignature::putDta(int acNew){
+    /* MOD must stay within the original */
+    if (mzPosOrg >= mzOrgSze) {
+        mpOut->put(INS, 1, 0, acNew, mzPosOrg, mzPosNew) ;
+    } else {
+        mpOut->put(MOD, 1, 0, acNew, mzPosOrg, mzPosNew) ;
+        mzPosOrg ++ ;
+    }
+    mzPosNew ++ ;
+    mbEql = false ;
+}
+
+void JSignature::putEql(off_t azOrg, off_t azBeg, int aiLen){
+    if (azOrg > mzPosOrg) {
+        mpOut->put(DEL, azOrg - mzPosOrg, 0, 0, mzPosOrg, mzPosNew) ;
+        mbEql = false ;
+    } else if (azOrg < mzPosOrg) {
+        mpOut->put(BKT, mzPosOrg - azOrg, 0, 0, mzPosOrg, mzPosNew) ;
+        mbEql = false ;
+    }
+    mzPosOrg = azOrg ;
+
+    /* Byte by byte until the output accepts a length */
+    for (int liPos = 0; liPos < aiLen; liPos++) {
+        if (mbEql) {
+            mpOut->put(EQL, aiLen - liPos, 0, 0, mzPosOrg, mzPosNew) ;
+            mzPosOrg += aiLen - liPos ;
+            mzPosNew += aiLen - liPos ;
+            break ;
+        }
+        int lcEql = mpWin[(azBeg + liPos) % miBlkSze] ;
+        mbEql = mpOut->put(EQL, 1, lcEql, lcEql, mzPosOrg, mzPosNew) ;
+        mzPosOrg ++ ;
+        mzPosNew ++ ;
+    }
+}
+
+int JSignature::delta(JFile &apFilNew, JOut &apOut){
+    mpWin = (jchar *) malloc(miBlkSze) ;
+    if (mpWin == null) {
+#ifdef JDIFF_THROW_BAD_ALLOC
+        throw bad_alloc() ;
+#else
+        return EXI_MEM ;
+#endif
+    }
+    mpOut = &apOut ;
+    mzPosOrg = 0 ;
+    mzPosNew = 0 ;
+    mbEql = false ;
+
+    hkey lkHsh = 0 ;
+    int  liEql = 0, lcPrv = EOF ;
+    off_t lzRed = 0 ;           // bytes read from the new file
+    off_t lzOut = 0 ;           // bytes output (the others are in the window)
+    uint64_t lkFal = 0 ;        // weak hash of the last failed strong check
+    off_t lzFal = - miBlkSze ;  // and its position
+    off_t lzMch = 0 ;           // number of matched blocks
+    int liRet = EXI_OK ;
+    for (;;) {
+        int lcNew = apFilNew.get() ;
+        if (lcNew < 0) {
+            if (lcNew != EOF)
+                liRet = EXI_RED ;
+            break ;
+        }
+
+        /* The byte leaving the window was not matched: output as data */
+        int liIdx = (int) (lzRed % miBlkSze) ;
+        if (lzRed - lzOut == miBlkSze) {
+            putDta(mpWin[liIdx]) ;
+            lzOut ++ ;
+        }
+        mpWin[liIdx] = (jchar) lcNew ;
+        lzRed ++ ;
+        lkHsh = JHashPos::hash(lkHsh, lcPrv, lcNew, liEql) ;
+
+        /* A full window of unmatched bytes: look for a block ending here */
+        if (lzRed - lzOut < miBlkSze)
+            continue ;
+        uint64_t lkWek = (uint64_t) lkHsh ;
+        if (lkWek == lkFal && lzRed - lzFal < miBlkSze)
+            continue ;      // same samples, same failure (e.g. within a run)
+        const rBlk *lpBlk = find(lkWek, 0) ;
+        if (lpBlk == null)
+            continue ;
+        uint64_t lkStr = strong(lzOut, miBlkSze) ;
+        off_t lzPrf = (mzPosOrg + miBlkSze - 1) / miBlkSze ;
+        const rBlk *lpFnd = find(lkWek, lzPrf) ;
+        if (lpFnd == null || lpFnd->izBlk != lzPrf || lpFnd->ikStr != lkStr) {
+            /* Not the next block of the original (which needs no DEL or BKT) */
+            lpFnd = null ;
+            const rBlk *lpEnd = mpBlk + mzBlkCnt ;
+            for (int liChk = 0; lpBlk < lpEnd && lpBlk->ikWek == lkWek && liChk < SIGCHK; lpBlk++, liChk++) {
+                if (lpBlk->ikStr == lkStr) {
+                    lpFnd = lpBlk ;
+                    break ;
+                }
+            }
+        }
+        if (lpFnd == null) {
+            lkFal = lkWek ;
+            lzFal = lzRed ;
+            continue ;
+        }
+        putEql(lpFnd->izBlk * miBlkSze, lzOut, miBlkSze) ;
+        lzOut = lzRed ;
+        lzMch ++ ;
+    }
+    if (liRet != EXI_OK)
+        return liRet ;
+
+    /* The partial block at the end of the original */
+    int liTal = (int) (mzOrgSze - mzBlkCnt * miBlkSze) ;
+    if (liTal > 0 && lzRed - lzOut >= liTal && strong(lzRed - liTal, liTal) == mkTal) {
+        for (; lzOut < lzRed - liTal; lzOut++)
+            putDta(mpWin[lzOut % miBlkSze]) ;
+        putEql(mzBlkCnt * miBlkSze, lzOut, liTal) ;
+        lzOut = lzRed ;
+        lzMch ++ ;
+    }
+    for (; lzOut < lzRed; lzOut++)
+        putDta(mpWin[lzOut % miBlkSze]) ;
+    mpOut->put(ESC, 0, 0, 0, mzPosOrg, mzPosNew) ;
+
+    if (miVerbse > 0)
+        fprintf(JDebug::stddbg, "Signature: " P8zd " of " P8zd " blocks found in " P8zd " bytes.\n",
+                lzMch, mzBlkCnt + (liTal > 0 ? 1 : 0), lzRed) ;
+    return (apOut.gzOutBytDta > 0) ? EXI_DIF : EXI_EQL ;
+}
+
+} /* namespace JojoDiff */
@@ -0,0 +1,149 @@
+/*
+ * JSignature.h
+ *
+ * Copyright (C) 2002-2020 Joris Heirbaut
+ *
+ * This file is part of JojoDiff.
+ *
+ * JojoDiff is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *******************************************************************************
+ * Signature-based (remote) diff, as rsync does.
+ *
+ * 1) make: where the original lives, cut it into blocks of a fixed size and
+ *    write for each block
+ *    - a weak hash: the value of the rolling hash of JHashPos::hash on the last
+ *      byte of the block (the rolling hash runs over the whole original),
+ *    - a strong hash: the first 8 bytes of the SHA-256 of the block,
+ * 2) delta: where the new file lives, roll the same hash over the new file.
+ *    When the last block-size bytes have the weak hash of a block, compare the
+ *    strong hashes: equal blocks become EQL operations, other bytes become data.
+ *
+ * The rolling hash only depends on the last 2 x SMPSZE bytes, so it can be
+ * compared between both files at any position, provided blocks are at least
+ * that large.
+ *
+ * Signature file (integers in little endian):
+ *    0  'J' 'D' 'S' version         4 bytes
+ *    4  SMPSZE of the weak hash     1 byte (hashes of 32 and 64 bits differ)
+ *    5  reserved                    3 bytes
+ *    8  block size                  4 bytes
+ *   12  reserved                    4 bytes
+ *   16  per full block: weak hash (8 bytes) and strong hash (8 bytes)
+ *   ..  trailer: strong hash of the last partial block (8 bytes, 0 if none)
+ *       and size of the original (8 bytes): the size comes last so that
+ *       the original can be read from stdin.
+ *
+ * The result of delta is a standard patch that jdiff -u applies on the original.
+ *******************************************************************************/
+
+#ifndef JSIGNATURE_H_
+#define JSIGNATURE_H_
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "JDefs.h"
+#include "JFile.h"
+#include "JOut.h"
+
+namespace JojoDiff {
+
+class JSignature {
+public:
+    static const int BLKDEF = 2048 ;        /**< Default block size             */
+    static const int BLKMIN = 2 * SMPSZE ;  /**< Smallest block size            */
+
+    JSignature(JSignature const&) = delete;
+    JSignature& operator=(JSignature const&) = delete;
+
+    /**
+     * @brief Create a signature handler.
+     *
+     * @param aiVerbse  Verbose level
+     */
+    JSignature(int aiVerbse);
+
+    virtual ~JSignature();
+
+    /**
+     * @brief Write the signature of the original (read sequentially).
+     *
+     * @param apFilOrg  Original file
+     * @param apFilSig  Output signature file
+     * @param aiBlkSze  Block size (at least BLKMIN)
+     * @return EXI_OK, EXI_WRI or EXI_RED
+     */
+    int make(JFile &apFilOrg, FILE *apFilSig, int aiBlkSze);
+
+    /**
+     * @brief Read a signature.
+     *
+     * @param apFilSig  Signature file
+     * @return EXI_OK, EXI_FRT (not a signature), EXI_RED or EXI_MEM
+     */
+    int load(FILE *apFilSig);
+
+    /**
+     * @brief Write the patch from the loaded signature to the new file (read sequentially).
+     *
+     * @param apFilNew  New file
+     * @param apOut     Output patch
+     * @return EXI_DIF when the files differ, EXI_EQL when not, error code otherwise
+     */
+    int delta(JFile &apFilNew, JOut &apOut);
+
+private:
+    /**
+     * One block of the original
+     */
+    typedef struct {
+        uint64_t ikWek ;        /**< weak (rolling) hash                    */
+        uint64_t ikStr ;        /**< strong hash                            */
+        off_t    izBlk ;        /**< block number                           */
+    } rBlk ;
+
+    /** @brief Sort order of the blocks: weak hash, then block number */
+    static int cmp(const void *apOne, const void *apTwo) ;
+
+    /** @brief First 8 bytes of the SHA-256 of a block, read from the window */
+    uint64_t strong(off_t azBeg, int aiLen) const ;
+
+    /** @brief First block with the given weak hash and a number of at least azPrf */
+    const rBlk *find(uint64_t akWek, off_t azPrf) const ;
+
+    /** @brief Output one byte of data */
+    void putDta(int acNew) ;
+
+    /** @brief Output aiLen bytes equal to the original at azOrg, from new file position azBeg (in the window) */
+    void putEql(off_t azOrg, off_t azBeg, int aiLen) ;
+
+    int const miVerbse ;            /**< Verbose level                      */
+
+    int miBlkSze = 0 ;              /**< Block size                         */
+    off_t mzOrgSze = 0 ;            /**< Size of the original               */
+    off_t mzBlkCnt = 0 ;            /**< Number of full blocks              */
+    uint64_t mkTal = 0 ;            /**< Strong hash of the partial block   */
+    rBlk *mpBlk = null ;            /**< Blocks, by weak hash               */
+
+    /* Delta state */
+    JOut *mpOut = null ;            /**< Output patch                       */
+    jchar *mpWin = null ;           /**< Last block-size bytes of the new file */
+    off_t mzPosOrg = 0 ;            /**< Position on the original           */
+    off_t mzPosNew = 0 ;            /**< Position on the new file (output)  */
+    bool mbEql = false ;            /**< Equal bytes may be sent in bulk ?  */
+};
+
+} /* namespace JojoDiff */
+#endif /* JSIGNATURE_H_ */
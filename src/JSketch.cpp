@@ -0,0 +1,240 @@
+/*
+ * JSketch.cpp
+ *
+ * Copyright (C) 2002-2020 Joris Heirbaut
+ *
+ * This file is part of JojoDiff.
+ *
+ * JojoDiff is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+using namespace std;
+
+#include "JSketch.h"
+#include "JHashPos.h"
+
+namespace JojoDiff {
+
+static const char gcSkhMgc[4] = {'J', 'S', 'K', '1'};   /**< Cache file magic */
+
+/**
+ * Cache file header
+ */
+typedef struct {
+    char  icMgc[4] ;        /**< magic: JSK1                    */
+    int   iiSmp ;           /**< sample size (SMPSZE)           */
+    int   iiSze ;           /**< sketch size (k)                */
+    int   iiCnt ;           /**< number of sample values        */
+    long long ilFilSze ;    /**< size of the sketched file      */
+    long long ilFilTim ;    /**< mtime of the sketched file     */
+} rSkhHdr ;
+
+/**
+ * @brief Scramble a hash value, so that the smallest values are spread over the file.
+ *
+ * The rolling hash of JHashPos is dominated by the last bytes of the sample in its
+ * low-order bits, so ordering on the raw value would favour certain byte values.
+ */
+static inline skey mix(skey akVal){
+    akVal ^= akVal >> 30 ;
+    akVal *= 0xbf58476d1ce4e5b9ULL ;
+    akVal ^= akVal >> 27 ;
+    akVal *= 0x94d049bb133111ebULL ;
+    akVal ^= akVal >> 31 ;
+    return akVal ;
+}
+
+JSketch::JSketch(int aiSze)
+: miSze(aiSze < 16 ? 16 : aiSze)
+{
+    mkVal = (skey *) malloc(miSze * sizeof(skey)) ;
+    #ifdef JDIFF_THROW_BAD_ALLOC
+      if ( mkVal == null ) {
+          throw bad_alloc() ;
+      }
+    #endif // JDIFF_THROW_BAD_ALLOC
+}
+
+JSketch::~JSketch() {
+    free(mkVal);
+    mkVal = null ;
+}
+
+/**
+ * Insert into the sorted array of values. The array is full most of the time
+ * and new values rarely beat the current maximum, so a binary search followed
+ * by a memmove is cheap enough.
+ */
+void JSketch::add(skey akVal){
+    if (miCnt == miSze && akVal >= mkVal[miCnt - 1])
+        return ;
+
+    int liLow = 0 ;
+    int liHig = miCnt ;
+    while (liLow < liHig) {
+        int liMid = (liLow + liHig) / 2 ;
+        if (mkVal[liMid] < akVal)
+            liLow = liMid + 1 ;
+        else
+            liHig = liMid ;
+    }
+    if (liLow < miCnt && mkVal[liLow] == akVal)
+        return ;    // already present
+
+    if (miCnt < miSze)
+        miCnt ++ ;
+    memmove(&mkVal[liLow + 1], &mkVal[liLow], (miCnt - 1 - liLow) * sizeof(skey)) ;
+    mkVal[liLow] = akVal ;
+}
+
+/**
+ * Scan the file the same way JDiff::buildFullIndex does.
+ */
+int JSketch::build(JFile * const apFil){
+    hkey  lkHsh=0;      // Current hash value
+    int   liEql=0;      // Number of times current value occurs in hash value
+    int   lcVal=0;      // Current  file value
+    int   lcPrv=EOF;    // Previous file value
+    off_t lzPos=-1;     // Position within file
+
+    miCnt = 0 ;
+
+    /* Read SMPSZE-1 bytes (31 or 63) to initialize the hash function */
+    for (int liIdx=0; (liIdx < SMPSZE - 1); liIdx++) {
+        lcVal = apFil->get(++ lzPos, JFile::HardAhead);
+        if (lcVal <= EOF)
+            break ;
+        lkHsh = JHashPos::hash(lkHsh, lcPrv, lcVal, liEql) ;
+    }
+
+    /* Sample the remainder */
+    while (lcVal > EOF) {
+        lcVal = apFil->get(++ lzPos, JFile::HardAhead);
+        if (lcVal <= EOF)
+            break ;
+        lkHsh = JHashPos::hash(lkHsh, lcPrv, lcVal, liEql) ;
+        if (liEql < SMPSZE)
+            add(mix(lkHsh)) ;
+    }
+    mzFilSze = lzPos ;
+
+    if (lcVal < EOB)
+        return EXI_RED ;
+    else
+        return 0 ;
+}
+
+bool JSketch::load(const char *asFilNam, off_t azFilSze, time_t alFilTim){
+    rSkhHdr lrHdr ;
+    bool lbRet = false ;
+
+    FILE *lfFil = jfopen(asFilNam, "rb") ;
+    if (lfFil == null)
+        return false ;
+    if (jfread(&lrHdr, sizeof(lrHdr), 1, lfFil) == 1
+        && memcmp(lrHdr.icMgc, gcSkhMgc, sizeof(gcSkhMgc)) == 0
+        && lrHdr.iiSmp == SMPSZE
+        && lrHdr.iiSze == miSze
+        && lrHdr.iiCnt >= 0 && lrHdr.iiCnt <= miSze
+        && lrHdr.ilFilSze == (long long) azFilSze
+        && lrHdr.ilFilTim == (long long) alFilTim
+        && (lrHdr.iiCnt == 0 || jfread(mkVal, sizeof(skey), lrHdr.iiCnt, lfFil) == (size_t) lrHdr.iiCnt)) {
+        miCnt = lrHdr.iiCnt ;
+        mzFilSze = azFilSze ;
+        lbRet = true ;
+    }
+    jfclose(lfFil) ;
+    return lbRet ;
+}
+
+bool JSketch::save(const char *asFilNam, time_t alFilTim) const {
+    rSkhHdr lrHdr ;
+    memset(&lrHdr, 0, sizeof(lrHdr)) ;
+    memcpy(lrHdr.icMgc, gcSkhMgc, sizeof(gcSkhMgc)) ;
+    lrHdr.iiSmp = SMPSZE ;
+    lrHdr.iiSze = miSze ;
+    lrHdr.iiCnt = miCnt ;
+    lrHdr.ilFilSze = mzFilSze ;
+    lrHdr.ilFilTim = alFilTim ;
+
+    FILE *lfFil = jfopen(asFilNam, "wb") ;
+    if (lfFil == null)
+        return false ;
+    bool lbRet = fwrite(&lrHdr, sizeof(lrHdr), 1, lfFil) == 1
+              && (miCnt == 0 || fwrite(mkVal, sizeof(skey), miCnt, lfFil) == (size_t) miCnt) ;
+    if (jfclose(lfFil) != 0)
+        lbRet = false ;
+    if (! lbRet)
+        remove(asFilNam) ;
+    return lbRet ;
+}
+
+/**
+ * Only the values of this sketch below the threshold of the other sketch can be
+ * checked: above it, the other sketch does not tell whether the value is present
+ * or not. A complete sketch (less than k samples) has no threshold.
+ */
+double JSketch::containment(JSketch const &arOth) const {
+    int liTot = 0 ;     // values of this sketch that can be checked
+    int liFnd = 0 ;     // values also found in the other sketch
+    int liOth = 0 ;
+
+    for (int liIdx = 0; liIdx < miCnt; liIdx++) {
+        if (! arOth.isComplete() && mkVal[liIdx] > arOth.mkVal[arOth.miCnt - 1])
+            break ;
+        liTot ++ ;
+        while (liOth < arOth.miCnt && arOth.mkVal[liOth] < mkVal[liIdx])
+            liOth ++ ;
+        if (liOth < arOth.miCnt && arOth.mkVal[liOth] == mkVal[liIdx])
+            liFnd ++ ;
+    }
+    if (liTot == 0)
+        return (miCnt == 0) ? 1.0 : 0.0 ;
+    return (double) liFnd / liTot ;
+}
+
+/**
+ * Bottom-k estimator: take the k smallest values of the union of both sketches
+ * and count how many of them belong to both.
+ */
+double JSketch::similarity(JSketch const &arOth) const {
+    int liMax = (miCnt < arOth.miCnt) ? miCnt : arOth.miCnt ;
+    if (isComplete() && arOth.isComplete())
+        liMax = miCnt + arOth.miCnt ;   // the union is known completely
+    int liTot = 0 ;
+    int liFnd = 0 ;
+    int liOne = 0 ;
+    int liTwo = 0 ;
+
+    while (liTot < liMax && (liOne < miCnt || liTwo < arOth.miCnt)) {
+        if (liTwo >= arOth.miCnt || (liOne < miCnt && mkVal[liOne] < arOth.mkVal[liTwo])) {
+            liOne ++ ;
+        } else if (liOne >= miCnt || arOth.mkVal[liTwo] < mkVal[liOne]) {
+            liTwo ++ ;
+        } else {
+            liFnd ++ ;
+            liOne ++ ;
+            liTwo ++ ;
+        }
+        liTot ++ ;
+    }
+    if (liTot == 0)
+        return (miCnt == arOth.miCnt) ? 1.0 : 0.0 ;
+    return (double) liFnd / liTot ;
+}
+
+} /* namespace JojoDiff */
@@ -0,0 +1,134 @@
+/*
+ * JSketch.h
+ *
+ * Copyright (C) 2002-2020 Joris Heirbaut
+ *
+ * This file is part of JojoDiff.
+ *
+ * JojoDiff is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *******************************************************************************
+ * Content sketch of a file (bottom-k min-hash).
+ *
+ * A sketch keeps the k smallest distinct sample values of a file, where a sample
+ * value is the JHashPos::hash of the SMPSZE bytes ending at a given position,
+ * scrambled by a mixing function so that the retained samples are spread
+ * uniformly over the file. Samples consisting of a long run of equal bytes
+ * (aiEql == SMPSZE) are ignored, like JHashPos ignores them when colliding:
+ * they would otherwise make all padded files look alike.
+ *
+ * Two sketches allow to estimate, without reading the files again:
+ * - containment: the fraction of samples of one file found in the other,
+ *   which is what matters to JDiff (large bases containing the new file are good),
+ * - similarity:  the Jaccard resemblance of both sample sets.
+ *
+ * Sketches can be saved to and loaded from a small cache file, so that a
+ * library of candidate bases only has to be scanned once.
+ *******************************************************************************/
+
+#ifndef JSKETCH_H_
+#define JSKETCH_H_
+
+#include <time.h>
+
+#include "JDefs.h"
+#include "JFile.h"
+
+namespace JojoDiff {
+
+typedef unsigned long long int skey ;   /**< 64-bit sketch values (independent of hkey size) */
+
+class JSketch {
+public:
+    JSketch(JSketch const&) = delete;
+    JSketch& operator=(JSketch const&) = delete;
+
+    /**
+     * @brief Create an empty sketch.
+     *
+     * @param aiSze     maximum number of samples to keep (k)
+     */
+    JSketch(int aiSze = 1024);
+
+    virtual ~JSketch();
+
+    /**
+     * @brief Scan the given file from start to end and fill up the sketch.
+     *
+     * @param apFil     File to scan
+     * @return 0=ok, EXI_RED in case of a read error
+     */
+    int build(JFile * const apFil);
+
+    /**
+     * @brief Load the sketch from a cache file.
+     *
+     * The cache is only accepted when it has been made with the same sketch size and
+     * sample size for a file with given size and modification time.
+     *
+     * @param asFilNam  Name of the cache file
+     * @param azFilSze  Expected size of the sketched file
+     * @param alFilTim  Expected modification time of the sketched file
+     * @return true=loaded, false=cache not found or outdated
+     */
+    bool load(const char *asFilNam, off_t azFilSze, time_t alFilTim);
+
+    /**
+     * @brief Save the sketch to a cache file.
+     *
+     * @param asFilNam  Name of the cache file
+     * @param alFilTim  Modification time of the sketched file
+     * @return true=saved, false=could not write cache
+     */
+    bool save(const char *asFilNam, time_t alFilTim) const;
+
+    /**
+     * @brief Estimate the fraction of this file's samples that are also present in the other file.
+     *
+     * @param arOth     Sketch of the other file (e.g. a candidate base)
+     * @return 0.0 (nothing in common) to 1.0 (all samples found)
+     */
+    double containment(JSketch const &arOth) const;
+
+    /**
+     * @brief Estimate the resemblance (Jaccard index) of both files.
+     *
+     * @param arOth     Sketch of the other file
+     * @return 0.0 (nothing in common) to 1.0 (same samples)
+     */
+    double similarity(JSketch const &arOth) const;
+
+    /* getters */
+    off_t getSze() const {return mzFilSze;}     /**< size of the sketched file      */
+    int getCnt() const {return miCnt;}          /**< number of samples in sketch   */
+
+private:
+    /**
+     * @brief Add a sample value to the sketch (if among the k smallest)
+     */
+    void add(skey akVal);
+
+    /**
+     * @brief Is the sketch complete, i.e. holding all distinct samples of the file ?
+     */
+    bool isComplete() const {return miCnt < miSze;}
+
+    int const miSze ;           /**< Maximum number of samples (k)              */
+    int miCnt=0 ;               /**< Actual number of samples                   */
+    skey *mkVal=null ;          /**< Sorted sample values (ascending)           */
+    off_t mzFilSze=0 ;          /**< Size of the sketched file                  */
+};
+
+} /* namespace JojoDiff */
+#endif /* JSKETCH_H_ */
@@ -0,0 +1,138 @@
+/*
+ * JSpeculate.cpp
+ *
+ * Copyright (C) 2002-2020 Joris Heirbaut
+ *
+ * This file is part of JojoDiff.
+ *
+ * JojoDiff is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <new>
+using namespace std;
+
+#include "JSpeculate.h"
+
+namespace JojoDiff {
+
+JSpeculate::JSpeculate(JHashPos const * const apHsh, JFile * const apFil)
+: mpHsh(apHsh), mpFil(apFil), mzPub(0), mbWai(false), mbStp(false)
+{
+    mpRng = new rEnt[SPCSZE] ;
+    for (int liIdx = 0; liIdx < SPCSZE; liIdx++) {
+        mpRng[liIdx].izPos.store(-1, memory_order_relaxed) ;
+        mpRng[liIdx].ikHsh.store(0, memory_order_relaxed) ;
+        mpRng[liIdx].izOrg.store(-1, memory_order_relaxed) ;
+    }
+    moThr = thread(&JSpeculate::run, this) ;
+}
+
+JSpeculate::~JSpeculate()
+{
+    {
+        lock_guard<mutex> loLck(moMtx) ;
+        mbStp.store(true) ;
+        moCnd.notify_one() ;
+    }
+    if (moThr.joinable())
+        moThr.join() ;
+    delete [] mpRng ;
+}
+
+/*******************************************************************************
+* Helper thread
+*******************************************************************************/
+void JSpeculate::wait(const off_t azPub)
+{
+    unique_lock<mutex> loLck(moMtx) ;
+    mbWai.store(true) ;
+    moCnd.wait(loLck, [&]{ return mbStp || mzPub.load() != azPub ; }) ;
+    mbWai.store(false) ;
+}
+
+void JSpeculate::run()
+{
+    off_t lzPos = -1 ;      // last position hashed
+    hkey  lkHsh = 0 ;       // current hash value
+    int   liEql = 0 ;       // equal-chars count
+    int   lcPrv = EOF ;     // previous file value
+    int   liSkp = 0 ;       // bytes to hash before the hash is valid
+    bool  lbEof = false ;   // end of file (or error) reached ?
+
+    off_t lzBatPos[SPCBAT] ;
+    hkey  lkBatHsh[SPCBAT] ;
+
+    for (;;) {
+        if (mbStp.load())
+            return ;
+
+        /* Restart at the published position when behind */
+        off_t lzNew = mzPub.load() ;
+        if (lzPos + 1 < lzNew) {
+            lzPos = lzNew - (SMPSZE * 2 - 1) ;
+            if (lzPos <= 0) {
+                lzPos = 0 ;
+                liSkp = SMPSZE - 1 ;        // initialize the hash (liEql=0 is correct)
+            } else {
+                liSkp = SMPSZE * 2 - 1 ;    // initialize the hash and liEql
+            }
+            lzPos -- ;  // switch to pre-increments
+            lkHsh = 0 ;
+            liEql = 0 ;
+            lcPrv = EOF ;
+            lbEof = false ;
+        } else if (lbEof || lzPos >= lzNew + SPCSZE) {
+            /* Nothing left to speculate: wait for JDiff to advance */
+            wait(lzNew) ;
+            continue ;
+        }
+
+        /* Hash a batch of samples and prefetch their index elements */
+        int liCnt = 0 ;
+        while (liCnt < SPCBAT) {
+            int lcVal = mpFil->get(lzPos + 1, JFile::Read) ;
+            if (lcVal <= EOF) {
+                lbEof = true ;
+                break ;
+            }
+            lzPos ++ ;
+            lkHsh = JHashPos::hash(lkHsh, lcPrv, lcVal, liEql) ;
+            if (liSkp > 0) {
+                liSkp -- ;
+            } else if (liEql < JHashPos::RUNEQL) {
+                // samples within runs are looked up in the run index by JDiff
+                mpHsh->prefetch(lkHsh) ;
+                lzBatPos[liCnt] = lzPos ;
+                lkBatHsh[liCnt] = lkHsh ;
+                liCnt ++ ;
+            }
+        }
+
+        /* Lookup the batch and publish the results in the ring */
+        for (int liIdx = 0; liIdx < liCnt; liIdx++) {
+            off_t lzOrg ;
+            if (! mpHsh->get(lkBatHsh[liIdx], lzOrg))
+                lzOrg = -1 ;
+            rEnt &lrEnt = mpRng[lzBatPos[liIdx] & SPCMSK] ;
+            lrEnt.izPos.store(-1, memory_order_relaxed) ;
+            atomic_thread_fence(memory_order_release) ;
+            lrEnt.ikHsh.store(lkBatHsh[liIdx], memory_order_relaxed) ;
+            lrEnt.izOrg.store(lzOrg, memory_order_relaxed) ;
+            lrEnt.izPos.store(lzBatPos[liIdx], memory_order_release) ;
+        }
+    }
+}
+
+} /* namespace JojoDiff */
@@ -0,0 +1,154 @@
+/*
+ * JSpeculate.h
+ *
+ * Copyright (C) 2002-2020 Joris Heirbaut
+ *
+ * This file is part of JojoDiff.
+ *
+ * JojoDiff is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *******************************************************************************
+ * Speculative index lookups on a helper thread (--speculate).
+ *
+ * Most of the time of a search goes to index lookups: the global index spans
+ * tens of megabytes, so nearly every lookup is a cache miss. While JDiff
+ * compares equal regions, or searches, a helper thread reads the new file
+ * ahead of the position published by JDiff, hashes it and looks up the samples
+ * in the index, in batches of SPCBAT prefetched lookups.
+ *
+ * Results go to a ring of SPCSZE (position, key, original position) entries.
+ * When JDiff hashes a position of the new file, it first looks for that
+ * position and key in the ring: on a match, the lookup is done; otherwise
+ * (the helper was not there yet, or a different key) JDiff looks up the index
+ * itself. Speculation beyond the next difference is simply never used.
+ *
+ * The index must not change while the helper is running: it is only started
+ * after a full prescan. The helper reads the new file through its own JFile.
+ *******************************************************************************/
+
+#ifndef JSPECULATE_H_
+#define JSPECULATE_H_
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "JDefs.h"
+#include "JFile.h"
+#include "JHashPos.h"
+
+namespace JojoDiff {
+
+class JSpeculate {
+public:
+    JSpeculate(JSpeculate const&) = delete;
+    JSpeculate& operator=(JSpeculate const&) = delete;
+
+    /**
+     * @brief Start the helper thread.
+     *
+     * @param apHsh     Index to lookup (must not change anymore)
+     * @param apFil     Own reader on the new file (not shared with JDiff)
+     */
+    JSpeculate(JHashPos const * const apHsh, JFile * const apFil);
+
+    /** Stops the helper thread */
+    virtual ~JSpeculate();
+
+    /**
+     * @brief Publish the position from where JDiff needs lookups on the new file.
+     *
+     * The helper restarts from this position when it is behind, and speculates
+     * up to SPCSZE bytes beyond it.
+     */
+    inline void publish (const off_t azPos) {
+        mzPub.store(azPos) ;
+        if (mbWai.load()) {
+            std::lock_guard<std::mutex> loLck(moMtx) ;
+            moCnd.notify_one() ;
+        }
+    }
+
+    /**
+     * @brief Get a speculative lookup.
+     *
+     * @param azPos     in:  position on the new file
+     * @param akHsh     in:  key at that position
+     * @param abHit     out: key found in the index ?
+     * @param azOrg     out: position in the original file (when found)
+     * @return true = lookup available, false = lookup the index yourself
+     */
+    inline bool get (const off_t azPos, const hkey akHsh, bool &abHit, off_t &azOrg) {
+        rEnt &lrEnt = mpRng[azPos & SPCMSK] ;
+        if (lrEnt.izPos.load(std::memory_order_acquire) != azPos)
+            return false ;
+        hkey lkHsh = lrEnt.ikHsh.load(std::memory_order_relaxed) ;
+        off_t lzOrg = lrEnt.izOrg.load(std::memory_order_relaxed) ;
+        std::atomic_thread_fence(std::memory_order_acquire) ;
+        if (lrEnt.izPos.load(std::memory_order_relaxed) != azPos || lkHsh != akHsh)
+            return false ;
+
+        mzUse ++ ;
+        abHit = (lzOrg >= 0) ;
+        if (abHit) {
+            mzHit ++ ;
+            azOrg = lzOrg ;
+        }
+        return true ;
+    }
+
+    /* statistics */
+    off_t get_used(){return mzUse;} /**< number of lookups served by the helper     */
+    off_t get_hits(){return mzHit;} /**< number of those that found a key           */
+
+private:
+    static const int SPCSZE = 65536 ;   /**< Ring size (power of two)               */
+    static const int SPCMSK = SPCSZE - 1 ;
+    static const int SPCBAT = 16 ;      /**< Number of lookups per batch            */
+
+    /** Ring entry: izPos is cleared while the entry is being rewritten */
+    typedef struct {
+        std::atomic<off_t> izPos ;      /**< Position in the new file, -1 = none    */
+        std::atomic<hkey> ikHsh ;       /**< Key at that position                   */
+        std::atomic<off_t> izOrg ;      /**< Position in the original file, -1 = not found */
+    } rEnt ;
+
+    /**
+     * @brief Helper thread: hash and lookup ahead of the published position.
+     */
+    void run() ;
+
+    /**
+     * @brief Helper thread: wait until a new position is published (or stop).
+     */
+    void wait(const off_t azPub) ;
+
+    JHashPos const * const mpHsh ;  /**< Index                                  */
+    JFile * const mpFil ;           /**< Reader on the new file                 */
+    rEnt *mpRng ;                   /**< Ring of lookups                        */
+
+    off_t mzUse = 0 ;               /**< Lookups served (main thread)           */
+    off_t mzHit = 0 ;               /**< Lookups served that found a key        */
+
+    std::atomic<off_t> mzPub ;      /**< Published position                     */
+    std::atomic<bool> mbWai ;       /**< Helper is waiting ?                    */
+    std::atomic<bool> mbStp ;       /**< Stop the helper ?                      */
+    std::mutex moMtx ;              /**< Used with moCnd                        */
+    std::condition_variable moCnd ; /**< Signals a new position or stop         */
+    std::thread moThr ;             /**< Helper thread                          */
+};
+
+} /* namespace JojoDiff */
+#endif /* JSPECULATE_H_ */
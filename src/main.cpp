@@ -201,6 +201,7 @@
 #include <limits.h>
 #include <inttypes.h>
 #include <getopt.h>
+#include <thread>
 
 using namespace std ;
 
@@ -209,6 +210,7 @@ using namespace std ;
 #include <fstream>
 #include "JFileAheadIStream.h"
 #include "JFileAheadStdio.h"
+#include "JFileSpool.h"
 
 #include "JDefs.h"
 #include "JDiff.h"
@@ -218,8 +220,16 @@ using namespace std ;
 #include "JOutRgn.h"
 #include "JFile.h"
 #include "JFileOut.h"
+#include "JBestBase.h"
+#include "JFanout.h"
+#include "JArcDiff.h"
+#include "JShard.h"
+#include "JSignature.h"
+#include "JRebase.h"
+#include "JCpu.h"
+#include "JAuto.h"
 #ifdef JDIFF_DEDUP
-#include "JOutDedup.h"
+#include "JDedup.h"
 #endif // JDIFF_DEDUP
 
 #ifdef _WIN32
@@ -235,6 +245,9 @@ using namespace JojoDiff ;
 *********************************************************************************/
 const char *gcOptSht = "a:bcd:fhi:jk:lm:n:pqrst::uvx:y"; /* u:: for optional aruments */
 
+/* Codes for long options without a short option */
+enum {OPT_BSE = 256, OPT_THR, OPT_CHK, OPT_CPU, OPT_BDG, OPT_AUT, OPT_SPL, OPT_SPC, OPT_CST, OPT_FAN, OPT_ENT, OPT_LST, OPT_ARC, OPT_SHD, OPT_SIG, OPT_FSG, OPT_RBS, OPT_DFR, OPT_NER, OPT_ADP} ;
+
 struct option gsOptLng [] = {
     {"better",            no_argument,      NULL,'b'},
     {"lazy",              no_argument,      NULL,'f'},
@@ -255,11 +268,120 @@ struct option gsOptLng [] = {
     {"search-size",       required_argument,NULL,'a'},
     {"search-min",        required_argument,NULL,'n'},
     {"search-max",        required_argument,NULL,'x'},
-    {"reflink",           no_argument,      NULL,'y'},
+    {"dedup",             no_argument,      NULL,'y'},
     {"verbose",           no_argument,      NULL,'v'},
+    {"best-base",         optional_argument,NULL,OPT_BSE},
+    {"threads",           required_argument,NULL,OPT_THR},
+    {"chunk-size",        required_argument,NULL,OPT_CHK},
+    {"cpu",               required_argument,NULL,OPT_CPU},
+    {"time-budget",       required_argument,NULL,OPT_BDG},
+    {"auto",              no_argument,      NULL,OPT_AUT},
+    {"spool-size",        required_argument,NULL,OPT_SPL},
+    {"speculate",         no_argument,      NULL,OPT_SPC},
+    {"cost-model",        no_argument,      NULL,OPT_CST},
+    {"fanout",            no_argument,      NULL,OPT_FAN},
+    {"entropy",           no_argument,      NULL,OPT_ENT},
+    {"list",              no_argument,      NULL,OPT_LST},
+    {"archive",           no_argument,      NULL,OPT_ARC},
+    {"shards",            required_argument,NULL,OPT_SHD},
+    {"signature",         optional_argument,NULL,OPT_SIG},
+    {"from-signature",    no_argument,      NULL,OPT_FSG},
+    {"rebase",            no_argument,      NULL,OPT_RBS},
+    {"defer-compares",    no_argument,      NULL,OPT_DFR},
+    {"near-index",        no_argument,      NULL,OPT_NER},
+    {"adaptive-search",   no_argument,      NULL,OPT_ADP},
     {NULL,0,NULL,0}
 };
 
+/************************************************************************************
+* Open the output file (- = stdout)
+*************************************************************************************/
+FILE *ufOpenOut(const char *acFilNamOut, int aiVerbse)
+{
+    FILE *lpFilOut ;
+    if (strcmp(acFilNamOut, "-") == 0 ){
+        lpFilOut = stdout ;
+
+        // Windows needs dome additional tweaking for stdout to work
+        #ifdef _WIN32
+        if (aiVerbse > 1)
+            fprintf(JDebug::stddbg, "%s\n", "Setting Windows stdout to binary mode.");
+        setmode(fileno(lpFilOut), O_BINARY );
+        #endif // __WIN32__
+    } else {
+        lpFilOut = fopen(acFilNamOut, "wb") ;
+    }
+    if ( lpFilOut == null ) {
+        fprintf(JDebug::stddbg, "Could not open output file %s for writing.\n", acFilNamOut) ;
+        exit(- EXI_OUT);
+    }
+    return lpFilOut ;
+}
+
+/************************************************************************************
+* Print the operations of a patch (jdiff --list): count/bytes per operation
+*************************************************************************************/
+void ufPrtLst(const char *acNam, const off_t azCnt[5], const off_t azByt[5], off_t azPch)
+{
+    // indexes: BKT, EQL, DEL, INS, MOD
+    fprintf(stdout, "%s: MOD %" PRIzd "/%" PRIzd " INS %" PRIzd "/%" PRIzd " DEL %" PRIzd "/%" PRIzd
+                    " BKT %" PRIzd "/%" PRIzd " EQL %" PRIzd "/%" PRIzd " new %" PRIzd " patch %" PRIzd
+                    " control %" PRIzd "\n", acNam,
+            azCnt[MOD - BKT], azByt[MOD - BKT], azCnt[INS - BKT], azByt[INS - BKT],
+            azCnt[DEL - BKT], azByt[DEL - BKT], azCnt[0], azByt[0], azCnt[EQL - BKT], azByt[EQL - BKT],
+            azByt[MOD - BKT] + azByt[INS - BKT] + azByt[EQL - BKT], azPch,
+            azPch - azByt[MOD - BKT] - azByt[INS - BKT]) ;
+}
+
+/************************************************************************************
+* Report the result and exit
+*************************************************************************************/
+void ufExit(int aiRet, int aiVerbse)
+{
+    switch (aiRet) {
+    case EXI_SEK:
+        fprintf(JDebug::stddbg, "\nSeek error !\n");
+        exit (- EXI_SEK);
+    case EXI_LRG:
+        fprintf(JDebug::stddbg, "\nError: 64-bit offsets not supported !\n");
+        exit (- EXI_LRG);
+    case EXI_RED:
+        fprintf(JDebug::stddbg, "\nError reading file !\n");
+        exit (- EXI_RED);
+    case EXI_WRI:
+        fprintf(JDebug::stddbg, "\nError writing file !\n");
+        exit (- EXI_WRI);
+    case EXI_MEM:
+        fprintf(JDebug::stddbg, "\nError allocating memory !\n");
+        exit (- EXI_MEM);
+    case EXI_ARG:
+        fprintf(JDebug::stddbg, "\nError in arguments !\n");
+        exit (- EXI_ARG);
+    case EXI_ERR:
+        fprintf(JDebug::stddbg, "\nError occurred !\n");
+        exit (- EXI_ERR);
+    case EXI_FRT:
+        exit (- EXI_FRT);
+    case EXI_SCD:
+        exit (- EXI_SCD);
+    case EXI_OUT:
+        exit (- EXI_OUT);
+    case EXI_OK:
+        exit (EXI_OK) ;
+    case EXI_EQL:
+        if (aiVerbse > 1)
+            fprintf(JDebug::stddbg, "\nFound all data within source file.\n");
+        exit(EXI_OK) ;
+    case EXI_DIF:
+        if (aiVerbse > 1)
+            fprintf(JDebug::stddbg, "\nNot all data has been found in source file.\n");
+        exit(EXI_DIF) ;
+    default:
+        fprintf(JDebug::stddbg, "\nUnknown exit code %d\n", aiRet);
+        exit (- EXI_ERR);
+    }
+}
+
 /************************************************************************************
 * Main function
 *************************************************************************************/
@@ -284,19 +406,35 @@ int main(int aiArgCnt, char *acArg[])
     long llBufOrg = 0 ;           /**< Default source-file buffer in MB                 */
     long llBufNew = 0 ;           /**< Default destin-file buffer in MB                 */
     int liBlkSze = 32*1024 ;      /**< Default block size (in bytes)                    */
-    int liAhdMax = 0;             /**< Lookahead range (0=same as llBufSze)             */
+    off_t lzAhdMax = 0;           /**< Lookahead range (0=same as llBufSze)             */
     int liHlp=0;                  /**< -h/--help flag: 0=no, 1=-h, 2=-hh, 3=error       */
     bool lbStdio=false;           /**< use stdio                                        */
     int liTst=0;                  /**< test to execute : 0 = normal, 1 etc... see JTest */
     bool lbSeqOrg = false;        /**< Sequential source file ?                         */
     bool lbSeqNew = false;        /**< Sequential destination file ?                    */
-    enum {Diff, Patch, Dedup, Test} liFun = Diff;  /**< function to execute             */
+    int liBseTop = 3 ;            /**< Best-base: number of candidates to diff          */
+    int liThrCnt = 0 ;            /**< Number of threads (0=number of cpu's)            */
+    int liShdCnt = 0 ;            /**< Number of shards (worker processes)              */
+    int liSigBlk = JSignature::BLKDEF ; /**< Signature: block size                      */
+    int liChkAvg = 8192 ;         /**< Dedup: average chunk size                        */
+    JCpu::eCpu liCpu = JCpu::Auto ; /**< Vector kernels to use                          */
+    double ldBdgSec = 0 ;         /**< Time budget in seconds (0 = none)                */
+    bool lbAuto = false ;         /**< Tune settings from a sampling pre-pass ?         */
+    bool lbSpc = false ;          /**< Speculate index lookups on a helper thread ?     */
+    bool lbCst = false ;          /**< Elect matches on their encoded cost ?            */
+    bool lbDfr = false ;          /**< Defer out-of-buffer compares ?                   */
+    bool lbNer = false ;          /**< Look up in a near index first ?                  */
+    bool lbAdp = false ;          /**< Adapt the lookahead window ?                     */
+    bool lbEnt = false ;          /**< Entropy code the patch ?                         */
+    long llSplMem = 64 ;          /**< Spool sequential input: MB in memory (0=no spool)*/
+    int liArgMin ;                /**< Minimum number of arguments (incl. command)      */
+    enum {Diff, Patch, Dedup, Test, Base, Fanout, List, Archive, Shard, Sign, FromSig, Rebase} liFun = Diff;  /**< function to execute       */
 
     JDebug::stddbg = stderr ;     /**< Debug and informational (verbose) output         */
 
     /* optional arguments parsing */
     int liOptArgCnt=0 ;           /**< number of options */
-    char lcOptSht;                /**< short option code */
+    int lcOptSht;                 /**< short option code */
     int liOptLng;                 /**< long option index */
 
     /* Read options */
@@ -390,19 +528,110 @@ int main(int aiArgCnt, char *acArg[])
             break;
         case 'y':   // deduplicate
             liFun = Dedup ;
-            liOutTyp = 3 ;
-            lbStdio = true ;
+            break ;
+
+        case OPT_BSE: // best-base
+            liFun = Base ;
             if (optarg)
-                liTst = atoi(optarg);    //@todo: minimum dedup size
-            else
-                liTst=0;
+                liBseTop = atoi(optarg) ;
+            if (liBseTop <= 0) {
+                liBseTop = 1 ;
+                fprintf(JDebug::stddbg, "Warning: invalid --best-base specified, set to 1.\n");
+            }
+            break ;
+        case OPT_FAN: // fanout
+            liFun = Fanout ;
+            break ;
+        case OPT_LST: // list patches
+            liFun = List ;
+            break ;
+        case OPT_ARC: // archive
+            liFun = Archive ;
+            break ;
+        case OPT_SHD: // shards
+            liShdCnt = atoi(optarg) ;
+            if (liShdCnt <= 0) {
+                liShdCnt = 1 ;
+                fprintf(JDebug::stddbg, "Warning: invalid --shards specified, set to 1.\n");
+            }
+            liFun = Shard ;
+            break ;
+        case OPT_SIG: // signature
+            if (optarg)
+                liSigBlk = atoi(optarg) ;
+            if (liSigBlk < JSignature::BLKMIN) {
+                liSigBlk = JSignature::BLKMIN ;
+                fprintf(JDebug::stddbg, "Warning: invalid --signature block size specified, set to %d.\n", liSigBlk);
+            }
+            liFun = Sign ;
+            break ;
+        case OPT_FSG: // from-signature
+            liFun = FromSig ;
+            break ;
+        case OPT_RBS: // rebase
+            liFun = Rebase ;
+            break ;
+        case OPT_THR: // threads
+            liThrCnt = atoi(optarg) ;
+            if (liThrCnt < 0)
+                liThrCnt = 0 ;
+            break ;
+        case OPT_CHK: // chunk-size
+            liChkAvg = atoi(optarg) ;
+            if (liChkAvg <= 0) {
+                liChkAvg = 8192 ;
+                fprintf(JDebug::stddbg, "Warning: invalid --chunk-size specified, set to 8192.\n");
+            }
+            break ;
+        case OPT_CPU: // cpu
+            if (! JCpu::parse(optarg, liCpu)) {
+                liCpu = JCpu::Auto ;
+                fprintf(JDebug::stddbg, "Warning: invalid --cpu specified, set to auto.\n");
+            }
+            break ;
+        case OPT_BDG: // time-budget
+            ldBdgSec = atof(optarg) ;
+            if (ldBdgSec <= 0) {
+                ldBdgSec = 0 ;
+                fprintf(JDebug::stddbg, "Warning: invalid --time-budget specified, no budget set.\n");
+            }
+            break ;
+        case OPT_AUT: // auto
+            lbAuto = true ;
+            break ;
+        case OPT_SPL: // spool-size
+            llSplMem = atol(optarg) ;
+            if (llSplMem < 0) {
+                llSplMem = 64 ;
+                fprintf(JDebug::stddbg, "Warning: invalid --spool-size specified, set to 64.\n");
+            }
+            break ;
+        case OPT_CST: // cost-model
+            lbCst = true ;
+            break ;
+        case OPT_DFR: // defer-compares
+            lbDfr = true ;
+            break ;
+        case OPT_NER: // near-index
+            lbNer = true ;
+            break ;
+        case OPT_ADP: // adaptive-search
+            lbAdp = true ;
+            break ;
+        case OPT_ENT: // entropy
+            lbEnt = true ;
+            break ;
+        case OPT_SPC: // speculate
+            lbSpc = (thread::hardware_concurrency() != 1) ;
+            if (! lbSpc)
+                fprintf(JDebug::stddbg, "Warning: --speculate needs more than one cpu, ignored.\n");
             break ;
 
         case 'a': // search-ahead-size
             if (optarg)
-                liAhdMax = atoi(optarg) * 1024 ;
+                lzAhdMax = (off_t) atol(optarg) * 1024 ;
             else
-                liAhdMax = 0 ;
+                lzAhdMax = 0 ;
             break;
 
         case 'i': // index-size
@@ -475,9 +704,10 @@ int main(int aiArgCnt, char *acArg[])
         }
     }
     liOptArgCnt=optind-1;
+    liArgMin = (liFun == Dedup || liFun == List || liFun == Sign) ? 2 : (liFun == Rebase) ? 4 : 3 ;
 
     /* Output greetings */
-    if ((liVerbse>0) || (liHlp > 0 ) || (aiArgCnt - liOptArgCnt < 3)) {
+    if ((liVerbse>0) || (liHlp > 0 ) || (aiArgCnt - liOptArgCnt < liArgMin)) {
         fprintf(JDebug::stddbg, "\nJDIFF - binary diff version " JDIFF_VERSION "\n") ;
         fprintf(JDebug::stddbg, JDIFF_COPYRIGHT "\n");
         fprintf(JDebug::stddbg, "\n") ;
@@ -508,18 +738,31 @@ int main(int aiArgCnt, char *acArg[])
                 (int) (sizeof(off_t) * 8), (int) maxoff_t_gb, maxoff_t_mul, SMPSZE) ;
     }
 
-    if ((aiArgCnt - liOptArgCnt < 3) || (liHlp > 0) || (liVerbse>2)) {
+    if ((aiArgCnt - liOptArgCnt < liArgMin) || (liHlp > 0) || (liVerbse>2)) {
         // ruler:                0---------1---------2---------3---------4---------5---------6---------7---------8
         fprintf(JDebug::stddbg, "\n");
         fprintf(JDebug::stddbg, "JDiff differentiates two files so that the second file can be recreated from\n");
         fprintf(JDebug::stddbg, "the first by \"undiffing\". JDiff aims for the smallest possible diff file.\n\n"),
 
         fprintf(JDebug::stddbg, "Usage: jdiff -j [options] <source file> <destination file> [<diff file>]\n") ;
-        fprintf(JDebug::stddbg, "   or: jdiff -u [options] <source file> <diff file> [<destination file>]\n\n") ;
+        fprintf(JDebug::stddbg, "   or: jdiff -u [options] <source file> <diff file> [<destination file>]\n") ;
+        fprintf(JDebug::stddbg, "   or: jdiff --best-base[=k] [options] <destination file> <diff file> <source file>...\n") ;
+        fprintf(JDebug::stddbg, "   or: jdiff --fanout [options] <source file> <destination file>...\n") ;
+        fprintf(JDebug::stddbg, "   or: jdiff --list [options] <diff file>...\n") ;
+        fprintf(JDebug::stddbg, "   or: jdiff --signature[=<block size>] [options] <source file> [<signature file>]\n") ;
+        fprintf(JDebug::stddbg, "   or: jdiff --from-signature [options] <signature file> <destination file> [<diff file>]\n") ;
+        fprintf(JDebug::stddbg, "   or: jdiff --rebase [options] <source file> <diff file> <change diff file> [<new diff file>]\n") ;
+        #ifdef JDIFF_DEDUP
+        fprintf(JDebug::stddbg, "   or: jdiff -y [options] <file>...\n") ;
+        #endif // JDIFF_DEDUP
+        fprintf(JDebug::stddbg, "\n") ;
         fprintf(JDebug::stddbg, "  -j                       JDiff:  create a difference file.\n");
-        #ifdef JDIFF_DEDUP
-        #endif // JDIFF_DEDUP
-        fprintf(JDebug::stddbg, "  -u                       Undiff: undiff a difference file.\n\n");
+        #ifdef JDIFF_DEDUP
+        fprintf(JDebug::stddbg, "  -y --dedup               Dedup:  list duplicate regions within and across files.\n");
+        #endif // JDIFF_DEDUP
+        fprintf(JDebug::stddbg, "  -u                       Undiff: undiff a difference file.\n");
+        fprintf(JDebug::stddbg, "  --list                   List:   count/bytes per operation of difference files,\n");
+        fprintf(JDebug::stddbg, "                           without source file (with -r or -l: list operations).\n\n");
 
         fprintf(JDebug::stddbg, "  -v --verbose             Verbose: greeting, results and tips.\n");
         fprintf(JDebug::stddbg, "  -vv                      Extra Verbose: progress info and statistics.\n");
@@ -538,16 +781,59 @@ int main(int aiArgCnt, char *acArg[])
         #ifndef JDIFF_STDIO_ONLY
         fprintf(JDebug::stddbg, "  -s --stdio               Use stdio files (for testing).\n");
         #endif // JDIFF_STDIO_ONLY
-        #ifdef JDIFF_DEDUP
-        fprintf(JDebug::stddbg, "  -y --reflink             Reflink to source file when possible.\n") ;
-        #endif // JDIFF_DEDUP
         fprintf(JDebug::stddbg, "\n");
-        fprintf(JDebug::stddbg, "  -a --search-size <size>  Size (in KB) to search (default=buffer-size).\n");
+        fprintf(JDebug::stddbg, "  -a --search-size <size>  Max size (in KB) to search (default=buffer-size).\n");
         fprintf(JDebug::stddbg, "  -i --index-size  <size>  Size (in MB) for index table    (default 64).\n");
         fprintf(JDebug::stddbg, "  -k --block-size  <size>  Block size in bytes for reading (default 8192).\n");
         fprintf(JDebug::stddbg, "  -m --buffer-size <size>  Size (in KB) for search buffers (0=no buffering)\n");
         fprintf(JDebug::stddbg, "  -n --search-min <count>  Minimum number of matches to search (default %d).\n", liMchMin);
         fprintf(JDebug::stddbg, "  -x --search-max <count>  Maximum number of matches to search (default %d).\n\n", liMchMax);
+
+        fprintf(JDebug::stddbg, "  --best-base[=<k>]        Diff against the best of the given sources: rank them\n");
+        fprintf(JDebug::stddbg, "                           with sketches (cached as <source>.jsk) and diff the\n");
+        fprintf(JDebug::stddbg, "                           top-k (default %d). The chosen source is reported.\n", liBseTop);
+        fprintf(JDebug::stddbg, "  --fanout                 Diff the source against each destination, in parallel,\n");
+        fprintf(JDebug::stddbg, "                           into <destination>.jdf: the source is mapped and indexed once.\n");
+        fprintf(JDebug::stddbg, "  --archive                Diff tar or cpio archives member by member, or ELF images\n");
+        fprintf(JDebug::stddbg, "                           section by section, in parallel: members and sections\n");
+        fprintf(JDebug::stddbg, "                           are paired by name (plain patches only).\n");
+        fprintf(JDebug::stddbg, "  --shards <count>         Split the destination into <count> shards diffed by as\n");
+        fprintf(JDebug::stddbg, "                           many worker processes, sharing the mapped source and its\n");
+        fprintf(JDebug::stddbg, "                           index, into one patch (plain patches only).\n");
+        fprintf(JDebug::stddbg, "  --signature[=<size>]     Write the signature of the source: rolling and strong\n");
+        fprintf(JDebug::stddbg, "                           hashes of blocks of <size> bytes (default %d).\n", JSignature::BLKDEF);
+        fprintf(JDebug::stddbg, "  --from-signature         Diff the destination against the source it was made of,\n");
+        fprintf(JDebug::stddbg, "                           into a patch to undiff on that source as usual.\n");
+        fprintf(JDebug::stddbg, "  --rebase                 Update a diff file (source to destination) with a change\n");
+        fprintf(JDebug::stddbg, "                           diff file (destination to new destination): only the\n");
+        fprintf(JDebug::stddbg, "                           changed regions are diffed again.\n");
+        fprintf(JDebug::stddbg, "  --threads <count>        Number of parallel diffs or chunkers (default: number of cpu's).\n");
+        #ifdef JDIFF_DEDUP
+        fprintf(JDebug::stddbg, "  --chunk-size <size>      Dedup: average chunk size in bytes (default %d).\n", liChkAvg);
+        #endif // JDIFF_DEDUP
+        fprintf(JDebug::stddbg, "  --cpu <kernels>          Vector kernels: auto, scalar, sse2, avx2 or avx512\n");
+        fprintf(JDebug::stddbg, "                           (default auto = best supported by the cpu).\n");
+        fprintf(JDebug::stddbg, "  --time-budget <seconds>  Finish the diff within the given time: reduce the search\n");
+        fprintf(JDebug::stddbg, "                           effort when running late, stop searching when out of time.\n");
+        fprintf(JDebug::stddbg, "  --auto                   Choose -a -i -k -m -n -x and -b/-f from samples of both\n");
+        fprintf(JDebug::stddbg, "                           files and probe diffs (overrides these options).\n");
+        fprintf(JDebug::stddbg, "  --spool-size <size>      Size (in MB) to spool sequential input (stdin, pipes) in\n");
+        fprintf(JDebug::stddbg, "                           memory, the remainder goes to a temporary file (default\n");
+        fprintf(JDebug::stddbg, "                           %ld, 0 = no spooling: diff sequentially as with -p/-q).\n", llSplMem);
+        fprintf(JDebug::stddbg, "  --cost-model             Take the match that costs the least patch bytes to reach\n");
+        fprintf(JDebug::stddbg, "                           and start (data, escapes, operators and lengths), rather\n");
+        fprintf(JDebug::stddbg, "                           than the nearest one (smaller, a little slower).\n");
+        fprintf(JDebug::stddbg, "  --defer-compares         Compare out-of-buffer matches at the end of each search,\n");
+        fprintf(JDebug::stddbg, "                           in source order: fewer seeks, patch size may differ.\n");
+        fprintf(JDebug::stddbg, "  --near-index             Look up a small index around the read position first\n");
+        fprintf(JDebug::stddbg, "                           (helps when the index is too small, see -i).\n");
+        fprintf(JDebug::stddbg, "  --adaptive-search        Shrink the search size (-a) to the distances at which\n");
+        fprintf(JDebug::stddbg, "                           matches are found: faster, patch size may differ.\n");
+        fprintf(JDebug::stddbg, "  --speculate              Look up the new file in the index ahead of the search,\n");
+        fprintf(JDebug::stddbg, "                           on a helper thread (with full indexing only).\n");
+        fprintf(JDebug::stddbg, "  --entropy                Entropy code the patch (undiff detects it): smaller than\n");
+        fprintf(JDebug::stddbg, "                           a plain patch, no need for an external compressor.\n");
+        fprintf(JDebug::stddbg, "\n");
 
         fprintf(JDebug::stddbg, "Make  diff-file: jdiff -j old-file new-file diff-file.jdf\n");
         fprintf(JDebug::stddbg, "Apply diff-file: jdiff -u old-file diff-file.jdf recreated-new-file\n\n");
@@ -591,7 +877,7 @@ int main(int aiArgCnt, char *acArg[])
             fprintf(JDebug::stddbg, "  The -f/-ff options will only compare buffered data to gain some speed, but\n");
             fprintf(JDebug::stddbg, "  will often be slower due to the lower accuracy.\n");
         }
-        if (aiArgCnt - liOptArgCnt < 3){
+        if (aiArgCnt - liOptArgCnt < liArgMin){
             if  (liHlp == 0)
                 fprintf(JDebug::stddbg, "Error: Not enough arguments have been specified !\n");
 
@@ -601,6 +887,112 @@ int main(int aiArgCnt, char *acArg[])
         fprintf(JDebug::stddbg, "\nUse -h for additional help and usage description.\n");
     }
 
+    /* Select the vector kernels for this cpu */
+    if (JCpu::init(liCpu) != liCpu && liCpu != JCpu::Auto)
+        fprintf(JDebug::stddbg, "Warning: --cpu %s not supported, using %s.\n",
+                JCpu::name(liCpu), JCpu::name(JCpu::get())) ;
+    if (liVerbse > 1)
+        fprintf(JDebug::stddbg, "Vector kernels: %s\n", JCpu::name(JCpu::get())) ;
+
+    if (liThrCnt == 0) {
+        liThrCnt = thread::hardware_concurrency() ;
+        if (liThrCnt <= 0)
+            liThrCnt = 1 ;
+    }
+
+    #ifdef JDIFF_DEDUP
+    /* Deduplication: all arguments are input files, regions are listed on stdout */
+    if (liFun == Dedup) {
+        JOutDedup loOut(stdout) ;
+        JDedup loDedup(&loOut, liChkAvg, liThrCnt, liVerbse) ;
+        int liRet = loDedup.dedup(aiArgCnt - liOptArgCnt - 1, &acArg[1 + liOptArgCnt]) ;
+        if (liRet == EXI_DIF || liRet == EXI_EQL) {
+            fprintf(JDebug::stddbg, "\n");
+            fprintf(JDebug::stddbg, "Scanned     bytes       = %" PRIzd "\n", loDedup.getScnByt());
+            if (liVerbse > 0) {
+                fprintf(JDebug::stddbg, "Chunks      (avg %5d) = %ld\n", loDedup.getChkAvg(), loDedup.getChkCnt());
+                fprintf(JDebug::stddbg, "Unique      chunks      = %ld\n", loDedup.getUnqCnt());
+            }
+            fprintf(JDebug::stddbg, "Duplicate   regions     = %ld\n", loOut.glOutRgnDup);
+            fprintf(JDebug::stddbg, "Duplicate   bytes       = %" PRIzd " (%.1f%%)\n", loOut.gzOutBytDup,
+                    loDedup.getScnByt() > 0 ? loOut.gzOutBytDup * 100.0 / loDedup.getScnByt() : 0.0);
+        }
+        ufExit(liRet, liVerbse) ;
+    }
+    #endif // JDIFF_DEDUP
+
+    /* Patch listing: all arguments are patch files, the source files are never opened */
+    if (liFun == List) {
+        int liRet = EXI_OK ;
+        int liPchCnt = 0 ;
+        off_t lzTotCnt[5] = {0, 0, 0, 0, 0} ;
+        off_t lzTotByt[5] = {0, 0, 0, 0, 0} ;
+        off_t lzTotPch = 0 ;
+        for (int liArg = 1 + liOptArgCnt; liArg < aiArgCnt; liArg++) {
+            bool lbStdInp = (strcmp(acArg[liArg], csStdInpOutNam) == 0) ;
+            FILE *lfFilPch = lbStdInp ? stdin : jfopen(acArg[liArg], "rb") ;
+            if (lfFilPch == null) {
+                fprintf(JDebug::stddbg, "Could not open diff file %s for reading.\n", acArg[liArg]);
+                liRet = EXI_FRT ;
+                continue ;
+            }
+            int liPchRet ;
+            off_t lzPch ;
+            off_t lzCnt[5], lzByt[5] ;
+            {
+                JFileAheadStdio loFilPch(lfFilPch, "Pch", 1024 * 1024, 64 * 1024, lbStdInp) ;
+                JPatcht loJPatcht(loFilPch, (liOutTyp > 0) ? stdout : null, liVerbse) ;
+                liPchRet = loJPatcht.jpatch() ;
+                lzPch = loFilPch.getEofPos() ;
+                for (int liOpr = BKT; liOpr <= MOD; liOpr++) {
+                    lzCnt[liOpr - BKT] = loJPatcht.getOprCnt(liOpr) ;
+                    lzByt[liOpr - BKT] = loJPatcht.getOprByt(liOpr) ;
+                }
+            }
+            if (! lbStdInp)
+                jfclose(lfFilPch) ;
+            if (liPchRet != EXI_OK) {
+                fprintf(JDebug::stddbg, "Error %d listing diff file %s.\n", liPchRet, acArg[liArg]);
+                liRet = liPchRet ;
+                continue ;
+            }
+            ufPrtLst(acArg[liArg], lzCnt, lzByt, lzPch) ;
+            for (int liIdx = 0; liIdx < 5; liIdx++) {
+                lzTotCnt[liIdx] += lzCnt[liIdx] ;
+                lzTotByt[liIdx] += lzByt[liIdx] ;
+            }
+            lzTotPch += lzPch ;
+            liPchCnt ++ ;
+        }
+        if (liPchCnt > 1)
+            ufPrtLst("Total", lzTotCnt, lzTotByt, lzTotPch) ;
+        ufExit(liRet, liVerbse) ;
+    }
+
+    /* Signature: the source file only, read sequentially */
+    if (liFun == Sign) {
+        lcFilNamOrg = acArg[1 + liOptArgCnt];
+        lcFilNamOut = (aiArgCnt - liOptArgCnt >= 3) ? acArg[2 + liOptArgCnt] : "-" ;
+        bool lbStdInp = (strcmp(lcFilNamOrg, csStdInpOutNam) == 0) ;
+        FILE *lfFilOrg = lbStdInp ? stdin : jfopen(lcFilNamOrg, "rb") ;
+        if (lfFilOrg == null) {
+            fprintf(JDebug::stddbg, "Could not open source file %s for reading.\n", lcFilNamOrg);
+            ufExit(EXI_FRT, liVerbse) ;
+        }
+        lpFilOut = ufOpenOut(lcFilNamOut, liVerbse) ;
+        int liRet ;
+        {
+            JFileAheadStdio loFilOrg(lfFilOrg, "Org", 1024 * 1024, 64 * 1024, true) ;
+            JSignature loSig(liVerbse) ;
+            liRet = loSig.make(loFilOrg, lpFilOut, liSigBlk) ;
+        }
+        if (! lbStdInp)
+            jfclose(lfFilOrg) ;
+        if (lpFilOut != stdout && fclose(lpFilOut) != 0 && liRet >= 0)
+            liRet = EXI_WRI ;
+        ufExit(liRet, liVerbse) ;
+    }
+
     /* Read filenames */
     lcFilNamOrg = acArg[1 + liOptArgCnt];
     lcFilNamNew = acArg[2 + liOptArgCnt];
@@ -635,13 +1027,178 @@ int main(int aiArgCnt, char *acArg[])
         fprintf(JDebug::stddbg, "Warning: Destination buffer size misaligned with block size: set to %ld.\n", llBufNew);
     }
 
-    // Default search ahead window
-    if (liAhdMax==0){
-        liAhdMax = llBufNew - liBlkSze ;
-        if (liAhdMax > llBufNew - liBlkSze)
-            liAhdMax = llBufNew - liBlkSze ;
-        if (liAhdMax < 4096)
-            liAhdMax = 4096 ;
+    // Default search ahead window: within the buffer actually allocated
+    if (lzAhdMax==0){
+        lzAhdMax = JFileAhead::ringSze(llBufNew, liBlkSze) - liBlkSze ;
+        if (lzAhdMax < 4096)
+            lzAhdMax = 4096 ;
+    }
+
+    /* Automatic tuning: sample both files and probe */
+    if (lbAuto && liFun == Diff) {
+        if (lbSeqOrg || lbSeqNew
+         || strcmp(lcFilNamOrg, csStdInpOutNam) == 0 || strcmp(lcFilNamNew, csStdInpOutNam) == 0) {
+            fprintf(JDebug::stddbg, "Warning: --auto requires regular files, ignored.\n");
+        } else {
+            JDiffJob::rSet lrSet = {liHshMbt, liVerbse, lbSrcBkt != 0, liSrcScn, liMchMax, liMchMin,
+                                    lzAhdMax, lbCmpAll, llBufOrg, llBufNew, liBlkSze, lbCst, lbDfr, lbNer, lbAdp, lbEnt} ;
+            JAuto loAuto(liVerbse) ;
+            int liRet = loAuto.sample(lrSet, lcFilNamOrg, lcFilNamNew) ;
+            if (liRet != 0) {
+                fprintf(JDebug::stddbg, "Warning: --auto could not sample the files (%d), ignored.\n", liRet);
+            } else {
+                loAuto.tune(lrSet) ;
+                loAuto.print(JDebug::stddbg, lrSet) ;
+                liHshMbt = lrSet.iiHshMbt ;
+                lbSrcBkt = lrSet.ibSrcBkt ;
+                liSrcScn = lrSet.iiSrcScn ;
+                liMchMax = lrSet.iiMchMax ;
+                liMchMin = lrSet.iiMchMin ;
+                lzAhdMax = lrSet.izAhdMax ;
+                lbCmpAll = lrSet.ibCmpAll ;
+                llBufOrg = lrSet.ilBufOrg ;
+                llBufNew = lrSet.ilBufNew ;
+                liBlkSze = lrSet.iiBlkSze ;
+            }
+        }
+    }
+
+    /* Best-base selection */
+    if (liFun == Base) {
+        if (aiArgCnt - liOptArgCnt < 4) {
+            fprintf(JDebug::stddbg, "Error: --best-base requires a destination, a diff file and at least one source file !\n");
+            exit(- EXI_ARG);
+        }
+        JDiffJob::rSet lrSet = {liHshMbt, liVerbse, lbSrcBkt != 0, liSrcScn, liMchMax, liMchMin,
+                                lzAhdMax, lbCmpAll, llBufOrg, llBufNew, liBlkSze, lbCst, lbDfr, lbNer, lbAdp, lbEnt} ;
+        lpFilOut = ufOpenOut(lcFilNamNew, liVerbse) ;
+
+        JBestBase loBestBase(lrSet, liBseTop, liThrCnt, 1024, liVerbse) ;
+        int liRet = loBestBase.select(lcFilNamOrg, aiArgCnt - liOptArgCnt - 3, &acArg[3 + liOptArgCnt], lpFilOut) ;
+        if (loBestBase.getBse() != null)
+            fprintf(JDebug::stddbg, "Best base: %s (" P8zd " bytes)\n", loBestBase.getBse(), loBestBase.getBseOutSze()) ;
+        if (lpFilOut != stdout)
+            fclose(lpFilOut) ;
+        ufExit(liRet, liVerbse) ;
+    }
+
+    /* Fan-out: one source, many destinations */
+    if (liFun == Fanout) {
+        if (strcmp(lcFilNamOrg, csStdInpOutNam) == 0 || lbSeqOrg) {
+            fprintf(JDebug::stddbg, "Error: --fanout requires a regular source file !\n");
+            exit(- EXI_ARG);
+        }
+        JDiffJob::rSet lrSet = {liHshMbt, liVerbse, lbSrcBkt != 0, liSrcScn, liMchMax, liMchMin,
+                                lzAhdMax, lbCmpAll, llBufOrg, llBufNew, liBlkSze, lbCst, lbDfr, lbNer, lbAdp, lbEnt} ;
+        JFanout loFanout(lrSet, liThrCnt, liVerbse) ;
+        int liRet = loFanout.run(lcFilNamOrg, aiArgCnt - liOptArgCnt - 2, &acArg[2 + liOptArgCnt]) ;
+        ufExit(liRet, liVerbse) ;
+    }
+
+    /* Archives: diff member by member, or as plain files when that is not possible */
+    if (liFun == Archive) {
+        if (lbEnt) {
+            fprintf(JDebug::stddbg, "Warning: --entropy is not supported with --archive, ignored.\n");
+            lbEnt = false ;
+        }
+        JDiffJob::rSet lrSet = {liHshMbt, liVerbse, lbSrcBkt != 0, liSrcScn, liMchMax, liMchMin,
+                                lzAhdMax, lbCmpAll, llBufOrg, llBufNew, liBlkSze, lbCst, lbDfr, lbNer, lbAdp, lbEnt} ;
+        JArcDiff loArcDiff(lrSet, liThrCnt, liVerbse) ;
+        int liRet = EXI_ARG ;
+        if (strcmp(lcFilNamOrg, csStdInpOutNam) != 0 && strcmp(lcFilNamNew, csStdInpOutNam) != 0
+         && ! lbSeqOrg && ! lbSeqNew)
+            liRet = loArcDiff.open(lcFilNamOrg, lcFilNamNew) ;
+        if (liRet == 0) {
+            lpFilOut = ufOpenOut(lcFilNamOut, liVerbse) ;
+            liRet = loArcDiff.run(lpFilOut) ;
+            if (lpFilOut != stdout && fclose(lpFilOut) != 0 && liRet >= 0)
+                liRet = EXI_WRI ;
+            ufExit(liRet, liVerbse) ;
+        } else if (liRet != EXI_ARG) {
+            ufExit(liRet, liVerbse) ;
+        }
+        fprintf(JDebug::stddbg, "Warning: --archive requires two tar, cpio or ELF files of one format, diffing as plain files.\n");
+        liFun = Diff ;
+    }
+
+    /* Shards: diff by worker processes, or in this process when that is not possible */
+    if (liFun == Shard) {
+        if (lbEnt) {
+            fprintf(JDebug::stddbg, "Warning: --entropy is not supported with --shards, ignored.\n");
+            lbEnt = false ;
+        }
+        JDiffJob::rSet lrSet = {liHshMbt, liVerbse, lbSrcBkt != 0, liSrcScn, liMchMax, liMchMin,
+                                lzAhdMax, lbCmpAll, llBufOrg, llBufNew, liBlkSze, lbCst, lbDfr, lbNer, lbAdp, lbEnt} ;
+        JShard loShard(lrSet, liShdCnt, liVerbse) ;
+        int liRet = EXI_ARG ;
+        if (strcmp(lcFilNamOrg, csStdInpOutNam) != 0 && strcmp(lcFilNamNew, csStdInpOutNam) != 0
+         && ! lbSeqOrg && ! lbSeqNew)
+            liRet = loShard.open(lcFilNamOrg, lcFilNamNew) ;
+        if (liRet == 0) {
+            lpFilOut = ufOpenOut(lcFilNamOut, liVerbse) ;
+            liRet = loShard.run(lpFilOut) ;
+            if (lpFilOut != stdout && fclose(lpFilOut) != 0 && liRet >= 0)
+                liRet = EXI_WRI ;
+            ufExit(liRet, liVerbse) ;
+        } else if (liRet != EXI_ARG) {
+            ufExit(liRet, liVerbse) ;
+        }
+        fprintf(JDebug::stddbg, "Warning: --shards requires two regular files that can be mapped, diffing in one process.\n");
+        liFun = Diff ;
+    }
+
+    /* From signature: the signature replaces the source file, the destination is read sequentially */
+    if (liFun == FromSig) {
+        FILE *lfFilSig = jfopen(lcFilNamOrg, "rb") ;
+        if (lfFilSig == null) {
+            fprintf(JDebug::stddbg, "Could not open signature file %s for reading.\n", lcFilNamOrg);
+            ufExit(EXI_FRT, liVerbse) ;
+        }
+        JSignature loSig(liVerbse) ;
+        int liRet = loSig.load(lfFilSig) ;
+        jfclose(lfFilSig) ;
+        if (liRet != EXI_OK) {
+            fprintf(JDebug::stddbg, "Error %d reading signature file %s.\n", liRet, lcFilNamOrg);
+            ufExit(liRet, liVerbse) ;
+        }
+        bool lbStdInp = (strcmp(lcFilNamNew, csStdInpOutNam) == 0) ;
+        FILE *lfFilNew = lbStdInp ? stdin : jfopen(lcFilNamNew, "rb") ;
+        if (lfFilNew == null) {
+            fprintf(JDebug::stddbg, "Could not open destination file %s for reading.\n", lcFilNamNew);
+            ufExit(EXI_SCD, liVerbse) ;
+        }
+        lpFilOut = ufOpenOut(lcFilNamOut, liVerbse) ;
+        {
+            JFileAheadStdio loFilNew(lfFilNew, "New", 1024 * 1024, 64 * 1024, true) ;
+            JOutBin loOut(lpFilOut, lbEnt) ;
+            liRet = loSig.delta(loFilNew, loOut) ;
+        }
+        if (! lbStdInp)
+            jfclose(lfFilNew) ;
+        if (lpFilOut != stdout && fclose(lpFilOut) != 0 && liRet >= 0)
+            liRet = EXI_WRI ;
+        ufExit(liRet, liVerbse) ;
+    }
+
+    /* Rebase: a diff file and a change diff file replace the destination */
+    if (liFun == Rebase) {
+        const char *lcFilNamChg = acArg[3 + liOptArgCnt];
+        lcFilNamOut = (aiArgCnt - liOptArgCnt >= 5) ? acArg[4 + liOptArgCnt] : "-" ;
+        JDiffJob::rSet lrSet = {liHshMbt, liVerbse, lbSrcBkt != 0, liSrcScn, liMchMax, liMchMin,
+                                lzAhdMax, lbCmpAll, llBufOrg, llBufNew, liBlkSze, lbCst, lbDfr, lbNer, lbAdp, lbEnt} ;
+        JRebase loRebase(lrSet, liVerbse) ;
+        int liRet = loRebase.open(lcFilNamOrg, lcFilNamNew, lcFilNamChg) ;
+        if (liRet == EXI_ARG) {
+            fprintf(JDebug::stddbg, "Error: --rebase requires a source file that can be mapped.\n");
+        } else if (liRet != 0) {
+            fprintf(JDebug::stddbg, "Error %d applying %s or %s.\n", liRet, lcFilNamNew, lcFilNamChg);
+        } else {
+            lpFilOut = ufOpenOut(lcFilNamOut, liVerbse) ;
+            liRet = loRebase.run(lpFilOut) ;
+            if (lpFilOut != stdout && fclose(lpFilOut) != 0 && liRet >= 0)
+                liRet = EXI_WRI ;
+        }
+        ufExit(liRet, liVerbse) ;
     }
 
     /* Open files and create file handlers */
@@ -656,6 +1213,8 @@ int main(int aiArgCnt, char *acArg[])
 
     FILE *lfFilOrg = NULL ;
     FILE *lfFilNew = NULL ;
+    FILE *lfFilSpc = NULL ;         // second reader on the new file for --speculate
+    JFile *lpJflSpc = NULL ;
 
     if (lbStdio) {
         /* Open first file */
@@ -688,10 +1247,7 @@ int main(int aiArgCnt, char *acArg[])
             // create a JFile
             lpJflNew = new JFileAheadStdio(stdin, "New", llBufNew, liBlkSze, lbSeqNew);
         } else {
-            if (liFun == Dedup)
-                lfFilNew = jfopen(lcFilNamNew, "r+b") ;
-            else
-                lfFilNew = jfopen(lcFilNamNew, "rb") ;
+            lfFilNew = jfopen(lcFilNamNew, "rb") ;
             if (lfFilNew != NULL) {
                 lpJflNew = new JFileAheadStdio(lfFilNew, "New", llBufNew, liBlkSze, lbSeqNew);
             }
@@ -752,31 +1308,18 @@ int main(int aiArgCnt, char *acArg[])
     }
 
     /* Open output */
-    if (liFun == Dedup) {
-        lpFilOut = null ;
-    } else {
-        if (strcmp(lcFilNamOut,csStdInpOutNam) == 0 ){
-            lpFilOut = stdout ;
-
-            // Windows needs dome additional tweaking for stdout to work
-            #ifdef _WIN32
-            if (liVerbse > 1)
-                fprintf(JDebug::stddbg, "%s\n", "Setting Windows stdout to binary mode.");
-            setmode(fileno(lpFilOut), O_BINARY );
-            #endif // __WIN32__
-        } else {
-            lpFilOut = fopen(lcFilNamOut, "wb") ;
-        }
-        if ( lpFilOut == null ) {
-            fprintf(JDebug::stddbg, "Could not open output file %s for writing.\n", lcFilNamOut) ;
-            exit(- EXI_OUT);
-        }
-    }
+    lpFilOut = ufOpenOut(lcFilNamOut, liVerbse) ;
 
     /* Execute required function */
     int liRet = EXI_ARG ; /**< default return code */
-    if (liFun == Diff || liFun == Test || liFun == Dedup) {
+    if (liFun == Diff || liFun == Test) {
         /* Perform JDiff */
+        // Spool sequential files (stdin, pipes) to diff them as seekable files
+        if (llSplMem > 0 && ! lbSeqOrg && lpJflOrg->isSequential())
+            lpJflOrg = new JFileSpool(lpJflOrg, "Org", llBufOrg, liBlkSze, llSplMem * 1024 * 1024) ;
+        if (llSplMem > 0 && ! lbSeqNew && lpJflNew->isSequential())
+            lpJflNew = new JFileSpool(lpJflNew, "New", llBufNew, liBlkSze, llSplMem * 1024 * 1024) ;
+
         // Switch to sequential source file
         if (! lbSeqOrg && lpJflOrg->isSequential()){
             lbSeqOrg = true ;
@@ -798,16 +1341,11 @@ int main(int aiArgCnt, char *acArg[])
         JOut *lpOut ;
         switch (liOutTyp) {
         case 0:
-            lpOut = new JOutBin(lpFilOut);
+            lpOut = new JOutBin(lpFilOut, lbEnt);
             break;
         case 1:
             lpOut = new JOutAsc(lpFilOut);
             break;
-        #ifdef JDIFF_DEDUP
-        case 3:
-            lpOut = new JOutDedup(*lpJflOrg, *lpJflNew, liVerbse) ;
-            break ;
-        #endif // JDIFF_DEDUP
         case 2:
         default:  // XXX get rid of uninitialized warning
             lpOut = new JOutRgn(lpFilOut);
@@ -817,15 +1355,28 @@ int main(int aiArgCnt, char *acArg[])
         /* Initialize JDiff object */
         JDiff loJDiff(lpJflOrg, lpJflNew, lpOut,
                       liHshMbt, liVerbse,
-                      lbSrcBkt, liSrcScn, liMchMax, liMchMin, liAhdMax, lbCmpAll);
+                      lbSrcBkt, liSrcScn, liMchMax, liMchMin, lzAhdMax, lbCmpAll);
+        loJDiff.setCost(lbCst) ;
+        loJDiff.setDefer(lbDfr) ;
+        loJDiff.setNear(lbNer) ;
+        loJDiff.setAdapt(lbAdp) ;
+
+        /* Speculate on a second reader of the new file (a regular file) */
+        if (lbSpc && liSrcScn > 0 && ! lbSeqNew && strcmp(lcFilNamNew, csStdInpOutNam) != 0) {
+            lfFilSpc = jfopen(lcFilNamNew, "rb") ;
+            if (lfFilSpc != NULL) {
+                lpJflSpc = new JFileAheadStdio(lfFilSpc, "Spc", 256 * 1024, liBlkSze, false);
+                loJDiff.setSpeculate(lpJflSpc) ;
+            }
+        }
 
         /* Show execution parameters */
         if (liVerbse>1) {
             fprintf(JDebug::stddbg, "\n");
-            fprintf(JDebug::stddbg, "Index table size (default: 64Mb) (-s): %dMb (%d samples)\n",
+            fprintf(JDebug::stddbg, "Index table size (default: 64Mb) (-s): %" PRIzd "Mb (%" PRIzd " samples)\n",
                     ((loJDiff.getHsh()->get_hashsize() + 512) / 1024 + 512) / 1024,
                     loJDiff.getHsh()->get_hashprime()) ;
-            fprintf(JDebug::stddbg, "Search size     (0 = buffersize) (-a): %dkb\n",  liAhdMax / 1024 );
+            fprintf(JDebug::stddbg, "Search size     (0 = buffersize) (-a): %" PRIzd "kb\n",  lzAhdMax / 1024 );
             fprintf(JDebug::stddbg, "Buffer size       (default  2Mb) (-m): %ldMb\n", (llBufOrg + llBufNew) / 1024 / 1024);
             fprintf(JDebug::stddbg, "Block  size       (default 32kb) (-b): %dkb\n",  liBlkSze / 1024);
             fprintf(JDebug::stddbg, "Min number of matches to search  (-n): %d\n", liMchMin);
@@ -833,9 +1384,16 @@ int main(int aiArgCnt, char *acArg[])
             fprintf(JDebug::stddbg, "Compare out-of-buffer (-f to disable): %s\n",    lbCmpAll?"yes":"no");
             fprintf(JDebug::stddbg, "Full indexing scan   (-ff to disbale): %s\n",   (liSrcScn>0)?"yes":"no");
             fprintf(JDebug::stddbg, "Backtrace allowed     (-p to disable): %s\n",    lbSrcBkt?"yes":"no");
+            fprintf(JDebug::stddbg, "Elect matches on cost  (--cost-model): %s\n",    lbCst?"yes":"no");
+            fprintf(JDebug::stddbg, "Defer compares     (--defer-compares): %s\n",    lbDfr?"yes":"no");
+            fprintf(JDebug::stddbg, "Near index first       (--near-index): %s\n",    lbNer?"yes":"no");
+            fprintf(JDebug::stddbg, "Adaptive search   (--adaptive-search): %s\n",    lbAdp?"yes":"no");
+            fprintf(JDebug::stddbg, "Entropy coded patch       (--entropy): %s\n",    lbEnt?"yes":"no");
         }
 
         /* Execute... */
+        if (ldBdgSec > 0)
+            loJDiff.setBudget(ldBdgSec) ;
         liRet = loJDiff.jdiff();
         if (liRet == EXI_OK) {
             if (lpOut->gzOutBytDta > 0)
@@ -847,11 +1405,30 @@ int main(int aiArgCnt, char *acArg[])
         /* Write statistics */
         if (liVerbse > 1) {
             fprintf(JDebug::stddbg, "\n");
-            fprintf(JDebug::stddbg, "Index table hits        = %d\n",   loJDiff.getHsh()->get_hashhits()) ;
-            fprintf(JDebug::stddbg, "Index table repairs     = %d\n",   loJDiff.getMch()->getHshRpr()) ;
+            fprintf(JDebug::stddbg, "Index table hits        = %" PRIzd "\n",   loJDiff.getHshHit()) ;
+            if (loJDiff.getNer() != null)
+                fprintf(JDebug::stddbg, "Near  index hits        = %" PRIzd "\n",   loJDiff.getNer()->get_hits()) ;
+            if (loJDiff.getSpc() != null)
+                fprintf(JDebug::stddbg, "Speculative lookups     = %" PRIzd " (%" PRIzd " hits)\n",
+                        loJDiff.getSpc()->get_used(), loJDiff.getSpc()->get_hits()) ;
+            fprintf(JDebug::stddbg, "Run   index runs        = %" PRIzd "\n",   loJDiff.getHsh()->get_runcount()) ;
+            fprintf(JDebug::stddbg, "Run   index hits        = %" PRIzd "\n",   loJDiff.getRunHit()) ;
+            if (loJDiff.getHsh()->get_runlost() > 0)
+                fprintf(JDebug::stddbg, "Run   index lost        = %" PRIzd "\n",   loJDiff.getHsh()->get_runlost()) ;
+            fprintf(JDebug::stddbg, "Index table repairs     = %" PRIzd "\n",   loJDiff.getMch()->getHshRpr()) ;
+            fprintf(JDebug::stddbg, "Deferred    compares    = %" PRIzd "\n",   loJDiff.getMch()->getChkDfr()) ;
             fprintf(JDebug::stddbg, "Index table overloading = %d\n",   loJDiff.getHsh()->get_hashcolmax() / 4 - 1);
             fprintf(JDebug::stddbg, "Reliability distance    = %d\n",   loJDiff.getHsh()->get_reliability());
-            fprintf(JDebug::stddbg, "Inaccurate  solutions   = %d\n",   loJDiff.getHshErr()) ;
+            fprintf(JDebug::stddbg, "Inaccurate  solutions   = %" PRIzd "\n",   loJDiff.getHshErr()) ;
+            if (ldBdgSec > 0) {
+                fprintf(JDebug::stddbg, "Budget effort reduction = %d\n",   loJDiff.getBdgLvl()) ;
+                if (loJDiff.getBdgPnc() >= 0)
+                    fprintf(JDebug::stddbg, "Budget search stop      = %" PRIzd "\n", loJDiff.getBdgPnc()) ;
+            }
+            fprintf(JDebug::stddbg, "Lookahead   windows     = %" PRIzd " / %" PRIzd " / %" PRIzd " (min/avg/max)\n",
+                    loJDiff.getAhdLow(), loJDiff.getAhdAvg(), loJDiff.getAhdHig()) ;
+            fprintf(JDebug::stddbg, "Lookahead   restarts    = %" PRIzd " (%" PRIzd " bytes warm-up)\n",
+                    loJDiff.getIniCnt(), loJDiff.getIniByt()) ;
             fprintf(JDebug::stddbg, "Source      seeks       = %ld\n",  lpJflOrg->seekcount());
             fprintf(JDebug::stddbg, "Destination seeks       = %ld\n",  lpJflNew->seekcount());
             fprintf(JDebug::stddbg, "Delete      bytes       = %" PRIzd "\n", lpOut->gzOutBytDel);
@@ -866,6 +1443,9 @@ int main(int aiArgCnt, char *acArg[])
             fprintf(JDebug::stddbg, "Control-Esc bytes       = %" PRIzd "\n", lpOut->gzOutBytCtl + lpOut->gzOutBytEsc);
             fprintf(JDebug::stddbg, "Total       bytes       = %" PRIzd "\n",
                     lpOut->gzOutBytCtl + lpOut->gzOutBytEsc + lpOut->gzOutBytDta);
+            if (lbEnt && liOutTyp == 0)
+                fprintf(JDebug::stddbg, "Entropy     coded       = %" PRIzd "\n",
+                        ((JOutBin *) lpOut)->getEntSze());
         }
     } /* liFun == 0 or 2 */
     if (liFun == Patch || liFun == Test) {
@@ -878,6 +1458,7 @@ int main(int aiArgCnt, char *acArg[])
     /* Cleanup */
     delete lpJflOrg;
     delete lpJflNew;
+    delete lpJflSpc;
 
     #ifndef JDIFF_STDIO_ONLY
     if (! lbStdio) {
@@ -891,43 +1472,9 @@ int main(int aiArgCnt, char *acArg[])
     #endif // JDIFF_STDIO_ONLY
     if (lfFilOrg != NULL) jfclose(lfFilOrg);
     if (lfFilNew != NULL) jfclose(lfFilNew);
+    if (lfFilSpc != NULL) jfclose(lfFilSpc);
 
 
     /* Exit */
-    switch (liRet) {
-    case EXI_SEK:
-        fprintf(JDebug::stddbg, "\nSeek error !\n");
-        exit (- EXI_SEK);
-    case EXI_LRG:
-        fprintf(JDebug::stddbg, "\nError: 64-bit offsets not supported !\n");
-        exit (- EXI_LRG);
-    case EXI_RED:
-        fprintf(JDebug::stddbg, "\nError reading file !\n");
-        exit (- EXI_RED);
-    case EXI_WRI:
-        fprintf(JDebug::stddbg, "\nError writing file !\n");
-        exit (- EXI_WRI);
-    case EXI_MEM:
-        fprintf(JDebug::stddbg, "\nError allocating memory !\n");
-        exit (- EXI_MEM);
-    case EXI_ARG:
-        fprintf(JDebug::stddbg, "\nError in arguments !\n");
-        exit (- EXI_ARG);
-    case EXI_ERR:
-        fprintf(JDebug::stddbg, "\nError occurred !\n");
-        exit (- EXI_ERR);
-    case EXI_OK:
-        exit (EXI_OK) ;
-    case EXI_EQL:
-        if (liVerbse > 1)
-            fprintf(JDebug::stddbg, "\nFound all data within source file.\n");
-        exit(EXI_OK) ;
-    case EXI_DIF:
-        if (liVerbse > 1)
-            fprintf(JDebug::stddbg, "\nNot all data has been found in source file.\n");
-        exit(EXI_DIF) ;
-    default:
-        fprintf(JDebug::stddbg, "\nUnknown exit code %d\n", liRet);
-        exit (- EXI_ERR);
-    }
+    ufExit(liRet, liVerbse) ;
 }